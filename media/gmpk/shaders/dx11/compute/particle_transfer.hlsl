@@ -5,40 +5,14 @@ cbuffer Constant : register(b0)
 	float __padding[3];
 };
 
-struct gravity_t
+// 与GMParticleInstance的布局一致
+struct instance_t
 {
-	float4 initialVelocity;
-	float radialAcceleration;
-	float tangentialAcceleration;
-	float __padding__[2];
-};
-
-struct radius_t
-{
-	float angle;
-	float degressPerSecond;
-	float radius;
-	float deltaRadius;
-};
-
-struct particle_t
-{
-	float4 color;
-	float4 deltaColor;
-	float4 position;
-	float4 startPosition;
-	float4 changePosition;
-	float4 velocity;
+	float3 position;
 	float size;
-	float currentSize;
-	float deltaSize;
+	float4 color;
 	float rotation;
-	float deltaRotation;
-	float remainingLife;
-	float __padding__[2];
-
-	gravity_t gravityModeData;
-	radius_t radiusModeData;
+	float __padding__[3];
 };
 
 struct vertex_t
@@ -54,7 +28,7 @@ struct vertex_t
 	float weights[4];
 };
 
-StructuredBuffer<particle_t> particles : register(t0);
+StructuredBuffer<instance_t> instances : register(t0);
 RWStructuredBuffer<vertex_t> vertex : register(u0);
 
 float4x4 rotate(float angle, float3 axis)
@@ -94,16 +68,16 @@ void main(uint3 DTid : SV_DispatchThreadID)
 	};
 
     // ignoreZ如果为1，表示忽略z坐标，这是个2D上的粒子渲染
-	float z = (ignoreZ != 0) ? 0 : particles[gid].position.z;
-	float halfExt = particles[gid].size / 2.f;
+	float z = (ignoreZ != 0) ? 0 : instances[gid].position.z;
+	float halfExt = instances[gid].size / 2.f;
 	float4 raw[4] = {
-		float4(particles[gid].position.x - halfExt, particles[gid].position.y - halfExt, z, 1),
-		float4(particles[gid].position.x - halfExt, particles[gid].position.y + halfExt, z, 1),
-		float4(particles[gid].position.x + halfExt, particles[gid].position.y - halfExt, z, 1),
-		float4(particles[gid].position.x + halfExt, particles[gid].position.y + halfExt, z, 1),
+		float4(instances[gid].position.x - halfExt, instances[gid].position.y - halfExt, z, 1),
+		float4(instances[gid].position.x - halfExt, instances[gid].position.y + halfExt, z, 1),
+		float4(instances[gid].position.x + halfExt, instances[gid].position.y - halfExt, z, 1),
+		float4(instances[gid].position.x + halfExt, instances[gid].position.y + halfExt, z, 1),
 	};
 
-	float4x4 rotation = rotate(particles[gid].rotation, float3(0, 0, 1));
+	float4x4 rotation = rotate(instances[gid].rotation, float3(0, 0, 1));
 	float4 transformed[4] = {
 		mul(raw[0], rotation),
 		mul(raw[1], rotation),
@@ -114,8 +88,8 @@ void main(uint3 DTid : SV_DispatchThreadID)
 	// 使用billboard效果
 	if (ignoreZ == 0)
 	{
-		float4x4 transToOrigin = translate(-particles[gid].position.xyz);
-		float4x4 transToPos = translate(particles[gid].position.xyz);
+		float4x4 transToOrigin = translate(-instances[gid].position.xyz);
+		float4x4 transToPos = translate(instances[gid].position.xyz);
 		float4x4 tBillboard = transpose(billboardRotation);
 		transformed[0] = mul(mul(mul(raw[0], transToOrigin), tBillboard), transToPos);
 		transformed[1] = mul(mul(mul(raw[1], transToOrigin), tBillboard), transToPos);
@@ -189,9 +163,9 @@ void main(uint3 DTid : SV_DispatchThreadID)
 		vertex[vertexOffset + i].weights[0] = vertex[vertexOffset + i].weights[1] = vertex[vertexOffset + i].weights[2] = vertex[vertexOffset + i].weights[3] = 0.f;
 		vertex[vertexOffset + i].boneIDs[0] = vertex[vertexOffset + i].boneIDs[1] = vertex[vertexOffset + i].boneIDs[2] = vertex[vertexOffset + i].boneIDs[3] = 0;
 
-		vertex[vertexOffset + i].colors[0] = particles[gid].color.x;
-		vertex[vertexOffset + i].colors[1] = particles[gid].color.y;
-		vertex[vertexOffset + i].colors[2] = particles[gid].color.z;
-		vertex[vertexOffset + i].colors[3] = particles[gid].color.w;
+		vertex[vertexOffset + i].colors[0] = instances[gid].color.x;
+		vertex[vertexOffset + i].colors[1] = instances[gid].color.y;
+		vertex[vertexOffset + i].colors[2] = instances[gid].color.z;
+		vertex[vertexOffset + i].colors[3] = instances[gid].color.w;
 	}
 }
\ No newline at end of file
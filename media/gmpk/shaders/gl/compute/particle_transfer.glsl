@@ -8,45 +8,19 @@ layout(std140, binding = 0) uniform Constant
     int ignoreZ;
 };
 
-struct gravity_t
+// 与GMParticleInstance的布局一致
+struct instance_t
 {
-    vec3 initialVelocity;
-    float _padding_; // initialVelocity's placeholder
-    float radialAcceleration;
-    float tangentialAcceleration;
-};
-
-struct radius_t
-{
-    float angle;
-    float degressPerSecond;
-    float radius;
-    float deltaRadius;
-};
-
-struct particle_t
-{
-    vec4 color;
-    vec4 deltaColor;
     vec3 position;
-    vec3 startPosition;
-    vec3 changePosition;
-    vec3 velocity;
-    float _padding_; // velocity's placeholder
     float size;
-    float currentSize;
-    float deltaSize;
+    vec4 color;
     float rotation;
-    float deltaRotation;
-    float remainingLife;
-
-    gravity_t gravityModeData;
-    radius_t radiusModeData;
+    float _padding_[3];
 };
 
-layout(std430, binding = 1) buffer Particle
+layout(std430, binding = 1) buffer Instance
 {
-    particle_t particles[];
+    instance_t instances[];
 };
 
 struct vertex_t
@@ -102,16 +76,16 @@ void main(void)
     };
 
     // ignoreZ如果为1，表示忽略z坐标，这是个2D上的粒子渲染
-    float z = (ignoreZ != 0) ? 0 : particles[gid].position.z;
-    float halfExt = particles[gid].size / 2.f;
+    float z = (ignoreZ != 0) ? 0 : instances[gid].position.z;
+    float halfExt = instances[gid].size / 2.f;
     vec4 raw[4] = {
-        vec4(particles[gid].position.x - halfExt, particles[gid].position.y - halfExt, z, 1),
-        vec4(particles[gid].position.x - halfExt, particles[gid].position.y + halfExt, z, 1),
-        vec4(particles[gid].position.x + halfExt, particles[gid].position.y - halfExt, z, 1),
-        vec4(particles[gid].position.x + halfExt, particles[gid].position.y + halfExt, z, 1),
+        vec4(instances[gid].position.x - halfExt, instances[gid].position.y - halfExt, z, 1),
+        vec4(instances[gid].position.x - halfExt, instances[gid].position.y + halfExt, z, 1),
+        vec4(instances[gid].position.x + halfExt, instances[gid].position.y - halfExt, z, 1),
+        vec4(instances[gid].position.x + halfExt, instances[gid].position.y + halfExt, z, 1),
     };
 
-    mat4 rotation = rotate(particles[gid].rotation, vec3(0, 0, 1));
+    mat4 rotation = rotate(instances[gid].rotation, vec3(0, 0, 1));
     vec4 transformed[4] = {
         rotation * raw[0],
         rotation * raw[1],
@@ -122,8 +96,8 @@ void main(void)
     // 使用billboard效果
     if (ignoreZ == 0)
     {
-        mat4 transToOrigin = translate(-particles[gid].position);
-        mat4 transToPos = translate(particles[gid].position);
+        mat4 transToOrigin = translate(-instances[gid].position);
+        mat4 transToPos = translate(instances[gid].position);
         transformed[0] = transToPos * billboardRotation * transToOrigin * transformed[0];
         transformed[1] = transToPos * billboardRotation * transToOrigin * transformed[1];
         transformed[2] = transToPos * billboardRotation * transToOrigin * transformed[2];
@@ -196,9 +170,9 @@ void main(void)
         vertex[vertexOffset + i].weights[0] = vertex[vertexOffset + i].weights[1] = vertex[vertexOffset + i].weights[2] = vertex[vertexOffset + i].weights[3] = 0.f;
         vertex[vertexOffset + i].boneIDs[0] = vertex[vertexOffset + i].boneIDs[1] = vertex[vertexOffset + i].boneIDs[2] = vertex[vertexOffset + i].boneIDs[3] = 0;
 
-        vertex[vertexOffset + i].colors[0] = particles[gid].color.x;
-        vertex[vertexOffset + i].colors[1] = particles[gid].color.y;
-        vertex[vertexOffset + i].colors[2] = particles[gid].color.z;
-        vertex[vertexOffset + i].colors[3] = particles[gid].color.w;
+        vertex[vertexOffset + i].colors[0] = instances[gid].color.x;
+        vertex[vertexOffset + i].colors[1] = instances[gid].color.y;
+        vertex[vertexOffset + i].colors[2] = instances[gid].color.z;
+        vertex[vertexOffset + i].colors[3] = instances[gid].color.w;
     }
 }
\ No newline at end of file
@@ -9,6 +9,9 @@ layout (location = 6) in vec4 color;
 layout (location = 7) in ivec4 boneIDs;
 layout (location = 8) in vec4 weights;
 
+// 使用八面体映射存储的属性，第i位对应location = i
+uniform int GM_OctahedralVertexAttributes = 0;
+
 out vec4 _position;
 out vec4 _normal;
 out vec2 _uv;
@@ -23,12 +26,27 @@ vec4 normal;
 vec4 tangent;
 vec4 bitangent;
 
+vec3 GM_DecodeOctahedral(vec2 e)
+{
+    vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0)
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0 ? 1.0 : -1.0, v.y >= 0 ? 1.0 : -1.0);
+    return normalize(v);
+}
+
+vec3 GM_DecodeVertexVector(vec3 v, int location)
+{
+    if ((GM_OctahedralVertexAttributes & (1 << location)) != 0)
+        return GM_DecodeOctahedral(v.xy);
+    return v;
+}
+
 void init_layouts()
 {
     position = vec4(gm_position.xyz, 1);
-    normal = vec4(gm_normal.xyz, 1);
-    tangent = vec4(gm_tangent.xyz, 1);
-    bitangent = vec4(gm_bitangent.xyz, 1);
+    normal = vec4(GM_DecodeVertexVector(gm_normal.xyz, 1), 1);
+    tangent = vec4(GM_DecodeVertexVector(gm_tangent.xyz, 3), 1);
+    bitangent = vec4(GM_DecodeVertexVector(gm_bitangent.xyz, 4), 1);
 
     _normal = normal;
     _tangent = tangent;
@@ -1,8 +1,28 @@
+// 为0时顶点已经展开为四边形，为1时在此展开2D粒子（粒子被放在z=0的平面上），为2时展开3D粒子
+uniform int GM_ParticleExpand = 0;
+// 所有粒子共用的billboard旋转
+uniform mat4 GM_ParticleBillboard;
+
 out vec4 _particle_position_world;
 
+// 一个粒子的6个顶点都是粒子的中心，纹理坐标表示顶点是四边形的哪个角，lightmapuv为粒子的大小和角度。
+// 粒子先绕原点按照自身的角度旋转，再绕粒子中心进行billboard旋转，与GMParticleModel在CPU中的展开方式一致。
+vec4 particle_expand()
+{
+    vec3 center = position.xyz;
+    float halfExt = lightmapuv.x * 0.5;
+    float s = sin(lightmapuv.y);
+    float c = cos(lightmapuv.y);
+    mat2 rotation = mat2(c, s, -s, c);
+    vec2 corner = vec2(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0) * halfExt;
+    vec3 offset = vec3(rotation * center.xy - center.xy + rotation * corner, (GM_ParticleExpand == 1) ? -center.z : 0.0);
+    return vec4(center + mat3(GM_ParticleBillboard) * offset, 1);
+}
+
 void particle_calcCoords()
 {
-    _particle_position_world = GM_WorldMatrix * position;
+    vec4 particle_position = (GM_ParticleExpand == 0) ? position : particle_expand();
+    _particle_position_world = GM_WorldMatrix * particle_position;
     gl_Position = GM_ProjectionMatrix * GM_ViewMatrix * _particle_position_world;
     _normal = normal;
     _tangent = tangent;
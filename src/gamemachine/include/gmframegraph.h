@@ -0,0 +1 @@
+﻿#include "../src/foundation/gmframegraph.h"
\ No newline at end of file
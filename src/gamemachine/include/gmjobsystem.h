@@ -0,0 +1 @@
+﻿#include "../src/foundation/gmjobsystem.h"
\ No newline at end of file
@@ -0,0 +1 @@
+﻿#include "../src/foundation/gmmessagequeue.h"
\ No newline at end of file
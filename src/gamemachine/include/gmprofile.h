@@ -0,0 +1 @@
+﻿#include "../src/foundation/gmprofile.h"
\ No newline at end of file
@@ -0,0 +1 @@
+﻿#include "../src/foundation/gmthreadpool.h"
\ No newline at end of file
@@ -193,6 +193,7 @@ void GMParticleSystem::setDescription(const GMParticleDescription& desc)
 	GM_ASSERT(d->emitter);
 	d->emitter->setDescription(desc);
 	d->textureBuffer = desc.getTextureImageData();
+	d->sharedTexture = desc.getSharedTexture();
 	setParticleModel(createParticleModel(desc));
 }
 
@@ -200,6 +201,8 @@ void GMParticleSystem::update(const IRenderContext* context, GMDuration dt)
 {
 	D(d);
 	d->emitter->update(context, dt);
+	if (d->particleModel)
+		d->particleModel->update(context);
 }
 
 void GMParticleSystem::render(const IRenderContext* context)
@@ -333,12 +336,9 @@ void GMParticleSystem::createCocos2DParticleSystem(
 {
 	if (particleSystem)
 	{
-		GMBuffer buf;
-		GM.getGamePackageManager()->readFile(GMPackageIndex::Particle, filename, &buf);
-		buf.convertToStringBuffer();
-
 		*particleSystem = new GMParticleSystem();
-		GMParticleDescription description = GMParticleSystem::createParticleDescriptionFromCocos2DPlist(gm::GMString((const char*)buf.getData()), modelType);
+		GMParticleDescription description;
+		GMParticleDescriptionCache::instance().getDescription(filename, modelType, description);
 		if (descriptionCallback)
 			descriptionCallback(description);
 
@@ -346,14 +346,595 @@ void GMParticleSystem::createCocos2DParticleSystem(
 	}
 }
 
+namespace
+{
+	enum
+	{
+		ParticleDescriptionMagic = 0x44504D47, // GMPD
+		ParticleDescriptionVersion = 2,
+	};
+
+	// 粒子描述的二进制格式，使用本机字节序，之后紧跟textureSize字节的纹理像素
+	struct ParticleDescriptionBinary
+	{
+		GMuint32 magic;
+		GMuint32 version;
+
+		GMfloat emitterPosition[3];
+		GMfloat emitterPositionV[3];
+		GMfloat emitterEmitAngle;
+		GMfloat emitterEmitAngleV;
+		GMfloat emitterEmitSpeed;
+		GMfloat emitterEmitSpeedV;
+		GMint32 particleCount;
+		GMfloat emitRate;
+		GMfloat duration;
+		GMint32 emitterType;
+		GMint32 motionMode;
+		GMint32 particleModelType;
+		GMfloat life;
+		GMfloat lifeV;
+		GMfloat beginColor[4];
+		GMfloat beginColorV[4];
+		GMfloat endColor[4];
+		GMfloat endColorV[4];
+		GMfloat beginSize;
+		GMfloat beginSizeV;
+		GMfloat endSize;
+		GMfloat endSizeV;
+		GMfloat beginSpin;
+		GMfloat beginSpinV;
+		GMfloat endSpin;
+		GMfloat endSpinV;
+
+		GMfloat gravity[3];
+		GMfloat tangentialAcceleration;
+		GMfloat tangentialAccelerationV;
+		GMfloat radialAcceleration;
+		GMfloat radialAccelerationV;
+
+		GMfloat beginRadius;
+		GMfloat beginRadiusV;
+		GMfloat endRadius;
+		GMfloat endRadiusV;
+		GMfloat spinPerSecond;
+		GMfloat spinPerSecondV;
+
+		// 纹理宽度为0表示没有纹理
+		GMint32 textureWidth;
+		GMint32 textureHeight;
+		GMint32 textureChannels;
+		GMint32 textureFormat;
+		GMint32 textureInternalFormat;
+		GMint32 textureType;
+		GMuint32 textureSize;
+	};
+
+	// 纹理每个通道占用的字节数，未知的类型返回0
+	GMuint32 getBytesPerChannel(GMImageDataType type)
+	{
+		switch (type)
+		{
+		case GMImageDataType::UnsignedByte:
+			return sizeof(GMbyte);
+		case GMImageDataType::Float:
+			return sizeof(GMfloat);
+		default:
+			return 0;
+		}
+	}
+
+	GMuint32 getTextureSize(GMint32 width, GMint32 height, GMuint32 channels, GMImageDataType type)
+	{
+		return gm_sizet_to_uint(static_cast<GMsize_t>(width) * height * channels * getBytesPerChannel(type));
+	}
+
+	inline void storeVec3(const GMVec3& v, GMfloat (&out)[3])
+	{
+		out[0] = v.getX();
+		out[1] = v.getY();
+		out[2] = v.getZ();
+	}
+
+	inline void storeVec4(const GMVec4& v, GMfloat (&out)[4])
+	{
+		out[0] = v.getX();
+		out[1] = v.getY();
+		out[2] = v.getZ();
+		out[3] = v.getW();
+	}
+
+	inline GMVec3 loadVec3(const GMfloat (&in)[3])
+	{
+		return GMVec3(in[0], in[1], in[2]);
+	}
+
+	inline GMVec4 loadVec4(const GMfloat (&in)[4])
+	{
+		return GMVec4(in[0], in[1], in[2], in[3]);
+	}
+
+	GMSharedPtr<GMParticleTexture> decodeParticleTexture(const GMBuffer& imageData)
+	{
+		GMImage* image = nullptr;
+		if (!imageData.getData() || !GMImageReader::load(imageData.getData(), imageData.getSize(), &image) || !image)
+			return GMSharedPtr<GMParticleTexture>();
+
+		GMSharedPtr<GMParticleTexture> texture = gm_makeSharedPtr<GMParticleTexture>();
+		texture->image.reset(image);
+		return texture;
+	}
+
+	GMParticleTexture* createParticleTexture(const ParticleDescriptionBinary& binary, const GMbyte* pixels)
+	{
+		GMParticleTexture* texture = new GMParticleTexture();
+		texture->image.reset(new GMImage());
+		GMImage::Data& data = texture->image->getData();
+		data.target = GMImageTarget::Texture2D;
+		data.mipLevels = 1;
+		data.internalFormat = static_cast<GMImageInternalFormat>(binary.textureInternalFormat);
+		data.format = static_cast<GMImageFormat>(binary.textureFormat);
+		data.channels = binary.textureChannels;
+		data.type = static_cast<GMImageDataType>(binary.textureType);
+		data.mip[0].width = binary.textureWidth;
+		data.mip[0].height = binary.textureHeight;
+		data.mip[0].data = new GMbyte[binary.textureSize];
+		memcpy_s(data.mip[0].data, binary.textureSize, pixels, binary.textureSize);
+		data.size = binary.textureSize;
+		return texture;
+	}
+}
+
+bool GMParticleSystem::saveParticleDescription(const GMParticleDescription& desc, OUT GMBuffer& buffer)
+{
+	ParticleDescriptionBinary binary = { 0 };
+	binary.magic = ParticleDescriptionMagic;
+	binary.version = ParticleDescriptionVersion;
+
+	storeVec3(desc.getEmitterPosition(), binary.emitterPosition);
+	storeVec3(desc.getEmitterPositionV(), binary.emitterPositionV);
+	binary.emitterEmitAngle = desc.getEmitterEmitAngle();
+	binary.emitterEmitAngleV = desc.getEmitterEmitAngleV();
+	binary.emitterEmitSpeed = desc.getEmitterEmitSpeed();
+	binary.emitterEmitSpeedV = desc.getEmitterEmitSpeedV();
+	binary.particleCount = desc.getParticleCount();
+	binary.emitRate = desc.getEmitRate();
+	binary.duration = desc.getDuration();
+	binary.emitterType = static_cast<GMint32>(desc.getEmitterType());
+	binary.motionMode = static_cast<GMint32>(desc.getMotionMode());
+	binary.particleModelType = static_cast<GMint32>(desc.getParticleModelType());
+	binary.life = desc.getLife();
+	binary.lifeV = desc.getLifeV();
+	storeVec4(desc.getBeginColor(), binary.beginColor);
+	storeVec4(desc.getBeginColorV(), binary.beginColorV);
+	storeVec4(desc.getEndColor(), binary.endColor);
+	storeVec4(desc.getEndColorV(), binary.endColorV);
+	binary.beginSize = desc.getBeginSize();
+	binary.beginSizeV = desc.getBeginSizeV();
+	binary.endSize = desc.getEndSize();
+	binary.endSizeV = desc.getEndSizeV();
+	binary.beginSpin = desc.getBeginSpin();
+	binary.beginSpinV = desc.getBeginSpinV();
+	binary.endSpin = desc.getEndSpin();
+	binary.endSpinV = desc.getEndSpinV();
+
+	const GMParticleGravityMode& gravityMode = desc.getGravityMode();
+	storeVec3(gravityMode.getGravity(), binary.gravity);
+	binary.tangentialAcceleration = gravityMode.getTangentialAcceleration();
+	binary.tangentialAccelerationV = gravityMode.getTangentialAccelerationV();
+	binary.radialAcceleration = gravityMode.getRadialAcceleration();
+	binary.radialAccelerationV = gravityMode.getRadialAccelerationV();
+
+	const GMParticleRadiusMode& radiusMode = desc.getRadiusMode();
+	binary.beginRadius = radiusMode.getBeginRadius();
+	binary.beginRadiusV = radiusMode.getBeginRadiusV();
+	binary.endRadius = radiusMode.getEndRadius();
+	binary.endRadiusV = radiusMode.getEndRadiusV();
+	binary.spinPerSecond = radiusMode.getSpinPerSecond();
+	binary.spinPerSecondV = radiusMode.getSpinPerSecondV();
+
+	// 纹理以解码后的像素保存
+	bool textureValid = true;
+	GMSharedPtr<GMParticleTexture> texture = desc.getSharedTexture();
+	if (!texture || !texture->image)
+	{
+		texture = decodeParticleTexture(desc.getTextureImageData());
+		textureValid = !!texture || !desc.getTextureImageData().getData();
+	}
+
+	const GMbyte* pixels = nullptr;
+	if (texture && texture->image)
+	{
+		const GMImage::Data& data = texture->image->getData();
+		binary.textureWidth = data.mip[0].width;
+		binary.textureHeight = data.mip[0].height;
+		binary.textureChannels = data.channels;
+		binary.textureFormat = static_cast<GMint32>(data.format);
+		binary.textureInternalFormat = static_cast<GMint32>(data.internalFormat);
+		binary.textureType = static_cast<GMint32>(data.type);
+		binary.textureSize = getTextureSize(data.mip[0].width, data.mip[0].height, data.channels, data.type);
+		pixels = data.mip[0].data;
+	}
+
+	buffer = GMBuffer(nullptr, sizeof(binary) + binary.textureSize);
+	memcpy_s(buffer.getData(), sizeof(binary), &binary, sizeof(binary));
+	if (pixels)
+		memcpy_s(buffer.getData() + sizeof(binary), binary.textureSize, pixels, binary.textureSize);
+	return textureValid;
+}
+
+bool GMParticleSystem::loadParticleDescription(const GMBuffer& buffer, OUT GMParticleDescription& desc)
+{
+	if (!isParticleDescriptionBinary(buffer))
+		return false;
+
+	ParticleDescriptionBinary binary;
+	memcpy_s(&binary, sizeof(binary), buffer.getData(), sizeof(binary));
+	if (binary.version != ParticleDescriptionVersion || buffer.getSize() < sizeof(binary) + binary.textureSize)
+		return false;
+
+	// 像素的大小必须与纹理的尺寸和格式一致
+	if (binary.textureWidth > 0 && binary.textureSize != getTextureSize(binary.textureWidth, binary.textureHeight, binary.textureChannels, static_cast<GMImageDataType>(binary.textureType)))
+		return false;
+
+	desc.setEmitterPosition(loadVec3(binary.emitterPosition));
+	desc.setEmitterPositionV(loadVec3(binary.emitterPositionV));
+	desc.setEmitterEmitAngle(binary.emitterEmitAngle);
+	desc.setEmitterEmitAngleV(binary.emitterEmitAngleV);
+	desc.setEmitterEmitSpeed(binary.emitterEmitSpeed);
+	desc.setEmitterEmitSpeedV(binary.emitterEmitSpeedV);
+	desc.setParticleCount(binary.particleCount);
+	desc.setEmitRate(binary.emitRate);
+	desc.setDuration(binary.duration);
+	desc.setEmitterType(static_cast<GMParticleEmitterType>(binary.emitterType));
+	desc.setMotionMode(static_cast<GMParticleMotionMode>(binary.motionMode));
+	desc.setParticleModelType(static_cast<GMParticleModelType>(binary.particleModelType));
+	desc.setLife(binary.life);
+	desc.setLifeV(binary.lifeV);
+	desc.setBeginColor(loadVec4(binary.beginColor));
+	desc.setBeginColorV(loadVec4(binary.beginColorV));
+	desc.setEndColor(loadVec4(binary.endColor));
+	desc.setEndColorV(loadVec4(binary.endColorV));
+	desc.setBeginSize(binary.beginSize);
+	desc.setBeginSizeV(binary.beginSizeV);
+	desc.setEndSize(binary.endSize);
+	desc.setEndSizeV(binary.endSizeV);
+	desc.setBeginSpin(binary.beginSpin);
+	desc.setBeginSpinV(binary.beginSpinV);
+	desc.setEndSpin(binary.endSpin);
+	desc.setEndSpinV(binary.endSpinV);
+
+	GMParticleGravityMode& gravityMode = desc.getGravityMode();
+	gravityMode.setGravity(loadVec3(binary.gravity));
+	gravityMode.setTangentialAcceleration(binary.tangentialAcceleration);
+	gravityMode.setTangentialAccelerationV(binary.tangentialAccelerationV);
+	gravityMode.setRadialAcceleration(binary.radialAcceleration);
+	gravityMode.setRadialAccelerationV(binary.radialAccelerationV);
+
+	GMParticleRadiusMode& radiusMode = desc.getRadiusMode();
+	radiusMode.setBeginRadius(binary.beginRadius);
+	radiusMode.setBeginRadiusV(binary.beginRadiusV);
+	radiusMode.setEndRadius(binary.endRadius);
+	radiusMode.setEndRadiusV(binary.endRadiusV);
+	radiusMode.setSpinPerSecond(binary.spinPerSecond);
+	radiusMode.setSpinPerSecondV(binary.spinPerSecondV);
+
+	desc.setTextureImageData(GMBuffer());
+	if (binary.textureWidth > 0 && binary.textureSize > 0)
+		desc.setSharedTexture(GMSharedPtr<GMParticleTexture>(createParticleTexture(binary, buffer.getData() + sizeof(binary))));
+	else
+		desc.setSharedTexture(GMSharedPtr<GMParticleTexture>());
+	return true;
+}
+
+bool GMParticleSystem::convertCocos2DPlist(const GMBuffer& plist, OUT GMBuffer& buffer)
+{
+	GMBuffer content = plist;
+	content.convertToStringBuffer();
+
+	// 模型类型不保存在文件中，由GMParticleDescriptionCache::getDescription()指定
+	GMParticleDescription desc = createParticleDescriptionFromCocos2DPlist(GMString((const char*)content.getData()), GMParticleModelType::Particle2D);
+	return saveParticleDescription(desc, buffer);
+}
+
+bool GMParticleSystem::isParticleDescriptionBinary(const GMBuffer& buffer)
+{
+	if (!buffer.getData() || buffer.getSize() < sizeof(ParticleDescriptionBinary))
+		return false;
+
+	GMuint32 magic;
+	memcpy_s(&magic, sizeof(magic), buffer.getData(), sizeof(magic));
+	return magic == ParticleDescriptionMagic;
+}
+
+GMParticleDescriptionCache& GMParticleDescriptionCache::instance()
+{
+	static GMParticleDescriptionCache s_instance;
+	return s_instance;
+}
+
+bool GMParticleDescriptionCache::getDescription(const GMString& filename, GMParticleModelType modelType, OUT GMParticleDescription& desc)
+{
+	D(d);
+	{
+		GMSharedLockGuard<GMReadWriteLock> guard(d->lock);
+		auto iter = d->descriptions.find(filename);
+		if (iter != d->descriptions.end())
+		{
+			desc = iter->second;
+			desc.setParticleModelType(modelType);
+			return true;
+		}
+	}
+
+	// 在独占锁内加载，避免多个线程同时解析同一个文件
+	GMLockGuard<GMReadWriteLock> guard(d->lock);
+	auto iter = d->descriptions.find(filename);
+	if (iter == d->descriptions.end())
+	{
+		GMBuffer buf;
+		if (!GM.getGamePackageManager()->readFile(GMPackageIndex::Particle, filename, &buf))
+		{
+			gm_warning(gm_dbg_wrap("Cannot read particle description {0}."), filename);
+			return false;
+		}
+
+		GMParticleDescription loaded;
+		if (!GMParticleSystem::loadParticleDescription(buf, loaded))
+		{
+			buf.convertToStringBuffer();
+			loaded = GMParticleSystem::createParticleDescriptionFromCocos2DPlist(GMString((const char*)buf.getData()), modelType);
+
+			// 纹理在此解码一次，之后所有的副本都共享它
+			loaded.setSharedTexture(decodeParticleTexture(loaded.getTextureImageData()));
+		}
+		iter = d->descriptions.insert(std::make_pair(filename, std::move(loaded))).first;
+	}
+
+	desc = iter->second;
+	desc.setParticleModelType(modelType);
+	return true;
+}
+
+void GMParticleDescriptionCache::clear()
+{
+	D(d);
+	GMLockGuard<GMReadWriteLock> guard(d->lock);
+	d->descriptions.clear();
+}
+
+namespace
+{
+	typedef GM_PRIVATE_NAME(GMParticle) ParticleData;
+
+	// 将一个粒子拆分到各个流中
+	void particleToStreams(const ParticleData& particle, GMfloat* values)
+	{
+		values[GMParticlePool::PositionX] = particle.position.getX();
+		values[GMParticlePool::PositionY] = particle.position.getY();
+		values[GMParticlePool::PositionZ] = particle.position.getZ();
+		values[GMParticlePool::StartPositionX] = particle.startPosition.getX();
+		values[GMParticlePool::StartPositionY] = particle.startPosition.getY();
+		values[GMParticlePool::StartPositionZ] = particle.startPosition.getZ();
+		values[GMParticlePool::ChangePositionX] = particle.changePosition.getX();
+		values[GMParticlePool::ChangePositionY] = particle.changePosition.getY();
+		values[GMParticlePool::ChangePositionZ] = particle.changePosition.getZ();
+		values[GMParticlePool::VelocityX] = particle.gravityModeData.initialVelocity.getX();
+		values[GMParticlePool::VelocityY] = particle.gravityModeData.initialVelocity.getY();
+		values[GMParticlePool::VelocityZ] = particle.gravityModeData.initialVelocity.getZ();
+		values[GMParticlePool::ColorR] = particle.color.getX();
+		values[GMParticlePool::ColorG] = particle.color.getY();
+		values[GMParticlePool::ColorB] = particle.color.getZ();
+		values[GMParticlePool::ColorA] = particle.color.getW();
+		values[GMParticlePool::DeltaColorR] = particle.deltaColor.getX();
+		values[GMParticlePool::DeltaColorG] = particle.deltaColor.getY();
+		values[GMParticlePool::DeltaColorB] = particle.deltaColor.getZ();
+		values[GMParticlePool::DeltaColorA] = particle.deltaColor.getW();
+		values[GMParticlePool::Size] = particle.size;
+		values[GMParticlePool::DeltaSize] = particle.deltaSize;
+		values[GMParticlePool::Rotation] = particle.rotation;
+		values[GMParticlePool::DeltaRotation] = particle.deltaRotation;
+		values[GMParticlePool::RemainingLife] = particle.remainingLife;
+		values[GMParticlePool::RadialAcceleration] = particle.gravityModeData.radialAcceleration;
+		values[GMParticlePool::TangentialAcceleration] = particle.gravityModeData.tangentialAcceleration;
+		values[GMParticlePool::Angle] = particle.radiusModeData.angle;
+		values[GMParticlePool::DegressPerSecond] = particle.radiusModeData.degressPerSecond;
+		values[GMParticlePool::Radius] = particle.radiusModeData.radius;
+		values[GMParticlePool::DeltaRadius] = particle.radiusModeData.deltaRadius;
+	}
+
+	// 从各个流中组装一个粒子
+	void streamsToParticle(const GMfloat* values, ParticleData& particle)
+	{
+		particle.position = GMVec3(values[GMParticlePool::PositionX], values[GMParticlePool::PositionY], values[GMParticlePool::PositionZ]);
+		particle.startPosition = GMVec3(values[GMParticlePool::StartPositionX], values[GMParticlePool::StartPositionY], values[GMParticlePool::StartPositionZ]);
+		particle.changePosition = GMVec3(values[GMParticlePool::ChangePositionX], values[GMParticlePool::ChangePositionY], values[GMParticlePool::ChangePositionZ]);
+		particle.gravityModeData.initialVelocity = GMVec3(values[GMParticlePool::VelocityX], values[GMParticlePool::VelocityY], values[GMParticlePool::VelocityZ]);
+		particle.color = GMVec4(values[GMParticlePool::ColorR], values[GMParticlePool::ColorG], values[GMParticlePool::ColorB], values[GMParticlePool::ColorA]);
+		particle.deltaColor = GMVec4(values[GMParticlePool::DeltaColorR], values[GMParticlePool::DeltaColorG], values[GMParticlePool::DeltaColorB], values[GMParticlePool::DeltaColorA]);
+		particle.size = values[GMParticlePool::Size];
+		particle.deltaSize = values[GMParticlePool::DeltaSize];
+		particle.rotation = values[GMParticlePool::Rotation];
+		particle.deltaRotation = values[GMParticlePool::DeltaRotation];
+		particle.remainingLife = values[GMParticlePool::RemainingLife];
+		particle.gravityModeData.radialAcceleration = values[GMParticlePool::RadialAcceleration];
+		particle.gravityModeData.tangentialAcceleration = values[GMParticlePool::TangentialAcceleration];
+		particle.radiusModeData.angle = values[GMParticlePool::Angle];
+		particle.radiusModeData.degressPerSecond = values[GMParticlePool::DegressPerSecond];
+		particle.radiusModeData.radius = values[GMParticlePool::Radius];
+		particle.radiusModeData.deltaRadius = values[GMParticlePool::DeltaRadius];
+	}
+}
+
+GM_STATIC_ASSERT(std::extent<decltype(GM_PRIVATE_NAME(GMParticlePool)::streams)>::value == GMParticlePool::StreamCount, "Stream count mismatch.");
+
+void GMParticlePool::setCapacity(GMsize_t capacity)
+{
+	D(d);
+	for (auto& stream : d->streams)
+	{
+		stream.resize(capacity);
+		stream.shrink_to_fit();
+	}
+	d->capacity = capacity;
+	if (d->size > capacity)
+		d->size = capacity;
+}
+
+void GMParticlePool::clear()
+{
+	D(d);
+	d->size = 0;
+}
+
+bool GMParticlePool::add(const GMParticle& particle)
+{
+	D(d);
+	if (d->size >= d->capacity)
+		return false;
+
+	++d->size;
+	set(d->size - 1, particle);
+	return true;
+}
+
+void GMParticlePool::get(GMsize_t index, OUT GMParticle& particle) const
+{
+	D(d);
+	GM_ASSERT(index < d->size);
+	GMfloat values[StreamCount];
+	for (GMint32 i = 0; i < StreamCount; ++i)
+	{
+		values[i] = d->streams[i][index];
+	}
+	streamsToParticle(values, *particle.data());
+}
+
+void GMParticlePool::set(GMsize_t index, const GMParticle& particle)
+{
+	D(d);
+	GM_ASSERT(index < d->size);
+	GMfloat values[StreamCount];
+	particleToStreams(*particle.data(), values);
+	for (GMint32 i = 0; i < StreamCount; ++i)
+	{
+		d->streams[i][index] = values[i];
+	}
+}
+
+void GMParticlePool::gather(OUT GMParticle* particles) const
+{
+	D(d);
+	for (GMsize_t i = 0; i < d->size; ++i)
+	{
+		get(i, particles[i]);
+	}
+}
+
+void GMParticlePool::scatterAlive(const GMParticle* particles, GMsize_t count)
+{
+	D(d);
+	GM_ASSERT(count <= d->capacity);
+	d->size = 0;
+	for (GMsize_t i = 0; i < count; ++i)
+	{
+		if (particles[i].getRemainingLife() > 0)
+		{
+			++d->size;
+			set(d->size - 1, particles[i]);
+		}
+	}
+}
+
+void GMParticlePool::removeDead()
+{
+	D(d);
+	const GMfloat* life = d->streams[RemainingLife].data();
+	GMsize_t firstDead = 0;
+	while (firstDead < d->size && life[firstDead] > 0)
+	{
+		++firstDead;
+	}
+
+	if (firstDead == d->size)
+		return;
+
+	if (d->removeMode == GMParticleRemoveMode::SwapWithLast)
+		removeDeadSwapWithLast(firstDead);
+	else
+		removeDeadStable(firstDead);
+}
+
+void GMParticlePool::removeDeadStable(GMsize_t firstDead)
+{
+	D(d);
+	// 粒子较少时，并行的开销比收益更大
+	enum { ParallelThreshold = 16384 };
+
+	// 从第一个死亡粒子开始，将存活的粒子依次前移。每个流都是独立的，可以并行处理
+	const GMfloat* life = d->streams[RemainingLife].data();
+	auto compact = [d, life, firstDead](GMfloat* values) {
+		GMsize_t alive = firstDead;
+		for (GMsize_t i = firstDead + 1; i < d->size; ++i)
+		{
+			if (life[i] > 0)
+				values[alive++] = values[i];
+		}
+		return alive;
+	};
+
+	auto compactStreams = [d, &compact](GMsize_t begin, GMsize_t end) {
+		for (GMsize_t s = begin; s < end; ++s)
+		{
+			if (s != RemainingLife)
+				compact(d->streams[s].data());
+		}
+	};
+
+	if (d->size - firstDead >= ParallelThreshold)
+		GMJobSystem::instance().parallelFor(0, StreamCount, 1, compactStreams);
+	else
+		compactStreams(0, StreamCount);
+
+	// 生命流作为判断依据，最后处理
+	d->size = compact(d->streams[RemainingLife].data());
+}
+
+void GMParticlePool::removeDeadSwapWithLast(GMsize_t firstDead)
+{
+	D(d);
+	GMfloat* life = d->streams[RemainingLife].data();
+	GMsize_t i = firstDead;
+	while (i < d->size)
+	{
+		if (life[i] > 0)
+		{
+			++i;
+			continue;
+		}
+
+		// 用最后一个粒子填补，填补过来的粒子也可能是死亡的，所以不移动i
+		GMsize_t last = --d->size;
+		if (i != last)
+		{
+			for (auto& stream : d->streams)
+			{
+				stream[i] = stream[last];
+			}
+		}
+	}
+}
+
 GMParticleEmitter::GMParticleEmitter(GMParticleSystem* system)
 {
 	D(d);
 	d->system = system;
+	d->random.seed(GMRandomMt19937::random_int<GMuint64>(0, std::numeric_limits<GMuint64>::max()));
 }
 
 void GMParticleEmitter::setDescription(const GMParticleDescription& desc)
 {
+	D(d);
 	setEmitPosition(desc.getEmitterPosition());
 	setEmitPositionV(desc.getEmitterPositionV());
 
@@ -366,6 +947,7 @@ void GMParticleEmitter::setDescription(const GMParticleDescription& desc)
 	setEmitRate(desc.getEmitRate());
 	setDuration(desc.getDuration());
 	setParticleCount(desc.getParticleCount());
+	d->particles.setCapacity(desc.getParticleCount());
 
 	GMParticleEffect* eff = nullptr;
 	if (desc.getEmitterType() == GMParticleEmitterType::Gravity)
@@ -385,11 +967,14 @@ void GMParticleEmitter::setDescription(const GMParticleDescription& desc)
 void GMParticleEmitter::addParticle()
 {
 	D(d);
-	if (d->particles.size() < static_cast<GMsize_t>(getParticleCount()))
+	if (d->particles.capacity() != static_cast<GMsize_t>(getParticleCount()))
+		d->particles.setCapacity(getParticleCount());
+
+	if (!d->particles.full())
 	{
 		GMParticle particle;
 		d->effect->initParticle(this, &particle);
-		d->particles.push_back(particle);
+		d->particles.add(particle);
 	}
 }
 
@@ -475,15 +1060,19 @@ void GMParticleEffect::setParticleDescription(const GMParticleDescription& desc)
 void GMParticleEffect::initParticle(GMParticleEmitter* emitter, GMParticle* particle)
 {
 	D(d);
-	GMVec3 randomPos(GMRandomMt19937::random_real(-1.f, 1.f), GMRandomMt19937::random_real(-1.f, 1.f), GMRandomMt19937::random_real(-1.f, 1.f));
+	// 一次生成这个粒子所需的全部随机数
+	GMfloat r[16];
+	emitter->getRandomEngine().fill(r, GM_array_size(r), -1.f, 1.f);
+
+	GMVec3 randomPos(r[0], r[1], r[2]);
 	particle->setPosition(emitter->getEmitPosition() + emitter->getEmitPositionV() * randomPos);
 
 	particle->setStartPosition(emitter->getEmitPosition());
 	particle->setChangePosition(particle->getPosition());
-	particle->setRemainingLife(Max(.1f, getLife() + getLifeV() * GMRandomMt19937::random_real(-1.f, 1.f)));
+	particle->setRemainingLife(Max(.1f, getLife() + getLifeV() * r[3]));
 
-	GMVec4 randomBeginColor(GMRandomMt19937::random_real(-1.f, 1.f), GMRandomMt19937::random_real(-1.f, 1.f), GMRandomMt19937::random_real(-1.f, 1.f), GMRandomMt19937::random_real(-1.f, 1.f));
-	GMVec4 randomEndColor(GMRandomMt19937::random_real(-1.f, 1.f), GMRandomMt19937::random_real(-1.f, 1.f), GMRandomMt19937::random_real(-1.f, 1.f), GMRandomMt19937::random_real(-1.f, 1.f));
+	GMVec4 randomBeginColor(r[4], r[5], r[6], r[7]);
+	GMVec4 randomEndColor(r[8], r[9], r[10], r[11]);
 
 	GMVec4 beginColor, endColor;
 	beginColor = Clamp(getBeginColor() + getBeginColorV() * randomBeginColor, 0, 1);
@@ -493,13 +1082,13 @@ void GMParticleEffect::initParticle(GMParticleEmitter* emitter, GMParticle* part
 	particle->setColor(beginColor);
 	particle->setDeltaColor((endColor - beginColor) * remainingLifeRev);
 
-	GMfloat beginSize = Max(0, getBeginSize() + getBeginSizeV() * GMRandomMt19937::random_real(-1.f, 1.f));
-	GMfloat endSize = Max(0, getEndSize() + getEndSize() * GMRandomMt19937::random_real(-1.f, 1.f));
+	GMfloat beginSize = Max(0, getBeginSize() + getBeginSizeV() * r[12]);
+	GMfloat endSize = Max(0, getEndSize() + getEndSize() * r[13]);
 	particle->setSize(beginSize);
 	particle->setDeltaSize((endSize - beginSize) / particle->getRemainingLife());
 
-	GMfloat beginSpin = Radian(Max(0, getBeginSpin() + getBeginSpinV() * GMRandomMt19937::random_real(-1.f, 1.f)));
-	GMfloat endSpin = Radian(Max(0, getEndSpin() + getEndSpin() * GMRandomMt19937::random_real(-1.f, 1.f)));
+	GMfloat beginSpin = Radian(Max(0, getBeginSpin() + getBeginSpinV() * r[14]));
+	GMfloat endSpin = Radian(Max(0, getEndSpin() + getEndSpin() * r[15]));
 	particle->setRotation(beginSpin);
 	particle->setDeltaRotation((endSpin - beginSpin) * remainingLifeRev);
 }
@@ -545,9 +1134,23 @@ void GMParticleSystemManager::render()
 void GMParticleSystemManager::update(GMDuration dt)
 {
 	D(d);
-	// 涉及到粒子池的分配，不能并行
+	// 计算着色器只能在当前线程使用，其余的粒子系统互不相关，可以并行更新
+	d->frameArena.reset();
+	FrameVector<GMParticleSystem*> parallelSystems{ GMFrameAllocator<GMParticleSystem*>(&d->frameArena) };
+	parallelSystems.reserve(d->particleSystems.size());
 	for (decltype(auto) system : d->particleSystems)
 	{
-		system->update(d->context, dt);
+		GMParticleEffect* effect = system->getEmitter()->getEffect();
+		if (effect && effect->isGPUValid())
+			system->update(d->context, dt);
+		else
+			parallelSystems.push_back(system.get());
 	}
+
+	GMJobSystem::instance().parallelFor(0, parallelSystems.size(), 1, [d, dt, &parallelSystems](GMsize_t begin, GMsize_t end) {
+		for (GMsize_t i = begin; i < end; ++i)
+		{
+			parallelSystems[i]->update(d->context, dt);
+		}
+	});
 }
\ No newline at end of file
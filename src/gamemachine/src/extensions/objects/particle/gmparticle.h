@@ -2,6 +2,8 @@
 #define __GMPARTICLE_H__
 #include <gmcommon.h>
 #include <gmgameobject.h>
+#include <gmimage.h>
+#include <gmthread.h>
 BEGIN_NS
 
 class GMParticleSystem;
@@ -12,6 +14,12 @@ class GMParticle;
 GM_INTERFACE(IParticleModel)
 {
 	virtual void render(const IRenderContext* context) = 0;
+
+	//! 在粒子更新之后，准备渲染所需的数据。
+	/*!
+	  此方法可能在工作线程中与其它粒子系统同时被调用，因此不能访问图形设备。
+	*/
+	virtual void update(const IRenderContext* context) {}
 };
 
 enum class GMParticleModelType
@@ -80,6 +88,16 @@ public:
 	GMParticleRadiusMode() = default;
 };
 
+//! 粒子的纹理，可以被多个粒子系统共享。
+/*!
+  image为解码后的图片。texture在第一次渲染时由image创建，之后共享此纹理的粒子系统都直接使用它，因此它只能在渲染线程中访问。
+*/
+struct GMParticleTexture
+{
+	GMOwnedPtr<GMImage> image;
+	GMTextureAsset texture;
+};
+
 GM_PRIVATE_OBJECT(GMParticleDescription)
 {
 	GMVec3 emitterPosition = Zero<GMVec3>(); //<! 发射器位置
@@ -115,6 +133,7 @@ GM_PRIVATE_OBJECT(GMParticleDescription)
 	GMParticleRadiusMode radiusMode;
 
 	GMBuffer textureImageData;
+	GMSharedPtr<GMParticleTexture> sharedTexture; //!< 已经解码的纹理，存在时优先于textureImageData使用
 	GMParticleModelType particleModelType = GMParticleModelType::Particle2D;
 
 	GMVec3 gravityDirection = GMVec3(1, 1, 1); //!< 重力方向，-1表示粒子坐标系与左手坐标系相反
@@ -159,6 +178,7 @@ class GMParticleDescription : public GMObject
 	GM_DECLARE_PROPERTY(GravityMode, gravityMode)
 	GM_DECLARE_PROPERTY(RadiusMode, radiusMode)
 	GM_DECLARE_PROPERTY(TextureImageData, textureImageData)
+	GM_DECLARE_PROPERTY(SharedTexture, sharedTexture)
 	GM_DECLARE_PROPERTY(ParticleModelType, particleModelType)
 
 public:
@@ -218,9 +238,170 @@ public:
 	GMParticle() = default;
 };
 
+//! 移除死亡粒子的方式。
+enum class GMParticleRemoveMode
+{
+	Stable, //!< 存活的粒子依次前移，保持原来的顺序。粒子较多时，各个流会并行处理。
+	SwapWithLast, //!< 用最后一个粒子填补死亡粒子的位置，不保持顺序。适合每帧死亡粒子较少的情况。
+};
+
+GM_PRIVATE_OBJECT_UNALIGNED(GMParticlePool)
+{
+	Vector<GMfloat> streams[31]; // 与GMParticlePool::StreamCount一致
+	GMsize_t size = 0;
+	GMsize_t capacity = 0;
+	GMParticleRemoveMode removeMode = GMParticleRemoveMode::Stable;
+};
+
+//! 以结构数组（SoA）的方式存储一个发射器的所有粒子。
+/*!
+  每一个粒子属性的每一个分量都存放在一段单独的连续内存中（见Stream），粒子的更新可以一次处理多个相邻的粒子，便于使用SIMD指令。<BR>
+  单个粒子的读写可以通过GMParticle进行，它会与流中对应的位置相互转换。<BR>
+  粒子池的容量是固定的，只有在setCapacity()时才会分配内存，添加和移除粒子都不会分配内存。
+*/
+class GMParticlePool
+{
+	GM_DECLARE_PRIVATE_NGO(GMParticlePool)
+
+public:
+	//! 粒子属性的流。
+	enum Stream
+	{
+		PositionX,
+		PositionY,
+		PositionZ,
+		StartPositionX,
+		StartPositionY,
+		StartPositionZ,
+		ChangePositionX,
+		ChangePositionY,
+		ChangePositionZ,
+		VelocityX, //!< 重力模式下粒子的速度
+		VelocityY,
+		VelocityZ,
+		ColorR,
+		ColorG,
+		ColorB,
+		ColorA,
+		DeltaColorR,
+		DeltaColorG,
+		DeltaColorB,
+		DeltaColorA,
+		Size,
+		DeltaSize,
+		Rotation,
+		DeltaRotation,
+		RemainingLife,
+		RadialAcceleration,
+		TangentialAcceleration,
+		Angle, //!< 半径模式下粒子的角度
+		DegressPerSecond,
+		Radius,
+		DeltaRadius,
+		StreamCount
+	};
+
+public:
+	GMParticlePool() = default;
+
+public:
+	//! 获取粒子的数量。
+	inline GMsize_t size() const GM_NOEXCEPT
+	{
+		D(d);
+		return d->size;
+	}
+
+	inline bool empty() const GM_NOEXCEPT
+	{
+		D(d);
+		return d->size == 0;
+	}
+
+	//! 获取粒子池的容量。
+	inline GMsize_t capacity() const GM_NOEXCEPT
+	{
+		D(d);
+		return d->capacity;
+	}
+
+	inline bool full() const GM_NOEXCEPT
+	{
+		D(d);
+		return d->size == d->capacity;
+	}
+
+	//! 设置移除死亡粒子的方式，默认为GMParticleRemoveMode::Stable。
+	inline void setRemoveMode(GMParticleRemoveMode mode) GM_NOEXCEPT
+	{
+		D(d);
+		d->removeMode = mode;
+	}
+
+	inline GMParticleRemoveMode getRemoveMode() const GM_NOEXCEPT
+	{
+		D(d);
+		return d->removeMode;
+	}
+
+	//! 获取一个属性流的首地址，流的长度为size()。
+	inline GMfloat* stream(Stream s) GM_NOEXCEPT
+	{
+		D(d);
+		return d->streams[s].data();
+	}
+
+	inline const GMfloat* stream(Stream s) const GM_NOEXCEPT
+	{
+		D(d);
+		return d->streams[s].data();
+	}
+
+	//! 设置粒子池的容量。
+	/*!
+	  这是粒子池唯一会分配内存的地方。如果当前粒子的数量超过了新的容量，多余的粒子会被丢弃。
+	  \param capacity 粒子池最多能容纳的粒子数。
+	*/
+	void setCapacity(GMsize_t capacity);
+
+	//! 移除所有粒子。
+	void clear();
+
+	//! 在末尾添加一个粒子。
+	/*!
+	  \return 如果粒子池已满，则不添加，返回false。
+	*/
+	bool add(const GMParticle& particle);
+
+	//! 将第index个粒子读取到particle中。
+	void get(GMsize_t index, OUT GMParticle& particle) const;
+
+	//! 将particle写入到第index个粒子。
+	void set(GMsize_t index, const GMParticle& particle);
+
+	//! 将所有粒子按照GMParticle的布局写入到particles中，particles至少要有size()个元素。
+	void gather(OUT GMParticle* particles) const;
+
+	//! 将count个GMParticle中存活（剩余生命大于0）的粒子依次写回，其余的粒子被丢弃。
+	/*!
+	  count不能超过粒子池的容量。
+	*/
+	void scatterAlive(const GMParticle* particles, GMsize_t count);
+
+	//! 按照getRemoveMode()移除所有剩余生命小于等于0的粒子。
+	void removeDead();
+
+private:
+	void removeDeadStable(GMsize_t firstDead);
+	void removeDeadSwapWithLast(GMsize_t firstDead);
+};
+
 class GMParticleEffect;
+// 粒子系统会随着特效频繁地创建和销毁，发射器、粒子效果和粒子系统的数据段都从各自的内存池中分配
 GM_PRIVATE_OBJECT(GMParticleEmitter)
 {
+	GM_DECLARE_POOLED_ALLOCATOR(GMParticleEmitterPrivate)
+
 	GMVec3 emitPosition = Zero<GMVec3>();
 	GMVec3 emitPositionV = Zero<GMVec3>();
 	GMfloat emitAngle = 0;
@@ -232,11 +413,12 @@ GM_PRIVATE_OBJECT(GMParticleEmitter)
 	GMDuration duration = 0;
 	GMVec3 rotationAxis = GMVec3(0, 0, 1);
 	GMOwnedPtr<GMParticleEffect> effect;
-	Vector<GMParticle> particles;
+	GMParticlePool particles;
 	bool canEmit = true;
 	GMParticleSystem* system = nullptr;
 	GMDuration emitCounter = 0;
 	GMDuration elapsed = 0;
+	GMXoshiro128 random;
 };
 
 class GMParticleEmitter : public GMObject
@@ -272,7 +454,7 @@ public:
 		return d->effect.get();
 	}
 
-	inline Vector<GMParticle>& getParticles() GM_NOEXCEPT
+	inline GMParticlePool& getParticles() GM_NOEXCEPT
 	{
 		D(d);
 		return d->particles;
@@ -283,10 +465,29 @@ public:
 		D(d);
 		return d->system;
 	}
+
+	//! 获取发射器的随机数引擎。
+	/*!
+	  每个发射器拥有自己的随机数引擎，初始化粒子时使用。这样不同的粒子系统可以在不同线程中同时发射粒子，
+	  并且设置了相同种子的发射器总是产生相同的粒子。
+	*/
+	inline GMXoshiro128& getRandomEngine() GM_NOEXCEPT
+	{
+		D(d);
+		return d->random;
+	}
+
+	inline void setRandomSeed(GMuint64 seed)
+	{
+		D(d);
+		d->random.seed(seed);
+	}
 };
 
 GM_PRIVATE_OBJECT(GMParticleEffect)
 {
+	GM_DECLARE_POOLED_ALLOCATOR(GMParticleEffectPrivate)
+
 	GMParticleMotionMode motionMode = GMParticleMotionMode::Free;
 	GMParticleGravityMode gravityMode;
 	GMParticleRadiusMode radiusMode;
@@ -335,6 +536,13 @@ public:
 public:
 	void setParticleDescription(const GMParticleDescription& desc);
 
+	//! 是否使用计算着色器更新粒子。使用计算着色器时，粒子只能在渲染线程中更新。
+	inline bool isGPUValid() const GM_NOEXCEPT
+	{
+		D(d);
+		return d->GPUValid;
+	}
+
 public:
 	virtual void initParticle(GMParticleEmitter* emitter, GMParticle* particle);
 	virtual void update(GMParticleEmitter* emitter, const IRenderContext* context, GMDuration dt);
@@ -346,10 +554,13 @@ protected:
 
 GM_PRIVATE_OBJECT(GMParticleSystem)
 {
+	GM_DECLARE_POOLED_ALLOCATOR(GMParticleSystemPrivate)
+
 	GMOwnedPtr<GMParticleEmitter> emitter;
 	GMParticleSystemManager* manager = nullptr;
 	GMTextureAsset texture;
 	GMBuffer textureBuffer;
+	GMSharedPtr<GMParticleTexture> sharedTexture;
 	GMOwnedPtr<IParticleModel> particleModel;
 };
 
@@ -389,6 +600,12 @@ public:
 		return d->textureBuffer;
 	}
 
+	inline const GMSharedPtr<GMParticleTexture>& getSharedTexture() GM_NOEXCEPT
+	{
+		D(d);
+		return d->sharedTexture;
+	}
+
 	inline void setParticleModel(AUTORELEASE IParticleModel* particleModel) GM_NOEXCEPT
 	{
 		D(d);
@@ -408,6 +625,46 @@ private:
 public:
 	static GMParticleDescription createParticleDescriptionFromCocos2DPlist(const GMString& content, GMParticleModelType modelType);
 
+	//! 将粒子描述保存为二进制格式。
+	/*!
+	  二进制格式保存了描述的所有属性，以及解码后的纹理像素，加载时不需要再解析XML、Base64和压缩过的纹理。
+	  可以在离线时将Cocos2D的plist转换为此格式，放入粒子资源包中代替原文件。
+	  \param desc 需要保存的粒子描述。
+	  \param buffer 保存的结果。
+	  \return 如果描述带有纹理，但是纹理无法解码，返回false。
+	  \sa loadParticleDescription()
+	*/
+	static bool saveParticleDescription(const GMParticleDescription& desc, OUT GMBuffer& buffer);
+
+	//! 从saveParticleDescription()保存的二进制数据中加载粒子描述。
+	/*!
+	  纹理会被直接还原为图片，放在描述的SharedTexture中。
+	  \param buffer 二进制数据。
+	  \param desc 加载的粒子描述。
+	  \return 数据不是粒子描述的二进制格式、版本不符，或者纹理像素的大小与纹理的尺寸和格式不一致时，返回false。
+	*/
+	static bool loadParticleDescription(const GMBuffer& buffer, OUT GMParticleDescription& desc);
+
+	//! 将Cocos2D的plist转换为saveParticleDescription()的二进制格式。
+	/*!
+	  用于离线转换粒子资源，见gamemachineparticleconverter。
+	  \param plist plist文件的内容。
+	  \param buffer 转换的结果。
+	  \return 如果plist带有纹理，但是纹理无法解码，返回false。
+	*/
+	static bool convertCocos2DPlist(const GMBuffer& plist, OUT GMBuffer& buffer);
+
+	//! 判断一段数据是否为粒子描述的二进制格式。
+	static bool isParticleDescriptionBinary(const GMBuffer& buffer);
+
+	//! 创建一个粒子系统。
+	/*!
+	  粒子描述从GMParticleDescriptionCache中获取，因此同一个文件只会被解析一次，文件可以是plist，也可以是二进制格式。
+	  \param filename 粒子资源包中的文件名。
+	  \param modelType 粒子的模型类型。
+	  \param particleSystem 创建的粒子系统。
+	  \param descriptionCallback 在设置粒子描述之前调用，可以修改描述。修改的是缓存中描述的一个副本。
+	*/
 	static void createCocos2DParticleSystem(
 		const GMString& filename,
 		GMParticleModelType modelType,
@@ -416,18 +673,49 @@ public:
 	);
 };
 
-GM_PRIVATE_OBJECT(GMParticlePool)
+GM_PRIVATE_OBJECT_UNALIGNED(GMParticleDescriptionCache)
 {
-	Vector<GMOwnedPtr<GMParticle>> particlePool;
-	Vector<GMParticle*> unused;
-	GMsize_t index = 0;
-	GMsize_t capacity = 0;
+	GMReadWriteLock lock;
+	HashMap<GMString, GMParticleDescription, GMStringHashFunctor> descriptions;
+};
+
+//! 以文件名为键缓存粒子描述。
+/*!
+  同一个粒子效果被创建多次时（如一次爆炸产生多个火花），文件只会被读取和解析一次，纹理也只会解码一次。
+  缓存返回描述的副本，副本之间共享同一个GMParticleTexture，因此它们使用的纹理也只会被创建一次。此类是线程安全的。
+*/
+class GM_EXPORT GMParticleDescriptionCache
+{
+	GM_DECLARE_PRIVATE_NGO(GMParticleDescriptionCache)
+	GM_DISABLE_COPY(GMParticleDescriptionCache)
+	GM_DISABLE_ASSIGN(GMParticleDescriptionCache)
+
+public:
+	static GMParticleDescriptionCache& instance();
+
+public:
+	GMParticleDescriptionCache() = default;
+
+public:
+	//! 获取一个粒子描述。
+	/*!
+	  第一次获取时从粒子资源包中读取文件。文件可以是Cocos2D的plist，也可以是GMParticleSystem::saveParticleDescription()保存的二进制格式。
+	  \param filename 粒子资源包中的文件名。
+	  \param modelType 粒子的模型类型，它不影响缓存，只会设置到返回的副本上。
+	  \param desc 获取到的粒子描述。
+	  \return 文件是否读取成功。
+	*/
+	bool getDescription(const GMString& filename, GMParticleModelType modelType, OUT GMParticleDescription& desc);
+
+	//! 清除所有缓存的描述。已经创建的粒子系统仍然持有自己的纹理。
+	void clear();
 };
 
 GM_PRIVATE_OBJECT(GMParticleSystemManager)
 {
 	const IRenderContext* context;
 	Vector<GMOwnedPtr<GMParticleSystem>> particleSystems;
+	GMFrameArena frameArena{ 1024 }; // 每次update()开始时重置
 };
 
 class GM_EXPORT GMParticleSystemManager : public GMObject
@@ -440,7 +728,21 @@ public:
 public:
 	void addParticleSystem(AUTORELEASE GMParticleSystem* ps);
 	void render();
+
+	//! 更新所有的粒子系统。
+	/*!
+	  每个粒子系统拥有自己的粒子池和随机数引擎，互不相关，因此在CPU中更新的粒子系统会作为任务交给GMJobSystem并行更新，
+	  顶点数据也在此时生成，render()只需要将其拷贝到顶点缓存。使用计算着色器的粒子系统仍然在调用线程中依次更新。<BR>
+	  更新时的临时数据分配在管理器自己的帧内存中，每次调用都会重置，因此不依赖GameMachine::renderFrame()。
+	*/
 	void update(GMDuration dt);
+
+	//! 获取更新时使用的帧内存，可以用来查看它的占用。
+	inline const GMFrameArena& getFrameArena() const GM_NOEXCEPT
+	{
+		D(d);
+		return d->frameArena;
+	}
 };
 
 END_NS
@@ -3,6 +3,8 @@
 #include "foundation/gmasync.h"
 #include "foundation/gamemachine.h"
 #include <gmengine/gmcomputeshadermanager.h>
+#include <gmjobsystem.h>
+#include "gmparticlesimd.h"
 
 namespace
 {
@@ -11,6 +13,245 @@ namespace
 	static GMString s_gravityEntry;
 	static GMString s_radialCode;
 	static GMString s_radialEntry;
+
+	// 每个任务更新的粒子数，是4的倍数
+	constexpr GMsize_t ParticlesPerJob = 4096;
+
+	struct GravityKernelArgs
+	{
+		GMfloat dt;
+		GMfloat gravity[3];
+		GMfloat emitPosition[3];
+		bool relative;
+	};
+
+	struct RadialKernelArgs
+	{
+		GMfloat dt;
+		GMfloat axis[3];
+		GMfloat emitPosition[3];
+		bool relative;
+	};
+
+	// 更新两种模式共有的属性：生命、颜色、大小和旋转
+	void advanceCommon(GMParticlePool& pool, GMsize_t begin, GMsize_t end, GMfloat dt)
+	{
+		GMfloat* life = pool.stream(GMParticlePool::RemainingLife);
+		GMfloat* size = pool.stream(GMParticlePool::Size);
+		const GMfloat* deltaSize = pool.stream(GMParticlePool::DeltaSize);
+		GMfloat* rotation = pool.stream(GMParticlePool::Rotation);
+		const GMfloat* deltaRotation = pool.stream(GMParticlePool::DeltaRotation);
+		GMfloat* color[4] = {
+			pool.stream(GMParticlePool::ColorR),
+			pool.stream(GMParticlePool::ColorG),
+			pool.stream(GMParticlePool::ColorB),
+			pool.stream(GMParticlePool::ColorA),
+		};
+		const GMfloat* deltaColor[4] = {
+			pool.stream(GMParticlePool::DeltaColorR),
+			pool.stream(GMParticlePool::DeltaColorG),
+			pool.stream(GMParticlePool::DeltaColorB),
+			pool.stream(GMParticlePool::DeltaColorA),
+		};
+
+		GMsize_t i = begin;
+#if GM_SIMD_SSE2
+		const __m128 vdt = _mm_set1_ps(dt);
+		const __m128 zero = _mm_setzero_ps();
+		for (; i + 4 <= end; i += 4)
+		{
+			_mm_storeu_ps(life + i, _mm_sub_ps(_mm_loadu_ps(life + i), vdt));
+			_mm_storeu_ps(size + i, _mm_max_ps(zero, _mm_add_ps(_mm_loadu_ps(size + i), _mm_mul_ps(_mm_loadu_ps(deltaSize + i), vdt))));
+			_mm_storeu_ps(rotation + i, _mm_add_ps(_mm_loadu_ps(rotation + i), _mm_mul_ps(_mm_loadu_ps(deltaRotation + i), vdt)));
+			for (GMint32 k = 0; k < 4; ++k)
+			{
+				_mm_storeu_ps(color[k] + i, _mm_add_ps(_mm_loadu_ps(color[k] + i), _mm_mul_ps(_mm_loadu_ps(deltaColor[k] + i), vdt)));
+			}
+		}
+#endif
+		for (; i < end; ++i)
+		{
+			life[i] -= dt;
+			size[i] = Max(0, size[i] + deltaSize[i] * dt);
+			rotation[i] += deltaRotation[i] * dt;
+			for (GMint32 k = 0; k < 4; ++k)
+			{
+				color[k][i] += deltaColor[k][i] * dt;
+			}
+		}
+	}
+
+	// 重力模式：径向加速度沿速度方向，切向加速度垂直于速度方向
+	void advanceGravity(GMParticlePool& pool, GMsize_t begin, GMsize_t end, const GravityKernelArgs& args)
+	{
+		GMfloat* px = pool.stream(GMParticlePool::PositionX);
+		GMfloat* py = pool.stream(GMParticlePool::PositionY);
+		GMfloat* pz = pool.stream(GMParticlePool::PositionZ);
+		const GMfloat* sx = pool.stream(GMParticlePool::StartPositionX);
+		const GMfloat* sy = pool.stream(GMParticlePool::StartPositionY);
+		const GMfloat* sz = pool.stream(GMParticlePool::StartPositionZ);
+		GMfloat* cx = pool.stream(GMParticlePool::ChangePositionX);
+		GMfloat* cy = pool.stream(GMParticlePool::ChangePositionY);
+		GMfloat* cz = pool.stream(GMParticlePool::ChangePositionZ);
+		GMfloat* vx = pool.stream(GMParticlePool::VelocityX);
+		GMfloat* vy = pool.stream(GMParticlePool::VelocityY);
+		GMfloat* vz = pool.stream(GMParticlePool::VelocityZ);
+		const GMfloat* radialAcceleration = pool.stream(GMParticlePool::RadialAcceleration);
+		const GMfloat* tangentialAcceleration = pool.stream(GMParticlePool::TangentialAcceleration);
+
+		// 相对模式下，粒子跟随发射器
+		const GMfloat dt = args.dt;
+		const GMfloat follow = args.relative ? 1.f : 0;
+
+		GMsize_t i = begin;
+#if GM_SIMD_SSE2
+		const __m128 vdt = _mm_set1_ps(dt);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 gx = _mm_set1_ps(args.gravity[0]);
+		const __m128 gy = _mm_set1_ps(args.gravity[1]);
+		const __m128 gz = _mm_set1_ps(args.gravity[2]);
+		const __m128 vfollow = _mm_set1_ps(follow);
+		const __m128 ex = _mm_set1_ps(args.emitPosition[0] * follow);
+		const __m128 ey = _mm_set1_ps(args.emitPosition[1] * follow);
+		const __m128 ez = _mm_set1_ps(args.emitPosition[2] * follow);
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(vx + i), y = _mm_loadu_ps(vy + i), z = _mm_loadu_ps(vz + i);
+			__m128 ox = _mm_loadu_ps(cx + i), oy = _mm_loadu_ps(cy + i), oz = _mm_loadu_ps(cz + i);
+
+			// 只有离开了出生点的粒子才有径向加速度
+			__m128 lengthSquare = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+			__m128 moved = _mm_or_ps(_mm_or_ps(_mm_cmpneq_ps(ox, zero), _mm_cmpneq_ps(oy, zero)), _mm_cmpneq_ps(oz, zero));
+			__m128 mask = _mm_and_ps(moved, _mm_cmpgt_ps(lengthSquare, zero));
+			__m128 invLength = _mm_and_ps(mask, _mm_div_ps(one, _mm_sqrt_ps(lengthSquare)));
+			__m128 rx = _mm_mul_ps(x, invLength), ry = _mm_mul_ps(y, invLength), rz = _mm_mul_ps(z, invLength);
+
+			__m128 radial = _mm_loadu_ps(radialAcceleration + i);
+			__m128 tangential = _mm_loadu_ps(tangentialAcceleration + i);
+			__m128 ax = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(rx, radial), _mm_mul_ps(ry, tangential)), gx);
+			__m128 ay = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ry, radial), _mm_mul_ps(rx, tangential)), gy);
+			__m128 az = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rz, radial), _mm_mul_ps(rz, tangential)), gz);
+
+			x = _mm_add_ps(x, _mm_mul_ps(ax, vdt));
+			y = _mm_add_ps(y, _mm_mul_ps(ay, vdt));
+			z = _mm_add_ps(z, _mm_mul_ps(az, vdt));
+			ox = _mm_add_ps(ox, _mm_mul_ps(x, vdt));
+			oy = _mm_add_ps(oy, _mm_mul_ps(y, vdt));
+			oz = _mm_add_ps(oz, _mm_mul_ps(z, vdt));
+			_mm_storeu_ps(vx + i, x);
+			_mm_storeu_ps(vy + i, y);
+			_mm_storeu_ps(vz + i, z);
+			_mm_storeu_ps(cx + i, ox);
+			_mm_storeu_ps(cy + i, oy);
+			_mm_storeu_ps(cz + i, oz);
+
+			_mm_storeu_ps(px + i, _mm_add_ps(ox, _mm_sub_ps(ex, _mm_mul_ps(_mm_loadu_ps(sx + i), vfollow))));
+			_mm_storeu_ps(py + i, _mm_add_ps(oy, _mm_sub_ps(ey, _mm_mul_ps(_mm_loadu_ps(sy + i), vfollow))));
+			_mm_storeu_ps(pz + i, _mm_add_ps(oz, _mm_sub_ps(ez, _mm_mul_ps(_mm_loadu_ps(sz + i), vfollow))));
+		}
+#endif
+		for (; i < end; ++i)
+		{
+			GMfloat rx = 0, ry = 0, rz = 0;
+			GMfloat lengthSquare = vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i];
+			if ((cx[i] != 0 || cy[i] != 0 || cz[i] != 0) && lengthSquare > 0)
+			{
+				GMfloat invLength = 1.f / Sqrt(lengthSquare);
+				rx = vx[i] * invLength;
+				ry = vy[i] * invLength;
+				rz = vz[i] * invLength;
+			}
+
+			const GMfloat radial = radialAcceleration[i];
+			const GMfloat tangential = tangentialAcceleration[i];
+			vx[i] += (rx * radial - ry * tangential + args.gravity[0]) * dt;
+			vy[i] += (ry * radial + rx * tangential + args.gravity[1]) * dt;
+			vz[i] += (rz * radial + rz * tangential + args.gravity[2]) * dt;
+			cx[i] += vx[i] * dt;
+			cy[i] += vy[i] * dt;
+			cz[i] += vz[i] * dt;
+
+			px[i] = cx[i] + (args.emitPosition[0] - sx[i]) * follow;
+			py[i] = cy[i] + (args.emitPosition[1] - sy[i]) * follow;
+			pz[i] = cz[i] + (args.emitPosition[2] - sz[i]) * follow;
+		}
+	}
+
+	// 半径模式：粒子从(0, 1, 0)开始，绕着发射器的旋转轴旋转
+	void advanceRadial(GMParticlePool& pool, GMsize_t begin, GMsize_t end, const RadialKernelArgs& args)
+	{
+		GMfloat* px = pool.stream(GMParticlePool::PositionX);
+		GMfloat* py = pool.stream(GMParticlePool::PositionY);
+		GMfloat* pz = pool.stream(GMParticlePool::PositionZ);
+		const GMfloat* sx = pool.stream(GMParticlePool::StartPositionX);
+		const GMfloat* sy = pool.stream(GMParticlePool::StartPositionY);
+		const GMfloat* sz = pool.stream(GMParticlePool::StartPositionZ);
+		GMfloat* cx = pool.stream(GMParticlePool::ChangePositionX);
+		GMfloat* cy = pool.stream(GMParticlePool::ChangePositionY);
+		GMfloat* cz = pool.stream(GMParticlePool::ChangePositionZ);
+		GMfloat* angle = pool.stream(GMParticlePool::Angle);
+		const GMfloat* degressPerSecond = pool.stream(GMParticlePool::DegressPerSecond);
+		GMfloat* radius = pool.stream(GMParticlePool::Radius);
+		const GMfloat* deltaRadius = pool.stream(GMParticlePool::DeltaRadius);
+
+		// 将(0, 1, 0)绕单位轴k旋转θ：v' = v * cosθ + (k × v) * sinθ + k * (k · v) * (1 - cosθ)
+		// 其中k × v = (-kz, 0, kx)，k · v = ky
+		const GMfloat kx = args.axis[0], ky = args.axis[1], kz = args.axis[2];
+		const GMfloat dt = args.dt;
+
+		// 相对模式下粒子围绕出生点，否则围绕发射器当前的位置
+		const GMfloat follow = args.relative ? 1.f : 0;
+		const GMfloat centerX = args.emitPosition[0] * (1 - follow);
+		const GMfloat centerY = args.emitPosition[1] * (1 - follow);
+		const GMfloat centerZ = args.emitPosition[2] * (1 - follow);
+
+		GMsize_t i = begin;
+#if GM_SIMD_SSE2
+		const __m128 vdt = _mm_set1_ps(dt);
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 vkx = _mm_set1_ps(kx), vky = _mm_set1_ps(ky), vkz = _mm_set1_ps(kz);
+		const __m128 vfollow = _mm_set1_ps(follow);
+		const __m128 vcx = _mm_set1_ps(centerX), vcy = _mm_set1_ps(centerY), vcz = _mm_set1_ps(centerZ);
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 a = _mm_add_ps(_mm_loadu_ps(angle + i), _mm_mul_ps(_mm_loadu_ps(degressPerSecond + i), vdt));
+			__m128 r = _mm_add_ps(_mm_loadu_ps(radius + i), _mm_mul_ps(_mm_loadu_ps(deltaRadius + i), vdt));
+			_mm_storeu_ps(angle + i, a);
+			_mm_storeu_ps(radius + i, r);
+
+			__m128 s, c;
+			GMSinCos4(a, s, c);
+			__m128 t = _mm_mul_ps(vky, _mm_sub_ps(one, c));
+			__m128 ox = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(vkx, t), _mm_mul_ps(vkz, s)), r);
+			__m128 oy = _mm_mul_ps(_mm_add_ps(c, _mm_mul_ps(vky, t)), r);
+			__m128 oz = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(vkx, s), _mm_mul_ps(vkz, t)), r);
+			_mm_storeu_ps(cx + i, ox);
+			_mm_storeu_ps(cy + i, oy);
+			_mm_storeu_ps(cz + i, oz);
+
+			_mm_storeu_ps(px + i, _mm_add_ps(_mm_add_ps(ox, vcx), _mm_mul_ps(_mm_loadu_ps(sx + i), vfollow)));
+			_mm_storeu_ps(py + i, _mm_add_ps(_mm_add_ps(oy, vcy), _mm_mul_ps(_mm_loadu_ps(sy + i), vfollow)));
+			_mm_storeu_ps(pz + i, _mm_add_ps(_mm_add_ps(oz, vcz), _mm_mul_ps(_mm_loadu_ps(sz + i), vfollow)));
+		}
+#endif
+		for (; i < end; ++i)
+		{
+			angle[i] += degressPerSecond[i] * dt;
+			radius[i] += deltaRadius[i] * dt;
+
+			const GMfloat s = Sin(angle[i]);
+			const GMfloat c = Cos(angle[i]);
+			const GMfloat t = ky * (1 - c);
+			cx[i] = (kx * t - kz * s) * radius[i];
+			cy[i] = (c + ky * t) * radius[i];
+			cz[i] = (kx * s + kz * t) * radius[i];
+
+			px[i] = cx[i] + centerX + sx[i] * follow;
+			py[i] = cy[i] + centerY + sy[i] * follow;
+			pz[i] = cz[i] + centerZ + sz[i] * follow;
+		}
+	}
 }
 
 GMParticleEffectImplBase::~GMParticleEffectImplBase()
@@ -66,6 +307,12 @@ bool GMParticleEffectImplBase::GPUUpdate(GMParticleEmitter* emitter, const IRend
 	if (particles.empty())
 		return true;
 
+	// 计算着色器使用GMParticle的布局，先将粒子池中的粒子转换到暂存区
+	typedef GM_PRIVATE_NAME(GMParticle) ParticleData;
+	auto& staging = d->staging;
+	staging.resize(particles.size());
+	particles.gather(staging.data());
+
 	auto& progParticles = d->particles;
 	auto& progParticlesSRV = d->particlesSRV;
 	auto& progParticlesResult = d->particlesResult;
@@ -76,29 +323,29 @@ bool GMParticleEffectImplBase::GPUUpdate(GMParticleEmitter* emitter, const IRend
 	// 粒子信息
 	if (!progParticles)
 	{
-		shaderProgram->createBuffer(sizeof(*particles[0].data()), gm_sizet_to_uint(particles.size()), nullptr, GMComputeBufferType::Structured, &progParticles);
+		shaderProgram->createBuffer(sizeof(ParticleData), gm_sizet_to_uint(staging.size()), nullptr, GMComputeBufferType::Structured, &progParticles);
 		shaderProgram->createBufferShaderResourceView(progParticles, &progParticlesSRV);
 
-		shaderProgram->createBuffer(sizeof(*particles[0].data()), gm_sizet_to_uint(particles.size()), nullptr, GMComputeBufferType::UnorderedStructured, &progParticlesResult);
+		shaderProgram->createBuffer(sizeof(ParticleData), gm_sizet_to_uint(staging.size()), nullptr, GMComputeBufferType::UnorderedStructured, &progParticlesResult);
 		shaderProgram->createBufferUnorderedAccessView(progParticlesResult, &progParticlesUAV);
 	}
 	else
 	{
 		// 如果粒子数量变多了，则重新生成buffer
 		GMsize_t sz = shaderProgram->getBufferSize(GMComputeBufferType::Structured, progParticles);
-		if (sz < sizeof(*particles[0].data()) * (particles.size()))
+		if (sz < sizeof(ParticleData) * (staging.size()))
 		{
 			shaderProgram->release(progParticles);
 			shaderProgram->release(progParticlesSRV);
 			shaderProgram->release(progParticlesResult);
 			shaderProgram->release(progParticlesUAV);
-			shaderProgram->createBuffer(sizeof(*particles[0].data()), gm_sizet_to_uint(particles.size()), particles.data(), GMComputeBufferType::Structured, &progParticles);
+			shaderProgram->createBuffer(sizeof(ParticleData), gm_sizet_to_uint(staging.size()), staging.data(), GMComputeBufferType::Structured, &progParticles);
 			shaderProgram->createBufferShaderResourceView(progParticles, &progParticlesSRV);
-			shaderProgram->createBuffer(sizeof(*particles[0].data()), gm_sizet_to_uint(particles.size()), nullptr, GMComputeBufferType::UnorderedStructured, &progParticlesResult);
+			shaderProgram->createBuffer(sizeof(ParticleData), gm_sizet_to_uint(staging.size()), nullptr, GMComputeBufferType::UnorderedStructured, &progParticlesResult);
 			shaderProgram->createBufferUnorderedAccessView(progParticlesResult, &progParticlesUAV);
 		}
 	}
-	shaderProgram->setBuffer(progParticles, GMComputeBufferType::Structured, particles.data(), sizeof(*particles[0].data()) * gm_sizet_to_uint(particles.size()));
+	shaderProgram->setBuffer(progParticles, GMComputeBufferType::Structured, staging.data(), sizeof(ParticleData) * gm_sizet_to_uint(staging.size()));
 	shaderProgram->bindShaderResourceView(1, &progParticlesSRV);
 
 	// 传入时间等变量
@@ -112,7 +359,7 @@ bool GMParticleEffectImplBase::GPUUpdate(GMParticleEmitter* emitter, const IRend
 	shaderProgram->bindUnorderedAccessView(1, &progParticlesUAV);
 
 	// 开始计算
-	shaderProgram->dispatch(gm_sizet_to_uint(particles.size()), 1, 1);
+	shaderProgram->dispatch(gm_sizet_to_uint(staging.size()), 1, 1);
 
 	bool canReadFromGPU = shaderProgram->canRead(progParticlesResult);
 	if (!canReadFromGPU)
@@ -124,28 +371,15 @@ bool GMParticleEffectImplBase::GPUUpdate(GMParticleEmitter* emitter, const IRend
 
 	// 处理结果
 	{
-		// 更新每个粒子的状态
+		// 更新每个粒子的状态，只将存活的粒子写回粒子池
 		GMComputeBufferHandle resultHandle = canReadFromGPU ? progParticlesResult : particleCpuResult;
 		if (!canReadFromGPU)
 			shaderProgram->copyBuffer(resultHandle, progParticlesResult);
-		typedef GM_PRIVATE_NAME(GMParticle) ParticleData;
 		const ParticleData* resultPtr = static_cast<ParticleData*>(shaderProgram->mapBuffer(resultHandle));
-		memcpy_s(particles.data(), sizeof(ParticleData) * particles.size(), resultPtr, sizeof(*particles[0].data()) * particles.size());
-
-		// 将存活的粒子放入临时容器，最后交换
-		Vector<GMParticle> tmp;
-		tmp.reserve(particles.size());
-		for (GMsize_t i = 0; i < particles.size(); ++i)
-		{
-			auto& particle = particles[i];
-			if (particle.getRemainingLife() > 0)
-			{
-				tmp.push_back(particle);
-			}
-		}
-		particles.swap(tmp);
-
+		memcpy_s(staging.data(), sizeof(ParticleData) * staging.size(), resultPtr, sizeof(ParticleData) * staging.size());
 		shaderProgram->unmapBuffer(resultHandle);
+
+		particles.scatterAlive(staging.data(), staging.size());
 	}
 	return true;
 }
@@ -154,72 +388,41 @@ void GMGravityParticleEffect::initParticle(GMParticleEmitter* emitter, GMParticl
 {
 	GMParticleEffect::initParticle(emitter, particle);
 
-	GMfloat particleSpeed = emitter->getEmitSpeed() + emitter->getEmitSpeedV() * GMRandomMt19937::random_real(-1.f, 1.f);
-	GMfloat angle = emitter->getEmitAngle() + emitter->getEmitAngleV() * GMRandomMt19937::random_real(-1.f, 1.f);
+	GMfloat r[4];
+	emitter->getRandomEngine().fill(r, GM_array_size(r), -1.f, 1.f);
+	GMfloat particleSpeed = emitter->getEmitSpeed() + emitter->getEmitSpeedV() * r[0];
+	GMfloat angle = emitter->getEmitAngle() + emitter->getEmitAngleV() * r[1];
 
 	GMQuat rotationQuat = Rotate(Radian(angle), emitter->getRotationAxis());
 	particle->getGravityModeData().initialVelocity = Inhomogeneous(s_rotateStartVector * rotationQuat) * particleSpeed;
-	particle->getGravityModeData().tangentialAcceleration = getGravityMode().getTangentialAcceleration() + getGravityMode().getTangentialAccelerationV() * GMRandomMt19937::random_real(-1.f, 1.f);
-	particle->getGravityModeData().radialAcceleration = getGravityMode().getRadialAcceleration() + getGravityMode().getRadialAccelerationV() * GMRandomMt19937::random_real(-1.f, 1.f);
+	particle->getGravityModeData().tangentialAcceleration = getGravityMode().getTangentialAcceleration() + getGravityMode().getTangentialAccelerationV() * r[2];
+	particle->getGravityModeData().radialAcceleration = getGravityMode().getRadialAcceleration() + getGravityMode().getRadialAccelerationV() * r[3];
 }
 
 void GMGravityParticleEffect::CPUUpdate(GMParticleEmitter* emitter, GMDuration dt)
 {
-	D(d);
 	auto& particles = emitter->getParticles();
-	for (auto iter = particles.begin(); iter != particles.end();)
-	{
-		GMParticle& particle = *iter;
-		particle.setRemainingLife(particle.getRemainingLife() - dt);
-		if (particle.getRemainingLife() > 0)
-		{
-			GMVec3 offset = Zero<GMVec3>();
-			GMVec3 radial = Zero<GMVec3>();
-			GMVec3 tangential = Zero<GMVec3>();
-
-			// 径向加速度
-			if (!FuzzyCompare(particle.getChangePosition().getX(), 0)
-				|| !FuzzyCompare(particle.getChangePosition().getY(), 0)
-				|| !FuzzyCompare(particle.getChangePosition().getZ(), 0))
-			{
-				radial = Normalize(particle.getGravityModeData().initialVelocity);
-			}
-			tangential = radial;
-			radial *= particle.getGravityModeData().radialAcceleration;
-
-			GMfloat y = tangential.getX();
-			tangential.setX(-tangential.getY());
-			tangential.setY(y);
-			tangential *= particle.getGravityModeData().tangentialAcceleration;
-
-			// 计算合力
-			offset = (radial + tangential + getGravityMode().getGravity()) * dt;
-			
-			// 移动粒子
-			particle.getGravityModeData().initialVelocity += offset;
-			particle.setChangePosition(particle.getChangePosition() + particle.getGravityModeData().initialVelocity * dt);
-
-			particle.setColor(particle.getColor() + particle.getDeltaColor() * dt);
-			particle.setSize(Max(0, particle.getSize() + particle.getDeltaSize() * dt));
-			particle.setRotation(particle.getRotation() + particle.getDeltaRotation() * dt);
-
-			if (getMotionMode() == GMParticleMotionMode::Relative)
-			{
-				// 跟随发射器
-				particle.setPosition(particle.getChangePosition() + emitter->getEmitPosition() - particle.getStartPosition());
-			}
-			else
-			{
-				GM_ASSERT(getMotionMode() == GMParticleMotionMode::Free);
-				particle.setPosition(particle.getChangePosition());
-			}
-			++iter;
-		}
-		else
-		{
-			iter = particles.erase(iter);
-		}
-	}
+	if (particles.empty())
+		return;
+
+	GravityKernelArgs args;
+	args.dt = dt;
+	args.relative = getMotionMode() == GMParticleMotionMode::Relative;
+	GM_ASSERT(args.relative || getMotionMode() == GMParticleMotionMode::Free);
+	const GMVec3& gravity = getGravityMode().getGravity();
+	const GMVec3& emitPosition = emitter->getEmitPosition();
+	args.gravity[0] = gravity.getX();
+	args.gravity[1] = gravity.getY();
+	args.gravity[2] = gravity.getZ();
+	args.emitPosition[0] = emitPosition.getX();
+	args.emitPosition[1] = emitPosition.getY();
+	args.emitPosition[2] = emitPosition.getZ();
+
+	GMJobSystem::instance().parallelFor(0, particles.size(), ParticlesPerJob, [&particles, &args](GMsize_t begin, GMsize_t end) {
+		advanceCommon(particles, begin, end, args.dt);
+		advanceGravity(particles, begin, end, args);
+	});
+	particles.removeDead();
 }
 
 GMString GMGravityParticleEffect::getCode()
@@ -251,54 +454,44 @@ void GMRadialParticleEffect::initParticle(GMParticleEmitter* emitter, GMParticle
 {
 	GMParticleEffect::initParticle(emitter, particle);
 
-	GMfloat beginRadius = getRadiusMode().getBeginRadius() + getRadiusMode().getBeginRadiusV() * GMRandomMt19937::random_real(-1.f, 1.f);
-	GMfloat endRadius = getRadiusMode().getEndRadius() + getRadiusMode().getEndRadiusV() * GMRandomMt19937::random_real(-1.f, 1.f);
+	GMfloat r[4];
+	emitter->getRandomEngine().fill(r, GM_array_size(r), -1.f, 1.f);
+	GMfloat beginRadius = getRadiusMode().getBeginRadius() + getRadiusMode().getBeginRadiusV() * r[0];
+	GMfloat endRadius = getRadiusMode().getEndRadius() + getRadiusMode().getEndRadiusV() * r[1];
 
 	particle->getRadiusModeData().radius = beginRadius;
 	particle->getRadiusModeData().deltaRadius = (endRadius - beginRadius) / particle->getRemainingLife();
 
-	particle->getRadiusModeData().angle = emitter->getEmitAngle() + emitter->getEmitAngleV() * GMRandomMt19937::random_real(-1.f, 1.f);
-	particle->getRadiusModeData().degressPerSecond = Radian(getRadiusMode().getSpinPerSecond() + getRadiusMode().getSpinPerSecondV() * GMRandomMt19937::random_real(-1.f, 1.f));
+	particle->getRadiusModeData().angle = emitter->getEmitAngle() + emitter->getEmitAngleV() * r[2];
+	particle->getRadiusModeData().degressPerSecond = Radian(getRadiusMode().getSpinPerSecond() + getRadiusMode().getSpinPerSecondV() * r[3]);
 }
 
 void GMRadialParticleEffect::CPUUpdate(GMParticleEmitter* emitter, GMDuration dt)
 {
 	auto& particles = emitter->getParticles();
-	for (auto iter = particles.begin(); iter != particles.end();)
-	{
-		GMParticle& particle = *iter;
-		particle.setRemainingLife(particle.getRemainingLife() - dt);
-		if (particle.getRemainingLife() > 0)
-		{
-			particle.getRadiusModeData().angle += particle.getRadiusModeData().degressPerSecond * dt;
-			particle.getRadiusModeData().radius += particle.getRadiusModeData().deltaRadius * dt;
-
-			GMQuat rotationQuat = Rotate(particle.getRadiusModeData().angle, emitter->getRotationAxis());
-			GMVec3 changePosition = particle.getChangePosition();
-			changePosition = s_rotateStartVector * rotationQuat * particle.getRadiusModeData().radius;
-			particle.setChangePosition(changePosition);
-
-			if (getMotionMode() == GMParticleMotionMode::Relative)
-			{
-				// 跟随发射器
-				particle.setPosition(particle.getChangePosition() + particle.getStartPosition());
-			}
-			else
-			{
-				GM_ASSERT(getMotionMode() == GMParticleMotionMode::Free);
-				particle.setPosition(particle.getChangePosition() + emitter->getEmitPosition());
-			}
-
-			particle.setColor(particle.getColor() + particle.getDeltaColor() * dt);
-			particle.setSize(Max(0, particle.getSize() + particle.getDeltaSize() * dt));
-			particle.setRotation(particle.getRotation() + particle.getDeltaRotation() * dt);
-			++iter;
-		}
-		else
-		{
-			iter = particles.erase(iter);
-		}
-	}
+	if (particles.empty())
+		return;
+
+	RadialKernelArgs args;
+	args.dt = dt;
+	args.relative = getMotionMode() == GMParticleMotionMode::Relative;
+	GM_ASSERT(args.relative || getMotionMode() == GMParticleMotionMode::Free);
+	// 核函数的旋转公式要求单位轴。原来的Rotate(angle, axis)同样会先将旋转轴单位化（glm::rotate和XMQuaternionRotationAxis都是如此），
+	// 因此非单位长度的旋转轴得到的结果不变
+	const GMVec3 axis = Normalize(emitter->getRotationAxis());
+	const GMVec3& emitPosition = emitter->getEmitPosition();
+	args.axis[0] = axis.getX();
+	args.axis[1] = axis.getY();
+	args.axis[2] = axis.getZ();
+	args.emitPosition[0] = emitPosition.getX();
+	args.emitPosition[1] = emitPosition.getY();
+	args.emitPosition[2] = emitPosition.getZ();
+
+	GMJobSystem::instance().parallelFor(0, particles.size(), ParticlesPerJob, [&particles, &args](GMsize_t begin, GMsize_t end) {
+		advanceCommon(particles, begin, end, args.dt);
+		advanceRadial(particles, begin, end, args);
+	});
+	particles.removeDead();
 }
 
 GMString GMRadialParticleEffect::getCode()
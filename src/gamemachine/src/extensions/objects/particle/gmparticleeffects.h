@@ -13,6 +13,7 @@ GM_PRIVATE_OBJECT_UNALIGNED(GMParticleEffectImplBase)
 	GMComputeSRVHandle particlesUAV = 0;
 	GMComputeBufferHandle particleCpuResult = 0;
 	GMComputeBufferHandle constant = 0;
+	Vector<GMParticle> staging;
 };
 
 class GMParticleEffectImplBase : public GMParticleEffect
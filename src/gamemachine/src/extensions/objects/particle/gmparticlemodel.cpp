@@ -1,8 +1,9 @@
 ﻿#include "stdafx.h"
 #include "foundation/gamemachine.h"
 #include "gmparticlemodel.h"
-#include "foundation/gmasync.h"
+#include <gmjobsystem.h>
 #include <gmengine/gmcomputeshadermanager.h>
+#include "gmparticlesimd.h"
 
 namespace
 {
@@ -15,6 +16,237 @@ namespace
 	}
 
 	static GMString s_code;
+
+	enum { VerticesPerParticle = 6 };
+
+	// 排列方式：
+	// 1   | 1 3
+	// 0 2 |   2
+	// (0, 1, 2), (2, 1, 3)
+	constexpr GMint32 s_cornerOfVertex[VerticesPerParticle] = { 0, 1, 2, 2, 1, 3 };
+	constexpr GMfloat s_texcoords[4][2] =
+	{
+		{ 0, 1 },
+		{ 0, 0 },
+		{ 1, 1 },
+		{ 1, 0 },
+	};
+
+	// 半精度浮点数表示的纹理坐标，0x3c00为1
+	constexpr GMushort s_halfTexcoords[4][2] =
+	{
+		{ 0, 0x3c00 },
+		{ 0, 0 },
+		{ 0x3c00, 0x3c00 },
+		{ 0x3c00, 0 },
+	};
+
+	// GMParticleVertex对应的顶点格式
+	GMVertexLayout createParticleVertexLayout()
+	{
+		GMVertexLayout layout;
+		layout.setFormat(GMVertexDataType::Normal, GMVertexAttributeFormat::None);
+		layout.setFormat(GMVertexDataType::Texcoord, GMVertexAttributeFormat::Half);
+		layout.setFormat(GMVertexDataType::Tangent, GMVertexAttributeFormat::None);
+		layout.setFormat(GMVertexDataType::Bitangent, GMVertexAttributeFormat::None);
+		layout.setFormat(GMVertexDataType::Color, GMVertexAttributeFormat::UNorm8);
+		layout.setFormat(GMVertexDataType::BoneIds, GMVertexAttributeFormat::None);
+		layout.setFormat(GMVertexDataType::Weights, GMVertexAttributeFormat::None);
+		return layout;
+	}
+
+	// 图形引擎可能不支持自定义顶点格式，因此以传输之后的顶点缓存为准
+	bool isParticleVertexLayout(const GMVertexLayout& layout)
+	{
+		return layout.getStride() == sizeof(GMParticleVertex) &&
+			layout.getOffset(GMVertexDataType::Texcoord) == offsetof(GMParticleVertex, texcoord) &&
+			layout.getOffset(GMVertexDataType::Lightmap) == offsetof(GMParticleVertex, size) &&
+			layout.getOffset(GMVertexDataType::Color) == offsetof(GMParticleVertex, color);
+	}
+
+	inline GMbyte toUNorm8(GMfloat value)
+	{
+		return static_cast<GMbyte>(Round(Clamp(value, 0.f, 1.f) * 255.f));
+	}
+
+	// 在顶点着色器中展开粒子时，绘制之前设置展开方式和billboard旋转
+	class GMParticleGameObject : public GMGameObject
+	{
+	public:
+		void setBillboard(const GMMat4& billboardRotation, bool useParticleZ)
+		{
+			m_billboardRotation = billboardRotation;
+			m_expand = useParticleZ ? 2 : 1;
+		}
+
+		virtual void onRenderShader(GMModel*, IShaderProgram* shaderProgram) const override
+		{
+			static const GMString s_expand = L"GM_ParticleExpand";
+			static const GMString s_billboard = L"GM_ParticleBillboard";
+			if (m_shaderProgram != shaderProgram)
+			{
+				m_shaderProgram = shaderProgram;
+				m_expandIndex = shaderProgram->getIndex(s_expand);
+				m_billboardIndex = shaderProgram->getIndex(s_billboard);
+			}
+			shaderProgram->setInt(m_expandIndex, m_expand);
+			shaderProgram->setMatrix4(m_billboardIndex, m_billboardRotation);
+		}
+
+	private:
+		GMMat4 m_billboardRotation = Identity<GMMat4>();
+		GMint32 m_expand = 0;
+		mutable IShaderProgram* m_shaderProgram = nullptr;
+		mutable GMint32 m_expandIndex = -1;
+		mutable GMint32 m_billboardIndex = -1;
+	};
+
+	// 初始化粒子顶点中不会改变的属性
+	void initParticleVertices(GMParticleVertex* vertices, GMsize_t particleCount)
+	{
+		for (GMsize_t i = 0; i < particleCount; ++i)
+		{
+			for (GMint32 j = 0; j < VerticesPerParticle; ++j)
+			{
+				GMParticleVertex& vertex = vertices[i * VerticesPerParticle + j];
+				const GMushort* texcoord = s_halfTexcoords[s_cornerOfVertex[j]];
+				vertex.texcoord[0] = texcoord[0];
+				vertex.texcoord[1] = texcoord[1];
+			}
+		}
+	}
+
+	void initParticleVertices(GMVertex* vertices, GMsize_t particleCount)
+	{
+		for (GMsize_t i = 0; i < particleCount; ++i)
+		{
+			for (GMint32 j = 0; j < VerticesPerParticle; ++j)
+			{
+				GMVertex& vertex = vertices[i * VerticesPerParticle + j];
+				const GMfloat* texcoord = s_texcoords[s_cornerOfVertex[j]];
+				vertex = GMVertex();
+				vertex.normals[2] = -1.f;
+				vertex.texcoords[0] = texcoord[0];
+				vertex.texcoords[1] = texcoord[1];
+			}
+		}
+	}
+
+	struct BillboardArgs
+	{
+		GMfloat basis[3][3]; // billboard旋转后的x、y、z轴
+		bool useParticleZ;
+	};
+
+	inline void writeParticleVertices(GMVertex* vertices, const GMfloat (&corners)[4][3], GMfloat r, GMfloat g, GMfloat b, GMfloat a)
+	{
+		for (GMint32 j = 0; j < VerticesPerParticle; ++j)
+		{
+			GMVertex& vertex = vertices[j];
+			const GMfloat* corner = corners[s_cornerOfVertex[j]];
+			vertex.positions[0] = corner[0];
+			vertex.positions[1] = corner[1];
+			vertex.positions[2] = corner[2];
+			vertex.color[0] = r;
+			vertex.color[1] = g;
+			vertex.color[2] = b;
+			vertex.color[3] = a;
+		}
+	}
+
+	// 粒子先绕原点按照自身的角度旋转，再绕粒子中心进行billboard旋转。
+	// 将两次旋转合并后，四个角为：中心 ± B * (h(c-s), h(s+c))，中心 ± B * (h(c+s), h(s-c))
+	void expandBillboardsWithBasis(const GMParticlePool& particles, GMsize_t begin, GMsize_t end, const BillboardArgs& args, GMVertex* vertices)
+	{
+		const GMfloat* x = particles.stream(GMParticlePool::PositionX);
+		const GMfloat* y = particles.stream(GMParticlePool::PositionY);
+		const GMfloat* z = particles.stream(GMParticlePool::PositionZ);
+		const GMfloat* size = particles.stream(GMParticlePool::Size);
+		const GMfloat* rotation = particles.stream(GMParticlePool::Rotation);
+		const GMfloat* r = particles.stream(GMParticlePool::ColorR);
+		const GMfloat* g = particles.stream(GMParticlePool::ColorG);
+		const GMfloat* b = particles.stream(GMParticlePool::ColorB);
+		const GMfloat* a = particles.stream(GMParticlePool::ColorA);
+		const auto& B = args.basis;
+		GMfloat corners[4][3];
+
+		GMsize_t i = begin;
+#if GM_SIMD_SSE2
+		const __m128 half = _mm_set1_ps(.5f);
+		__m128 basis[3][3];
+		for (GMint32 m = 0; m < 3; ++m)
+		{
+			for (GMint32 n = 0; n < 3; ++n)
+			{
+				basis[m][n] = _mm_set1_ps(B[m][n]);
+			}
+		}
+
+		GM_ALIGNED_16(GMfloat) lanes[4][3][4];
+		for (; i + 4 <= end; i += 4)
+		{
+			const __m128 px = _mm_loadu_ps(x + i);
+			const __m128 py = _mm_loadu_ps(y + i);
+			const __m128 pz = _mm_loadu_ps(z + i);
+			const __m128 h = _mm_mul_ps(_mm_loadu_ps(size + i), half);
+			__m128 s, c;
+			GMSinCos4(_mm_loadu_ps(rotation + i), s, c);
+
+			const __m128 dx = _mm_sub_ps(_mm_sub_ps(_mm_mul_ps(px, c), _mm_mul_ps(py, s)), px);
+			const __m128 dy = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(px, s), _mm_mul_ps(py, c)), py);
+			const __m128 dz = args.useParticleZ ? _mm_setzero_ps() : _mm_sub_ps(_mm_setzero_ps(), pz);
+			const __m128 ax = _mm_mul_ps(h, _mm_sub_ps(c, s));
+			const __m128 ay = _mm_mul_ps(h, _mm_add_ps(s, c));
+			const __m128 bx = _mm_mul_ps(h, _mm_add_ps(c, s));
+			const __m128 by = _mm_mul_ps(h, _mm_sub_ps(s, c));
+			const __m128 p[3] = { px, py, pz };
+			for (GMint32 k = 0; k < 3; ++k)
+			{
+				const __m128 q = _mm_add_ps(p[k], _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, basis[0][k]), _mm_mul_ps(dy, basis[1][k])), _mm_mul_ps(dz, basis[2][k])));
+				const __m128 ma = _mm_add_ps(_mm_mul_ps(ax, basis[0][k]), _mm_mul_ps(ay, basis[1][k]));
+				const __m128 mb = _mm_add_ps(_mm_mul_ps(bx, basis[0][k]), _mm_mul_ps(by, basis[1][k]));
+				_mm_store_ps(lanes[0][k], _mm_sub_ps(q, ma));
+				_mm_store_ps(lanes[1][k], _mm_sub_ps(q, mb));
+				_mm_store_ps(lanes[2][k], _mm_add_ps(q, mb));
+				_mm_store_ps(lanes[3][k], _mm_add_ps(q, ma));
+			}
+
+			for (GMint32 lane = 0; lane < 4; ++lane)
+			{
+				for (GMint32 corner = 0; corner < 4; ++corner)
+				{
+					corners[corner][0] = lanes[corner][0][lane];
+					corners[corner][1] = lanes[corner][1][lane];
+					corners[corner][2] = lanes[corner][2][lane];
+				}
+				const GMsize_t index = i + lane;
+				writeParticleVertices(vertices + index * VerticesPerParticle, corners, r[index], g[index], b[index], a[index]);
+			}
+		}
+#endif
+		for (; i < end; ++i)
+		{
+			const GMfloat h = size[i] * .5f;
+			const GMfloat s = Sin(rotation[i]), c = Cos(rotation[i]);
+			const GMfloat dx = x[i] * c - y[i] * s - x[i];
+			const GMfloat dy = x[i] * s + y[i] * c - y[i];
+			const GMfloat dz = args.useParticleZ ? 0 : -z[i];
+			const GMfloat ax = h * (c - s), ay = h * (s + c);
+			const GMfloat bx = h * (c + s), by = h * (s - c);
+			const GMfloat p[3] = { x[i], y[i], z[i] };
+			for (GMint32 k = 0; k < 3; ++k)
+			{
+				const GMfloat q = p[k] + dx * B[0][k] + dy * B[1][k] + dz * B[2][k];
+				const GMfloat ma = ax * B[0][k] + ay * B[1][k];
+				const GMfloat mb = bx * B[0][k] + by * B[1][k];
+				corners[0][k] = q - ma;
+				corners[1][k] = q - mb;
+				corners[2][k] = q + mb;
+				corners[3][k] = q + ma;
+			}
+			writeParticleVertices(vertices + i * VerticesPerParticle, corners, r[i], g[i], b[i], a[i]);
+		}
+	}
 }
 
 GMParticleModel::GMParticleModel(GMParticleSystem* system)
@@ -33,7 +265,6 @@ GMGameObject* GMParticleModel::createGameObject(
 )
 {
 	D(d);
-	GMGameObject* object = new GMGameObject();
 	d->particleModel = new GMModel();
 	d->particleModel->getShader().setCull(GMS_Cull::None);
 	d->particleModel->getShader().setBlend(true);
@@ -44,10 +275,12 @@ GMGameObject* GMParticleModel::createGameObject(
 	d->particleModel->setType(GMModelType::Particle);
 
 	d->particleModel->setPrimitiveTopologyMode(GMTopologyMode::Triangles);
+	d->particleModel->setVertexLayout(createParticleVertexLayout());
 	GMPart* part = new GMPart(d->particleModel);
 
 	// 使用triangles拓扑，一次性填充所有的矩形
 	GMsize_t total = d->system->getEmitter()->getParticleCount();
+	d->instances.reserve(total);
 	for (GMsize_t i = 0; i < total; ++i)
 	{
 		// 一个particle由6个定点组成
@@ -60,145 +293,103 @@ GMGameObject* GMParticleModel::createGameObject(
 	}
 
 	context->getEngine()->createModelDataProxy(context, d->particleModel);
+
+	// 顶点缓存使用GMParticleVertex的格式时，粒子在顶点着色器中展开，否则仍然在CPU或者计算着色器中展开
+	d->expandInShader = isParticleVertexLayout(d->particleModel->getModelBuffer()->getVertexLayout());
+	GMGameObject* object = d->expandInShader ? new GMParticleGameObject() : new GMGameObject();
 	object->setContext(context);
 	object->setAsset(gm::GMScene::createSceneFromSingleModel(GMAsset(GMAssetType::Model, d->particleModel)));
 	return object;
 }
 
-void GMParticleModel::update6Vertices(
-	GMVertex* vertex,
-	const GMVec3& centerPt,
-	const GMVec2& halfExtents,
-	const GMVec4& color,
-	const GMQuat& quat,
-	const GMVec3& lookDirection,
-	GMfloat z
-)
+void GMParticleModel::updateData(const IRenderContext* context, void* dataPtr)
 {
-	const static GMVec3 s_normal(0, 0, -1.f);
-	constexpr GMfloat texcoord[4][2] =
+	D(d);
+	if (d->GPUValid && !d->expandInShader)
 	{
-		{ 0, 1 },
-		{ 0, 0 },
-		{ 1, 1 },
-		{ 1, 0 },
-	};
-
-	const GMfloat x = halfExtents.getX(), y = halfExtents.getY();
-	GMVec4 raw[4] = {
-		GMVec4(centerPt.getX() - x, centerPt.getY() - y, z, 1),
-		GMVec4(centerPt.getX() - x, centerPt.getY() + y, z, 1),
-		GMVec4(centerPt.getX() + x, centerPt.getY() - y, z, 1),
-		GMVec4(centerPt.getX() + x, centerPt.getY() + y, z, 1),
-	};
+		IComputeShaderProgram* prog = GMComputeShaderManager::instance().getComputeShaderProgram(context, GMCS_PARTICLE_DATA_TRANSFER, L".", getCode(), L"main");
+		if (prog)
+		{
+			GPUUpdate(prog, context, dataPtr);
+			return;
+		}
+		d->GPUValid = false;
+	}
 
-	GMVec4 transformed[4] = {
-		raw[0] * quat,
-		raw[1] * quat,
-		raw[2] * quat,
-		raw[3] * quat,
-	};
+	// DirectX以WRITE_DISCARD方式映射顶点缓存，映射的内存不保留之前的内容；OpenGL以READ_WRITE方式映射，
+	// 读取映射的内存很慢。因此顶点在常驻的数组中生成，这里整块拷贝，不读取也不依赖映射内存中原有的数据
+	if (!d->verticesPrepared)
+		prepareVertices(context);
 
-	// 当玩家没有直视粒子时，使用billboard效果
-	if (!normalFuzzyEquals(-lookDirection, s_normal))
+	if (d->expandInShader)
 	{
-		GMQuat rot = RotationTo(s_normal, -lookDirection, Zero<GMVec3>());
-
-		GMMat4 transToOrigin = Translate(-centerPt);
-		GMMat4 transToCenterPt = Translate(centerPt);
-		// 先移回原点，旋转之后再移会原位置
-		transformed[0] = transformed[0] * transToOrigin * rot * transToCenterPt;
-		transformed[1] = transformed[1] * transToOrigin * rot * transToCenterPt;
-		transformed[2] = transformed[2] * transToOrigin * rot * transToCenterPt;
-		transformed[3] = transformed[3] * transToOrigin * rot * transToCenterPt;
+		const GMsize_t verticesSize = sizeof(GMParticleVertex) * VerticesPerParticle * d->preparedCount;
+		memcpy_s(dataPtr, verticesSize, d->particleVertices.data(), verticesSize);
 	}
-
-	// 排列方式：
-	// 1   | 1 3
-	// 0 2 |   2
-	// (0, 1, 2), (2, 1, 3)
-	const GMfloat vertices[4][3] = {
-		{ transformed[0].getX(), transformed[0].getY(), transformed[0].getZ() },
-		{ transformed[1].getX(), transformed[1].getY(), transformed[1].getZ() },
-		{ transformed[2].getX(), transformed[2].getY(), transformed[2].getZ() },
-		{ transformed[3].getX(), transformed[3].getY(), transformed[3].getZ() },
-	};
-
-	vertex[0] = {
-		{ vertices[0][0], vertices[0][1], vertices[0][2] }, //position
-		{ 0, 0, -1.f }, //normal
-		{ texcoord[0][0], texcoord[0][1] }, //texcoord
-		{ 0 },
-		{ 0 },
-		{ 0 },
-		{ color.getX(), color.getY(), color.getZ(), color.getW() }
-	};
-	vertex[1] = {
-		{ vertices[1][0], vertices[1][1], vertices[1][2] }, //position
-		{ 0, 0, -1.f }, //normal
-		{ texcoord[1][0], texcoord[1][1] }, //texcoord
-		{ 0 },
-		{ 0 },
-		{ 0 },
-		{ color.getX(), color.getY(), color.getZ(), color.getW() }
-	};
-	vertex[2] = {
-		{ vertices[2][0], vertices[2][1], vertices[2][2] }, //position
-		{ 0, 0, -1.f }, //normal
-		{ texcoord[2][0], texcoord[2][1] }, //texcoord
-		{ 0 },
-		{ 0 },
-		{ 0 },
-		{ color.getX(), color.getY(), color.getZ(), color.getW() }
-	};
-	vertex[3] = {
-		{ vertices[2][0], vertices[2][1], vertices[2][2] }, //position
-		{ 0, 0, -1.f }, //normal
-		{ texcoord[2][0], texcoord[2][1] }, //texcoord
-		{ 0 },
-		{ 0 },
-		{ 0 },
-		{ color.getX(), color.getY(), color.getZ(), color.getW() }
-	};
-	vertex[4] = {
-		{ vertices[1][0], vertices[1][1], vertices[1][2] }, //position
-		{ 0, 0, -1.f }, //normal
-		{ texcoord[1][0], texcoord[1][1] }, //texcoord
-		{ 0 },
-		{ 0 },
-		{ 0 },
-		{ color.getX(), color.getY(), color.getZ(), color.getW() }
-	};
-	vertex[5] = {
-		{ vertices[3][0], vertices[3][1], vertices[3][2] }, //position
-		{ 0, 0, -1.f }, //normal
-		{ texcoord[3][0], texcoord[3][1] }, //texcoord
-		{ 0 },
-		{ 0 },
-		{ 0 },
-		{ color.getX(), color.getY(), color.getZ(), color.getW() }
-	};
+	else
+	{
+		const GMsize_t verticesSize = sizeof(GMVertex) * VerticesPerParticle * d->preparedCount;
+		memcpy_s(dataPtr, verticesSize, d->vertices.data(), verticesSize);
+	}
+	d->verticesPrepared = false;
 }
 
-void GMParticleModel::updateData(const IRenderContext* context, void* dataPtr)
+void GMParticleModel::prepareVertices(const IRenderContext* context)
 {
 	D(d);
-	if (d->GPUValid)
+	const auto& particles = d->system->getEmitter()->getParticles();
+	if (d->expandInShader)
 	{
-		IComputeShaderProgram* prog = GMComputeShaderManager::instance().getComputeShaderProgram(context, GMCS_PARTICLE_DATA_TRANSFER, L".", getCode(), L"main");
-		if (!prog)
+		const GMsize_t initialized = d->particleVertices.size() / VerticesPerParticle;
+		if (initialized < particles.capacity())
 		{
-			d->GPUValid = false;
-			CPUUpdate(context, dataPtr);
-			return;
+			d->particleVertices.resize(particles.capacity() * VerticesPerParticle);
+			initParticleVertices(d->particleVertices.data() + initialized * VerticesPerParticle, particles.capacity() - initialized);
 		}
-
-		GPUUpdate(prog, context, dataPtr);
+		CPUUpdate(context, d->particleVertices.data());
 	}
 	else
 	{
-		CPUUpdate(context, dataPtr);
+		const GMsize_t initialized = d->vertices.size() / VerticesPerParticle;
+		if (initialized < particles.capacity())
+		{
+			d->vertices.resize(particles.capacity() * VerticesPerParticle);
+			initParticleVertices(d->vertices.data() + initialized * VerticesPerParticle, particles.capacity() - initialized);
+		}
+		CPUUpdate(context, d->vertices.data());
+	}
+	d->preparedCount = particles.size();
+}
+
+void GMParticleModel::updateBillboards(const IRenderContext* context, void* vertices, bool useParticleZ)
+{
+	D(d);
+	const auto& particles = d->system->getEmitter()->getParticles();
+	const auto& lookDirection = context->getEngine()->getCamera().getLookAt().lookDirection;
+	const GMsize_t total = particles.size();
+	const GMsize_t processors = Max(1, GM.getRunningStates().systemInfo.numberOfProcessors);
+
+	// 当玩家没有直视粒子时，使用billboard效果
+	const static GMVec3 s_normal(0, 0, -1.f);
+	const bool useBillboard = !normalFuzzyEquals(-lookDirection, s_normal);
+	const GMQuat rot = useBillboard ? RotationTo(s_normal, -lookDirection, Zero<GMVec3>()) : Identity<GMQuat>();
+
+	if (d->expandInShader)
+	{
+		GM_ASSERT(d->particleObject);
+		gm_cast<GMParticleGameObject*>(d->particleObject.get())->setBillboard(QuatToMatrix(rot), useParticleZ);
+		GMParticleVertex* particleVertices = static_cast<GMParticleVertex*>(vertices);
+		GMJobSystem::instance().parallelFor(0, total, (total + processors - 1) / processors, [&particles, particleVertices](GMsize_t begin, GMsize_t end) {
+			writeParticles(particles, begin, end, particleVertices);
+		});
+		return;
 	}
+
+	// 一个粒子有6个顶点，2个三角形，放入并行计算
+	GMVertex* expandedVertices = static_cast<GMVertex*>(vertices);
+	GMJobSystem::instance().parallelFor(0, total, (total + processors - 1) / processors, [&particles, &rot, useParticleZ, expandedVertices](GMsize_t begin, GMsize_t end) {
+		expandBillboards(particles, begin, end, rot, useParticleZ, expandedVertices);
+	});
 }
 
 void GMParticleModel::GPUUpdate(IComputeShaderProgram* shaderProgram, const IRenderContext* context, void* dataPtr)
@@ -246,12 +437,40 @@ GMComputeBufferHandle GMParticleModel::prepareBuffers(IComputeShaderProgram* sha
 	};
 
 	D(d);
-	auto& particles = d->system->getEmitter()->getParticles();
+	// 计算着色器只需要粒子的位置、大小、颜色和旋转，将它们打包后上传
+	auto& particles = d->instances;
+	const auto& pool = d->system->getEmitter()->getParticles();
+	particles.resize(pool.size());
+	{
+		const GMfloat* x = pool.stream(GMParticlePool::PositionX);
+		const GMfloat* y = pool.stream(GMParticlePool::PositionY);
+		const GMfloat* z = pool.stream(GMParticlePool::PositionZ);
+		const GMfloat* size = pool.stream(GMParticlePool::Size);
+		const GMfloat* r = pool.stream(GMParticlePool::ColorR);
+		const GMfloat* g = pool.stream(GMParticlePool::ColorG);
+		const GMfloat* b = pool.stream(GMParticlePool::ColorB);
+		const GMfloat* a = pool.stream(GMParticlePool::ColorA);
+		const GMfloat* rotation = pool.stream(GMParticlePool::Rotation);
+		for (GMsize_t i = 0; i < particles.size(); ++i)
+		{
+			GMParticleInstance& instance = particles[i];
+			instance.position[0] = x[i];
+			instance.position[1] = y[i];
+			instance.position[2] = z[i];
+			instance.size = size[i];
+			instance.color[0] = r[i];
+			instance.color[1] = g[i];
+			instance.color[2] = b[i];
+			instance.color[3] = a[i];
+			instance.rotation = rotation[i];
+		}
+	}
+
 	if (!d->constantBuffer || d->particleSizeChanged)
 	{
 		disposeGPUHandles();
 		shaderProgram->createBuffer(sizeof(Constant), 1, nullptr, GMComputeBufferType::Constant, &d->constantBuffer);
-		shaderProgram->createBuffer(sizeof(particles[0]), gm_sizet_to_uint(particles.size()), nullptr, GMComputeBufferType::Structured, &d->particleBuffer);
+		shaderProgram->createBuffer(sizeof(GMParticleInstance), gm_sizet_to_uint(particles.size()), nullptr, GMComputeBufferType::Structured, &d->particleBuffer);
 		shaderProgram->createBufferShaderResourceView(d->particleBuffer, &d->particleView);
 		shaderProgram->createBuffer(sizeof(GMVertex), gm_sizet_to_uint(particles.size()) * 6, nullptr, GMComputeBufferType::UnorderedStructured, &d->resultBuffer);
 		shaderProgram->createBufferUnorderedAccessView(d->resultBuffer, &d->resultView);
@@ -264,7 +483,7 @@ GMComputeBufferHandle GMParticleModel::prepareBuffers(IComputeShaderProgram* sha
 	shaderProgram->setBuffer(d->constantBuffer, GMComputeBufferType::Constant, &c, sizeof(c));
 	shaderProgram->bindConstantBuffer(d->constantBuffer);
 
-	shaderProgram->setBuffer(d->particleBuffer, GMComputeBufferType::Structured, particles.data(), sizeof(particles[0]) * gm_sizet_to_uint(particles.size()));
+	shaderProgram->setBuffer(d->particleBuffer, GMComputeBufferType::Structured, particles.data(), sizeof(GMParticleInstance) * gm_sizet_to_uint(particles.size()));
 	shaderProgram->bindShaderResourceView(1, &d->particleView);
 
 	// 创建结果
@@ -302,6 +521,60 @@ void GMParticleModel::setDefaultCode(const GMString& code)
 	s_code = code;
 }
 
+void GMParticleModel::expandBillboards(const GMParticlePool& particles, GMsize_t begin, GMsize_t end, const GMQuat& billboardRotation, bool useParticleZ, GMVertex* vertices)
+{
+	GMVec3 axes[3] = { GMVec3(1, 0, 0), GMVec3(0, 1, 0), GMVec3(0, 0, 1) };
+	BillboardArgs args;
+	for (GMint32 k = 0; k < 3; ++k)
+	{
+		const GMVec3 axis = axes[k] * billboardRotation;
+		args.basis[k][0] = axis.getX();
+		args.basis[k][1] = axis.getY();
+		args.basis[k][2] = axis.getZ();
+	}
+	args.useParticleZ = useParticleZ;
+	expandBillboardsWithBasis(particles, begin, end, args, vertices);
+}
+
+void GMParticleModel::writeParticles(const GMParticlePool& particles, GMsize_t begin, GMsize_t end, GMParticleVertex* vertices)
+{
+	const GMfloat* x = particles.stream(GMParticlePool::PositionX);
+	const GMfloat* y = particles.stream(GMParticlePool::PositionY);
+	const GMfloat* z = particles.stream(GMParticlePool::PositionZ);
+	const GMfloat* size = particles.stream(GMParticlePool::Size);
+	const GMfloat* rotation = particles.stream(GMParticlePool::Rotation);
+	const GMfloat* r = particles.stream(GMParticlePool::ColorR);
+	const GMfloat* g = particles.stream(GMParticlePool::ColorG);
+	const GMfloat* b = particles.stream(GMParticlePool::ColorB);
+	const GMfloat* a = particles.stream(GMParticlePool::ColorA);
+	for (GMsize_t i = begin; i < end; ++i)
+	{
+		const GMbyte color[4] = { toUNorm8(r[i]), toUNorm8(g[i]), toUNorm8(b[i]), toUNorm8(a[i]) };
+		for (GMint32 j = 0; j < VerticesPerParticle; ++j)
+		{
+			GMParticleVertex& vertex = vertices[i * VerticesPerParticle + j];
+			vertex.position[0] = x[i];
+			vertex.position[1] = y[i];
+			vertex.position[2] = z[i];
+			vertex.size = size[i];
+			vertex.rotation = rotation[i];
+			memcpy(vertex.color, color, sizeof(color));
+		}
+	}
+}
+
+void GMParticleModel::update(const IRenderContext* context)
+{
+	D(d);
+	// 计算着色器只能在渲染线程中使用，此时顶点仍然在render()中生成
+	d->verticesPrepared = false;
+	if (!d->particleObject || (d->GPUValid && !d->expandInShader))
+		return;
+
+	prepareVertices(context);
+	d->verticesPrepared = true;
+}
+
 void GMParticleModel::render(const IRenderContext* context)
 {
 	D(d);
@@ -311,22 +584,36 @@ void GMParticleModel::render(const IRenderContext* context)
 
 		if (d->system->getTexture().isEmpty())
 		{
-			// 获取并设置纹理
-			GMImage* image = nullptr;
-			auto& buffer = d->system->getTextureBuffer();
-			if (buffer.getData())
+			// 获取并设置纹理，共享的纹理只需要创建一次
+			GMTextureAsset texture;
+			const auto& sharedTexture = d->system->getSharedTexture();
+			if (sharedTexture && sharedTexture->image)
+			{
+				if (sharedTexture->texture.isEmpty())
+					GM.getFactory()->createTexture(context, sharedTexture->image.get(), sharedTexture->texture);
+				texture = sharedTexture->texture;
+			}
+			else
 			{
-				GMImageReader::load(buffer.getData(), buffer.getSize(), &image);
-				if (image)
+				GMImage* image = nullptr;
+				auto& buffer = d->system->getTextureBuffer();
+				if (buffer.getData())
 				{
-					GMTextureAsset texture;
-					GM.getFactory()->createTexture(context, image, texture);
-					GM_delete(image);
-					GM_ASSERT(d->particleObject->getModel());
-					d->particleObject->getModel()->getShader().getTextureList().getTextureSampler(GMTextureType::Ambient).addFrame(texture);
-					d->system->setTexture(texture);
+					GMImageReader::load(buffer.getData(), buffer.getSize(), &image);
+					if (image)
+					{
+						GM.getFactory()->createTexture(context, image, texture);
+						GM_delete(image);
+					}
 				}
 			}
+
+			if (!texture.isEmpty())
+			{
+				GM_ASSERT(d->particleObject->getModel());
+				d->particleObject->getModel()->getShader().getTextureList().getTextureSampler(GMTextureType::Ambient).addFrame(texture);
+				d->system->setTexture(texture);
+			}
 		}
 	}
 
@@ -346,36 +633,7 @@ void GMParticleModel::render(const IRenderContext* context)
 
 void GMParticleModel_2D::CPUUpdate(const IRenderContext* context, void* dataPtr)
 {
-	D(d);
-	auto& particles = d->system->getEmitter()->getParticles();
-	const auto& lookDirection = context->getEngine()->getCamera().getLookAt().lookDirection;
-
-	// 一个粒子有6个顶点，2个三角形，放入并行计算
-	enum { VerticesPerParticle = 6 };
-	GMAsync::blockedAsync(
-		GMAsync::Async,
-		GM.getRunningStates().systemInfo.numberOfProcessors,
-		particles.begin(),
-		particles.end(),
-		[&particles, dataPtr, this, &lookDirection](auto begin, auto end) {
-		// 计算一下数据偏移
-		GMVertex* dataOffset = reinterpret_cast<GMVertex*>(dataPtr) + (begin - particles.begin()) * VerticesPerParticle;
-		for (auto iter = begin; iter != end; ++iter)
-		{
-			GMParticle& particle = *iter;
-			GMfloat he = particle.getSize() / 2.f;
-			update6Vertices(
-				dataOffset,
-				particle.getPosition(),
-				he,
-				particle.getColor(),
-				Rotate(particle.getRotation(), GMVec3(0, 0, 1)),
-				lookDirection
-			);
-			dataOffset += VerticesPerParticle;
-		}
-	}
-	);
+	updateBillboards(context, dataPtr, false);
 }
 
 GMString GMParticleModel_2D::getCode()
@@ -385,39 +643,8 @@ GMString GMParticleModel_2D::getCode()
 
 void GMParticleModel_3D::CPUUpdate(const IRenderContext* context, void* dataPtr)
 {
-	D(d);
-	auto& particles = d->system->getEmitter()->getParticles();
-	const auto& lookDirection = context->getEngine()->getCamera().getLookAt().lookDirection;
-
 	// 粒子本身若带有旋转，则会在正对用户视觉后再来应用此旋转
-	// 一个粒子有6个顶点，2个三角形，放入并行计算
-	enum { VerticesPerParticle = 6 };
-	GMAsync::blockedAsync(
-		GMAsync::Async,
-		GM.getRunningStates().systemInfo.numberOfProcessors,
-		particles.begin(),
-		particles.end(),
-		[&particles, dataPtr, this, &lookDirection](auto begin, auto end) {
-		// 计算一下数据偏移
-		GMVertex* dataOffset = reinterpret_cast<GMVertex*>(dataPtr) + (begin - particles.begin()) * VerticesPerParticle;
-		for (auto iter = begin; iter != end; ++iter)
-		{
-			GMParticle& particle = *iter;
-			GMfloat he = particle.getSize() / 2.f;
-
-			update6Vertices(
-				dataOffset,
-				particle.getPosition(),
-				he,
-				particle.getColor(),
-				Rotate(particle.getRotation(), GMVec3(0, 0, 1)),
-				lookDirection,
-				particle.getPosition().getZ()
-			);
-			dataOffset += VerticesPerParticle;
-		}
-	}
-	);
+	updateBillboards(context, dataPtr, true);
 }
 
 GMString GMParticleModel_3D::getCode()
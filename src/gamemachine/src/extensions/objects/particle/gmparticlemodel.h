@@ -5,6 +5,34 @@
 
 BEGIN_NS
 
+//! 渲染一个粒子所需要的数据。
+/*!
+  使用计算着色器生成顶点时，每个粒子只上传此结构，而不是完整的GMParticle。它的布局与particle_transfer着色器中的instance_t一致。
+*/
+GM_ALIGNED_16(struct) GMParticleInstance
+{
+	GMfloat position[3];
+	GMfloat size;
+	GMfloat color[4];
+	GMfloat rotation;
+	GMfloat padding[3];
+};
+
+//! 在顶点着色器中展开粒子时，粒子的一个顶点。
+/*!
+  一个粒子仍然由6个顶点组成，但每个顶点只保存粒子的中心、所在的角、大小、角度和颜色，由顶点着色器展开为朝向摄像机的四边形。
+  它对应的GMVertexLayout为：位置使用32位浮点数，纹理坐标使用半精度浮点数，光照贴图坐标（粒子的大小和角度）使用32位浮点数，
+  颜色使用8位归一化整数，其它属性被省略。每个顶点占用28字节，GMVertex为112字节。
+*/
+struct GMParticleVertex
+{
+	GMfloat position[3];
+	GMushort texcoord[2];
+	GMfloat size;
+	GMfloat rotation;
+	GMbyte color[4];
+};
+
 GM_PRIVATE_OBJECT(GMParticleModel)
 {
 	GMOwnedPtr<GMGameObject> particleObject;
@@ -19,6 +47,12 @@ GM_PRIVATE_OBJECT(GMParticleModel)
 	GMComputeBufferHandle resultBuffer_CPU = 0;
 	bool particleSizeChanged = true;
 	GMsize_t lastMaxSize = 0;
+	Vector<GMParticleInstance> instances;
+	Vector<GMVertex> vertices;
+	Vector<GMParticleVertex> particleVertices;
+	GMsize_t preparedCount = 0;
+	bool verticesPrepared = false;
+	bool expandInShader = false;
 };
 
 //! 表示一个2D粒子，是一个四边形
@@ -40,23 +74,32 @@ public:
 public:
 	virtual void render(const IRenderContext* context) override;
 
+	//! 不使用计算着色器时，在更新阶段生成所有粒子的顶点，render()时只需要拷贝。
+	virtual void update(const IRenderContext* context) override;
+
 protected:
 	GMGameObject* createGameObject(
 		const IRenderContext* context
 	);
 
-	void update6Vertices(
-		GMVertex* vertex,
-		const GMVec3& centerPt,
-		const GMVec2& halfExtents,
-		const GMVec4& color,
-		const GMQuat& quat,
-		const GMVec3& lookDirection,
-		GMfloat z = 0
-	);
+	//! 将粒子展开为朝向摄像机的四边形，只写入顶点的位置和颜色。
+	/*!
+	  所有粒子共用一个billboard旋转，每帧只计算一次，每个粒子只需要计算一次旋转的正弦和余弦。支持SSE2时一次处理4个粒子。<BR>
+	  如果顶点缓存使用GMParticleVertex的格式（目前只有OpenGL），则只写入粒子的数据，billboard旋转交给顶点着色器。
+	  \param context 渲染上下文，用于获取摄像机的朝向。
+	  \param vertices 顶点数组，每个粒子6个顶点，类型为GMVertex或GMParticleVertex。
+	  \param useParticleZ 是否使用粒子的z坐标，为false时粒子先被放在z=0的平面上。
+	*/
+	void updateBillboards(const IRenderContext* context, void* vertices, bool useParticleZ);
 
 protected:
 	virtual void updateData(const IRenderContext* context, void* dataPtr);
+
+	//! 在CPU中生成所有粒子的顶点。
+	/*!
+	  dataPtr指向一个常驻的顶点数组，顶点的法线、纹理坐标等不变的属性已经初始化，只需要写入位置和颜色。
+	  在顶点着色器中展开粒子时，数组的类型为GMParticleVertex。
+	*/
 	virtual void CPUUpdate(const IRenderContext* context, void* dataPtr) = 0;
 	virtual void GPUUpdate(IComputeShaderProgram*, const IRenderContext* context, void* dataPtr);
 	virtual GMString getCode() = 0;
@@ -66,9 +109,28 @@ protected:
 
 private:
 	void disposeGPUHandles();
+	void prepareVertices(const IRenderContext* context);
 
 public:
 	static void setDefaultCode(const GMString& code);
+
+	//! 将[begin, end)之间的粒子展开为四边形，只写入顶点的位置和颜色。
+	/*!
+	  粒子先按照自身的角度绕z轴旋转，再绕粒子中心进行billboard旋转。
+	  \param particles 粒子池。
+	  \param begin 第一个粒子的下标。
+	  \param end 最后一个粒子之后的下标。
+	  \param billboardRotation 所有粒子共用的billboard旋转。
+	  \param useParticleZ 是否使用粒子的z坐标，为false时粒子先被放在z=0的平面上。
+	  \param vertices 顶点数组，第i个粒子的6个顶点从vertices[i * 6]开始。
+	*/
+	static void expandBillboards(const GMParticlePool& particles, GMsize_t begin, GMsize_t end, const GMQuat& billboardRotation, bool useParticleZ, GMVertex* vertices);
+
+	//! 将[begin, end)之间粒子的中心、大小、角度和颜色写入顶点，由顶点着色器展开。
+	/*!
+	  \param vertices 顶点数组，第i个粒子的6个顶点从vertices[i * 6]开始。
+	*/
+	static void writeParticles(const GMParticlePool& particles, GMsize_t begin, GMsize_t end, GMParticleVertex* vertices);
 };
 
 class GMParticleModel_2D : public GMParticleModel
@@ -3,6 +3,7 @@
 #define _CRT_NON_CONFORMING_SWPRINTFS
 #include "stdafx.h"
 #include "debug.h"
+#include <gmthread.h>
 #include <cwchar>
 #include <chrono>
 #include <ctime>
@@ -81,3 +82,32 @@ void GMDebugger::print(
 }
 
 Map<GMsize_t, void*> HookFactory::g_hooks;
+
+namespace
+{
+	GMReadWriteLock& hookLock()
+	{
+		static GMReadWriteLock s_lock;
+		return s_lock;
+	}
+}
+
+HookFactory::SharedLocker::SharedLocker()
+{
+	hookLock().lockShared();
+}
+
+HookFactory::SharedLocker::~SharedLocker()
+{
+	hookLock().unlockShared();
+}
+
+HookFactory::Locker::Locker()
+{
+	hookLock().lock();
+}
+
+HookFactory::Locker::~Locker()
+{
+	hookLock().unlock();
+}
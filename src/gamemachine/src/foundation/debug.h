@@ -109,9 +109,22 @@ public:
 // hooks
 typedef GMsize_t CallbackType;
 typedef void *HookObject;
-struct HookFactory
+struct GM_EXPORT HookFactory
 {
 	static Map<CallbackType, HookObject> g_hooks;
+
+	// 触发钩子时共享锁定钩子表，安装钩子时独占锁定钩子表
+	struct GM_EXPORT SharedLocker
+	{
+		SharedLocker();
+		~SharedLocker();
+	};
+
+	struct GM_EXPORT Locker
+	{
+		Locker();
+		~Locker();
+	};
 };
 
 template <typename... Args>
@@ -124,6 +137,7 @@ using HookMap = Map<GMString, Vector<std::function<void(Args...)> > >;
   例如，当调用gm_hook("A hook", 1, 2)时，对应的回调函数类型为void(int, int)。
   如果需要使用带引用的回调函数，必须在gm_hook的模板参数中显示指定出来。如：
   调用gm_hook<int&&, int&&>("A hook", 1, 2)表示触发类型为void(int&&, int&&)的回调函数，参数整数1和2将会作为右值引用传入回调函数。
+  钩子可以在多个线程中同时被触发，但是不能在钩子回调函数中安装钩子。
   \param hookName 钩子名称
   \param args 传入钩子回调函数的参数
   \sa installHook()
@@ -135,12 +149,17 @@ void hook(const GMString& hookName, Args... args)
 	typedef Vector<_FnType> _FnListType;
 
 	CallbackType hash_code = typeid(_FnListType).hash_code();
-	HookObject hookMap = HookFactory::g_hooks[hash_code];
-	if (!hookMap)
+	HookFactory::SharedLocker locker;
+	auto hookIter = HookFactory::g_hooks.find(hash_code);
+	if (hookIter == HookFactory::g_hooks.end())
+		return;
+
+	HookMap<Args...>* hm = static_cast<HookMap<Args...>* >(hookIter->second);
+	auto callbacksIter = hm->find(hookName);
+	if (callbacksIter == hm->end())
 		return;
 
-	HookMap<Args...>* hm = static_cast<HookMap<Args...>* >(hookMap);
-	_FnListType& callbacks = (*hm)[hookName];
+	_FnListType& callbacks = callbacksIter->second;
 	for (auto& callback : callbacks)
 		callback(std::forward<Args>(args)...);
 }
@@ -162,6 +181,7 @@ void installHook(const GMString& hookName, std::function<void(Args...)> callback
 	typedef Vector<std::function<void(Args...)>> _FnListType;
 
 	CallbackType hash_code = typeid(_FnListType).hash_code();
+	HookFactory::Locker locker;
 	HookObject hookMap = HookFactory::g_hooks[hash_code];
 	if (hookMap)
 	{
@@ -112,8 +112,8 @@ using Deque = std::deque<T, Alloc>;
 template <typename T, typename Container = Deque<T> >
 using Stack = std::stack<T, Container>;
 
-template <typename T>
-using List = std::list<T>;
+template <typename T, typename Alloc = std::allocator<T>>
+using List = std::list<T, Alloc>;
 
 template <typename... T>
 using Tuple = std::tuple<T...>;
@@ -144,6 +144,15 @@ using GMAtomic = std::atomic<T>;
 #	endif
 #endif
 
+// 是否可以使用SSE2指令。x64平台总是支持SSE2，可以在编译选项中定义GM_SIMD_SSE2=0来关闭
+#ifndef GM_SIMD_SSE2
+#	if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#		define GM_SIMD_SSE2 1
+#	else
+#		define GM_SIMD_SSE2 0
+#	endif
+#endif
+
 // 编译设置：
 #ifndef GM_LIB
 #	define GM_LIB 1
@@ -253,6 +262,7 @@ typedef short GMshort;
 typedef unsigned short GMushort;
 typedef wchar_t GMwchar;
 typedef int64_t GMint64;
+typedef uint64_t GMuint64;
 typedef GMint32 GMFontSizePt;
 typedef size_t GMsize_t;
 
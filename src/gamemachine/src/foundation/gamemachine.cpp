@@ -5,6 +5,9 @@
 #include "gmconfigs.h"
 #include "gmengine/ui/gmwidget.h"
 #include "gmmessage.h"
+#include "gmjobsystem.h"
+#include "gmprofile.h"
+#include "gmthreadpool.h"
 
 extern "C"
 {
@@ -27,6 +30,7 @@ extern "C"
 namespace
 {
 	static GMMessage s_frameUpdateMsg(GameMachineMessageType::FrameUpdate);
+	constexpr GMsize_t MessageBatchSize = 64;
 }
 
 GameMachine& GameMachine::instance()
@@ -47,6 +51,7 @@ void GameMachine::init(
 {
 	D(d);
 	initSystemInfo();
+	GMJobSystem::instance().start(d->states.systemInfo.numberOfProcessors);
 
 	d->runningMode = desc.runningMode;
 	setRenderEnvironment(desc.renderEnvironment);
@@ -147,6 +152,8 @@ bool GameMachine::renderFrame(IWindow* window)
 	if (checkCrashDown())
 		return false;
 
+	++d->states.frameNumber;
+
 	// 调用Handler
 	beginHandlerEvents(window);
 
@@ -159,6 +166,14 @@ bool GameMachine::renderFrame(IWindow* window)
 	// 本帧结束
 	endHandlerEvents(window);
 
+	// 帧内存只在当前帧有效
+	GMFrameArena::instance().reset();
+
+	// 同步性能统计的开关，并标记一帧结束
+	GMProfiler& profiler = GMProfiler::instance();
+	profiler.setEnabled(d->configs.getConfig(GMConfigs::Debug).asDebugConfig().get(GMDebugConfigs::RunProfile_Bool).toBool());
+	profiler.endFrame();
+
 	d->states.lastFrameElpased = frameCounter.elapsedFromStart();
 	return true;
 }
@@ -253,16 +268,22 @@ bool GameMachine::handleMessages()
 {
 	D(d);
 	GMMessage msg;
-	while (d->messageQueue.size() > 0)
+	while (true)
 	{
-		msg = d->messageQueue.front();
+		// 批量取出消息，上一次因为退出而没有处理完的消息会先被处理
+		if (d->messageBatchIndex >= d->messageBatch.size())
+		{
+			d->messageBatch.resize(MessageBatchSize);
+			d->messageBatch.resize(d->messageQueue.popBatch(d->messageBatch.data(), MessageBatchSize));
+			d->messageBatchIndex = 0;
+			if (d->messageBatch.empty())
+				break;
+		}
 
+		msg = d->messageBatch[d->messageBatchIndex++];
+		d->messageQueue.markHandled(msg);
 		if (!handleMessage(msg))
-		{
-			d->messageQueue.pop();
 			return false;
-		}
-		d->messageQueue.pop();
 	}
 	d->lastMessage = msg;
 	return true;
@@ -344,6 +365,10 @@ void GameMachine::finalize()
 	{
 		GM_delete(window);
 	}
+
+	GMThreadPool::ioPool().stop();
+	GMProfiler::instance().stop();
+	GMJobSystem::instance().stop();
 }
 
 void GameMachine::updateGameMachineRunningStates()
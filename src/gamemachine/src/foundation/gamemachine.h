@@ -8,6 +8,7 @@
 #include <gmgamepackage.h>
 #include <gmthread.h>
 #include <gmmessage.h>
+#include <gmmessagequeue.h>
 
 BEGIN_NS
 
@@ -74,6 +75,7 @@ struct GMGameMachineRunningStates
 	// 每一帧更新的内容
 	GMDuration lastFrameElpased = 0; //!< 上一帧渲染锁花费的时间，单位是秒。
 	GMDuration elapsedTime = 0; //!< 程序运行到现在为止的时间，单位是秒。
+	GMuint64 frameNumber = 0; //!< 当前帧的序号，每次渲染一帧时加1。
 	GMfloat fps = 0; //!< 程序当前的帧率。
 	bool crashDown = false; //!< 程序是否已崩溃。当遇到不可恢复的错误时，此项为true。
 
@@ -113,7 +115,9 @@ GM_PRIVATE_OBJECT_UNALIGNED(GameMachine)
 	GMGamePackage* gamePackageManager = nullptr;
 	GMConfigs* statesManager = nullptr;
 	GMMessage lastMessage;
-	Queue<GMMessage> messageQueue;
+	GMMessageQueue messageQueue;
+	Vector<GMMessage> messageBatch;
+	GMsize_t messageBatchIndex = 0;
 	Vector<IDestroyObject*> managerQueue;
 	GMGameMachineRunningStates states;
 	GMGameMachineRunningMode runningMode;
@@ -183,7 +187,8 @@ public:
 
 	//! 发送一条GameMachine的消息。
 	/*!
-	  发送一条GameMachine的消息。发送消息之后，此消息将会在下一轮消息循环时被执行。
+	  发送一条GameMachine的消息。发送消息之后，此消息将会在下一轮消息循环时被执行。<BR>
+	  此方法是线程安全的，资源加载、音频解码等线程可以直接投递消息，而不需要额外加锁。
 	  \param msg 需要发送的GameMachine消息。
 	  \sa startGameMachine()
 	*/
@@ -197,6 +202,13 @@ public:
 	*/
 	GMMessage peekMessage();
 
+	//! 获取GameMachine的消息队列。
+	/*!
+	  可以通过消息队列获取每种消息被投递和处理的次数。
+	  \return GameMachine的消息队列。
+	*/
+	inline const GMMessageQueue& getMessageQueue() const { D(d); return d->messageQueue; }
+
 	//! 开始运行GameMachine。
 	/*!
 	  当GameMachine实例初始化之后，调用此方法开始程序内的游戏循环。<BR>
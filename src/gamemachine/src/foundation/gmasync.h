@@ -1,6 +1,7 @@
 ﻿#ifndef __GMASYNC_H__
 #define __GMASYNC_H__
 #include <gmcommon.h>
+#include <gmjobsystem.h>
 #include <future>
 #include <type_traits>
 BEGIN_NS
@@ -17,49 +18,68 @@ public:
 		Deferred = 0x2
 	};
 
+	//! 异步执行一个函数。
+	/*!
+	  如果策略为Async，函数将作为一个任务交给GMJobSystem执行，不会创建新的线程。等待返回的future时，调用线程会通过
+	  GMJobSystem::wait()帮助执行队列中的其它任务，因此在一个异步函数中等待另一个异步函数的结果也不会死锁。<BR>
+	  如果策略为Deferred，函数将在获取结果时在调用线程中执行。
+	  \return 用于获取函数执行结果的future。
+	*/
 	template <typename Function, typename... Args>
 	static auto async(LaunchPolicy policy, Function&& function, Args&&... args)
 	{
-		return std::async(static_cast<std::launch>(policy), std::forward<Function>(function), std::forward<Args>(args)...);
+		typedef decltype(std::bind(std::forward<Function>(function), std::forward<Args>(args)...)) BoundType;
+		typedef typename std::result_of<BoundType()>::type ResultType;
+		if (policy == Deferred)
+			return std::async(std::launch::deferred, std::forward<Function>(function), std::forward<Args>(args)...);
+
+		auto task = gm_makeSharedPtr<std::packaged_task<ResultType()>>(std::bind(std::forward<Function>(function), std::forward<Args>(args)...));
+		GMFuture<ResultType> result = task->get_future();
+		GMJobHandle job = GMJobSystem::instance().schedule([task]() {
+			(*task)();
+		});
+
+		// 返回的future在等待时先等待任务结束，而不是直接阻塞在结果上
+		return std::async(std::launch::deferred, [job](GMFuture<ResultType> result) {
+			GMJobSystem::instance().wait(job);
+			return result.get();
+		}, std::move(result));
 	}
 
+	//! 将一个区间分块，并行执行。
+	/*!
+	  区间将被分成taskCount块，每一块作为一个任务交给GMJobSystem执行，此方法在所有块执行完毕后返回。
+	  \param policy 如果为Deferred，整个区间将在调用线程中执行。
+	  \param taskCount 分块的数量。
+	  \param iterBegin 区间起始迭代器，必须为随机访问迭代器。
+	  \param iterEnd 区间结束迭代器。
+	  \param function 执行函数，其签名为void(Iter begin, Iter end)。
+	*/
 	template <typename Iter, typename Function>
 	static void blockedAsync(LaunchPolicy policy, GMsize_t taskCount, Iter iterBegin, Iter iterEnd, Function&& function)
 	{
 		typedef typename std::iterator_traits<Iter>::iterator_category IterTag;
 		GM_STATIC_ASSERT(std::is_same<std::random_access_iterator_tag, IterTag>::value, "Iterator must be a random access iterator");
-		typedef decltype(async(Async, std::forward<Function>(function), Iter(), Iter())) FutureType;
 
-		// 用于缓存Async状态的future，否则future析构时将会进行等待
+		GMsize_t len = iterEnd - iterBegin;
+		if (len == 0)
+			return;
+
 		if (taskCount < 1)
 			taskCount = 1;
-
-		Vector<FutureType> futures;
-		futures.reserve(taskCount);
-
-		GMsize_t len = iterEnd - iterBegin;
-		GMsize_t step = (iterEnd - iterBegin) / taskCount;
 		if (taskCount > len)
 			taskCount = len;
 
-		Iter iter = iterBegin;
-		for (GMsize_t i = 0; i < taskCount; ++i)
+		if (policy == Deferred || taskCount == 1)
 		{
-			if (i < taskCount - 1)
-			{
-				futures.push_back(std::move(async(policy, std::forward<Function>(function), iter, iter + step)));
-				iter += step;
-			}
-			else
-			{
-				futures.push_back(std::move(async(policy, std::forward<Function>(function), iter, iterEnd)));
-			}
+			function(iterBegin, iterEnd);
+			return;
 		}
 
-		for (auto& future : futures)
-		{
-			future.wait();
-		}
+		GMsize_t step = (len + taskCount - 1) / taskCount;
+		GMJobSystem::instance().parallelFor(0, len, step, [&function, iterBegin](GMsize_t begin, GMsize_t end) {
+			function(iterBegin + begin, iterBegin + end);
+		});
 	}
 };
 
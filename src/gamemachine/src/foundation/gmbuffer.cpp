@@ -2,11 +2,38 @@
 #include "gmbuffer.h"
 #include "foundation/debug.h"
 
+namespace
+{
+	// 数据紧跟在控制块之后，保持16字节对齐
+	constexpr GMsize_t BlockHeaderSize = (sizeof(GMBufferBlock) + 15) & ~static_cast<GMsize_t>(15);
+
+	inline GMint32 sizeClassOf(GMsize_t size)
+	{
+		GMint32 index = 0;
+		GMsize_t classSize = GMBufferPool::MinBlockSize;
+		while (classSize < size)
+		{
+			classSize <<= 1;
+			++index;
+		}
+		return index;
+	}
+
+	inline GMsize_t classSizeOf(GMint32 index)
+	{
+		return static_cast<GMsize_t>(GMBufferPool::MinBlockSize) << index;
+	}
+}
+
+GMbyte* GMBufferBlock::payload()
+{
+	return reinterpret_cast<GMbyte*>(this) + BlockHeaderSize;
+}
+
 GMBuffer::GMBuffer()
-	: isOwned(true)
+	: data(nullptr)
 	, size(0)
-	, data(nullptr)
-	, ref(nullptr)
+	, block(nullptr)
 {
 }
 
@@ -25,12 +52,11 @@ GMBuffer::GMBuffer(GMBuffer&& buf) GM_NOEXCEPT
 GMBuffer::GMBuffer(GMbyte* rhs, GMsize_t sz, bool owned)
 	: GMBuffer()
 {
-	ref = new GMAtomic<GMuint32>(1);
-	isOwned = owned;
 	size = sz;
-	if (isOwned)
+	if (owned)
 	{
-		data = new GMbyte[size];
+		block = GMBufferPool::instance().acquire(size);
+		data = block->payload();
 		if (rhs)
 			memcpy_s(data, size, rhs, size);
 	}
@@ -40,12 +66,18 @@ GMBuffer::GMBuffer(GMbyte* rhs, GMsize_t sz, bool owned)
 	}
 }
 
-GMBuffer::GMBuffer(GMBuffer& buf, GMsize_t offset)
+GMBuffer::GMBuffer(const GMBuffer& buf, GMsize_t offset, GMsize_t length)
 	: GMBuffer()
 {
-	isOwned = false;
-	data = buf.getData() + offset;
-	size = buf.getSize() - offset;
+	if (offset > buf.size)
+		offset = buf.size;
+	if (length > buf.size - offset)
+		length = buf.size - offset;
+
+	data = buf.data + offset;
+	size = length;
+	block = buf.block;
+	addRef();
 }
 
 GMBuffer::~GMBuffer()
@@ -60,8 +92,7 @@ GMBuffer& GMBuffer::operator=(const GMBuffer& rhs)
 		releaseRef();
 		size = rhs.size;
 		data = rhs.data;
-		ref = rhs.ref;
-		isOwned = rhs.isOwned;
+		block = rhs.block;
 		addRef();
 	}
 	return *this;
@@ -75,7 +106,12 @@ GMBuffer& GMBuffer::operator=(GMBuffer&& rhs) GM_NOEXCEPT
 
 GMBuffer GMBuffer::createBufferView(const GMBuffer& buf, GMsize_t offset)
 {
-	return GMBuffer(const_cast<GMBuffer&>(buf), offset);
+	return GMBuffer(buf, offset, buf.getSize());
+}
+
+GMBuffer GMBuffer::createBufferView(const GMBuffer& buf, GMsize_t offset, GMsize_t length)
+{
+	return GMBuffer(buf, offset, length);
 }
 
 GMBuffer GMBuffer::createBufferView(GMbyte* data, GMsize_t size)
@@ -100,7 +136,7 @@ GMsize_t GMBuffer::getSize() const
 
 bool GMBuffer::isOwnedBuffer() const
 {
-	return isOwned;
+	return !!block;
 }
 
 void GMBuffer::resize(GMsize_t sz, GMbyte* d)
@@ -123,38 +159,145 @@ void GMBuffer::swap(GMBuffer& rhs)
 	{
 		std::swap(size, rhs.size);
 		std::swap(data, rhs.data);
-		std::swap(ref, rhs.ref);
-		std::swap(isOwned, rhs.isOwned);
+		std::swap(block, rhs.block);
 	}
 }
 
 void GMBuffer::convertToStringBuffer()
 {
+	// 如果独占一个块，并且块中还有空间，直接在末尾补0
+	if (block && block->ref.load(std::memory_order_acquire) == 1 && data + size < block->payload() + block->capacity)
+	{
+		data[size++] = 0;
+		return;
+	}
+
 	GMBuffer buf;
 	buf.resize(size + 1);
 	memcpy_s(buf.data, size, data, size);
 	// 在末尾补0
 	buf.data[size] = 0;
-	*this = buf;
+	*this = std::move(buf);
 }
 
 void GMBuffer::addRef()
 {
-	if (ref)
-		++(*ref);
+	if (block)
+		block->ref.fetch_add(1, std::memory_order_relaxed);
 }
 
 void GMBuffer::releaseRef()
 {
-	if (ref)
+	if (block)
+	{
+		if (block->ref.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			if (block->pool)
+				block->pool->release(block);
+			else
+				GMBufferPool::freeBlock(block);
+		}
+		block = nullptr;
+		data = nullptr;
+		size = 0;
+	}
+}
+
+GMBufferPool& GMBufferPool::instance()
+{
+	// 缓冲池永不析构，保证静态对象析构时释放的缓冲区仍然可以归还
+	static GMBufferPool* s_instance = new GMBufferPool();
+	return *s_instance;
+}
+
+GMBufferPool::GMBufferPool()
+	: m_reuseCount(0)
+{
+}
+
+GMBufferPool::~GMBufferPool()
+{
+	trim();
+}
+
+GMBufferBlock* GMBufferPool::acquire(GMsize_t size)
+{
+	if (size > MaxBlockSize)
+		return allocateBlock(size, nullptr);
+
+	GMint32 index = sizeClassOf(size);
+	SizeClass& sizeClass = m_classes[index];
+	{
+		std::lock_guard<std::mutex> lock(sizeClass.mutex);
+		if (!sizeClass.freeBlocks.empty())
+		{
+			GMBufferBlock* block = sizeClass.freeBlocks.back();
+			sizeClass.freeBlocks.pop_back();
+			block->ref.store(1, std::memory_order_relaxed);
+			m_reuseCount.fetch_add(1, std::memory_order_relaxed);
+			return block;
+		}
+	}
+	return allocateBlock(classSizeOf(index), this);
+}
+
+void GMBufferPool::release(GMBufferBlock* block)
+{
+	GM_ASSERT(block && block->pool == this);
+	GMint32 index = sizeClassOf(block->capacity);
+	SizeClass& sizeClass = m_classes[index];
+	{
+		std::lock_guard<std::mutex> lock(sizeClass.mutex);
+		if ((sizeClass.freeBlocks.size() + 1) * block->capacity <= MaxCachedBytesPerClass)
+		{
+			sizeClass.freeBlocks.push_back(block);
+			return;
+		}
+	}
+	freeBlock(block);
+}
+
+void GMBufferPool::trim()
+{
+	for (auto& sizeClass : m_classes)
 	{
-		--(*ref);
-		if (*ref == 0)
+		Vector<GMBufferBlock*> blocks;
 		{
-			size = 0;
-			GM_delete(ref);
-			if (isOwnedBuffer())
-				GM_delete_array(data);
+			std::lock_guard<std::mutex> lock(sizeClass.mutex);
+			blocks.swap(sizeClass.freeBlocks);
+		}
+
+		for (auto block : blocks)
+		{
+			freeBlock(block);
 		}
 	}
 }
+
+GMsize_t GMBufferPool::getCachedBytes() const
+{
+	GMsize_t bytes = 0;
+	for (GMint32 i = 0; i < ClassCount; ++i)
+	{
+		SizeClass& sizeClass = const_cast<SizeClass&>(m_classes[i]);
+		std::lock_guard<std::mutex> lock(sizeClass.mutex);
+		bytes += sizeClass.freeBlocks.size() * classSizeOf(i);
+	}
+	return bytes;
+}
+
+GMBufferBlock* GMBufferPool::allocateBlock(GMsize_t capacity, GMBufferPool* pool)
+{
+	GMBufferBlock* block = static_cast<GMBufferBlock*>(gmAlignedAlloc(BlockHeaderSize + capacity, 16));
+	new (block) GMBufferBlock();
+	block->ref.store(1, std::memory_order_relaxed);
+	block->capacity = capacity;
+	block->pool = pool;
+	return block;
+}
+
+void GMBufferPool::freeBlock(GMBufferBlock* block)
+{
+	block->~GMBufferBlock();
+	gmAlignedFree(block);
+}
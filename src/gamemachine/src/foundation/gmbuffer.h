@@ -1,8 +1,30 @@
 ﻿#ifndef __GMBUFFER_H__
 #define __GMBUFFER_H__
 #include <defines.h>
+#include <mutex>
 BEGIN_NS
 
+class GMBufferPool;
+
+//! 缓冲区的控制块。
+/*!
+  控制块与数据分配在同一块内存中，数据紧跟在控制块之后，并且16字节对齐。
+*/
+struct GMBufferBlock
+{
+	GMAtomic<GMuint32> ref;
+	GMsize_t capacity;
+	GMBufferPool* pool; //!< 所属的缓冲池，为空表示不是从缓冲池中分配的。
+
+	GMbyte* payload();
+};
+
+//! 一段带引用计数的二进制数据。
+/*!
+  拥有数据的缓冲区与其控制块一同分配，因此创建一个缓冲区只需要一次内存分配，常用大小的缓冲区还会从GMBufferPool中复用。
+  引用计数是线程安全的，缓冲区可以在多个线程之间传递。<BR>
+  通过createBufferView()可以创建一个缓冲区的切片，它与原缓冲区共享数据和引用计数，因此原缓冲区被释放后切片依然有效。
+*/
 class GM_EXPORT GMBuffer : public IDestroyObject
 {
 public:
@@ -16,10 +38,22 @@ public:
 	GMBuffer& operator=(GMBuffer&&) GM_NOEXCEPT;
 
 private:
-	GMBuffer(GMBuffer& buf, GMsize_t offset);
+	GMBuffer(const GMBuffer& buf, GMsize_t offset, GMsize_t length);
 
 public:
+	//! 创建一个从offset开始直到末尾的切片。
 	static GMBuffer createBufferView(const GMBuffer& buf, GMsize_t offset);
+
+	//! 创建一个从offset开始，长度为length的切片。
+	/*!
+	  切片与buf共享数据，并且持有buf的引用。
+	  \param buf 原缓冲区。
+	  \param offset 切片开始的位置。
+	  \param length 切片的长度，超出原缓冲区的部分会被截断。
+	*/
+	static GMBuffer createBufferView(const GMBuffer& buf, GMsize_t offset, GMsize_t length);
+
+	//! 创建一个不拥有数据的缓冲区，调用者需要确保数据在缓冲区使用期间有效。
 	static GMBuffer createBufferView(GMbyte* data, GMsize_t size);
 
 public:
@@ -38,9 +72,66 @@ private:
 private:
 	GMbyte* data;
 	GMsize_t size;
-	GMAtomic<GMuint32>* ref;
-	bool isOwned;
+	GMBufferBlock* block;
+};
+
+//! 缓冲区的内存池。
+/*!
+  缓冲池按照2的幂划分大小等级，最小的等级为MinBlockSize，最大的等级为MaxBlockSize。释放的块放回对应等级的空闲列表中，
+  每个等级缓存的总字节数不超过MaxCachedBytesPerClass。超过MaxBlockSize的缓冲区直接向系统申请。此类是线程安全的。
+*/
+class GM_EXPORT GMBufferPool
+{
+public:
+	enum
+	{
+		MinBlockSizeShift = 8,
+		MaxBlockSizeShift = 20,
+		MinBlockSize = 1 << MinBlockSizeShift,
+		MaxBlockSize = 1 << MaxBlockSizeShift,
+		ClassCount = MaxBlockSizeShift - MinBlockSizeShift + 1,
+		MaxCachedBytesPerClass = 4 * 1024 * 1024,
+	};
+
+	static GMBufferPool& instance();
+
+public:
+	GMBufferPool();
+	~GMBufferPool();
+
+	GMBufferPool(const GMBufferPool&) = delete;
+	GMBufferPool& operator=(const GMBufferPool&) = delete;
+
+public:
+	//! 获取一个至少能存放size个字节的块，块的引用计数为1。
+	GMBufferBlock* acquire(GMsize_t size);
+
+	//! 归还一个引用计数已经为0的块。
+	void release(GMBufferBlock* block);
+
+	//! 释放所有缓存的块。
+	void trim();
+
+	//! 获取从缓存中复用块的次数。
+	GMint64 getReuseCount() const { return m_reuseCount.load(std::memory_order_relaxed); }
+
+	//! 获取缓存的总字节数。
+	GMsize_t getCachedBytes() const;
+
+public:
+	static GMBufferBlock* allocateBlock(GMsize_t capacity, GMBufferPool* pool);
+	static void freeBlock(GMBufferBlock* block);
+
+private:
+	struct SizeClass
+	{
+		std::mutex mutex;
+		Vector<GMBufferBlock*> freeBlocks;
+	};
+
+	SizeClass m_classes[ClassCount];
+	GMAtomic<GMint64> m_reuseCount;
 };
 
 END_NS
-#endif
\ No newline at end of file
+#endif
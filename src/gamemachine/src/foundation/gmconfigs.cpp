@@ -51,6 +51,7 @@ void GMConfigs::init()
 	renderConfig.set(GMRenderConfigs::HDR_Bool, false);
 	renderConfig.set(GMRenderConfigs::ToneMapping, GMToneMapping::Reinhard);
 	renderConfig.set(GMRenderConfigs::ViewCascade_Bool, false);
+	renderConfig.set(GMRenderConfigs::RenderQueue_Bool, false);
 }
 
 GMConfig& GMConfigs::getConfig(Category state)
@@ -68,6 +68,7 @@ enum class GMRenderConfigs
 	HDR_Bool,
 	ToneMapping,
 	ViewCascade_Bool,
+	RenderQueue_Bool,
 	Max,
 };
 
@@ -0,0 +1,101 @@
+﻿#include "stdafx.h"
+#include "gmframegraph.h"
+
+GMFrameTaskId GMFrameGraph::addTask(GMJobFunction function, const Vector<GMFrameTaskId>& dependencies, GMFrameTaskThread thread)
+{
+	D(d);
+	GMFrameTaskId id = d->tasks.size();
+	GMFrameTask task;
+	task.function = std::move(function);
+	task.thread = thread;
+	for (auto dependency : dependencies)
+	{
+		// 只能依赖之前添加的任务
+		GM_ASSERT(dependency < id);
+		if (dependency < id)
+			task.dependencies.push_back(dependency);
+	}
+	d->tasks.push_back(std::move(task));
+	return id;
+}
+
+void GMFrameGraph::execute()
+{
+	D(d);
+	GMJobSystem& jobSystem = GMJobSystem::instance();
+	GMsize_t taskCount = d->tasks.size();
+	d->handles.clear();
+	d->handles.resize(taskCount);
+
+	Vector<GMJobHandle> dependencies;
+	GMsize_t remaining = taskCount;
+	while (remaining > 0)
+	{
+		// 先把所有依赖已经被调度的工作线程任务交给GMJobSystem
+		for (GMsize_t i = 0; i < taskCount; ++i)
+		{
+			const GMFrameTask& task = d->tasks[i];
+			if (d->handles[i] || task.thread != GMFrameTaskThread::Worker || !isReady(task))
+				continue;
+
+			collectDependencies(task, dependencies);
+			d->handles[i] = jobSystem.schedule(task.function, dependencies);
+			--remaining;
+		}
+
+		// 再执行第一个可以执行的主线程任务，执行完之后，依赖它的工作线程任务可以被调度
+		for (GMsize_t i = 0; i < taskCount; ++i)
+		{
+			const GMFrameTask& task = d->tasks[i];
+			if (d->handles[i] || task.thread != GMFrameTaskThread::MainThread || !isReady(task))
+				continue;
+
+			collectDependencies(task, dependencies);
+			jobSystem.waitAll(dependencies);
+			if (task.function)
+				task.function();
+
+			GMJobHandle finishedJob = GMJobSystem::createJob();
+			finishedJob->finished = true;
+			d->handles[i] = finishedJob;
+			--remaining;
+			break;
+		}
+	}
+
+	jobSystem.waitAll(d->handles);
+}
+
+void GMFrameGraph::clear()
+{
+	D(d);
+	d->tasks.clear();
+	d->handles.clear();
+}
+
+GMsize_t GMFrameGraph::getTaskCount()
+{
+	D(d);
+	return d->tasks.size();
+}
+
+bool GMFrameGraph::isReady(const GMFrameTask& task)
+{
+	D(d);
+	for (auto dependency : task.dependencies)
+	{
+		if (!d->handles[dependency])
+			return false;
+	}
+	return true;
+}
+
+void GMFrameGraph::collectDependencies(const GMFrameTask& task, REF Vector<GMJobHandle>& dependencies)
+{
+	D(d);
+	dependencies.clear();
+	for (auto dependency : task.dependencies)
+	{
+		dependencies.push_back(d->handles[dependency]);
+	}
+}
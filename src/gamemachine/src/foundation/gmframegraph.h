@@ -0,0 +1,64 @@
+﻿#ifndef __GMFRAMEGRAPH_H__
+#define __GMFRAMEGRAPH_H__
+#include <gmcommon.h>
+#include <gmjobsystem.h>
+BEGIN_NS
+
+//! 帧任务执行的线程。
+enum class GMFrameTaskThread
+{
+	Worker, //!< 在GMJobSystem的工作线程中执行。
+	MainThread, //!< 在调用GMFrameGraph::execute()的线程中执行，如需要访问渲染上下文的任务。
+};
+
+typedef GMsize_t GMFrameTaskId;
+
+struct GMFrameTask
+{
+	GMJobFunction function;
+	Vector<GMFrameTaskId> dependencies;
+	GMFrameTaskThread thread = GMFrameTaskThread::Worker;
+};
+
+GM_PRIVATE_OBJECT_UNALIGNED(GMFrameGraph)
+{
+	Vector<GMFrameTask> tasks;
+	Vector<GMJobHandle> handles;
+};
+
+//! 表示一帧之内需要执行的任务依赖图。
+/*!
+  每一帧重新添加任务，然后调用execute()执行。没有依赖关系的任务会在工作线程中并行执行，标记为MainThread的任务
+  会在调用线程中按照添加顺序执行。<BR>
+  任务只能依赖在它之前添加的任务，因此任务图中不会出现环。
+*/
+class GM_EXPORT GMFrameGraph
+{
+	GM_DECLARE_PRIVATE_NGO(GMFrameGraph)
+
+public:
+	//! 添加一个任务。
+	/*!
+	  \param function 任务执行的函数。
+	  \param dependencies 此任务依赖的任务，它们必须在此任务之前添加。
+	  \param thread 任务执行的线程。
+	  \return 任务的ID，可以作为后续任务的依赖。
+	*/
+	GMFrameTaskId addTask(GMJobFunction function, const Vector<GMFrameTaskId>& dependencies = Vector<GMFrameTaskId>(), GMFrameTaskThread thread = GMFrameTaskThread::Worker);
+
+	//! 执行所有任务，并等待它们结束。
+	void execute();
+
+	//! 清除所有任务。
+	void clear();
+
+	//! 获取任务的数量。
+	GMsize_t getTaskCount();
+
+private:
+	bool isReady(const GMFrameTask& task);
+	void collectDependencies(const GMFrameTask& task, REF Vector<GMJobHandle>& dependencies);
+};
+
+END_NS
+#endif
@@ -0,0 +1,329 @@
+﻿#include "stdafx.h"
+#include "gmjobsystem.h"
+#include <thread>
+
+namespace
+{
+	// 当前线程对应的工作线程索引，非工作线程为-1
+	thread_local GMint32 t_workerIndex = -1;
+
+	// 当前线程正在执行的任务的嵌套层数。在任务中等待其它任务时，被帮助执行的任务会嵌套在外层任务中
+	thread_local GMint32 t_jobDepth = 0;
+}
+
+void GMJobWorker::run()
+{
+	m_system->workerLoop(m_index);
+}
+
+GMJobSystem& GMJobSystem::instance()
+{
+	static GMJobSystem s_instance;
+	return s_instance;
+}
+
+GMJobSystem::GMJobSystem()
+{
+	D(d);
+	d->started = false;
+	d->stopping = false;
+	d->pendingJobs = 0;
+	d->nextQueue = 0;
+	d->busyCycles = 0;
+	d->jobsExecuted = 0;
+	d->statisticsStart = GMClock::highResolutionTimer();
+}
+
+GMJobSystem::~GMJobSystem()
+{
+	stop();
+}
+
+void GMJobSystem::start(GMint32 numberOfProcessors, bool pinWorkers)
+{
+	D(d);
+	std::lock_guard<std::mutex> lock(d->startMutex);
+	if (d->started)
+		return;
+
+	// 调用线程在等待时也会执行任务，因此少开一个工作线程
+	GMint32 workerCount = numberOfProcessors - 1;
+	if (workerCount < 1)
+		workerCount = 1;
+
+	d->stopping = false;
+	d->queues.clear();
+	d->workers.clear();
+	for (GMint32 i = 0; i < workerCount; ++i)
+	{
+		d->queues.push_back(gm_makeOwnedPtr<GMJobQueue>());
+	}
+
+	for (GMint32 i = 0; i < workerCount; ++i)
+	{
+		auto worker = gm_makeOwnedPtr<GMJobWorker>(this, i);
+		worker->setName(L"GM Worker " + GMString(i));
+		if (pinWorkers && i + 1 < 64)
+			worker->setAffinityMask(1ull << (i + 1));
+		d->workers.push_back(std::move(worker));
+	}
+
+	if (!d->profileName)
+		d->profileName = GMProfiler::instance().intern(L"GMJobSystem");
+
+	// 队列准备好之后才能让ensureStarted()看到启动的标记
+	d->started.store(true, std::memory_order_release);
+	for (auto& worker : d->workers)
+	{
+		worker->start();
+	}
+}
+
+void GMJobSystem::stop()
+{
+	D(d);
+	std::lock_guard<std::mutex> lock(d->startMutex);
+	if (!d->started)
+		return;
+
+	{
+		std::lock_guard<std::mutex> sleepLock(d->sleepMutex);
+		d->stopping = true;
+	}
+	d->wakeCondition.notify_all();
+
+	for (auto& worker : d->workers)
+	{
+		worker->join();
+	}
+	d->workers.clear();
+	d->started.store(false, std::memory_order_release);
+}
+
+GMint32 GMJobSystem::getWorkerCount()
+{
+	D(d);
+	return gm_sizet_to_int(d->workers.size());
+}
+
+GMWorkerStatistics GMJobSystem::getStatistics()
+{
+	D(d);
+	static GMint64 s_frequency = GMClock::highResolutionTimerFrequency();
+	GMWorkerStatistics statistics;
+	statistics.tasksExecuted = d->jobsExecuted;
+	statistics.busyInSecond = static_cast<GMfloat>(d->busyCycles) / s_frequency;
+	statistics.elapsedInSecond = static_cast<GMfloat>(GMClock::highResolutionTimer() - d->statisticsStart) / s_frequency;
+	if (statistics.elapsedInSecond > 0)
+		statistics.utilization = statistics.busyInSecond / (statistics.elapsedInSecond * (getWorkerCount() + 1));
+	return statistics;
+}
+
+void GMJobSystem::resetStatistics()
+{
+	D(d);
+	d->busyCycles = 0;
+	d->jobsExecuted = 0;
+	d->statisticsStart = GMClock::highResolutionTimer();
+}
+
+GMJobHandle GMJobSystem::createJob()
+{
+	return std::allocate_shared<GMJob>(GMPoolAllocator<GMJob>());
+}
+
+GMJobHandle GMJobSystem::schedule(GMJobFunction function)
+{
+	ensureStarted();
+	GMJobHandle job = createJob();
+	job->function = std::move(function);
+	enqueue(job);
+	return job;
+}
+
+GMJobHandle GMJobSystem::schedule(GMJobFunction function, const GMJobHandle& dependency)
+{
+	if (!dependency)
+		return schedule(std::move(function));
+
+	Vector<GMJobHandle> dependencies = { dependency };
+	return schedule(std::move(function), dependencies);
+}
+
+GMJobHandle GMJobSystem::schedule(GMJobFunction function, const Vector<GMJobHandle>& dependencies)
+{
+	ensureStarted();
+	GMJobHandle job = createJob();
+	job->function = std::move(function);
+
+	// 先占住一个计数，防止依赖在注册过程中完成，导致任务被提前执行
+	job->remainingDependencies = 1;
+	for (const auto& dependency : dependencies)
+	{
+		if (!dependency)
+			continue;
+
+		std::lock_guard<std::mutex> lock(dependency->continuationMutex);
+		if (!dependency->finished)
+		{
+			++job->remainingDependencies;
+			dependency->continuations.push_back(job);
+		}
+	}
+
+	if (--job->remainingDependencies == 0)
+		enqueue(job);
+	return job;
+}
+
+void GMJobSystem::wait(const GMJobHandle& job)
+{
+	if (!job)
+		return;
+
+	while (!job->finished)
+	{
+		if (!runOneJob())
+			std::this_thread::yield();
+	}
+}
+
+void GMJobSystem::waitAll(const Vector<GMJobHandle>& jobs)
+{
+	for (const auto& job : jobs)
+	{
+		wait(job);
+	}
+}
+
+void GMJobSystem::workerLoop(GMint32 index)
+{
+	D(d);
+	t_workerIndex = index;
+	while (true)
+	{
+		if (runOneJob())
+			continue;
+
+		std::unique_lock<std::mutex> lock(d->sleepMutex);
+		d->wakeCondition.wait(lock, [d]() {
+			return d->pendingJobs > 0 || d->stopping;
+		});
+
+		if (d->stopping && d->pendingJobs == 0)
+			break;
+	}
+	t_workerIndex = -1;
+}
+
+void GMJobSystem::ensureStarted()
+{
+	D(d);
+	// started是原子变量，已经启动时不需要加锁。未启动时由start()在startMutex中再次检查
+	if (!d->started.load(std::memory_order_acquire))
+		start(static_cast<GMint32>(std::thread::hardware_concurrency()));
+}
+
+void GMJobSystem::enqueue(GMJobHandle job)
+{
+	D(d);
+	GMsize_t queueCount = d->queues.size();
+	GM_ASSERT(queueCount > 0);
+
+	// 工作线程将任务放入自己的队列，其它线程轮流放入各个工作线程的队列
+	GMsize_t index = (t_workerIndex >= 0) ? static_cast<GMsize_t>(t_workerIndex) : (d->nextQueue++ % queueCount);
+	GMJobQueue* queue = d->queues[index].get();
+	{
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		queue->jobs.push_back(std::move(job));
+	}
+	++d->pendingJobs;
+
+	// 获取一次锁，确保正在进入等待的工作线程不会错过此次唤醒
+	{
+		std::lock_guard<std::mutex> lock(d->sleepMutex);
+	}
+	d->wakeCondition.notify_one();
+}
+
+bool GMJobSystem::runOneJob()
+{
+	GMJobHandle job;
+	if (!popJob(job))
+		return false;
+
+	execute(job);
+	return true;
+}
+
+bool GMJobSystem::popJob(OUT GMJobHandle& job)
+{
+	D(d);
+	if (d->pendingJobs <= 0)
+		return false;
+
+	GMsize_t queueCount = d->queues.size();
+	GMsize_t start = 0;
+
+	// 先从自己队列尾部取任务
+	if (t_workerIndex >= 0)
+	{
+		start = static_cast<GMsize_t>(t_workerIndex);
+		GMJobQueue* queue = d->queues[start].get();
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		if (!queue->jobs.empty())
+		{
+			job = std::move(queue->jobs.back());
+			queue->jobs.pop_back();
+			--d->pendingJobs;
+			return true;
+		}
+	}
+
+	// 从其它队列头部窃取任务
+	for (GMsize_t i = 0; i < queueCount; ++i)
+	{
+		GMJobQueue* queue = d->queues[(start + i) % queueCount].get();
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		if (!queue->jobs.empty())
+		{
+			job = std::move(queue->jobs.front());
+			queue->jobs.pop_front();
+			--d->pendingJobs;
+			return true;
+		}
+	}
+	return false;
+}
+
+void GMJobSystem::execute(const GMJobHandle& job)
+{
+	D(d);
+	if (job->function)
+	{
+		// 只统计每个线程最外层任务的时间，嵌套执行的任务的时间已经包含在外层任务中
+		bool outermost = t_jobDepth++ == 0;
+		GMint64 begin = outermost ? GMClock::highResolutionTimer() : 0;
+		{
+			GMProfile profile(d->profileName);
+			job->function();
+		}
+		--t_jobDepth;
+		if (outermost)
+			d->busyCycles.fetch_add(GMClock::highResolutionTimer() - begin, std::memory_order_relaxed);
+		d->jobsExecuted.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Vector<GMJobHandle> continuations;
+	{
+		std::lock_guard<std::mutex> lock(job->continuationMutex);
+		job->finished = true;
+		continuations.swap(job->continuations);
+	}
+
+	for (auto& continuation : continuations)
+	{
+		if (--continuation->remainingDependencies == 0)
+			enqueue(std::move(continuation));
+	}
+}
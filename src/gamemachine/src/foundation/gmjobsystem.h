@@ -0,0 +1,218 @@
+﻿#ifndef __GMJOBSYSTEM_H__
+#define __GMJOBSYSTEM_H__
+#include <gmcommon.h>
+#include <gmthread.h>
+#include <gmprofile.h>
+#include <condition_variable>
+BEGIN_NS
+
+typedef std::function<void()> GMJobFunction;
+
+//! 表示一个被调度的任务。
+/*!
+  任务由GMJobSystem创建，用户只需要持有其句柄GMJobHandle，用来等待任务结束或者作为其它任务的依赖。
+*/
+struct GMJob
+{
+	GMJobFunction function;
+	GMAtomic<GMint32> remainingDependencies;
+	GMAtomic<bool> finished;
+	std::mutex continuationMutex;
+	Vector<GMSharedPtr<GMJob>> continuations;
+
+	GMJob()
+		: remainingDependencies(0)
+		, finished(false)
+	{
+	}
+};
+
+typedef GMSharedPtr<GMJob> GMJobHandle;
+
+//! 工作线程的运行统计。
+struct GMWorkerStatistics
+{
+	GMint64 tasksExecuted = 0; //!< 执行过的任务数量。
+	GMfloat busyInSecond = 0; //!< 所有线程执行任务花费的时间总和。
+	GMfloat elapsedInSecond = 0; //!< 从开始统计到现在经过的时间。
+	GMfloat utilization = 0; //!< 利用率，即busyInSecond / (elapsedInSecond * 线程数)。
+};
+
+struct GMJobQueue
+{
+	std::mutex mutex;
+	Deque<GMJobHandle> jobs;
+};
+
+class GMJobSystem;
+class GMJobWorker : public GMThread
+{
+public:
+	GMJobWorker(GMJobSystem* system, GMint32 index)
+		: m_system(system)
+		, m_index(index)
+	{
+	}
+
+public:
+	virtual void run() override;
+
+private:
+	GMJobSystem* m_system;
+	GMint32 m_index;
+};
+
+GM_PRIVATE_OBJECT_UNALIGNED(GMJobSystem)
+{
+	GMAtomic<bool> started;
+	GMAtomic<bool> stopping;
+	GMAtomic<GMint32> pendingJobs;
+	GMAtomic<GMuint32> nextQueue;
+	std::mutex startMutex;
+	std::mutex sleepMutex;
+	std::condition_variable wakeCondition;
+	Vector<GMOwnedPtr<GMJobQueue>> queues;
+	Vector<GMOwnedPtr<GMJobWorker>> workers;
+	GMProfileNameId profileName = 0;
+	GMAtomic<GMint64> busyCycles;
+	GMAtomic<GMint64> jobsExecuted;
+	GMAtomic<GMint64> statisticsStart;
+};
+
+//! 常驻的任务调度系统。
+/*!
+  GMJobSystem拥有一组常驻的工作线程，每个工作线程拥有一个自己的任务队列。工作线程优先执行自己队列尾部的任务，
+  当自己的队列为空时，从其它线程队列的头部窃取任务。<BR>
+  线程数量由GMSystemInfo::numberOfProcessors决定，GameMachine初始化时会启动它。如果在此之前就有任务被调度，
+  将会按照硬件线程数启动。<BR>
+  等待任务的线程不会空闲，它会帮助执行队列中的任务，因此在任务中嵌套等待其它任务是安全的。<BR>
+  工作线程被命名为“GM Worker n”。每个任务的执行都会以“GMJobSystem”为名称记录到GMProfiler中。
+*/
+class GM_EXPORT GMJobSystem
+{
+	GM_DECLARE_PRIVATE_NGO(GMJobSystem)
+
+public:
+	static GMJobSystem& instance();
+
+protected:
+	GMJobSystem();
+	~GMJobSystem();
+
+public:
+	//! 启动工作线程。
+	/*!
+	  工作线程数为处理器数量减一（至少为1），因为调用线程在等待时也会执行任务。如果已经启动，则此方法不做任何事。
+	  \param numberOfProcessors 处理器的数量。
+	  \param pinWorkers 是否将第n个工作线程固定在第n+1个逻辑处理器上，第0个逻辑处理器留给主线程。
+	*/
+	void start(GMint32 numberOfProcessors, bool pinWorkers = false);
+
+	//! 停止所有工作线程。
+	/*!
+	  已经在队列中的任务会被执行完毕，然后工作线程退出。
+	*/
+	void stop();
+
+	//! 获取工作线程的数量。
+	GMint32 getWorkerCount();
+
+	//! 获取任务执行的统计。
+	/*!
+	  由于等待任务的线程也会执行任务，利用率按照工作线程数加一来计算。
+	*/
+	GMWorkerStatistics getStatistics();
+
+	//! 重置任务执行的统计。
+	void resetStatistics();
+
+	//! 创建一个任务对象。
+	/*!
+	  任务对象和它的引用计数一起从GMJob专用的内存池中分配。每帧的并行更新都会创建大量的任务，使用内存池可以避免反复向堆申请内存。
+	  \return 新的任务句柄。
+	*/
+	static GMJobHandle createJob();
+
+	//! 调度一个任务。
+	/*!
+	  \param function 任务执行的函数。
+	  \return 任务句柄。
+	*/
+	GMJobHandle schedule(GMJobFunction function);
+
+	//! 调度一个任务，此任务在依赖的任务完成后才会被执行。
+	/*!
+	  \param function 任务执行的函数。
+	  \param dependency 依赖的任务，可以为空。
+	  \return 任务句柄。
+	*/
+	GMJobHandle schedule(GMJobFunction function, const GMJobHandle& dependency);
+
+	//! 调度一个任务，此任务在所有依赖的任务完成后才会被执行。
+	/*!
+	  \param function 任务执行的函数。
+	  \param dependencies 依赖的任务列表。
+	  \return 任务句柄。
+	*/
+	GMJobHandle schedule(GMJobFunction function, const Vector<GMJobHandle>& dependencies);
+
+	//! 等待一个任务结束。
+	/*!
+	  在等待期间，调用线程会执行队列中的其它任务。
+	  \param job 需要等待的任务句柄。
+	*/
+	void wait(const GMJobHandle& job);
+
+	//! 等待一组任务结束。
+	void waitAll(const Vector<GMJobHandle>& jobs);
+
+	//! 将区间[begin, end)按照粒度切分，并行执行。
+	/*!
+	  第一个区间会在调用线程中执行，此方法在所有区间执行完毕后返回。
+	  \param begin 区间起始。
+	  \param end 区间结束。
+	  \param grainSize 每个任务处理的元素个数。
+	  \param function 执行函数，其签名为void(GMsize_t begin, GMsize_t end)。
+	*/
+	template <typename Function>
+	void parallelFor(GMsize_t begin, GMsize_t end, GMsize_t grainSize, Function&& function)
+	{
+		if (begin >= end)
+			return;
+
+		if (grainSize < 1)
+			grainSize = 1;
+
+		if (end - begin <= grainSize)
+		{
+			function(begin, end);
+			return;
+		}
+
+		Vector<GMJobHandle> jobs;
+		jobs.reserve((end - begin) / grainSize + 1);
+		for (GMsize_t i = begin + grainSize; i < end; i += grainSize)
+		{
+			GMsize_t chunkEnd = (end - i > grainSize) ? i + grainSize : end;
+			jobs.push_back(schedule([&function, i, chunkEnd]() {
+				function(i, chunkEnd);
+			}));
+		}
+
+		function(begin, begin + grainSize);
+		waitAll(jobs);
+	}
+
+public:
+	void workerLoop(GMint32 index);
+
+private:
+	void ensureStarted();
+	void enqueue(GMJobHandle job);
+	bool runOneJob();
+	bool popJob(OUT GMJobHandle& job);
+	void execute(const GMJobHandle& job);
+};
+
+END_NS
+#endif
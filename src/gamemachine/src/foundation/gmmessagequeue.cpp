@@ -0,0 +1,174 @@
+﻿#include "stdafx.h"
+#include "gmmessagequeue.h"
+
+namespace
+{
+	inline GMsize_t typeIndex(GameMachineMessageType type)
+	{
+		return static_cast<GMsize_t>(type);
+	}
+
+	inline bool isValidType(GameMachineMessageType type)
+	{
+		return typeIndex(type) < typeIndex(GameMachineMessageType::EndOfEnum);
+	}
+}
+
+GMMessageQueue::GMMessageQueue(GMsize_t capacity)
+{
+	D(d);
+	GMsize_t size = 2;
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+
+	Vector<GMMessageQueueSlot> slots(size);
+	for (GMsize_t i = 0; i < size; ++i)
+	{
+		slots[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	d->slots.swap(slots);
+	d->mask = size - 1;
+	d->enqueuePos = 0;
+	d->overflowed = false;
+	d->overflowCount = 0;
+	for (auto& count : d->postedCounts)
+	{
+		count = 0;
+	}
+	for (auto& count : d->handledCounts)
+	{
+		count = 0;
+	}
+}
+
+void GMMessageQueue::push(const GMMessage& msg)
+{
+	D(d);
+	if (isValidType(msg.msgType))
+		d->postedCounts[typeIndex(msg.msgType)].fetch_add(1, std::memory_order_relaxed);
+
+	// 溢出队列不为空时，直接进入溢出队列，保证投递顺序
+	if (!d->overflowed.load(std::memory_order_acquire) && tryPushRing(msg))
+		return;
+
+	std::lock_guard<std::mutex> lock(d->overflowMutex);
+	d->overflow.push_back(msg);
+	d->overflowed.store(true, std::memory_order_release);
+	d->overflowCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool GMMessageQueue::pop(OUT GMMessage& msg)
+{
+	D(d);
+	if (tryPopRing(msg))
+		return true;
+
+	if (!d->overflowed.load(std::memory_order_acquire))
+		return false;
+
+	// 环形缓冲区中还有正在写入的消息时不能读取溢出队列，它们可能比溢出队列中的消息更早投递。
+	// 生产者在加锁之前已经占住了槽位，因此需要在锁内判断。
+	std::lock_guard<std::mutex> lock(d->overflowMutex);
+	if (d->enqueuePos.load(std::memory_order_acquire) != d->dequeuePos)
+		return false;
+
+	if (d->overflow.empty())
+	{
+		d->overflowed.store(false, std::memory_order_release);
+		return false;
+	}
+
+	msg = d->overflow.front();
+	d->overflow.pop_front();
+	if (d->overflow.empty())
+		d->overflowed.store(false, std::memory_order_release);
+	return true;
+}
+
+GMsize_t GMMessageQueue::popBatch(OUT GMMessage* msgs, GMsize_t maxCount)
+{
+	GMsize_t count = 0;
+	while (count < maxCount && pop(msgs[count]))
+	{
+		++count;
+	}
+	return count;
+}
+
+void GMMessageQueue::markHandled(const GMMessage& msg)
+{
+	D(d);
+	if (isValidType(msg.msgType))
+		d->handledCounts[typeIndex(msg.msgType)].fetch_add(1, std::memory_order_relaxed);
+}
+
+GMint64 GMMessageQueue::getPostedCount(GameMachineMessageType type) const
+{
+	D(d);
+	return isValidType(type) ? d->postedCounts[typeIndex(type)].load(std::memory_order_relaxed) : 0;
+}
+
+GMint64 GMMessageQueue::getHandledCount(GameMachineMessageType type) const
+{
+	D(d);
+	return isValidType(type) ? d->handledCounts[typeIndex(type)].load(std::memory_order_relaxed) : 0;
+}
+
+GMint64 GMMessageQueue::getOverflowCount() const
+{
+	D(d);
+	return d->overflowCount.load(std::memory_order_relaxed);
+}
+
+GMsize_t GMMessageQueue::getCapacity() const
+{
+	D(d);
+	return d->slots.size();
+}
+
+bool GMMessageQueue::tryPushRing(const GMMessage& msg)
+{
+	D(d);
+	GMsize_t pos = d->enqueuePos.load(std::memory_order_relaxed);
+	GMMessageQueueSlot* slot = nullptr;
+	while (true)
+	{
+		slot = &d->slots[pos & d->mask];
+		GMsize_t sequence = slot->sequence.load(std::memory_order_acquire);
+		intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+		if (diff == 0)
+		{
+			// 槽位空闲，尝试占住它
+			if (d->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+		{
+			// 环形缓冲区已满
+			return false;
+		}
+		else
+		{
+			pos = d->enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->message = msg;
+	slot->sequence.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+bool GMMessageQueue::tryPopRing(OUT GMMessage& msg)
+{
+	D(d);
+	GMMessageQueueSlot& slot = d->slots[d->dequeuePos & d->mask];
+	if (slot.sequence.load(std::memory_order_acquire) != d->dequeuePos + 1)
+		return false;
+
+	msg = slot.message;
+	slot.sequence.store(d->dequeuePos + d->mask + 1, std::memory_order_release);
+	++d->dequeuePos;
+	return true;
+}
@@ -0,0 +1,86 @@
+﻿#ifndef __GMMESSAGEQUEUE_H__
+#define __GMMESSAGEQUEUE_H__
+#include <gmcommon.h>
+#include <gmmessage.h>
+#include <mutex>
+BEGIN_NS
+
+struct GMMessageQueueSlot
+{
+	GMAtomic<GMsize_t> sequence;
+	GMMessage message;
+};
+
+GM_PRIVATE_OBJECT_UNALIGNED(GMMessageQueue)
+{
+	Vector<GMMessageQueueSlot> slots;
+	GMsize_t mask = 0;
+	GMAtomic<GMsize_t> enqueuePos;
+	GMsize_t dequeuePos = 0;
+	GMAtomic<bool> overflowed;
+	std::mutex overflowMutex;
+	Deque<GMMessage> overflow;
+	Array<GMAtomic<GMint64>, (GMsize_t)GameMachineMessageType::EndOfEnum> postedCounts;
+	Array<GMAtomic<GMint64>, (GMsize_t)GameMachineMessageType::EndOfEnum> handledCounts;
+	GMAtomic<GMint64> overflowCount;
+};
+
+//! 多生产者单消费者的有界无锁消息队列。
+/*!
+  任何线程都可以调用push()投递消息，不需要加锁。只有一个线程（一般是主线程）调用pop()或popBatch()取出消息。<BR>
+  队列容量固定为2的幂。当环形缓冲区写满时，消息会进入一个加锁的溢出队列，并且在溢出队列清空之前，后续的消息都进入
+  溢出队列，以保证同一个线程投递的消息仍然按照顺序被取出。<BR>
+  队列会按照消息类型统计投递和处理的数量。
+*/
+class GM_EXPORT GMMessageQueue
+{
+	GM_DECLARE_PRIVATE_NGO(GMMessageQueue)
+
+public:
+	//! 构造一个消息队列。
+	/*!
+	  \param capacity 环形缓冲区的容量，会被向上取整为2的幂。
+	*/
+	GMMessageQueue(GMsize_t capacity = 1024);
+
+public:
+	//! 投递一条消息，可以在任意线程调用。
+	void push(const GMMessage& msg);
+
+	//! 取出一条消息，只能在消费线程调用。
+	/*!
+	  \param msg 取出的消息。
+	  \return 如果队列为空，返回false。
+	*/
+	bool pop(OUT GMMessage& msg);
+
+	//! 批量取出消息，只能在消费线程调用。
+	/*!
+	  \param msgs 用于存放消息的数组。
+	  \param maxCount 数组的长度。
+	  \return 实际取出的消息数量。
+	*/
+	GMsize_t popBatch(OUT GMMessage* msgs, GMsize_t maxCount);
+
+	//! 记录一条消息已经被处理。
+	void markHandled(const GMMessage& msg);
+
+	//! 获取某种类型的消息被投递的次数。
+	GMint64 getPostedCount(GameMachineMessageType type) const;
+
+	//! 获取某种类型的消息被处理的次数。
+	GMint64 getHandledCount(GameMachineMessageType type) const;
+
+	//! 获取因为环形缓冲区写满而进入溢出队列的消息数量。
+	GMint64 getOverflowCount() const;
+
+	//! 获取环形缓冲区的容量。
+	GMsize_t getCapacity() const;
+
+private:
+	bool tryPushRing(const GMMessage& msg);
+	bool tryPopRing(OUT GMMessage& msg);
+};
+
+END_NS
+#endif
@@ -2,6 +2,7 @@
 #include "gmobject.h"
 #include "interfaces.h"
 #include <utility>
+#include <gmthread.h>
 
 template <typename ContainerType>
 static size_t removeIf(ContainerType& container, std::function<bool(typename ContainerType::iterator)> pred)
@@ -21,6 +22,32 @@ static size_t removeIf(ContainerType& container, std::function<bool(typename Con
 	return cnt;
 }
 
+namespace
+{
+	struct SignalRegistry
+	{
+		GMReadWriteLock lock;
+		HashMap<GMString, GMSignal, GMStringHashFunctor> ids;
+		Vector<GMString> names;
+	};
+
+	SignalRegistry& signalRegistry()
+	{
+		static SignalRegistry s_registry;
+		return s_registry;
+	}
+
+	GMSignalSlot* findSlot(GMSlots& slots, GMSignal sig)
+	{
+		for (auto& slot : slots)
+		{
+			if (slot.signal == sig)
+				return &slot;
+		}
+		return nullptr;
+	}
+}
+
 GMObject::~GMObject()
 {
 	releaseConnections();
@@ -40,20 +67,50 @@ const GMMeta* GMObject::meta() const
 
 void GMObject::connect(GMObject& sender, GMSignal sig, const GMEventCallback& callback)
 {
-	sender.addConnection(std::move(sig), *this, callback);
+	sender.addConnection(sig, *this, callback);
 }
 
 void GMObject::disconnect(GMObject& sender, GMSignal sig)
 {
-	sender.removeSignalAndConnection(std::move(sig), *this);
+	sender.removeSignalAndConnection(sig, *this);
+}
+
+GMSignal GMObject::internSignal(const GMString& name)
+{
+	SignalRegistry& registry = signalRegistry();
+	{
+		GMSharedLockGuard<GMReadWriteLock> guard(registry.lock);
+		auto iter = registry.ids.find(name);
+		if (iter != registry.ids.end())
+			return iter->second;
+	}
+
+	GMLockGuard<GMReadWriteLock> guard(registry.lock);
+	auto result = registry.ids.insert({ name, static_cast<GMSignal>(registry.names.size()) });
+	if (result.second)
+		registry.names.push_back(name);
+	return result.first->second;
+}
+
+GMString GMObject::getSignalName(GMSignal sig)
+{
+	SignalRegistry& registry = signalRegistry();
+	GMSharedLockGuard<GMReadWriteLock> guard(registry.lock);
+	return sig < registry.names.size() ? registry.names[sig] : GMString();
 }
 
 void GMObject::addConnection(GMSignal sig, GMObject& receiver, GMEventCallback callback)
 {
 	D(d);
 	GMCallbackTarget target = { &receiver, callback };
-	d->objSlots[sig].push_back(target);
-	receiver.addConnection(this, std::move(sig));
+	GMSignalSlot* slot = findSlot(d->objSlots, sig);
+	if (!slot)
+	{
+		d->objSlots.push_back({ sig, Vector<GMCallbackTarget>() });
+		slot = &d->objSlots.back();
+	}
+	slot->targets.push_back(std::move(target));
+	receiver.addConnection(this, sig);
 }
 
 void GMObject::removeSignalAndConnection(GMSignal sig, GMObject& receiver)
@@ -63,18 +120,27 @@ void GMObject::removeSignalAndConnection(GMSignal sig, GMObject& receiver)
 	removeSignal(sig, receiver);
 
 	// 移除自己连接到的信号
-	receiver.removeConnection(this, std::move(sig));
+	receiver.removeConnection(this, sig);
 }
 
-void GMObject::emitSignal(GMSignal sig)
+void GMObject::emitSignalToReceivers(GMSignal sig)
 {
 	D(d);
-	if (d->objSlots.empty())
-		return;
+	GMsize_t slotIndex = 0;
+	for (; slotIndex < d->objSlots.size(); ++slotIndex)
+	{
+		if (d->objSlots[slotIndex].signal == sig)
+			break;
+	}
 
-	auto& targets = d->objSlots[std::move(sig)];
-	for (auto& target : targets)
+	// 回调中可能连接新的信号而导致数组重新分配，因此每次都通过下标重新获取接收者
+	for (GMsize_t i = 0; slotIndex < d->objSlots.size(); ++i)
 	{
+		GMSignalSlot& slot = d->objSlots[slotIndex];
+		if (slot.signal != sig || i >= slot.targets.size())
+			break;
+
+		GMCallbackTarget& target = slot.targets[i];
 		target.callback(this, target.receiver);
 	}
 }
@@ -82,10 +148,17 @@ void GMObject::emitSignal(GMSignal sig)
 void GMObject::removeSignal(GMSignal sig, GMObject& receiver)
 {
 	D(d);
-	auto& targets = d->objSlots[std::move(sig)];
-	removeIf(targets, [&](auto iter) {
+	GMSignalSlot* slot = findSlot(d->objSlots, sig);
+	if (!slot)
+		return;
+
+	removeIf(slot->targets, [&](auto iter) {
 		return iter->receiver == &receiver;
 	});
+
+	// 移除空的信号，使没有接收者的对象重新走到emitSignal的快速路径
+	if (slot->targets.empty())
+		d->objSlots.erase(d->objSlots.begin() + (slot - d->objSlots.data()));
 }
 
 void GMObject::releaseConnections()
@@ -96,8 +169,8 @@ void GMObject::releaseConnections()
 	{
 		for (auto& event : d->objSlots)
 		{
-			GMSignal name = event.first;
-			for (auto& target : event.second)
+			GMSignal name = event.signal;
+			for (auto& target : event.targets)
 			{
 				target.receiver->removeConnection(this, name);
 			}
@@ -120,7 +193,7 @@ void GMObject::addConnection(GMObject* host, GMSignal sig)
 	D(d);
 	GMConnectionTarget c;
 	c.host = host;
-	c.name = std::move(sig);
+	c.name = sig;
 	d->connectionTargets.push_back(std::move(c));
 }
 
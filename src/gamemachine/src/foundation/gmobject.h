@@ -260,7 +260,8 @@ struct GMCallbackTarget
 	GMEventCallback callback;
 };
 
-typedef GMString GMSignal;
+// 信号的ID，由信号名驻留得到，相同名称的信号ID相同
+typedef GMuint32 GMSignal;
 
 // 连接目标，表示一个GMObject连接了多少个信号
 struct GMConnectionTarget
@@ -270,10 +271,18 @@ struct GMConnectionTarget
 };
 using GMConnectionTargets = Vector<GMConnectionTarget>;
 
-using GMSlots = HashMap<GMSignal, Vector<GMCallbackTarget>, GMStringHashFunctor>;
+// 一个信号的所有接收者
+struct GMSignalSlot
+{
+	GMSignal signal;
+	Vector<GMCallbackTarget> targets;
+};
+
+// 一个对象连接的信号很少，因此用线性查找的数组代替哈希表
+using GMSlots = Vector<GMSignalSlot>;
 
 #define GM_SIGNAL(host, sig) host::sig_##sig()
-#define GM_DECLARE_SIGNAL(sig) public: inline static const gm::GMString& sig_##sig() { static gm::GMString s_sig(#sig); return s_sig; }
+#define GM_DECLARE_SIGNAL(sig) public: inline static gm::GMSignal sig_##sig() { static const gm::GMSignal s_sig = gm::GMObject::internSignal(#sig); return s_sig; }
 
 #define GM_META(memberName) \
 { \
@@ -361,7 +370,14 @@ public:
 	  当一个信号被触发后，将会通知所有绑定了此对象此信号的所有对象，调用它们绑定的回调函数。
 	  \param sig 需要触发的信号名。
 	*/
-	void emitSignal(GMSignal sig);
+	inline void emitSignal(GMSignal sig)
+	{
+		D(d);
+		// 没有任何接收者时直接返回，这是最常见的情况
+		if (d->objSlots.empty())
+			return;
+		emitSignalToReceivers(sig);
+	}
 
 	//! 拷贝GMObject私有数据
 	/*!
@@ -381,7 +397,21 @@ public:
 		m_data.swap(another.m_data);
 	}
 
+public:
+	//! 驻留一个信号名，返回它的ID。
+	/*!
+	  同一个信号名总是返回同一个ID。GM_DECLARE_SIGNAL声明的信号会在第一次使用时驻留，并缓存其ID。
+	  脚本等只知道信号名的地方，可以通过此方法得到信号ID。此方法是线程安全的。
+	  \param name 信号名。
+	  \return 信号ID。
+	*/
+	static GMSignal internSignal(const GMString& name);
+
+	//! 获取信号ID对应的信号名。
+	static GMString getSignalName(GMSignal sig);
+
 private:
+	void emitSignalToReceivers(GMSignal sig);
 	void addConnection(GMSignal sig, GMObject& receiver, GMEventCallback callback);
 	void removeSignalAndConnection(GMSignal sig, GMObject& receiver);
 	void removeSignal(GMSignal sig, GMObject& receiver);
@@ -1,100 +1,501 @@
 ﻿#include "stdafx.h"
 #include "gmprofile.h"
-#include "foundation/gamemachine.h"
+#include <gmtools.h>
+#include <algorithm>
 
-//Profile
-static IProfileHandler* g_handler = nullptr;
-static GMProfileSessions g_sessions;
+namespace
+{
+	// 线程退出时，通知刷新线程回收此线程的缓冲区
+	struct GMProfileThreadBufferHolder
+	{
+		GMSharedPtr<GMProfileThreadBuffer> buffer;
 
-void GMProfile::setHandler(IProfileHandler* handler)
+		~GMProfileThreadBufferHolder()
+		{
+			if (buffer)
+				buffer->retired.store(true, std::memory_order_release);
+		}
+	};
+
+	thread_local GMProfileThreadBufferHolder t_bufferHolder;
+	thread_local GMProfileThreadBuffer* t_buffer = nullptr;
+
+	void appendJsonString(REF std::string& out, const std::string& str)
+	{
+		out += '"';
+		for (char c : str)
+		{
+			switch (c)
+			{
+			case '"':
+				out += "\\\"";
+				break;
+			case '\\':
+				out += "\\\\";
+				break;
+			case '\n':
+				out += "\\n";
+				break;
+			case '\t':
+				out += "\\t";
+				break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					char buf[8];
+					snprintf(buf, sizeof(buf), "\\u%04x", c);
+					out += buf;
+				}
+				else
+				{
+					out += c;
+				}
+			}
+		}
+		out += '"';
+	}
+}
+
+void GMProfileFlushThread::run()
 {
-	g_handler = handler;
+	while (!m_stopping)
+	{
+		m_profiler->flush();
+		GMThread::sleep(10);
+	}
 }
 
-void GMProfile::clearHandler()
+GMProfiler& GMProfiler::instance()
 {
-	setHandler(nullptr);
+	static GMProfiler s_instance;
+	return s_instance;
 }
 
-void GMProfile::resetTimeline()
+GMProfiler::GMProfiler()
+{
+	D(d);
+	d->enabled = false;
+	d->frame = 0;
+	d->frequency = 0;
+	d->calibrationCycle = now();
+	d->calibrationTimer = GMClock::highResolutionTimer();
+	d->timelineStart = d->calibrationCycle;
+#if GM_PROFILE_USE_TSC
+	// 先粗略地校准一次，刷新时会用更长的时间间隔重新校准
+	GMint64 timerFrequency = GMClock::highResolutionTimerFrequency();
+	while (GMClock::highResolutionTimer() - d->calibrationTimer < timerFrequency / 1000);
+	calibrate();
+#else
+	d->frequency.store(static_cast<double>(GMClock::highResolutionTimerFrequency()), std::memory_order_relaxed);
+#endif
+
+	// 0表示无效的名称
+	d->names.push_back(GMString());
+}
+
+GMProfiler::~GMProfiler()
 {
-	for (auto& session : g_sessions.sessions)
+	stop();
+}
+
+GMProfileNameId GMProfiler::intern(const GMString& name)
+{
+	D(d);
+	std::lock_guard<std::mutex> lock(d->nameMutex);
+	auto iter = d->nameIds.find(name);
+	if (iter != d->nameIds.end())
+		return iter->second;
+
+	GMProfileNameId id = static_cast<GMProfileNameId>(d->names.size());
+	d->names.push_back(name);
+	d->nameIds[name] = id;
+	return id;
+}
+
+GMString GMProfiler::getName(GMProfileNameId id)
+{
+	D(d);
+	std::lock_guard<std::mutex> lock(d->nameMutex);
+	return id < d->names.size() ? d->names[id] : GMString();
+}
+
+void GMProfiler::setEnabled(bool enabled)
+{
+	D(d);
+	if (enabled)
+		startFlushThread();
+	d->enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void GMProfiler::endFrame()
+{
+	D(d);
+	d->frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+void GMProfiler::flush()
+{
+	D(d);
+	std::lock_guard<std::mutex> flushLock(d->flushMutex);
+	Vector<GMSharedPtr<GMProfileThreadBuffer>> buffers;
 	{
-		session.second.firstProfileTimeInCycle = -1;
+		std::lock_guard<std::mutex> lock(d->bufferMutex);
+		buffers = d->buffers;
+	}
+
+	calibrate();
+	bool hasRetired = false;
+	for (auto& buffer : buffers)
+	{
+		// 先判断是否退出，再读取head，这样不会漏掉退出前写入的事件
+		bool retired = buffer->retired.load(std::memory_order_acquire);
+		GMsize_t tail = buffer->tail.load(std::memory_order_relaxed);
+		GMsize_t head = buffer->head.load(std::memory_order_acquire);
+		for (; tail != head; ++tail)
+		{
+			const GMProfileEvent& e = buffer->events[tail & (ThreadBufferSize - 1)];
+			collect(e);
+			dispatch(buffer.get(), e);
+		}
+		buffer->tail.store(tail, std::memory_order_release);
+		hasRetired = hasRetired || retired;
+	}
+
+	if (hasRetired)
+	{
+		{
+			std::lock_guard<std::mutex> lock(d->bufferMutex);
+			d->buffers.erase(std::remove_if(d->buffers.begin(), d->buffers.end(), [](const GMSharedPtr<GMProfileThreadBuffer>& buffer) {
+				return buffer->retired.load(std::memory_order_acquire) && buffer->tail.load(std::memory_order_relaxed) == buffer->head.load(std::memory_order_acquire);
+			}), d->buffers.end());
+		}
+
+		// 线程已经退出，剩余的内层事件不会再有外层作用域。处理器可能会使用GM_PROFILE，因此不能在bufferMutex中回调
+		for (auto& buffer : buffers)
+		{
+			if (buffer->retired.load(std::memory_order_acquire) && buffer->tail.load(std::memory_order_relaxed) == buffer->head.load(std::memory_order_acquire))
+				dispatchTree(buffer->pendingTree, buffer->threadId);
+		}
+	}
+
+	// 一帧刚结束时，其它线程可能还有这一帧的事件没有写入，因此只汇总更早的帧
+	GMuint32 currentFrame = d->frame.load(std::memory_order_relaxed);
+	while (!d->pendingSummaries.empty())
+	{
+		auto iter = d->pendingSummaries.begin();
+		if (iter->first + 1 >= currentFrame)
+			break;
+
+		d->lastFrameSummary.clear();
+		for (auto& item : iter->second)
+		{
+			item.second.name = getName(item.first);
+			d->lastFrameSummary.push_back(std::move(item.second));
+		}
+		d->summarizedFrame = iter->first + 1;
+		d->pendingSummaries.erase(iter);
 	}
 }
 
-GMProfileSessions::GMProfileSession& GMProfile::profileSession()
+void GMProfiler::stop()
 {
-	return g_sessions.sessions[GMThread::getCurrentThreadId()];
+	D(d);
+	{
+		std::lock_guard<std::mutex> lock(d->threadMutex);
+		if (d->flushThread)
+		{
+			d->flushThread->requestStop();
+			d->flushThread->join();
+			d->flushThread.reset();
+		}
+	}
+	flush();
 }
 
-GMProfile::GMProfile()
+Vector<GMProfileSummaryItem> GMProfiler::getFrameSummary()
 {
 	D(d);
-	d->debugConfig = GM.getConfigs().getConfig(GMConfigs::Debug).asDebugConfig();
+	std::lock_guard<std::mutex> lock(d->flushMutex);
+	return d->lastFrameSummary;
 }
 
-GMProfile::GMProfile(const GMString& name)
-	: GMProfile()
+std::string GMProfiler::exportChromeTrace()
 {
 	D(d);
-	startRecord(name);
+	Vector<GMProfileEvent> events;
+	double frequency;
+	{
+		std::lock_guard<std::mutex> lock(d->flushMutex);
+		events = d->collectedEvents;
+		frequency = d->frequency.load(std::memory_order_relaxed);
+	}
+
+	Vector<std::string> names;
+	{
+		std::lock_guard<std::mutex> lock(d->nameMutex);
+		names.reserve(d->names.size());
+		for (const auto& name : d->names)
+		{
+			names.push_back(name.toStdString());
+		}
+	}
+
+	GMint64 start = d->timelineStart.load(std::memory_order_relaxed);
+	double microsecondsPerCycle = 1000000.0 / frequency;
+	std::string json = "{\"traceEvents\":[";
+	char buf[128];
+	bool first = true;
+	for (const auto& e : events)
+	{
+		if (!first)
+			json += ',';
+		first = false;
+
+		json += "{\"name\":";
+		appendJsonString(json, e.name < names.size() ? names[e.name] : std::string());
+		snprintf(buf, sizeof(buf), ",\"cat\":\"gm\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+			e.threadIndex,
+			(e.beginCycle - start) * microsecondsPerCycle,
+			(e.endCycle - e.beginCycle) * microsecondsPerCycle);
+		json += buf;
+	}
+	json += "],\"displayTimeUnit\":\"ms\"}";
+	return json;
 }
 
-GMProfile::GMProfile(const GMwchar* name)
-	: GMProfile()
+void GMProfiler::resetTimeline()
+{
+	D(d);
+	std::lock_guard<std::mutex> lock(d->flushMutex);
+	d->collectedEvents.clear();
+	d->timelineStart = now();
+}
+
+void GMProfiler::setHandler(IProfileHandler* handler)
+{
+	D(d);
+	// 刷新时持有flushMutex，因此获得锁之后，旧的处理器已经不会再被调用
+	std::lock_guard<std::mutex> lock(d->flushMutex);
+	d->handler = handler;
+}
+
+GMint64 GMProfiler::getDroppedCount()
+{
+	D(d);
+	std::lock_guard<std::mutex> lock(d->bufferMutex);
+	GMint64 dropped = 0;
+	for (const auto& buffer : d->buffers)
+	{
+		dropped += buffer->dropped.load(std::memory_order_relaxed);
+	}
+	return dropped;
+}
+
+GMProfileThreadBuffer* GMProfiler::threadBuffer()
+{
+	D(d);
+	if (t_buffer)
+		return t_buffer;
+
+	GMSharedPtr<GMProfileThreadBuffer> buffer = gm_makeSharedPtr<GMProfileThreadBuffer>();
+	buffer->threadId = GMThread::getCurrentThreadId();
+	buffer->events.resize(ThreadBufferSize);
+	buffer->head = 0;
+	buffer->tail = 0;
+	buffer->dropped = 0;
+	buffer->retired = false;
+	{
+		std::lock_guard<std::mutex> lock(d->bufferMutex);
+		static GMint32 s_threadIndex = 0;
+		buffer->threadIndex = s_threadIndex++;
+		d->buffers.push_back(buffer);
+	}
+
+	t_bufferHolder.buffer = buffer;
+	t_buffer = buffer.get();
+	return t_buffer;
+}
+
+void GMProfiler::record(GMProfileThreadBuffer* buffer, GMProfileNameId name, GMint64 beginCycle, GMint64 endCycle, GMint32 level)
 {
 	D(d);
-	// 这里先判断，阻止赋值GMString
-	if (!d->debugConfig.get(GMDebugConfigs::RunProfile_Bool).toBool())
+	GMsize_t head = buffer->head.load(std::memory_order_relaxed);
+	if (head - buffer->tail.load(std::memory_order_acquire) >= ThreadBufferSize)
+	{
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
 		return;
+	}
 
-	startRecord(name);
+	GMProfileEvent& e = buffer->events[head & (ThreadBufferSize - 1)];
+	e.beginCycle = beginCycle;
+	e.endCycle = endCycle;
+	e.name = name;
+	e.frame = d->frame.load(std::memory_order_relaxed);
+	e.level = level;
+	e.threadIndex = buffer->threadIndex;
+	buffer->head.store(head + 1, std::memory_order_release);
 }
 
-GMProfile::~GMProfile()
+void GMProfiler::collect(const GMProfileEvent& e)
 {
-	stopRecord();
+	D(d);
+	if (d->collectedEvents.size() < d->maxCollectedEvents)
+		d->collectedEvents.push_back(e);
+
+	// 已经汇总过的帧不再统计
+	if (e.frame >= d->summarizedFrame)
+	{
+		GMProfileSummaryItem& item = d->pendingSummaries[e.frame][e.name];
+		GMfloat elapsed = toSecond(e.endCycle - e.beginCycle);
+		++item.count;
+		item.totalInSecond += elapsed;
+		if (item.maxInSecond < elapsed)
+			item.maxInSecond = elapsed;
+	}
 }
 
-void GMProfile::startRecord(const GMString& name)
+void GMProfiler::dispatch(GMProfileThreadBuffer* buffer, const GMProfileEvent& e)
 {
 	D(d);
-	static GMint64 frequency = GMClock::highResolutionTimerFrequency();
-	if (!g_handler)
+	if (!d->handler)
+	{
+		buffer->pendingTree.clear();
 		return;
+	}
 
-	if (!d->debugConfig.get(GMDebugConfigs::RunProfile_Bool).toBool())
+	// 缓冲区中的事件按照结束的顺序排列，内层作用域先于外层。暂存内层事件，直到最外层作用域结束
+	buffer->pendingTree.push_back(e);
+	if (e.level == 0 || buffer->pendingTree.size() >= ThreadBufferSize)
+		dispatchTree(buffer->pendingTree, buffer->threadId);
+}
+
+void GMProfiler::dispatchTree(REF Vector<GMProfileEvent>& events, GMThreadId threadId)
+{
+	D(d);
+	IProfileHandler* handler = d->handler;
+	if (!handler || events.empty())
+	{
+		events.clear();
 		return;
+	}
 
-	GMProfileSessions::GMProfileSession& ps = profileSession();
+	// 按照开始时间排序，开始时间相同时外层在前，再用栈还原嵌套关系
+	std::stable_sort(events.begin(), events.end(), [](const GMProfileEvent& a, const GMProfileEvent& b) {
+		return a.beginCycle < b.beginCycle || (a.beginCycle == b.beginCycle && a.level < b.level);
+	});
 
-	d->valid = true;
-	d->name = name;
-	GMint64 now = GMClock::highResolutionTimer();
-	if (ps.firstProfileTimeInCycle < 0)
-		ps.firstProfileTimeInCycle = now;
-	GM_ASSERT(now - ps.firstProfileTimeInCycle >= 0);
-	d->durationSinceLastProfile = (now - ps.firstProfileTimeInCycle) / (GMfloat) frequency;
-	g_handler->beginProfile(name, d->durationSinceLastProfile, GMThread::getCurrentThreadId(), ps.level);
+	GMint64 start = d->timelineStart.load(std::memory_order_relaxed);
+	Vector<const GMProfileEvent*> stack;
+	auto endProfile = [&]() {
+		const GMProfileEvent* top = stack.back();
+		handler->endProfile(getName(top->name), toSecond(top->endCycle - top->beginCycle), threadId, top->level);
+		stack.pop_back();
+	};
+
+	for (const auto& e : events)
+	{
+		while (!stack.empty() && (stack.back()->endCycle <= e.beginCycle || stack.back()->level >= e.level))
+		{
+			endProfile();
+		}
+		handler->beginProfile(getName(e.name), toSecond(e.beginCycle - start), threadId, e.level);
+		stack.push_back(&e);
+	}
 
-	ps.level++;
-	d->stopwatch.start();
+	while (!stack.empty())
+	{
+		endProfile();
+	}
+	events.clear();
 }
 
-void GMProfile::stopRecord()
+void GMProfiler::startFlushThread()
 {
 	D(d);
-	d->stopwatch.stop();
-	if (!d->valid)
+	std::lock_guard<std::mutex> lock(d->threadMutex);
+	if (d->flushThread)
 		return;
 
-	if (!g_handler)
+	d->flushThread = gm_makeOwnedPtr<GMProfileFlushThread>(this);
+	d->flushThread->start();
+}
+
+void GMProfiler::calibrate()
+{
+#if GM_PROFILE_USE_TSC
+	D(d);
+	GMint64 elapsedTimer = GMClock::highResolutionTimer() - d->calibrationTimer;
+	GMint64 elapsedCycles = now() - d->calibrationCycle;
+	if (elapsedTimer > 0)
+		d->frequency.store(static_cast<double>(elapsedCycles) * GMClock::highResolutionTimerFrequency() / elapsedTimer, std::memory_order_relaxed);
+#endif
+}
+
+GMfloat GMProfiler::toSecond(GMint64 cycles) const
+{
+	D(d);
+	return static_cast<GMfloat>(static_cast<double>(cycles) / d->frequency.load(std::memory_order_relaxed));
+}
+
+GMProfile::GMProfile(GMProfileNameId name)
+{
+	startRecord(name);
+}
+
+GMProfile::GMProfile(const GMString& name)
+{
+	// 未开启统计时不驻留名称
+	if (GMProfiler::instance().isEnabled())
+		startRecord(GMProfiler::instance().intern(name));
+}
+
+GMProfile::GMProfile(const GMwchar* name)
+{
+	if (GMProfiler::instance().isEnabled())
+		startRecord(GMProfiler::instance().intern(name));
+}
+
+GMProfile::~GMProfile()
+{
+	stopRecord();
+}
+
+void GMProfile::setHandler(IProfileHandler* handler)
+{
+	GMProfiler::instance().setHandler(handler);
+}
+
+void GMProfile::clearHandler()
+{
+	setHandler(nullptr);
+}
+
+void GMProfile::resetTimeline()
+{
+	GMProfiler::instance().resetTimeline();
+}
+
+void GMProfile::startRecord(GMProfileNameId name)
+{
+	D(d);
+	GMProfiler& profiler = GMProfiler::instance();
+	if (!profiler.isEnabled())
+		return;
+
+	d->buffer = profiler.threadBuffer();
+	d->name = name;
+	++d->buffer->level;
+	d->beginCycle = profiler.now();
+}
+
+void GMProfile::stopRecord()
+{
+	D(d);
+	if (!d->buffer)
 		return;
 
-	GMProfileSessions::GMProfileSession& ps = profileSession();
-	GMThreadId id = GMThread::getCurrentThreadId();
-	GMint32& level = ps.level;
-	g_handler->endProfile(d->name, d->stopwatch.timeInSecond(), id, --level);
+	GMProfiler& profiler = GMProfiler::instance();
+	GMint64 endCycle = profiler.now();
+	GMint32 level = --d->buffer->level;
+	profiler.record(d->buffer, d->name, d->beginCycle, endCycle, level);
 }
@@ -2,50 +2,248 @@
 #define __GMPROFILE_H__
 #include <gmcommon.h>
 #include <gmthread.h>
-#include <stack>
+
+// x86下使用时间戳计数器计时，它比系统的高精度计时器开销更小
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#	define GM_PROFILE_USE_TSC 1
+#	if GM_WINDOWS
+#		include <intrin.h>
+#	else
+#		include <x86intrin.h>
+#	endif
+#else
+#	define GM_PROFILE_USE_TSC 0
+#endif
+
 BEGIN_NS
 
-#define GM_PROFILE(name) gm::GMProfile __profile(L ## name)
+#define GM_PROFILE_CAT2(a, b) a ## b
+#define GM_PROFILE_CAT(a, b) GM_PROFILE_CAT2(a, b)
+
+//! 统计当前作用域的耗时。
+/*!
+  名称在每个调用点只会被驻留一次，此后记录一次作用域只需要两次计时和一次写入线程本地缓冲区。
+*/
+#define GM_PROFILE(name) \
+	static const gm::GMProfileNameId GM_PROFILE_CAT(__profileName, __LINE__) = gm::GMProfiler::instance().intern(L ## name); \
+	gm::GMProfile __profile(GM_PROFILE_CAT(__profileName, __LINE__))
 #define GM_PROFILE_HANDLER(ptr) gm::GMProfile::setHandler(ptr)
 #define GM_PROFILE_CLEAR_HANDLER() gm::GMProfile::clearHandler()
 #define GM_PROFILE_RESET_TIMELINE() gm::GMProfile::resetTimeline()
 
+typedef GMuint32 GMProfileNameId;
+
+//! 接收性能统计结果的处理器。
+/*!
+  处理器在后台的刷新线程（或者手动调用GMProfiler::flush()的线程）中被调用，而不是在被统计的线程中调用，
+  因此回调的时刻晚于作用域实际开始和结束的时刻，时间以参数中的值为准。<BR>
+  同一个线程的作用域按照实际的嵌套关系回调：外层作用域的beginProfile()在内层之前，endProfile()在内层之后。
+  为此，内层作用域会被暂存，直到最外层的作用域结束后才整体回调。如果暂存的事件过多（例如最外层作用域一直没有结束），
+  则会提前按照开始时间的顺序回调，此时外层作用域的回调可能缺失。不同线程的回调之间没有顺序保证。<BR>
+  GMProfiler::setHandler()返回之后，旧的处理器不会再被调用，可以安全地释放。不能在处理器的回调中调用setHandler()。
+*/
 GM_INTERFACE(IProfileHandler)
 {
 	virtual void beginProfile(const GMString& name, GMfloat durationSinceStartInSecond, GMThreadId id, GMint32 level) = 0;
 	virtual void endProfile(const GMString& name, GMfloat elapsedInSecond, GMThreadId id, GMint32 level) = 0;
 };
 
-GM_PRIVATE_OBJECT_UNALIGNED(GMProfile)
+//! 一次作用域的统计记录。
+struct GMProfileEvent
+{
+	GMint64 beginCycle; //!< 作用域开始的时间。
+	GMint64 endCycle; //!< 作用域结束的时间。
+	GMProfileNameId name; //!< 驻留的名称。
+	GMuint32 frame; //!< 作用域结束时所在的帧。
+	GMint32 level; //!< 作用域的嵌套层次。
+	GMint32 threadIndex; //!< 记录此事件的线程序号。
+};
+
+//! 某个名称在一帧之中的汇总统计。
+struct GMProfileSummaryItem
 {
-	GMDebugConfig debugConfig;
-	GMStopwatch stopwatch;
-	GMfloat durationSinceLastProfile = 0; // 距离上一次Profile的时间
-	bool valid = false;
 	GMString name;
+	GMint32 count = 0; //!< 调用次数。
+	GMfloat totalInSecond = 0; //!< 总耗时。
+	GMfloat maxInSecond = 0; //!< 单次最大耗时。
 };
 
-struct GMProfileSessions : public GMObject
+//! 每个线程独有的事件环形缓冲区，只有所属线程写入，只有刷新线程读取。
+struct GMProfileThreadBuffer
 {
-	struct GMProfileSession
+	GMThreadId threadId;
+	GMint32 threadIndex = 0;
+	GMint32 level = 0;
+	Vector<GMProfileEvent> events;
+	GMAtomic<GMsize_t> head;
+	GMAtomic<GMsize_t> tail;
+	GMAtomic<GMint64> dropped;
+	GMAtomic<bool> retired; //!< 所属线程已经退出。
+	Vector<GMProfileEvent> pendingTree; //!< 等待最外层作用域结束的内层事件，只由刷新线程访问。
+};
+
+class GMProfiler;
+class GMProfileFlushThread : public GMThread
+{
+public:
+	GMProfileFlushThread(GMProfiler* profiler)
+		: m_profiler(profiler)
+		, m_stopping(false)
 	{
-		GMProfileSession() : level(0) {};
-		GMint32 level;
-		GMint64 firstProfileTimeInCycle = -1;
-	};
+	}
+
+public:
+	virtual void run() override;
+
+	void requestStop() { m_stopping = true; }
 
-	Map<GMThreadId, GMProfileSession> sessions;
+private:
+	GMProfiler* m_profiler;
+	GMAtomic<bool> m_stopping;
 };
 
-class GMProfile
+GM_PRIVATE_OBJECT_UNALIGNED(GMProfiler)
 {
-	GM_DECLARE_PRIVATE_NGO(GMProfile)
+	GMAtomic<bool> enabled;
+	GMAtomic<GMuint32> frame;
+	GMAtomic<double> frequency; //!< 每秒的计时周期数，在刷新时根据高精度计时器校准。
+	GMint64 calibrationCycle = 0;
+	GMint64 calibrationTimer = 0;
+	GMAtomic<GMint64> timelineStart;
+
+	std::mutex nameMutex;
+	Map<GMString, GMProfileNameId> nameIds;
+	Vector<GMString> names;
+
+	std::mutex bufferMutex;
+	Vector<GMSharedPtr<GMProfileThreadBuffer>> buffers;
+
+	std::mutex flushMutex;
+	IProfileHandler* handler = nullptr; //!< 由flushMutex保护。
+	Vector<GMProfileEvent> collectedEvents;
+	GMsize_t maxCollectedEvents = 1 << 20;
+	Map<GMuint32, Map<GMProfileNameId, GMProfileSummaryItem>> pendingSummaries;
+	GMuint32 summarizedFrame = 0;
+	Vector<GMProfileSummaryItem> lastFrameSummary;
+
+	std::mutex threadMutex;
+	GMOwnedPtr<GMProfileFlushThread> flushThread;
+};
+
+//! 性能统计器。
+/*!
+  每个线程拥有一个固定大小的环形缓冲区，作用域结束时将事件写入缓冲区，不需要加锁，也不会分配内存。后台的刷新线程
+  定期将缓冲区中的事件取出，交给IProfileHandler，并且汇总成每一帧的统计以及Chrome Trace格式的记录。<BR>
+  当缓冲区写满时，新的事件将会被丢弃。<BR>
+  GameMachine在每一帧结束时根据GMDebugConfigs::RunProfile_Bool打开或关闭统计，并调用endFrame()。
+*/
+class GM_EXPORT GMProfiler
+{
+	GM_DECLARE_PRIVATE_NGO(GMProfiler)
+
+	enum
+	{
+		ThreadBufferSize = 1 << 13,
+	};
 
 public:
-	static GMProfileSessions::GMProfileSession& profileSession();
+	static GMProfiler& instance();
+
+protected:
+	GMProfiler();
+	~GMProfiler();
 
 public:
-	GMProfile();
+	//! 驻留一个名称，相同的名称返回相同的标识。此方法是线程安全的。
+	GMProfileNameId intern(const GMString& name);
+
+	//! 根据标识获取驻留的名称。
+	GMString getName(GMProfileNameId id);
+
+	//! 打开或关闭统计。打开时会启动后台刷新线程。
+	void setEnabled(bool enabled);
+
+	inline bool isEnabled() const
+	{
+		D(d);
+		return d->enabled.load(std::memory_order_relaxed);
+	}
+
+	//! 标记一帧结束。
+	void endFrame();
+
+	//! 获取当前帧的序号。
+	inline GMuint32 getFrame() const
+	{
+		D(d);
+		return d->frame.load(std::memory_order_relaxed);
+	}
+
+	//! 将各线程缓冲区中的事件取出并汇总。
+	/*!
+	  刷新线程会定期调用此方法，也可以手动调用。
+	*/
+	void flush();
+
+	//! 停止后台刷新线程，并刷新剩余的事件。
+	void stop();
+
+	//! 获取最近一个已经结束的帧的汇总统计。
+	Vector<GMProfileSummaryItem> getFrameSummary();
+
+	//! 将收集到的事件导出为Chrome Trace格式的JSON，可以在chrome://tracing中查看。
+	std::string exportChromeTrace();
+
+	//! 清除收集到的事件，并重置时间轴起点。
+	void resetTimeline();
+
+	//! 设置接收统计结果的处理器。
+	/*!
+	  如果刷新正在进行，此方法会等待刷新结束，因此返回之后旧的处理器不会再被调用。
+	  \sa IProfileHandler
+	*/
+	void setHandler(IProfileHandler* handler);
+
+	//! 获取因为缓冲区已满而丢弃的事件数量。
+	GMint64 getDroppedCount();
+
+public:
+	static inline GMint64 now()
+	{
+#if GM_PROFILE_USE_TSC
+		return static_cast<GMint64>(__rdtsc());
+#else
+		return GMClock::highResolutionTimer();
+#endif
+	}
+
+	GMProfileThreadBuffer* threadBuffer();
+
+	void record(GMProfileThreadBuffer* buffer, GMProfileNameId name, GMint64 beginCycle, GMint64 endCycle, GMint32 level);
+
+private:
+	void collect(const GMProfileEvent& e);
+	void dispatch(GMProfileThreadBuffer* buffer, const GMProfileEvent& e);
+	void dispatchTree(REF Vector<GMProfileEvent>& events, GMThreadId threadId);
+	void startFlushThread();
+	void calibrate();
+	GMfloat toSecond(GMint64 cycles) const;
+};
+
+GM_PRIVATE_OBJECT_UNALIGNED(GMProfile)
+{
+	GMProfileThreadBuffer* buffer = nullptr;
+	GMint64 beginCycle = 0;
+	GMProfileNameId name = 0;
+};
+
+//! 统计一个作用域的耗时，一般通过GM_PROFILE宏来使用。
+class GM_EXPORT GMProfile
+{
+	GM_DECLARE_PRIVATE_NGO(GMProfile)
+
+public:
+	GMProfile(GMProfileNameId name);
 	GMProfile(const GMString& name);
 	GMProfile(const GMwchar* name);
 	~GMProfile();
@@ -56,10 +254,9 @@ public:
 	static void resetTimeline();
 
 private:
-	void startRecord(const GMString& name);
+	void startRecord(GMProfileNameId name);
 	void stopRecord();
 };
 
-
 END_NS
-#endif
\ No newline at end of file
+#endif
@@ -52,6 +52,8 @@ GM_PRIVATE_OBJECT(GMThread)
 	GMThreadHandle handle = 0;
 	ThreadState state;
 	ThreadPriority priority = ThreadPriority::Normal;
+	GMString name;
+	GMuint64 affinityMask = 0;
 #if GM_UNIX
 	GMThreadAttr attr;
 #endif
@@ -89,6 +91,24 @@ public:
 	*/
 	void setPriority(ThreadPriority p);
 
+	//! 设置线程的名称。
+	/*!
+	  名称会在线程启动时设置到操作系统中，因此可以在调试器和性能分析工具（如gdb、perf、Visual Studio）中看到。
+	  部分系统限制了名称的长度（如Linux为15个字符），超出的部分会被截断。名称应该在线程开始前设置。
+	  \param name 线程名称。
+	*/
+	void setName(const GMString& name);
+
+	//! 获取线程的名称。
+	const GMString& getName() { D(d); return d->name; }
+
+	//! 设置线程的CPU亲和性。
+	/*!
+	  线程只会被调度到掩码中对应位为1的逻辑处理器上。掩码为0表示不限制。亲和性应该在线程开始前设置。
+	  \param mask 逻辑处理器掩码，第i位表示第i个逻辑处理器。
+	*/
+	void setAffinityMask(GMuint64 mask);
+
 	//! 开始一个线程。
 	/*!
 	  通过调用系统的创建线程函数，创建一个新线程。在新建的线程中，将会调用run()方法。
@@ -168,6 +188,16 @@ public:
 	  \param milliseconds 睡眠时间，单位为毫秒。
 	*/
 	static void sleep(GMint32 milliseconds);
+
+	//! 设置当前线程的名称。
+	static void setCurrentThreadName(const GMString& name);
+
+	//! 设置当前线程的CPU亲和性。
+	/*!
+	  \param mask 逻辑处理器掩码，为0时不做任何事。
+	  \return 是否设置成功。
+	*/
+	static bool setCurrentThreadAffinityMask(GMuint64 mask);
 };
 
 GM_PRIVATE_OBJECT(GMMutex)
@@ -206,6 +236,13 @@ public:
 	  \sa lock()
 	*/
 	void unlock();
+
+	//! 尝试锁定此互斥量。
+	/*!
+	  此方法不会阻塞当前线程。
+	  \return 如果成功锁定，返回true。如果互斥量已经被锁定，返回false。
+	*/
+	bool tryLock();
 };
 
 struct GMMutexRelease
@@ -213,5 +250,172 @@ struct GMMutexRelease
 	void operator()(GMMutex* mutex) { mutex->unlock(); }
 };
 
+GM_PRIVATE_OBJECT_UNALIGNED(GMReadWriteLock)
+{
+#if GM_WINDOWS
+	SRWLOCK lock = SRWLOCK_INIT;
+#endif
+#if GM_UNIX
+	pthread_rwlock_t lock;
+#endif
+	GMAtomic<GMint64> contentions;
+	GMuint32 profileName = 0;
+	bool profiled = false;
+};
+
+//! 此类表示一个读写锁。
+/*!
+  多个线程可以同时以共享的方式锁定读写锁（读），但同一时间只能有一个线程以独占的方式锁定它（写）。
+  读写锁适用于读多写少的场合，如资产表、字形缓存等。读写锁不可重入。
+*/
+class GM_EXPORT GMReadWriteLock
+{
+	GM_DECLARE_PRIVATE_NGO(GMReadWriteLock)
+	GM_DISABLE_COPY(GMReadWriteLock)
+	GM_DISABLE_ASSIGN(GMReadWriteLock)
+
+public:
+	GMReadWriteLock();
+	~GMReadWriteLock();
+
+public:
+	//! 以独占的方式锁定读写锁。
+	void lock();
+
+	//! 释放独占的锁定。
+	void unlock();
+
+	//! 尝试以独占的方式锁定读写锁，此方法不会阻塞当前线程。
+	bool tryLock();
+
+	//! 以共享的方式锁定读写锁。
+	void lockShared();
+
+	//! 释放共享的锁定。
+	void unlockShared();
+
+	//! 尝试以共享的方式锁定读写锁，此方法不会阻塞当前线程。
+	bool tryLockShared();
+
+	//! 设置此锁在GMProfiler中的名称。
+	/*!
+	  设置名称后，每次锁定时发生竞争，等待的时间都会以此名称记录到GMProfiler中。
+	  \param name 锁的名称。
+	*/
+	void setProfileName(const GMString& name);
+
+	//! 获取锁定时发生竞争（需要等待）的次数。
+	GMint64 getContentionCount() const;
+};
+
+//! 此类表示一个自旋锁。
+/*!
+  自旋锁在等待时不会让出线程，而是反复检查锁的状态，并逐渐增加每次检查之间的间隔，等待过久时才会让出线程。
+  它只适合保护非常短小的临界区，否则应该使用GMMutex。自旋锁不可重入。
+*/
+class GM_EXPORT GMSpinLock
+{
+	GM_DISABLE_COPY(GMSpinLock)
+	GM_DISABLE_ASSIGN(GMSpinLock)
+
+public:
+	GMSpinLock() = default;
+
+public:
+	//! 锁定自旋锁。
+	inline void lock()
+	{
+		if (!m_locked.exchange(true, std::memory_order_acquire))
+			return;
+		lockContended();
+	}
+
+	//! 尝试锁定自旋锁，此方法不会阻塞当前线程。
+	inline bool tryLock()
+	{
+		return !m_locked.load(std::memory_order_relaxed) && !m_locked.exchange(true, std::memory_order_acquire);
+	}
+
+	//! 释放自旋锁。
+	inline void unlock()
+	{
+		m_locked.store(false, std::memory_order_release);
+	}
+
+	//! 设置此锁在GMProfiler中的名称。
+	/*!
+	  设置名称后，每次锁定时发生竞争，自旋等待的时间都会以此名称记录到GMProfiler中。
+	  \param name 锁的名称。
+	*/
+	void setProfileName(const GMString& name);
+
+	//! 获取锁定时发生竞争（需要等待）的次数。
+	GMint64 getContentionCount() const
+	{
+		return m_contentions.load(std::memory_order_relaxed);
+	}
+
+private:
+	void lockContended();
+
+private:
+	GMAtomic<bool> m_locked{ false };
+	GMAtomic<GMint64> m_contentions{ 0 };
+	GMuint32 m_profileName = 0;
+	bool m_profiled = false;
+};
+
+//! 在作用域内以独占的方式锁定一个锁。
+/*!
+  构造时调用锁的lock()，析构时调用unlock()。可以用于GMMutex、GMReadWriteLock和GMSpinLock。
+*/
+template <typename LockType>
+class GMLockGuard
+{
+	GM_DISABLE_COPY(GMLockGuard)
+	GM_DISABLE_ASSIGN(GMLockGuard)
+
+public:
+	explicit GMLockGuard(LockType& lock)
+		: m_lock(lock)
+	{
+		m_lock.lock();
+	}
+
+	~GMLockGuard()
+	{
+		m_lock.unlock();
+	}
+
+private:
+	LockType& m_lock;
+};
+
+//! 在作用域内以共享的方式锁定一个读写锁。
+/*!
+  构造时调用lockShared()，析构时调用unlockShared()。
+*/
+template <typename LockType>
+class GMSharedLockGuard
+{
+	GM_DISABLE_COPY(GMSharedLockGuard)
+	GM_DISABLE_ASSIGN(GMSharedLockGuard)
+
+public:
+	explicit GMSharedLockGuard(LockType& lock)
+		: m_lock(lock)
+	{
+		m_lock.lockShared();
+	}
+
+	~GMSharedLockGuard()
+	{
+		m_lock.unlockShared();
+	}
+
+private:
+	LockType& m_lock;
+};
+
 END_NS
 #endif
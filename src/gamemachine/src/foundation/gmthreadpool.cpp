@@ -0,0 +1,197 @@
+﻿#include "stdafx.h"
+#include "gmthreadpool.h"
+#include <thread>
+
+void GMThreadPoolWorker::run()
+{
+	m_pool->workerLoop();
+}
+
+GMThreadPool& GMThreadPool::ioPool()
+{
+	static GMThreadPool s_instance([]() {
+		GMThreadPoolDesc desc;
+		desc.name = L"GM IO";
+		desc.threadCount = 2;
+		desc.affinityMask = backgroundAffinityMask();
+		desc.priority = ThreadPriority::BelowNormal;
+		return desc;
+	}());
+	return s_instance;
+}
+
+GMuint64 GMThreadPool::backgroundAffinityMask()
+{
+	GMint32 processors = static_cast<GMint32>(std::thread::hardware_concurrency());
+	if (processors < 2)
+		return 0;
+
+	GMuint64 mask = (processors >= 64) ? ~0ull : ((1ull << processors) - 1);
+	return mask & ~1ull;
+}
+
+GMThreadPool::GMThreadPool(const GMThreadPoolDesc& desc)
+{
+	D(d);
+	d->desc = desc;
+	if (d->desc.threadCount < 1)
+		d->desc.threadCount = 1;
+	d->profileName = GMProfiler::instance().intern(d->desc.name);
+	d->busyCycles = 0;
+	d->tasksExecuted = 0;
+	d->statisticsStart = GMClock::highResolutionTimer();
+}
+
+GMThreadPool::~GMThreadPool()
+{
+	stop();
+}
+
+GMJobHandle GMThreadPool::submit(GMJobFunction function)
+{
+	D(d);
+	GMJobHandle job = gm_makeSharedPtr<GMJob>();
+	job->function = std::move(function);
+	{
+		std::lock_guard<std::mutex> lock(d->mutex);
+		if (!d->started)
+			startWorkers();
+		d->tasks.push_back(job);
+	}
+	d->taskCondition.notify_one();
+	return job;
+}
+
+void GMThreadPool::wait(const GMJobHandle& job)
+{
+	D(d);
+	if (!job)
+		return;
+
+	std::unique_lock<std::mutex> lock(d->mutex);
+	d->finishCondition.wait(lock, [&job]() {
+		return job->finished.load();
+	});
+}
+
+void GMThreadPool::stop()
+{
+	D(d);
+	{
+		std::lock_guard<std::mutex> lock(d->mutex);
+		if (!d->started)
+			return;
+		d->stopping = true;
+	}
+	d->taskCondition.notify_all();
+
+	for (auto& worker : d->workers)
+	{
+		worker->join();
+	}
+	d->workers.clear();
+
+	// 工作线程退出之后仍可能有任务被提交，在当前线程中将它们执行完毕，否则等待这些任务的线程会永远阻塞
+	while (true)
+	{
+		GMJobHandle job;
+		{
+			std::lock_guard<std::mutex> lock(d->mutex);
+			if (d->tasks.empty())
+			{
+				d->started = false;
+				d->stopping = false;
+				break;
+			}
+			job = std::move(d->tasks.front());
+			d->tasks.pop_front();
+		}
+		execute(job);
+	}
+}
+
+const GMThreadPoolDesc& GMThreadPool::getDesc() const
+{
+	D(d);
+	return d->desc;
+}
+
+GMWorkerStatistics GMThreadPool::getStatistics()
+{
+	D(d);
+	static GMint64 s_frequency = GMClock::highResolutionTimerFrequency();
+	GMWorkerStatistics statistics;
+	statistics.tasksExecuted = d->tasksExecuted;
+	statistics.busyInSecond = static_cast<GMfloat>(d->busyCycles) / s_frequency;
+	statistics.elapsedInSecond = static_cast<GMfloat>(GMClock::highResolutionTimer() - d->statisticsStart) / s_frequency;
+	if (statistics.elapsedInSecond > 0)
+		statistics.utilization = statistics.busyInSecond / (statistics.elapsedInSecond * d->desc.threadCount);
+	return statistics;
+}
+
+void GMThreadPool::resetStatistics()
+{
+	D(d);
+	d->busyCycles = 0;
+	d->tasksExecuted = 0;
+	d->statisticsStart = GMClock::highResolutionTimer();
+}
+
+void GMThreadPool::workerLoop()
+{
+	D(d);
+	while (true)
+	{
+		GMJobHandle job;
+		{
+			std::unique_lock<std::mutex> lock(d->mutex);
+			d->taskCondition.wait(lock, [d]() {
+				return !d->tasks.empty() || d->stopping;
+			});
+
+			if (d->tasks.empty())
+				break;
+
+			job = std::move(d->tasks.front());
+			d->tasks.pop_front();
+		}
+
+		execute(job);
+	}
+}
+
+void GMThreadPool::execute(const GMJobHandle& job)
+{
+	D(d);
+	GMint64 begin = GMClock::highResolutionTimer();
+	if (job->function)
+	{
+		GMProfile profile(d->profileName);
+		job->function();
+	}
+	d->busyCycles.fetch_add(GMClock::highResolutionTimer() - begin, std::memory_order_relaxed);
+	d->tasksExecuted.fetch_add(1, std::memory_order_relaxed);
+
+	{
+		// 在锁内设置完成标记，保证等待的线程不会错过通知
+		std::lock_guard<std::mutex> lock(d->mutex);
+		job->finished = true;
+	}
+	d->finishCondition.notify_all();
+}
+
+void GMThreadPool::startWorkers()
+{
+	D(d);
+	d->started = true;
+	d->stopping = false;
+	for (GMint32 i = 0; i < d->desc.threadCount; ++i)
+	{
+		auto worker = gm_makeOwnedPtr<GMThreadPoolWorker>(this);
+		worker->setName(d->desc.name + L" " + GMString(i));
+		worker->setAffinityMask(d->desc.affinityMask);
+		worker->setPriority(d->desc.priority);
+		worker->start();
+		d->workers.push_back(std::move(worker));
+	}
+}
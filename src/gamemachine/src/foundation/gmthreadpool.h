@@ -0,0 +1,109 @@
+﻿#ifndef __GMTHREADPOOL_H__
+#define __GMTHREADPOOL_H__
+#include <gmcommon.h>
+#include <gmthread.h>
+#include <gmjobsystem.h>
+BEGIN_NS
+
+//! 描述一个线程池。
+struct GMThreadPoolDesc
+{
+	GMString name; //!< 线程池名称，工作线程被命名为“名称 n”，每个任务也以此名称记录到GMProfiler中。
+	GMint32 threadCount = 1; //!< 工作线程数量。
+	GMuint64 affinityMask = 0; //!< 工作线程的CPU亲和性掩码，为0表示不限制。
+	ThreadPriority priority = ThreadPriority::Normal; //!< 工作线程的优先级。
+};
+
+class GMThreadPool;
+class GMThreadPoolWorker : public GMThread
+{
+public:
+	GMThreadPoolWorker(GMThreadPool* pool)
+		: m_pool(pool)
+	{
+	}
+
+public:
+	virtual void run() override;
+
+private:
+	GMThreadPool* m_pool;
+};
+
+GM_PRIVATE_OBJECT_UNALIGNED(GMThreadPool)
+{
+	GMThreadPoolDesc desc;
+	std::mutex mutex;
+	std::condition_variable taskCondition;
+	std::condition_variable finishCondition;
+	Deque<GMJobHandle> tasks;
+	bool started = false;
+	bool stopping = false;
+	Vector<GMOwnedPtr<GMThreadPoolWorker>> workers;
+	GMProfileNameId profileName = 0;
+	GMAtomic<GMint64> busyCycles;
+	GMAtomic<GMint64> tasksExecuted;
+	GMAtomic<GMint64> statisticsStart;
+};
+
+//! 一组常驻的、按先进先出顺序执行任务的工作线程。
+/*!
+  与GMJobSystem不同，线程池适合执行会阻塞的任务，如文件读取、网络请求、音频解码。阻塞的任务不应该放在GMJobSystem中，
+  否则会占用计算线程。<BR>
+  ioPool()是GameMachine提供的I/O线程池，它的线程不会运行在第0个逻辑处理器上，从而避免与主线程（渲染线程）争抢。
+*/
+class GM_EXPORT GMThreadPool
+{
+	GM_DECLARE_PRIVATE_NGO(GMThreadPool)
+
+public:
+	//! 获取I/O线程池。
+	static GMThreadPool& ioPool();
+
+	//! 获取后台线程使用的CPU亲和性掩码。
+	/*!
+	  掩码包含除第0个以外的所有逻辑处理器，第0个逻辑处理器留给主线程。如果只有一个逻辑处理器，返回0。
+	*/
+	static GMuint64 backgroundAffinityMask();
+
+public:
+	GMThreadPool(const GMThreadPoolDesc& desc);
+	~GMThreadPool();
+
+public:
+	//! 提交一个任务。
+	/*!
+	  如果线程池尚未启动或者已经停止，会先启动线程池。
+	  \param function 任务执行的函数。
+	  \return 任务句柄。
+	*/
+	GMJobHandle submit(GMJobFunction function);
+
+	//! 阻塞等待一个任务结束。
+	void wait(const GMJobHandle& job);
+
+	//! 停止线程池，已经提交的任务会被执行完毕。
+	/*!
+	  停止的过程中提交的任务如果没有被工作线程取走，会在调用此方法的线程中执行，因此返回之后所有任务都已经结束。
+	*/
+	void stop();
+
+	//! 获取线程池的描述。
+	const GMThreadPoolDesc& getDesc() const;
+
+	//! 获取任务执行的统计。
+	GMWorkerStatistics getStatistics();
+
+	//! 重置任务执行的统计。
+	void resetStatistics();
+
+public:
+	void workerLoop();
+
+private:
+	void startWorkers();
+	void execute(const GMJobHandle& job);
+};
+
+END_NS
+#endif
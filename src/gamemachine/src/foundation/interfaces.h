@@ -3,6 +3,7 @@
 #include <defines.h>
 #include <glm/fwd.hpp>
 #include <gmenums.h>
+#include "memory.h"
 
 struct GMFloat4;
 struct GMMat4;
@@ -70,6 +71,9 @@ typedef GMAsset GMSceneAsset;
 typedef GMAsset GMPhysicsShapeAsset;
 typedef GMAsset GMTextureAsset;
 
+//! 渲染列表中的对象链表。渲染列表每帧都会重新填充，因此节点从GMFixedSizePool中分配。
+typedef List<GMGameObject*, GMPoolAllocator<GMGameObject*>> GMGameObjectList;
+
 enum class GameMachineHandlerEvent
 {
 	FrameStart,
@@ -504,7 +508,7 @@ enum class GMGeometryPassingState
 GM_INTERFACE(IGBuffer)
 {
 	virtual void init() = 0;
-	virtual void geometryPass(const List<GMGameObject*>& objects) = 0;
+	virtual void geometryPass(const GMGameObjectList& objects) = 0;
 	virtual void lightPass() = 0;
 	virtual IFramebuffers* getGeometryFramebuffers() = 0;
 	virtual void setGeometryPassingState(GMGeometryPassingState) = 0;
@@ -633,7 +637,7 @@ GM_INTERFACE_FROM(IGraphicEngine, IQueriable)
 	  \param forwardRenderingObjects 正向渲染对象列表。
 	  \param deferredRenderingObjects 延迟渲染对象列表。
 	*/
-	virtual void draw(const List<GMGameObject*>& forwardRenderingObjects, const List<GMGameObject*>& deferredRenderingObjects) = 0;
+	virtual void draw(const GMGameObjectList& forwardRenderingObjects, const GMGameObjectList& deferredRenderingObjects) = 0;
 
 	//! 更新绘制数据。
 	/*!
@@ -3,9 +3,9 @@
 #include "debug.h"
 #include <gmthread.h>
 
-GMint32 gm_s_numAlignedAllocs = 0;
-GMint32 gm_s_numAlignedFree = 0;
-GMint32 gm_s_totalBytesAlignedAllocs = 0;//detect memory leaks
+static GMAtomic<GMint64> gm_s_numAlignedAllocs(0);
+static GMAtomic<GMint64> gm_s_numAlignedFree(0);
+static GMAtomic<GMint64> gm_s_totalBytesAlignedAllocs(0);//detect memory leaks
 
 static void *gmAllocDefault(size_t size)
 {
@@ -80,7 +80,8 @@ void gmAlignedAllocSetCustom(gmAllocFunc *allocFunc, gmFreeFunc *freeFunc)
 
 void* AlignedMemoryAlloc::gmAlignedAllocInternal(size_t size, GMint32 alignment)
 {
-	gm_s_numAlignedAllocs++;
+	gm_s_numAlignedAllocs.fetch_add(1, std::memory_order_relaxed);
+	gm_s_totalBytesAlignedAllocs.fetch_add(static_cast<GMint64>(size), std::memory_order_relaxed);
 	void* ptr;
 	ptr = gm_s_alignedAllocFunc(size, alignment);
 	return ptr;
@@ -91,6 +92,206 @@ void AlignedMemoryAlloc::gmAlignedFreeInternal(void* ptr)
 	if (!ptr)
 		return;
 
-	gm_s_numAlignedFree++;
+	gm_s_numAlignedFree.fetch_add(1, std::memory_order_relaxed);
 	gm_s_alignedFreeFunc(ptr);
 }
+
+GMAlignedMemoryStatistics AlignedMemoryAlloc::getStatistics()
+{
+	GMAlignedMemoryStatistics statistics;
+	statistics.numAllocs = gm_s_numAlignedAllocs.load(std::memory_order_relaxed);
+	statistics.numFrees = gm_s_numAlignedFree.load(std::memory_order_relaxed);
+	statistics.totalBytesAllocated = gm_s_totalBytesAlignedAllocs.load(std::memory_order_relaxed);
+	return statistics;
+}
+
+GMFixedSizePool::GMFixedSizePool(GMsize_t blockSize, GMsize_t blocksPerPage)
+	: m_blocksPerPage(blocksPerPage > 0 ? blocksPerPage : 1)
+	, m_liveBlocks(0)
+{
+	// 每个块至少能放下空闲链表的指针，并保持16字节对齐
+	if (blockSize < sizeof(FreeBlock))
+		blockSize = sizeof(FreeBlock);
+	m_blockSize = (blockSize + 15) & ~static_cast<GMsize_t>(15);
+}
+
+GMFixedSizePool::~GMFixedSizePool()
+{
+	for (auto page : m_pages)
+	{
+		gmAlignedFree(page);
+	}
+}
+
+void* GMFixedSizePool::allocate(GMsize_t size)
+{
+	if (size > m_blockSize)
+		return gmAlignedAlloc(size, 16);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_freeList)
+	{
+		GMbyte* page = static_cast<GMbyte*>(gmAlignedAlloc(m_blockSize * m_blocksPerPage, 16));
+		if (!page)
+			return nullptr;
+
+		m_pages.push_back(page);
+		for (GMsize_t i = m_blocksPerPage; i > 0; --i)
+		{
+			FreeBlock* block = reinterpret_cast<FreeBlock*>(page + (i - 1) * m_blockSize);
+			block->next = m_freeList;
+			m_freeList = block;
+		}
+	}
+
+	FreeBlock* block = m_freeList;
+	m_freeList = block->next;
+	++m_liveBlocks;
+	return block;
+}
+
+void GMFixedSizePool::deallocate(void* ptr, GMsize_t size)
+{
+	if (!ptr)
+		return;
+
+	if (size > m_blockSize)
+	{
+		gmAlignedFree(ptr);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	FreeBlock* block = static_cast<FreeBlock*>(ptr);
+	block->next = m_freeList;
+	m_freeList = block;
+	--m_liveBlocks;
+}
+
+GMsize_t GMFixedSizePool::getPageCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_pages.size();
+}
+
+BEGIN_NS
+struct GMFrameArenaChunk
+{
+	GMbyte* memory;
+	GMsize_t capacity;
+	GMAtomic<GMsize_t> offset;
+	GMFrameArenaChunk* next;
+};
+END_NS
+
+GMFrameArena& GMFrameArena::instance()
+{
+	static GMFrameArena s_instance;
+	return s_instance;
+}
+
+GMFrameArena::GMFrameArena(GMsize_t capacity)
+	: m_chunkCapacity(capacity)
+{
+	m_chunks = newChunk(capacity);
+	m_current = m_chunks;
+}
+
+GMFrameArena::~GMFrameArena()
+{
+	freeChunks();
+}
+
+void* GMFrameArena::allocate(GMsize_t size, GMsize_t alignment)
+{
+	GM_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	// 按最坏情况预留对齐所需的空间，这样只需要一次原子加法
+	GMsize_t reserved = size + alignment - 1;
+	while (true)
+	{
+		GMFrameArenaChunk* chunk = m_current.load(std::memory_order_acquire);
+		GMsize_t offset = chunk->offset.fetch_add(reserved, std::memory_order_relaxed);
+		if (offset + reserved <= chunk->capacity)
+		{
+			GMsize_t address = reinterpret_cast<GMsize_t>(chunk->memory + offset);
+			address = (address + alignment - 1) & ~(alignment - 1);
+			return reinterpret_cast<void*>(address);
+		}
+
+		// 当前块已满，申请新的块
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_current.load(std::memory_order_acquire) == chunk)
+		{
+			GMFrameArenaChunk* next = newChunk(reserved > m_chunkCapacity ? reserved : m_chunkCapacity);
+			next->next = m_chunks;
+			m_chunks = next;
+			m_current.store(next, std::memory_order_release);
+		}
+	}
+}
+
+void GMFrameArena::reset()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_chunks->next)
+	{
+		// 上一帧用到了多个块，将它们合并成一个，下一帧便不再需要申请
+		GMsize_t capacity = 0;
+		for (GMFrameArenaChunk* chunk = m_chunks; chunk; chunk = chunk->next)
+		{
+			capacity += chunk->capacity;
+		}
+		freeChunks();
+		m_chunkCapacity = capacity;
+		m_chunks = newChunk(capacity);
+		m_current.store(m_chunks, std::memory_order_release);
+	}
+	else
+	{
+		m_chunks->offset.store(0, std::memory_order_relaxed);
+	}
+}
+
+GMsize_t GMFrameArena::getUsedBytes() const
+{
+	GMsize_t used = 0;
+	for (GMFrameArenaChunk* chunk = m_chunks; chunk; chunk = chunk->next)
+	{
+		GMsize_t offset = chunk->offset.load(std::memory_order_relaxed);
+		used += offset < chunk->capacity ? offset : chunk->capacity;
+	}
+	return used;
+}
+
+GMsize_t GMFrameArena::getCapacity() const
+{
+	GMsize_t capacity = 0;
+	for (GMFrameArenaChunk* chunk = m_chunks; chunk; chunk = chunk->next)
+	{
+		capacity += chunk->capacity;
+	}
+	return capacity;
+}
+
+GMFrameArenaChunk* GMFrameArena::newChunk(GMsize_t capacity)
+{
+	GMFrameArenaChunk* chunk = new GMFrameArenaChunk();
+	chunk->memory = static_cast<GMbyte*>(gmAlignedAlloc(capacity, 16));
+	chunk->capacity = capacity;
+	chunk->offset = 0;
+	chunk->next = nullptr;
+	return chunk;
+}
+
+void GMFrameArena::freeChunks()
+{
+	GMFrameArenaChunk* chunk = m_chunks;
+	while (chunk)
+	{
+		GMFrameArenaChunk* next = chunk->next;
+		gmAlignedFree(chunk->memory);
+		delete chunk;
+		chunk = next;
+	}
+	m_chunks = nullptr;
+}
@@ -1,6 +1,7 @@
 ﻿#ifndef __GM_MEMORY_H__
 #define __GM_MEMORY_H__
 #include "defines.h"
+#include <mutex>
 BEGIN_NS
 
 typedef void *(gmAlignedAllocFunc)(size_t size, GMint32 alignment);
@@ -13,11 +14,22 @@ void gmAlignedAllocSetCustomAligned(gmAlignedAllocFunc *allocFunc, gmAlignedFree
 #define gmAlignedAlloc(size,alignment) gm::AlignedMemoryAlloc::gmAlignedAllocInternal(size,alignment)
 #define gmAlignedFree(ptr) gm::AlignedMemoryAlloc::gmAlignedFreeInternal(ptr)
 
+//! 对齐内存分配的统计数据。
+struct GMAlignedMemoryStatistics
+{
+	GMint64 numAllocs = 0; //!< 分配的次数。
+	GMint64 numFrees = 0; //!< 释放的次数。
+	GMint64 totalBytesAllocated = 0; //!< 累计分配的字节数。
+};
+
 class GM_EXPORT AlignedMemoryAlloc
 {
 public:
 	static void* gmAlignedAllocInternal(size_t size, GMint32 alignment);
 	static void gmAlignedFreeInternal(void* ptr);
+
+	//! 获取对齐内存分配的统计数据，此方法是线程安全的。
+	static GMAlignedMemoryStatistics getStatistics();
 };
 
 template < typename T, unsigned Alignment = 16>
@@ -82,6 +94,221 @@ class GMAlignmentObject
 #define GM_ALIGNED_STRUCT_FROM(name, from) GM_ALIGNED_16(struct) name : public from
 #define GM_ALIGNED_STRUCT(name) GM_ALIGNED_STRUCT_FROM(name, gm::GMAlignmentObject)
 
+//! 固定大小的内存池。
+/*!
+  内存池按页向系统申请内存，每一页切分为若干个大小相同的块，释放的块放入空闲链表中以便复用。
+  所有的块都是16字节对齐的。此类是线程安全的。
+*/
+class GM_EXPORT GMFixedSizePool
+{
+public:
+	//! 获取某个类型使用的内存池，块大小为此类型的大小。
+	/*!
+	  内存池永远不会被析构，因为在它之后析构的单例（如GMJobSystem）仍然可能向它归还内存。
+	*/
+	template <typename T>
+	static GMFixedSizePool& poolOf()
+	{
+		static GMFixedSizePool* s_pool = new GMFixedSizePool(sizeof(T));
+		return *s_pool;
+	}
+
+public:
+	GMFixedSizePool(GMsize_t blockSize, GMsize_t blocksPerPage = 64);
+	~GMFixedSizePool();
+
+	GMFixedSizePool(const GMFixedSizePool&) = delete;
+	GMFixedSizePool& operator=(const GMFixedSizePool&) = delete;
+
+public:
+	//! 分配一块内存。
+	/*!
+	  如果size大于块大小（比如一个派生类使用了基类的内存池），将直接通过gmAlignedAlloc分配。
+	  \param size 需要分配的字节数。
+	*/
+	void* allocate(GMsize_t size);
+
+	//! 释放一块内存，size必须与分配时一致。
+	void deallocate(void* ptr, GMsize_t size);
+
+	GMsize_t getBlockSize() const { return m_blockSize; }
+	GMsize_t getLiveBlocks() const { return m_liveBlocks; }
+	GMsize_t getPageCount() const;
+
+private:
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	GMsize_t m_blockSize;
+	GMsize_t m_blocksPerPage;
+	FreeBlock* m_freeList = nullptr;
+	Vector<void*> m_pages;
+	GMAtomic<GMsize_t> m_liveBlocks;
+	mutable std::mutex m_mutex;
+};
+
+// override new, delete，使用此类型的内存池分配内存
+#define GM_DECLARE_POOLED_ALLOCATOR(className) \
+	public:   \
+	inline void* operator new(size_t sizeInBytes){ return gm::GMFixedSizePool::poolOf<className>().allocate(sizeInBytes); }   \
+	inline void  operator delete(void* ptr, size_t sizeInBytes) { gm::GMFixedSizePool::poolOf<className>().deallocate(ptr, sizeInBytes); }   \
+	inline void* operator new(size_t, void* ptr){ return ptr; }   \
+	inline void  operator delete(void*, void*)      { }   \
+	inline void* operator new[](size_t sizeInBytes)   { return gmAlignedAlloc(sizeInBytes, 16); }   \
+	inline void  operator delete[](void* ptr)         { gmAlignedFree(ptr); }   \
+	inline void* operator new[](size_t, void* ptr)   { return ptr; }   \
+	inline void  operator delete[](void*, void*)      {}
+
+//! 使用GMFixedSizePool分配内存的STL分配器。
+/*!
+  每个类型使用GMFixedSizePool::poolOf()返回的内存池。与GM_DECLARE_POOLED_ALLOCATOR不同，它可以用于std::allocate_shared，
+  使得对象和引用计数一起从内存池中分配。
+*/
+template <typename T>
+class GMPoolAllocator
+{
+public:
+	typedef T value_type;
+
+	GMPoolAllocator() = default;
+
+	template <typename O>
+	GMPoolAllocator(const GMPoolAllocator<O>&)
+	{
+	}
+
+	T* allocate(GMsize_t n)
+	{
+		return static_cast<T*>(GMFixedSizePool::poolOf<T>().allocate(sizeof(T) * n));
+	}
+
+	void deallocate(T* ptr, GMsize_t n)
+	{
+		GMFixedSizePool::poolOf<T>().deallocate(ptr, sizeof(T) * n);
+	}
+
+	template <typename O>
+	bool operator==(const GMPoolAllocator<O>&) const { return true; }
+
+	template <typename O>
+	bool operator!=(const GMPoolAllocator<O>&) const { return false; }
+};
+
+struct GMFrameArenaChunk;
+
+//! 帧内存分配器。
+/*!
+  帧内存分配器是一个线性分配器，分配时只需要移动偏移量，并且可以在多个线程中同时分配。分配的内存不需要释放，
+  它们在reset()时一并失效。<BR>
+  GMFrameArena::instance()返回的分配器在GameMachine::renderFrame()的每一帧结束（GameMachineHandlerEvent::FrameEnd之后）
+  时被重置，因此只能用来存放当前帧的临时数据。不经过renderFrame()的更新（如没有窗口、只调用更新的服务器）不会重置它，
+  这样的子系统应该持有自己的分配器，并在每次更新开始时重置，如GMGameWorld的对象分组、GMParticleSystemManager的
+  并行更新列表。<BR>
+  如果一帧内申请的内存超出了容量，分配器会申请新的内存块，并在重置时将它们合并为一块，使得下一帧不再需要申请内存。
+*/
+class GM_EXPORT GMFrameArena
+{
+public:
+	static GMFrameArena& instance();
+
+public:
+	GMFrameArena(GMsize_t capacity = 1024 * 1024);
+	~GMFrameArena();
+
+	GMFrameArena(const GMFrameArena&) = delete;
+	GMFrameArena& operator=(const GMFrameArena&) = delete;
+
+public:
+	//! 分配一块内存，此方法是线程安全的。
+	/*!
+	  \param size 需要分配的字节数。
+	  \param alignment 对齐字节数，必须是2的幂。
+	  \return 分配的内存，在下次reset()之前有效。
+	*/
+	void* allocate(GMsize_t size, GMsize_t alignment = 16);
+
+	//! 在帧内存上构造一个对象。
+	/*!
+	  由于分配器不会调用析构函数，对象必须是可平凡析构的。
+	*/
+	template <typename T, typename... Args>
+	T* create(Args&&... args)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Frame arena objects will never be destructed.");
+		return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	//! 重置分配器，之前分配的内存全部失效。
+	/*!
+	  调用此方法时，不能有其它线程正在分配内存。
+	*/
+	void reset();
+
+	//! 获取当前帧已经分配的字节数。
+	GMsize_t getUsedBytes() const;
+
+	//! 获取分配器的总容量。
+	GMsize_t getCapacity() const;
+
+private:
+	GMFrameArenaChunk* newChunk(GMsize_t capacity);
+	void freeChunks();
+
+private:
+	GMAtomic<GMFrameArenaChunk*> m_current;
+	GMFrameArenaChunk* m_chunks = nullptr;
+	GMsize_t m_chunkCapacity;
+	std::mutex m_mutex;
+};
+
+//! 在GMFrameArena上分配内存的STL分配器。
+/*!
+  释放内存时不做任何事，因此使用此分配器的容器不能跨帧保存。
+*/
+template <typename T>
+class GMFrameAllocator
+{
+	template <typename O> friend class GMFrameAllocator;
+
+public:
+	typedef T value_type;
+
+	GMFrameAllocator(GMFrameArena* arena = &GMFrameArena::instance())
+		: m_arena(arena)
+	{
+	}
+
+	template <typename O>
+	GMFrameAllocator(const GMFrameAllocator<O>& other)
+		: m_arena(other.m_arena)
+	{
+	}
+
+	T* allocate(GMsize_t n)
+	{
+		return static_cast<T*>(m_arena->allocate(sizeof(T) * n, alignof(T)));
+	}
+
+	void deallocate(T*, GMsize_t) {}
+
+	template <typename O>
+	bool operator==(const GMFrameAllocator<O>& other) const { return m_arena == other.m_arena; }
+
+	template <typename O>
+	bool operator!=(const GMFrameAllocator<O>& other) const { return m_arena != other.m_arena; }
+
+private:
+	GMFrameArena* m_arena;
+};
+
+template <typename T>
+using FrameVector = Vector<T, GMFrameAllocator<T>>;
+
+template <typename T1, typename T2, typename Hasher = Hash<T1>>
+using FrameHashMap = std::unordered_map<T1, T2, Hasher, std::equal_to<T1>, GMFrameAllocator<std::pair<const T1, T2>>>;
+
 #if GM_WINDOWS
 template <typename T>
 using AlignedVector = Vector<T, AlignedAllocator<T>>;
@@ -3,6 +3,8 @@
 #include <gmthread.h>
 #include <signal.h>
 #include <unistd.h>
+#include <sched.h>
+#include <gmprofile.h>
 
 namespace
 {
@@ -11,6 +13,9 @@ namespace
 		GMThread* thread = static_cast<GMThread*>(param);
 		GM_PRIVATE_NAME(GMThread)* d = thread->_thread_private();
 		d->state = ThreadState::Running;
+		if (!d->name.isEmpty())
+			GMThread::setCurrentThreadName(d->name);
+		GMThread::setCurrentThreadAffinityMask(d->affinityMask);
 		if (d->callback)
 			d->callback->beforeRun(thread);
 		thread->run();
@@ -44,6 +49,18 @@ void GMThread::setPriority(ThreadPriority p)
 	d->priority = p;
 }
 
+void GMThread::setName(const GMString& name)
+{
+	D(d);
+	d->name = name;
+}
+
+void GMThread::setAffinityMask(GMuint64 mask)
+{
+	D(d);
+	d->affinityMask = mask;
+}
+
 void GMThread::start()
 {
 	D(d);
@@ -67,6 +84,7 @@ bool GMThread::join(GMuint32 milliseconds)
 {
 	D(d);
 	pthread_join(d->handle, NULL);
+	return true;
 }
 
 GMThreadId GMThread::getThreadId()
@@ -91,6 +109,38 @@ void GMThread::sleep(GMint32 milliseconds)
 	usleep(milliseconds * 1000);
 }
 
+void GMThread::setCurrentThreadName(const GMString& name)
+{
+#if defined(__linux__)
+	// Linux的线程名最多15个字符
+	std::string threadName = name.toStdString();
+	if (threadName.size() > 15)
+		threadName.resize(15);
+	pthread_setname_np(pthread_self(), threadName.c_str());
+#elif defined(__APPLE__)
+	pthread_setname_np(name.toStdString().c_str());
+#endif
+}
+
+bool GMThread::setCurrentThreadAffinityMask(GMuint64 mask)
+{
+	if (!mask)
+		return false;
+
+#if defined(__linux__)
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	for (GMint32 i = 0; i < 64 && i < CPU_SETSIZE; ++i)
+	{
+		if (mask & (1ull << i))
+			CPU_SET(i, &cpuSet);
+	}
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+	return false;
+#endif
+}
+
 // Mutex
 GMMutex::GMMutex()
 {
@@ -114,4 +164,157 @@ void GMMutex::unlock()
 {
 	D(d);
 	pthread_mutex_unlock(&d->mutex);
+}
+
+bool GMMutex::tryLock()
+{
+	D(d);
+	return pthread_mutex_trylock(&d->mutex) == 0;
+}
+
+// ReadWriteLock
+GMReadWriteLock::GMReadWriteLock()
+{
+	D(d);
+	d->contentions = 0;
+	pthread_rwlock_init(&d->lock, NULL);
+}
+
+GMReadWriteLock::~GMReadWriteLock()
+{
+	D(d);
+	pthread_rwlock_destroy(&d->lock);
+}
+
+void GMReadWriteLock::lock()
+{
+	D(d);
+	if (pthread_rwlock_trywrlock(&d->lock) == 0)
+		return;
+
+	d->contentions.fetch_add(1, std::memory_order_relaxed);
+	if (d->profiled)
+	{
+		GMProfile profile(d->profileName);
+		pthread_rwlock_wrlock(&d->lock);
+	}
+	else
+	{
+		pthread_rwlock_wrlock(&d->lock);
+	}
+}
+
+void GMReadWriteLock::unlock()
+{
+	D(d);
+	pthread_rwlock_unlock(&d->lock);
+}
+
+bool GMReadWriteLock::tryLock()
+{
+	D(d);
+	return pthread_rwlock_trywrlock(&d->lock) == 0;
+}
+
+void GMReadWriteLock::lockShared()
+{
+	D(d);
+	if (pthread_rwlock_tryrdlock(&d->lock) == 0)
+		return;
+
+	d->contentions.fetch_add(1, std::memory_order_relaxed);
+	if (d->profiled)
+	{
+		GMProfile profile(d->profileName);
+		pthread_rwlock_rdlock(&d->lock);
+	}
+	else
+	{
+		pthread_rwlock_rdlock(&d->lock);
+	}
+}
+
+void GMReadWriteLock::unlockShared()
+{
+	D(d);
+	pthread_rwlock_unlock(&d->lock);
+}
+
+bool GMReadWriteLock::tryLockShared()
+{
+	D(d);
+	return pthread_rwlock_tryrdlock(&d->lock) == 0;
+}
+
+void GMReadWriteLock::setProfileName(const GMString& name)
+{
+	D(d);
+	d->profileName = GMProfiler::instance().intern(name);
+	d->profiled = true;
+}
+
+GMint64 GMReadWriteLock::getContentionCount() const
+{
+	D(d);
+	return d->contentions.load(std::memory_order_relaxed);
+}
+
+// SpinLock
+namespace
+{
+	// 自旋的次数超过此值后，开始让出线程
+	constexpr GMint32 MaxSpinCount = 64;
+
+	inline void cpuRelax()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+		__asm__ __volatile__("yield");
+#endif
+	}
+
+	void spinUntilLocked(GMAtomic<bool>& locked)
+	{
+		GMint32 spinCount = 1;
+		do
+		{
+			// 只读等待，避免反复写缓存行
+			while (locked.load(std::memory_order_relaxed))
+			{
+				if (spinCount <= MaxSpinCount)
+				{
+					for (GMint32 i = 0; i < spinCount; ++i)
+					{
+						cpuRelax();
+					}
+					spinCount <<= 1;
+				}
+				else
+				{
+					sched_yield();
+				}
+			}
+		} while (locked.exchange(true, std::memory_order_acquire));
+	}
+}
+
+void GMSpinLock::setProfileName(const GMString& name)
+{
+	m_profileName = GMProfiler::instance().intern(name);
+	m_profiled = true;
+}
+
+void GMSpinLock::lockContended()
+{
+	m_contentions.fetch_add(1, std::memory_order_relaxed);
+	if (m_profiled)
+	{
+		GMProfile profile(m_profileName);
+		spinUntilLocked(m_locked);
+	}
+	else
+	{
+		spinUntilLocked(m_locked);
+	}
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 ﻿#include "stdafx.h"
 #include <gmthread.h>
+#include <gmprofile.h>
 #if GM_WINDOWS
 #	include <process.h>
 #endif
@@ -11,6 +12,9 @@ namespace
 		GMThread* thread = static_cast<GMThread*>(pvParam);
 		GM_PRIVATE_NAME(GMThread)* d = thread->_thread_private();
 		d->state = ThreadState::Running;
+		if (!d->name.isEmpty())
+			GMThread::setCurrentThreadName(d->name);
+		GMThread::setCurrentThreadAffinityMask(d->affinityMask);
 		if (d->callback)
 			d->callback->beforeRun(thread);
 		thread->run();
@@ -64,6 +68,18 @@ void GMThread::setPriority(ThreadPriority p)
 	d->priority = p;
 }
 
+void GMThread::setName(const GMString& name)
+{
+	D(d);
+	d->name = name;
+}
+
+void GMThread::setAffinityMask(GMuint64 mask)
+{
+	D(d);
+	d->affinityMask = mask;
+}
+
 void GMThread::start()
 {
 	D(d);
@@ -109,6 +125,24 @@ void GMThread::sleep(GMint32 milliseconds)
 	::Sleep(milliseconds);
 }
 
+void GMThread::setCurrentThreadName(const GMString& name)
+{
+	// SetThreadDescription从Windows 10 1607开始提供，因此动态获取
+	typedef HRESULT (WINAPI *SetThreadDescriptionProc)(HANDLE, PCWSTR);
+	static SetThreadDescriptionProc s_setThreadDescription = reinterpret_cast<SetThreadDescriptionProc>(
+		::GetProcAddress(::GetModuleHandleW(L"kernel32.dll"), "SetThreadDescription"));
+	if (s_setThreadDescription)
+		s_setThreadDescription(::GetCurrentThread(), name.toStdWString().c_str());
+}
+
+bool GMThread::setCurrentThreadAffinityMask(GMuint64 mask)
+{
+	if (!mask)
+		return false;
+
+	return ::SetThreadAffinityMask(::GetCurrentThread(), static_cast<DWORD_PTR>(mask)) != 0;
+}
+
 GMMutex::GMMutex()
 {
 	D(d);
@@ -132,4 +166,143 @@ void GMMutex::unlock()
 {
 	D(d);
 	::ReleaseMutex(d->mutex);
+}
+
+bool GMMutex::tryLock()
+{
+	D(d);
+	return ::WaitForSingleObject(d->mutex, 0) == WAIT_OBJECT_0;
+}
+
+GMReadWriteLock::GMReadWriteLock()
+{
+	D(d);
+	d->contentions = 0;
+}
+
+GMReadWriteLock::~GMReadWriteLock()
+{
+}
+
+void GMReadWriteLock::lock()
+{
+	D(d);
+	if (!!::TryAcquireSRWLockExclusive(&d->lock))
+		return;
+
+	d->contentions.fetch_add(1, std::memory_order_relaxed);
+	if (d->profiled)
+	{
+		GMProfile profile(d->profileName);
+		::AcquireSRWLockExclusive(&d->lock);
+	}
+	else
+	{
+		::AcquireSRWLockExclusive(&d->lock);
+	}
+}
+
+void GMReadWriteLock::unlock()
+{
+	D(d);
+	::ReleaseSRWLockExclusive(&d->lock);
+}
+
+bool GMReadWriteLock::tryLock()
+{
+	D(d);
+	return !!::TryAcquireSRWLockExclusive(&d->lock);
+}
+
+void GMReadWriteLock::lockShared()
+{
+	D(d);
+	if (!!::TryAcquireSRWLockShared(&d->lock))
+		return;
+
+	d->contentions.fetch_add(1, std::memory_order_relaxed);
+	if (d->profiled)
+	{
+		GMProfile profile(d->profileName);
+		::AcquireSRWLockShared(&d->lock);
+	}
+	else
+	{
+		::AcquireSRWLockShared(&d->lock);
+	}
+}
+
+void GMReadWriteLock::unlockShared()
+{
+	D(d);
+	::ReleaseSRWLockShared(&d->lock);
+}
+
+bool GMReadWriteLock::tryLockShared()
+{
+	D(d);
+	return !!::TryAcquireSRWLockShared(&d->lock);
+}
+
+void GMReadWriteLock::setProfileName(const GMString& name)
+{
+	D(d);
+	d->profileName = GMProfiler::instance().intern(name);
+	d->profiled = true;
+}
+
+GMint64 GMReadWriteLock::getContentionCount() const
+{
+	D(d);
+	return d->contentions.load(std::memory_order_relaxed);
+}
+
+namespace
+{
+	// 自旋的次数超过此值后，开始让出线程
+	constexpr GMint32 MaxSpinCount = 64;
+
+	void spinUntilLocked(GMAtomic<bool>& locked)
+	{
+		GMint32 spinCount = 1;
+		do
+		{
+			// 只读等待，避免反复写缓存行
+			while (locked.load(std::memory_order_relaxed))
+			{
+				if (spinCount <= MaxSpinCount)
+				{
+					for (GMint32 i = 0; i < spinCount; ++i)
+					{
+						YieldProcessor();
+					}
+					spinCount <<= 1;
+				}
+				else
+				{
+					::SwitchToThread();
+				}
+			}
+		} while (locked.exchange(true, std::memory_order_acquire));
+	}
+}
+
+void GMSpinLock::setProfileName(const GMString& name)
+{
+	m_profileName = GMProfiler::instance().intern(name);
+	m_profiled = true;
+}
+
+void GMSpinLock::lockContended()
+{
+	m_contentions.fetch_add(1, std::memory_order_relaxed);
+	if (m_profiled)
+	{
+		GMProfile profile(m_profileName);
+		spinUntilLocked(m_locked);
+	}
+	else
+	{
+		spinUntilLocked(m_locked);
+	}
 }
\ No newline at end of file
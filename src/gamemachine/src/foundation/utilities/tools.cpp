@@ -4,6 +4,9 @@
 #include "assert.h"
 #include <zlib.h>
 #include <fstream>
+#if GM_SIMD_SSE2
+#	include <emmintrin.h>
+#endif
 
 //GMClock
 GMClock::GMClock()
@@ -619,4 +622,103 @@ GMZip::ErrorCode GMZip::translateError(GMint32 err)
 		return StreamError;
 	}
 	return UnknownError;
+}
+
+namespace
+{
+	inline GMuint64 splitMix64(REF GMuint64& x)
+	{
+		GMuint64 z = (x += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	// 取随机数的高24位转换为[0, 1)之间的浮点数
+	constexpr GMfloat Uint24ToUnit = 1.f / 16777216.f;
+}
+
+GMXoshiro128::GMXoshiro128(GMuint64 seed)
+{
+	this->seed(seed);
+}
+
+void GMXoshiro128::seed(GMuint64 seed)
+{
+	// 使用splitmix64将种子扩展为状态，避免出现全为0的状态
+	GMuint64 x = seed;
+	for (GMint32 i = 0; i < 4; i += 2)
+	{
+		GMuint64 v = splitMix64(x);
+		m_state[i] = static_cast<GMuint32>(v);
+		m_state[i + 1] = static_cast<GMuint32>(v >> 32);
+	}
+
+	for (GMint32 lane = 0; lane < 4; ++lane)
+	{
+		for (GMint32 i = 0; i < 4; i += 2)
+		{
+			GMuint64 v = splitMix64(x);
+			m_lanes[i][lane] = static_cast<GMuint32>(v);
+			m_lanes[i + 1][lane] = static_cast<GMuint32>(v >> 32);
+		}
+	}
+}
+
+void GMXoshiro128::fill(GMfloat* out, GMsize_t count, GMfloat min, GMfloat max)
+{
+	const GMfloat scale = (max - min) * Uint24ToUnit;
+	GMsize_t i = 0;
+#if GM_SIMD_SSE2
+	__m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_lanes[0]));
+	__m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_lanes[1]));
+	__m128i s2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_lanes[2]));
+	__m128i s3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_lanes[3]));
+	const __m128 vMin = _mm_set1_ps(min);
+	const __m128 vScale = _mm_set1_ps(scale);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i result = _mm_add_epi32(s0, s3);
+		__m128i t = _mm_slli_epi32(s1, 9);
+		s2 = _mm_xor_si128(s2, s0);
+		s3 = _mm_xor_si128(s3, s1);
+		s1 = _mm_xor_si128(s1, s2);
+		s0 = _mm_xor_si128(s0, s3);
+		s2 = _mm_xor_si128(s2, t);
+		s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+
+		__m128 unit = _mm_cvtepi32_ps(_mm_srli_epi32(result, 8));
+		_mm_storeu_ps(out + i, _mm_add_ps(vMin, _mm_mul_ps(unit, vScale)));
+	}
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(m_lanes[0]), s0);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(m_lanes[1]), s1);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(m_lanes[2]), s2);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(m_lanes[3]), s3);
+#endif
+
+	// 每次推进全部4组状态，不足4个时丢弃多余的结果
+	for (; i < count; i += 4)
+	{
+		GMuint32 results[4];
+		for (GMint32 lane = 0; lane < 4; ++lane)
+		{
+			GMuint32& s0 = m_lanes[0][lane];
+			GMuint32& s1 = m_lanes[1][lane];
+			GMuint32& s2 = m_lanes[2][lane];
+			GMuint32& s3 = m_lanes[3][lane];
+			results[lane] = s0 + s3;
+			const GMuint32 t = s1 << 9;
+			s2 ^= s0;
+			s3 ^= s1;
+			s1 ^= s2;
+			s0 ^= s3;
+			s2 ^= t;
+			s3 = (s3 << 11) | (s3 >> 21);
+		}
+
+		for (GMsize_t j = 0; j < 4 && i + j < count; ++j)
+		{
+			out[i + j] = min + static_cast<GMfloat>(results[j] >> 8) * scale;
+		}
+	}
 }
\ No newline at end of file
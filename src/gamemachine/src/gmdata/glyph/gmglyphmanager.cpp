@@ -49,18 +49,47 @@ const GMGlyphInfo& GMGlyphManager::getCharInner(GMwchar c, GMFontSizePt fontSize
 	if (font >= d->fonts.size())
 		return err;
 
-	auto& charsWithSize = d->chars[font][fontSize];
-	auto iter = charsWithSize.find(c);
-	if (iter != charsWithSize.end())
-		return (*iter).second;
+	{
+		// 绝大部分字形已经在缓存中，查找时允许多个线程同时进行
+		GMSharedLockGuard<GMReadWriteLock> guard(d->charsLock);
+		const GMGlyphInfo* cached = findChar(c, fontSize, font);
+		if (cached)
+			return *cached;
+	}
 
-	const GMGlyphInfo& glyph = createChar(c, fontSize, font);
-	if (!glyph.valid)
+	const GMGlyphInfo* glyph = nullptr;
+	{
+		GMLockGuard<GMReadWriteLock> guard(d->charsLock);
+		// 等待锁的过程中，其它线程可能已经创建了此字形
+		glyph = findChar(c, fontSize, font);
+		if (glyph)
+			return *glyph;
+		glyph = &createChar(c, fontSize, font);
+	}
+
+	if (!glyph->valid)
 	{
 		//如果没有拿到当前的字形，需要换一种默认字体匹配
 		return getCharInner(c, fontSize, candidate, candidate + 1);
 	}
-	return glyph;
+	return *glyph;
+}
+
+const GMGlyphInfo* GMGlyphManager::findChar(GMwchar c, GMFontSizePt fontSize, GMFontHandle font)
+{
+	D(d);
+	auto fontIter = d->chars.find(font);
+	if (fontIter == d->chars.end())
+		return nullptr;
+
+	auto sizeIter = fontIter->second.find(fontSize);
+	if (sizeIter == fontIter->second.end())
+		return nullptr;
+
+	auto iter = sizeIter->second.find(c);
+	if (iter == sizeIter->second.end())
+		return nullptr;
+	return &(*iter).second;
 }
 
 GMFontHandle GMGlyphManager::addFontByFileName(const GMString& fontFileName)
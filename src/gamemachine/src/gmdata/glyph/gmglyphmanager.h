@@ -37,6 +37,7 @@ typedef HashMap<GMFontHandle, HashMap<GMint32, HashMap<GMwchar, GMGlyphInfo> > >
 GM_PRIVATE_OBJECT(GMGlyphManager)
 {
 	const IRenderContext* context = nullptr;
+	GMReadWriteLock charsLock;
 	CharList chars;
 	GMint32 cursor_u, cursor_v;
 	GMfloat maxHeight;
@@ -104,6 +105,7 @@ private:
 	virtual void updateTexture(const GMGlyphBitmap& bitmapGlyph, const GMGlyphInfo& glyphInfo) = 0;
 
 private:
+	const GMGlyphInfo* findChar(GMwchar c, GMFontSizePt fontSize, GMFontHandle font);
 	const GMGlyphInfo& createChar(GMwchar c, GMFontSizePt fontSize, GMFontHandle font);
 	GMFont* getFont(GMFontHandle);
 	GMGlyphInfo& insertChar(GMFontSizePt fontSize, GMFontHandle font, GMwchar ch, const GMGlyphInfo& glyph);
@@ -0,0 +1,866 @@
+﻿#include "stdafx.h"
+#include "gmmeshoptimizer.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+	const GMuint32 InvalidIndex = std::numeric_limits<GMuint32>::max();
+
+	// 按照32位字计算一个顶点的哈希值
+	GMuint32 hashVertex(const GMVertex& vertex)
+	{
+		GM_STATIC_ASSERT(sizeof(GMVertex) % sizeof(GMuint32) == 0, "Wrong type size.");
+		GMuint32 words[sizeof(GMVertex) / sizeof(GMuint32)];
+		memcpy(words, &vertex, sizeof(GMVertex));
+
+		GMuint32 h = 2166136261u;
+		for (GMuint32 word : words)
+		{
+			word *= 0xcc9e2d51u;
+			word = (word << 15) | (word >> 17);
+			h ^= word * 0x1b873593u;
+			h = ((h << 13) | (h >> 19)) * 5 + 0xe6546b64u;
+		}
+		h ^= h >> 16;
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+		return h;
+	}
+
+	// 模拟FIFO顶点缓存，timestamp - timestamps[v] <= cacheSize表示顶点v在缓存中
+	GMuint32 updateCache(GMuint32 a, GMuint32 b, GMuint32 c, GMuint32 cacheSize, GMuint32* timestamps, REF GMuint32& timestamp)
+	{
+		GMuint32 misses = 0;
+		for (GMuint32 v : { a, b, c })
+		{
+			if (timestamp - timestamps[v] > cacheSize)
+			{
+				timestamps[v] = timestamp++;
+				++misses;
+			}
+		}
+		return misses;
+	}
+
+	// Forsyth算法的评分，模拟的是LRU缓存
+	const GMint32 ForsythCacheSize = 32;
+	const GMint32 ForsythMaxValence = 32;
+
+	struct ForsythScores
+	{
+		GMfloat cache[ForsythCacheSize];
+		GMfloat valence[ForsythMaxValence + 1];
+
+		ForsythScores()
+		{
+			for (GMint32 i = 0; i < ForsythCacheSize; ++i)
+			{
+				// 最后一个三角形的三个顶点得分固定，避免立即重复使用同一条边
+				if (i < 3)
+					cache[i] = .75f;
+				else
+					cache[i] = std::pow(1.f - static_cast<GMfloat>(i - 3) / (ForsythCacheSize - 3), 1.5f);
+			}
+
+			valence[0] = 0;
+			for (GMint32 i = 1; i <= ForsythMaxValence; ++i)
+			{
+				// 优先处理剩余三角形少的顶点，避免留下孤立的三角形
+				valence[i] = 2.f / std::sqrt(static_cast<GMfloat>(i));
+			}
+		}
+
+		GMfloat score(GMint32 cachePosition, GMuint32 remaining) const
+		{
+			if (remaining == 0)
+				return -1;
+
+			GMfloat s = cachePosition < 0 ? 0 : cache[cachePosition];
+			return s + valence[std::min<GMuint32>(remaining, ForsythMaxValence)];
+		}
+	};
+
+	struct Cluster
+	{
+		GMsize_t begin;
+		GMsize_t end;
+		GMfloat key;
+	};
+
+	// 平面的二次误差，保存对称矩阵的上三角、一次项、常数项和面积权重
+	struct Quadric
+	{
+		double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+		double b0 = 0, b1 = 0, b2 = 0, c = 0, w = 0;
+
+		void addPlane(double nx, double ny, double nz, double d, double weight)
+		{
+			a00 += weight * nx * nx; a11 += weight * ny * ny; a22 += weight * nz * nz;
+			a01 += weight * nx * ny; a02 += weight * nx * nz; a12 += weight * ny * nz;
+			b0 += weight * nx * d; b1 += weight * ny * d; b2 += weight * nz * d;
+			c += weight * d * d;
+			w += weight;
+		}
+
+		Quadric& operator+=(const Quadric& q)
+		{
+			a00 += q.a00; a11 += q.a11; a22 += q.a22;
+			a01 += q.a01; a02 += q.a02; a12 += q.a12;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2;
+			c += q.c;
+			w += q.w;
+			return *this;
+		}
+
+		// 点到各个平面的距离平方和
+		double evaluate(const Array<GMfloat, 3>& p) const
+		{
+			const double x = p[0], y = p[1], z = p[2];
+			double r = a00 * x * x + a11 * y * y + a22 * z * z
+				+ 2 * (a01 * x * y + a02 * x * z + a12 * y * z)
+				+ 2 * (b0 * x + b1 * y + b2 * z)
+				+ c;
+			return r > 0 ? r : 0;
+		}
+	};
+
+	struct Collapse
+	{
+		GMuint32 from;
+		GMuint32 to;
+		double error;
+	};
+
+	inline GMVec3 toVec3(const Array<GMfloat, 3>& p)
+	{
+		return GMVec3(p[0], p[1], p[2]);
+	}
+
+	// 找到位置相同的顶点，返回每个顶点对应的第一个同位置顶点
+	Vector<GMuint32> weldPositions(const GMVertices& vertices)
+	{
+		GMsize_t capacity = 1;
+		while (capacity < vertices.size() * 2)
+			capacity <<= 1;
+		Vector<GMuint32> table(capacity, InvalidIndex);
+		Vector<GMuint32> result(vertices.size());
+		for (GMsize_t i = 0; i < vertices.size(); ++i)
+		{
+			const auto& p = vertices[i].positions;
+			GMuint32 bits[3];
+			memcpy(bits, p.data(), sizeof(bits));
+			GMuint32 h = (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+			h ^= h >> 15;
+			h *= 0x2c1b3c6du;
+
+			GMsize_t slot = h & (capacity - 1);
+			while (table[slot] != InvalidIndex && memcmp(vertices[table[slot]].positions.data(), p.data(), sizeof(bits)) != 0)
+			{
+				slot = (slot + 1) & (capacity - 1);
+			}
+
+			if (table[slot] == InvalidIndex)
+				table[slot] = gm_sizet_to_uint(i);
+			result[i] = table[slot];
+		}
+		return result;
+	}
+}
+
+bool GMMeshOptimizer::optimize(GMModel* model, const GMMeshOptimizeSettings& settings, OUT GMMeshOptimizeReport* report)
+{
+	if (!model || !model->isNeedTransfer() || model->getPrimitiveTopologyMode() != GMTopologyMode::Triangles)
+		return false;
+
+	// 重排顶点会使已经生成的LOD索引失效
+	if (!model->getLods().levels.empty())
+		return false;
+
+	const bool indexed = model->getDrawMode() == GMModelDrawMode::Index;
+	if (!indexed && !settings.deduplicateVertices)
+		return false;
+
+	GMMeshOptimizeReport modelReport;
+	for (auto& part : model->getParts())
+	{
+		GMVertices vertices;
+		GMIndices indices;
+		part->swap(vertices);
+		part->swap(indices);
+
+		if (!indexed)
+		{
+			// 非索引模型按照顶点顺序组成三角形，切线空间之后会由着色器计算
+			indices.resize(vertices.size() - vertices.size() % 3);
+			std::iota(indices.begin(), indices.end(), 0);
+		}
+		else
+		{
+			indices.resize(indices.size() - indices.size() % 3);
+		}
+
+		modelReport.verticesBefore += vertices.size();
+		modelReport.triangles += indices.size() / 3;
+		modelReport.cacheMissesBefore += countCacheMisses(indices, vertices.size(), settings.cacheSize);
+
+		if (settings.deduplicateVertices)
+			deduplicateVertices(vertices, indices);
+
+		if (settings.optimizeVertexCache)
+			optimizeVertexCache(indices, vertices.size());
+
+		if (settings.optimizeOverdraw)
+			optimizeOverdraw(indices, vertices, settings.cacheSize, settings.overdrawThreshold);
+
+		if (settings.optimizeVertexFetch)
+			optimizeVertexFetch(vertices, indices);
+
+		modelReport.verticesAfter += vertices.size();
+		modelReport.cacheMissesAfter += countCacheMisses(indices, vertices.size(), settings.cacheSize);
+
+		part->swap(vertices);
+		part->swap(indices);
+		if (!indexed)
+			part->invalidateTangentSpace();
+	}
+
+	model->setDrawMode(GMModelDrawMode::Index);
+	if (report)
+		*report += modelReport;
+	return true;
+}
+
+void GMMeshOptimizer::optimize(GMScene* scene, const GMMeshOptimizeSettings& settings, OUT GMMeshOptimizeReport* report)
+{
+	for (auto& asset : scene->getModels())
+	{
+		optimize(asset.getModel(), settings, report);
+	}
+}
+
+GMsize_t GMMeshOptimizer::countCacheMisses(const GMIndices& indices, GMsize_t vertexCount, GMuint32 cacheSize)
+{
+	Vector<GMuint32> timestamps(vertexCount, 0);
+	GMuint32 timestamp = cacheSize + 1;
+	GMsize_t misses = 0;
+	for (GMsize_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		misses += updateCache(indices[i], indices[i + 1], indices[i + 2], cacheSize, timestamps.data(), timestamp);
+	}
+	return misses;
+}
+
+void GMMeshOptimizer::deduplicateVertices(REF GMVertices& vertices, REF GMIndices& indices)
+{
+	// 开放寻址的哈希表，保存的是合并后顶点的序号
+	GMsize_t capacity = 1;
+	while (capacity < vertices.size() * 2)
+		capacity <<= 1;
+	Vector<GMuint32> table(capacity, InvalidIndex);
+
+	GMVertices uniqueVertices;
+	uniqueVertices.reserve(vertices.size());
+	Vector<GMuint32> remap(vertices.size(), InvalidIndex);
+	for (GMsize_t i = 0; i < vertices.size(); ++i)
+	{
+		const GMVertex& vertex = vertices[i];
+		GMsize_t slot = hashVertex(vertex) & (capacity - 1);
+		while (table[slot] != InvalidIndex && memcmp(&uniqueVertices[table[slot]], &vertex, sizeof(GMVertex)) != 0)
+		{
+			slot = (slot + 1) & (capacity - 1);
+		}
+
+		if (table[slot] == InvalidIndex)
+		{
+			table[slot] = gm_sizet_to_uint(uniqueVertices.size());
+			uniqueVertices.push_back(vertex);
+		}
+		remap[i] = table[slot];
+	}
+
+	for (auto& index : indices)
+	{
+		GM_ASSERT(index < remap.size());
+		index = remap[index];
+	}
+	vertices.swap(uniqueVertices);
+}
+
+void GMMeshOptimizer::optimizeVertexCache(REF GMIndices& indices, GMsize_t vertexCount)
+{
+	static const ForsythScores scores;
+	const GMsize_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	// 每个顶点相邻的三角形，已经输出的三角形会被移动到列表末尾
+	Vector<GMuint32> remaining(vertexCount, 0);
+	for (GMuint32 index : indices)
+	{
+		++remaining[index];
+	}
+
+	Vector<GMuint32> adjacencyOffsets(vertexCount + 1, 0);
+	for (GMsize_t v = 0; v < vertexCount; ++v)
+	{
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+	}
+
+	Vector<GMuint32> adjacency(indices.size());
+	{
+		Vector<GMuint32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (GMsize_t t = 0; t < triangleCount; ++t)
+		{
+			for (GMsize_t k = 0; k < 3; ++k)
+			{
+				adjacency[fill[indices[t * 3 + k]]++] = gm_sizet_to_uint(t);
+			}
+		}
+	}
+
+	Vector<GMint32> cachePositions(vertexCount, -1);
+	Vector<GMfloat> vertexScores(vertexCount);
+	for (GMsize_t v = 0; v < vertexCount; ++v)
+	{
+		vertexScores[v] = scores.score(-1, remaining[v]);
+	}
+
+	Vector<GMfloat> triangleScores(triangleCount);
+	Vector<bool> emitted(triangleCount, false);
+	for (GMsize_t t = 0; t < triangleCount; ++t)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+	}
+
+	GMIndices result;
+	result.reserve(indices.size());
+
+	// LRU缓存，多出3个位置用来保存刚被挤出的顶点，以便更新它们的评分
+	GMuint32 cache[ForsythCacheSize + 3];
+	GMuint32 newCache[ForsythCacheSize + 3];
+	GMsize_t cacheCount = 0;
+
+	GMsize_t best = 0;
+	GMsize_t cursor = 0;
+	for (GMsize_t i = 1; i < triangleCount; ++i)
+	{
+		if (triangleScores[i] > triangleScores[best])
+			best = i;
+	}
+
+	while (best != InvalidIndex)
+	{
+		const GMuint32 a = indices[best * 3], b = indices[best * 3 + 1], c = indices[best * 3 + 2];
+		result.push_back(a);
+		result.push_back(b);
+		result.push_back(c);
+		emitted[best] = true;
+
+		// 从三个顶点的相邻列表中删除此三角形
+		for (GMuint32 v : { a, b, c })
+		{
+			GMuint32* begin = adjacency.data() + adjacencyOffsets[v];
+			GMuint32* end = begin + remaining[v];
+			GMuint32* found = std::find(begin, end, static_cast<GMuint32>(best));
+			GM_ASSERT(found != end);
+			std::swap(*found, *(end - 1));
+			--remaining[v];
+		}
+
+		// 三个顶点放到缓存最前面
+		GMsize_t newCount = 0;
+		newCache[newCount++] = a;
+		newCache[newCount++] = b;
+		newCache[newCount++] = c;
+		for (GMsize_t j = 0; j < cacheCount; ++j)
+		{
+			GMuint32 v = cache[j];
+			if (v != a && v != b && v != c)
+				newCache[newCount++] = v;
+		}
+
+		// 更新缓存中顶点的评分，以及和它们相邻的三角形的评分
+		for (GMsize_t j = 0; j < newCount; ++j)
+		{
+			GMuint32 v = newCache[j];
+			GMint32 position = j < ForsythCacheSize ? static_cast<GMint32>(j) : -1;
+			cachePositions[v] = position;
+
+			GMfloat score = scores.score(position, remaining[v]);
+			GMfloat delta = score - vertexScores[v];
+			vertexScores[v] = score;
+
+			const GMuint32* begin = adjacency.data() + adjacencyOffsets[v];
+			for (GMuint32 k = 0; k < remaining[v]; ++k)
+			{
+				triangleScores[begin[k]] += delta;
+			}
+		}
+
+		// 所有评分更新完成之后再选择评分最高的三角形，否则一个三角形可能在它的其它顶点更新之前就被比较
+		best = InvalidIndex;
+		GMfloat bestScore = -1;
+		for (GMsize_t j = 0; j < newCount; ++j)
+		{
+			GMuint32 v = newCache[j];
+			const GMuint32* begin = adjacency.data() + adjacencyOffsets[v];
+			for (GMuint32 k = 0; k < remaining[v]; ++k)
+			{
+				GMuint32 t = begin[k];
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					best = t;
+				}
+			}
+		}
+
+		cacheCount = std::min<GMsize_t>(newCount, ForsythCacheSize);
+		memcpy(cache, newCache, cacheCount * sizeof(GMuint32));
+
+		// 缓存中的顶点已经没有剩余的三角形，从还没有输出的三角形中任意选择一个
+		if (best == InvalidIndex)
+		{
+			while (cursor < triangleCount && emitted[cursor])
+				++cursor;
+			if (cursor < triangleCount)
+				best = cursor;
+		}
+	}
+
+	indices.swap(result);
+}
+
+void GMMeshOptimizer::optimizeOverdraw(REF GMIndices& indices, const GMVertices& vertices, GMuint32 cacheSize, GMfloat threshold)
+{
+	const GMsize_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	Vector<GMuint32> timestamps(vertices.size(), 0);
+	GMuint32 timestamp = cacheSize + 1;
+
+	// 三个顶点都未命中的三角形通常是一块新区域的开始，以此划分硬边界
+	Vector<GMsize_t> hardBoundaries;
+	for (GMsize_t t = 0; t < triangleCount; ++t)
+	{
+		GMuint32 misses = updateCache(indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2], cacheSize, timestamps.data(), timestamp);
+		if (t == 0 || misses == 3)
+			hardBoundaries.push_back(t);
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// 在每个硬边界内，ACMR达到整体的threshold倍时就可以切分出一个簇
+	Vector<Cluster> clusters;
+	for (GMsize_t h = 0; h + 1 < hardBoundaries.size(); ++h)
+	{
+		const GMsize_t begin = hardBoundaries[h], end = hardBoundaries[h + 1];
+
+		timestamp += cacheSize + 1;
+		GMsize_t clusterMisses = 0;
+		for (GMsize_t t = begin; t < end; ++t)
+		{
+			clusterMisses += updateCache(indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2], cacheSize, timestamps.data(), timestamp);
+		}
+		const GMfloat clusterThreshold = threshold * static_cast<GMfloat>(clusterMisses) / (end - begin);
+
+		timestamp += cacheSize + 1;
+		GMsize_t start = begin, runningMisses = 0;
+		for (GMsize_t t = begin; t < end; ++t)
+		{
+			runningMisses += updateCache(indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2], cacheSize, timestamps.data(), timestamp);
+			if (static_cast<GMfloat>(runningMisses) / (t - start + 1) <= clusterThreshold)
+			{
+				clusters.push_back({ start, t + 1, 0 });
+				start = t + 1;
+				runningMisses = 0;
+				timestamp += cacheSize + 1;
+			}
+		}
+
+		// 最后一段没有达到目标的三角形并入上一个簇
+		if (start < end)
+		{
+			if (!clusters.empty() && clusters.back().end == start && clusters.back().begin >= begin)
+				clusters.back().end = end;
+			else
+				clusters.push_back({ start, end, 0 });
+		}
+	}
+
+	if (clusters.size() <= 1)
+		return;
+
+	// 簇的中心相对于网格中心越朝外，越应该先绘制
+	auto position = [&](GMuint32 index) {
+		const auto& p = vertices[index].positions;
+		return GMVec3(p[0], p[1], p[2]);
+	};
+
+	GMVec3 meshCenter = Zero<GMVec3>();
+	GMfloat meshArea = 0;
+	Vector<GMVec3> clusterCenters(clusters.size());
+	Vector<GMVec3> clusterNormals(clusters.size());
+	for (GMsize_t i = 0; i < clusters.size(); ++i)
+	{
+		GMVec3 center = Zero<GMVec3>(), normal = Zero<GMVec3>();
+		GMfloat area = 0;
+		for (GMsize_t t = clusters[i].begin; t < clusters[i].end; ++t)
+		{
+			GMVec3 p0 = position(indices[t * 3]), p1 = position(indices[t * 3 + 1]), p2 = position(indices[t * 3 + 2]);
+			GMVec3 n = Cross(p1 - p0, p2 - p0);
+			GMfloat triangleArea = Length(n);
+			center += (p0 + p1 + p2) * (triangleArea / 3);
+			normal += n;
+			area += triangleArea;
+		}
+
+		clusterCenters[i] = area > 0 ? center / area : center;
+		clusterNormals[i] = normal;
+		meshCenter += center;
+		meshArea += area;
+	}
+
+	if (meshArea > 0)
+		meshCenter = meshCenter / meshArea;
+
+	for (GMsize_t i = 0; i < clusters.size(); ++i)
+	{
+		GMfloat length = Length(clusterNormals[i]);
+		clusters[i].key = length > 0 ? Dot(clusterCenters[i] - meshCenter, clusterNormals[i] / length) : 0;
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+		return a.key > b.key;
+	});
+
+	GMIndices result;
+	result.reserve(indices.size());
+	for (const auto& cluster : clusters)
+	{
+		result.insert(result.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+	}
+	indices.swap(result);
+}
+
+void GMMeshOptimizer::simplify(
+	const GMVertices& vertices,
+	const GMIndices& indices,
+	GMsize_t targetIndexCount,
+	GMfloat targetError,
+	OUT GMIndices& result,
+	OUT GMfloat* resultError
+)
+{
+	const GMsize_t vertexCount = vertices.size();
+	result.assign(indices.begin(), indices.begin() + (indices.size() - indices.size() % 3));
+	if (resultError)
+		*resultError = 0;
+
+	// 位置相同而属性不同的顶点（接缝），以及开放边界上的顶点都不能移动
+	Vector<GMuint32> positionIds = weldPositions(vertices);
+	Vector<GMuint32> wedges(vertexCount, 0);
+	for (GMsize_t v = 0; v < vertexCount; ++v)
+	{
+		++wedges[positionIds[v]];
+	}
+
+	Vector<bool> locked(vertexCount, false);
+	{
+		HashMap<GMuint64, GMuint32> edges;
+		auto edgeKey = [](GMuint32 a, GMuint32 b) {
+			return (static_cast<GMuint64>(a) << 32) | b;
+		};
+
+		for (GMsize_t i = 0; i < result.size(); i += 3)
+		{
+			for (GMsize_t k = 0; k < 3; ++k)
+			{
+				++edges[edgeKey(positionIds[result[i + k]], positionIds[result[i + (k + 1) % 3]])];
+			}
+		}
+
+		Vector<bool> lockedPositions(vertexCount, false);
+		for (const auto& edge : edges)
+		{
+			GMuint32 a = static_cast<GMuint32>(edge.first >> 32), b = static_cast<GMuint32>(edge.first);
+			if (edges.find(edgeKey(b, a)) == edges.end())
+				lockedPositions[a] = lockedPositions[b] = true;
+		}
+
+		for (GMsize_t v = 0; v < vertexCount; ++v)
+		{
+			locked[v] = lockedPositions[positionIds[v]] || wedges[positionIds[v]] > 1;
+		}
+	}
+
+	Vector<Quadric> quadrics(vertexCount);
+	for (GMsize_t i = 0; i < result.size(); i += 3)
+	{
+		GMVec3 p0 = toVec3(vertices[result[i]].positions);
+		GMVec3 n = Cross(toVec3(vertices[result[i + 1]].positions) - p0, toVec3(vertices[result[i + 2]].positions) - p0);
+		GMfloat length = Length(n);
+		if (length <= 0)
+			continue;
+
+		n = n / length;
+		const double d = -Dot(n, p0);
+		for (GMsize_t k = 0; k < 3; ++k)
+		{
+			quadrics[result[i + k]].addPlane(n.getX(), n.getY(), n.getZ(), d, length * .5);
+		}
+	}
+
+	auto collapseError = [&](GMuint32 from, GMuint32 to) {
+		Quadric q = quadrics[from];
+		q += quadrics[to];
+		return q.w > 0 ? q.evaluate(vertices[to].positions) / q.w : 0;
+	};
+
+	// 折叠后三角形的法线不能翻转，也不能偏转太多，否则多轮折叠后狭长的三角形会逐渐翻转
+	auto flips = [&](const GMuint32* triangles, GMuint32 count, GMuint32 from, GMuint32 to) {
+		for (GMuint32 j = 0; j < count; ++j)
+		{
+			const GMuint32* t = &result[triangles[j] * 3];
+			if (t[0] == to || t[1] == to || t[2] == to)
+				continue;
+
+			GMVec3 before[3], after[3];
+			for (GMsize_t k = 0; k < 3; ++k)
+			{
+				before[k] = toVec3(vertices[t[k]].positions);
+				after[k] = t[k] == from ? toVec3(vertices[to].positions) : before[k];
+			}
+
+			GMVec3 n0 = Cross(before[1] - before[0], before[2] - before[0]);
+			GMVec3 n1 = Cross(after[1] - after[0], after[2] - after[0]);
+			if (Dot(n0, n1) <= .25f * Length(n0) * Length(n1))
+				return true;
+		}
+		return false;
+	};
+
+	const double errorLimit = static_cast<double>(targetError) * targetError;
+	double maxError = 0;
+	Vector<GMuint32> remap(vertexCount);
+	Vector<bool> touched(vertexCount);
+	Vector<GMuint32> adjacencyOffsets(vertexCount + 1);
+	Vector<GMuint32> adjacency;
+	Vector<Collapse> collapses;
+	while (result.size() > targetIndexCount)
+	{
+		const GMsize_t triangleCount = result.size() / 3;
+
+		// 每个顶点相邻的三角形
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (GMuint32 index : result)
+		{
+			++adjacencyOffsets[index + 1];
+		}
+		for (GMsize_t v = 0; v < vertexCount; ++v)
+		{
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		}
+		adjacency.resize(result.size());
+		{
+			Vector<GMuint32> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (GMsize_t i = 0; i < result.size(); ++i)
+			{
+				adjacency[fill[result[i]]++] = gm_sizet_to_uint(i / 3);
+			}
+		}
+
+		collapses.clear();
+		for (GMsize_t i = 0; i < result.size(); i += 3)
+		{
+			for (GMsize_t k = 0; k < 3; ++k)
+			{
+				GMuint32 a = result[i + k], b = result[i + (k + 1) % 3];
+				if (!locked[a])
+					collapses.push_back({ a, b, collapseError(a, b) });
+				if (!locked[b])
+					collapses.push_back({ b, a, collapseError(b, a) });
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+			return a.error < b.error;
+		});
+
+		// 每一轮只折叠互不相邻的边，每次折叠大约删除两个三角形
+		const GMsize_t trianglesToRemove = (result.size() - targetIndexCount) / 3 + 1;
+		GMsize_t removed = 0, collapsed = 0;
+		std::iota(remap.begin(), remap.end(), 0);
+		std::fill(touched.begin(), touched.end(), false);
+		for (const auto& collapse : collapses)
+		{
+			if (collapse.error > errorLimit || removed >= trianglesToRemove)
+				break;
+
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			const GMuint32* triangles = adjacency.data() + adjacencyOffsets[collapse.from];
+			const GMuint32 count = adjacencyOffsets[collapse.from + 1] - adjacencyOffsets[collapse.from];
+			if (flips(triangles, count, collapse.from, collapse.to))
+				continue;
+
+			for (GMuint32 j = 0; j < count; ++j)
+			{
+				const GMuint32* t = &result[triangles[j] * 3];
+				touched[t[0]] = touched[t[1]] = touched[t[2]] = true;
+				if (t[0] == collapse.to || t[1] == collapse.to || t[2] == collapse.to)
+					++removed;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to] += quadrics[collapse.from];
+			maxError = std::max(maxError, collapse.error);
+			++collapsed;
+		}
+
+		if (collapsed == 0)
+			break;
+
+		GMsize_t write = 0;
+		for (GMsize_t t = 0; t < triangleCount; ++t)
+		{
+			GMuint32 a = remap[result[t * 3]], b = remap[result[t * 3 + 1]], c = remap[result[t * 3 + 2]];
+			if (a != b && b != c && a != c)
+			{
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+		}
+		result.resize(write);
+	}
+
+	if (resultError)
+		*resultError = static_cast<GMfloat>(std::sqrt(maxError));
+}
+
+GMuint32 GMMeshOptimizer::generateLods(GMModel* model, const GMLodSettings& settings)
+{
+	if (!model || !model->isNeedTransfer() || settings.levels == 0)
+		return 0;
+
+	if (model->getDrawMode() != GMModelDrawMode::Index || model->getPrimitiveTopologyMode() != GMTopologyMode::Triangles)
+		return 0;
+
+	GMModelLods& lods = model->getLods();
+	if (!lods.levels.empty())
+		return gm_sizet_to_uint(lods.levels.size());
+
+	GMParts& parts = model->getParts();
+	GMVec3 min(FLT_MAX, FLT_MAX, FLT_MAX), max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	GMsize_t previousCount = 0;
+	for (auto& part : parts)
+	{
+		const GMVertices& vertices = part->vertices();
+		for (GMuint32 index : part->indices())
+		{
+			GMVec3 p = toVec3(vertices[index].positions);
+			min = MinComponent(min, p);
+			max = MaxComponent(max, p);
+		}
+		previousCount += part->indices().size();
+	}
+
+	if (previousCount == 0)
+		return 0;
+
+	// 使用包围盒的中心，半径取到最远顶点的距离
+	GMVec3 center = (min + max) * .5f;
+	GMfloat radius = 0;
+	for (auto& part : parts)
+	{
+		const GMVertices& vertices = part->vertices();
+		for (GMuint32 index : part->indices())
+		{
+			radius = Max(radius, Length(toVec3(vertices[index].positions) - center));
+		}
+	}
+
+	if (radius <= 0)
+		return 0;
+
+	Vector<GMIndices> current(parts.size());
+	for (GMsize_t p = 0; p < parts.size(); ++p)
+	{
+		current[p] = parts[p]->indices();
+	}
+
+	GMModelLods result;
+	result.center = { center.getX(), center.getY(), center.getZ() };
+	result.radius = radius;
+
+	const GMfloat errorLimit = settings.maxError * radius;
+	GMfloat error = 0;
+	Vector<GMIndices> next(parts.size());
+	for (GMuint32 level = 1; level <= settings.levels; ++level)
+	{
+		GMsize_t count = 0;
+		GMfloat levelError = 0;
+		for (GMsize_t p = 0; p < parts.size(); ++p)
+		{
+			const GMVertices& vertices = parts[p]->vertices();
+			GMsize_t target = static_cast<GMsize_t>(current[p].size() / 3 * settings.reduction) * 3;
+			GMfloat partError = 0;
+			simplify(vertices, current[p], target, errorLimit - error, next[p], &partError);
+			optimizeVertexCache(next[p], vertices.size());
+			levelError = Max(levelError, partError);
+			count += next[p].size();
+		}
+
+		// 无法再明显减少三角形时停止
+		if (count == 0 || count > previousCount * 9 / 10)
+			break;
+
+		error += levelError;
+		for (GMsize_t p = 0; p < parts.size(); ++p)
+		{
+			GMIndices lodIndices = next[p];
+			parts[p]->addLod(lodIndices);
+		}
+		current.swap(next);
+		previousCount = count;
+
+		GMModelLodLevel lodLevel;
+		lodLevel.screenSize = settings.screenSize * std::pow(.5f, static_cast<GMfloat>(level - 1));
+		lodLevel.error = error / radius;
+		result.levels.push_back(lodLevel);
+	}
+
+	lods = std::move(result);
+	return gm_sizet_to_uint(lods.levels.size());
+}
+
+void GMMeshOptimizer::generateLods(GMScene* scene, const GMLodSettings& settings)
+{
+	for (auto& asset : scene->getModels())
+	{
+		generateLods(asset.getModel(), settings);
+	}
+}
+
+void GMMeshOptimizer::optimizeVertexFetch(REF GMVertices& vertices, REF GMIndices& indices)
+{
+	Vector<GMuint32> remap(vertices.size(), InvalidIndex);
+	GMVertices orderedVertices;
+	orderedVertices.reserve(vertices.size());
+	for (auto& index : indices)
+	{
+		GM_ASSERT(index < remap.size());
+		if (remap[index] == InvalidIndex)
+		{
+			remap[index] = gm_sizet_to_uint(orderedVertices.size());
+			orderedVertices.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(orderedVertices);
+}
@@ -0,0 +1,137 @@
+﻿#ifndef __GMMESHOPTIMIZER_H__
+#define __GMMESHOPTIMIZER_H__
+#include <gmcommon.h>
+#include <gmmodel.h>
+BEGIN_NS
+
+//! 网格优化的参数。
+struct GMMeshOptimizeSettings
+{
+	bool deduplicateVertices = true; //!< 合并完全相同的顶点，非索引的模型会被转换为索引模型
+	bool optimizeVertexCache = true; //!< 重排三角形，提高变换后顶点缓存的命中率
+	bool optimizeOverdraw = true; //!< 在缓存命中率允许的范围内，将朝外的三角形簇排在前面以减少过度绘制
+	bool optimizeVertexFetch = true; //!< 按照首次使用的顺序重排顶点，并删除没有被引用的顶点
+	GMfloat overdrawThreshold = 1.05f; //!< 优化过度绘制时，三角形簇的ACMR允许增长的比例
+	GMuint32 cacheSize = 16; //!< 统计ACMR时模拟的FIFO顶点缓存大小
+};
+
+//! 生成LOD的参数。
+struct GMLodSettings
+{
+	GMuint32 levels = 3; //!< 最多生成的LOD级别数量，不包括原始网格
+	GMfloat reduction = .5f; //!< 每一级相对于上一级保留的三角形比例
+	GMfloat maxError = .05f; //!< 允许的最大误差，相对于模型包围球半径
+	GMfloat screenSize = .25f; //!< 第一级LOD的屏幕高度占比阈值，之后每一级减半
+};
+
+//! 网格优化前后的统计。
+/*!
+  ACMR（Average Cache Miss Ratio）为平均每个三角形在顶点缓存中未命中的次数，即每个三角形调用顶点着色器的次数，
+  最小值接近0.5，非索引的网格为3。
+*/
+struct GMMeshOptimizeReport
+{
+	GMsize_t verticesBefore = 0; //!< 优化前的顶点数量
+	GMsize_t verticesAfter = 0; //!< 优化后的顶点数量
+	GMsize_t triangles = 0; //!< 三角形数量
+	GMsize_t cacheMissesBefore = 0; //!< 优化前顶点缓存未命中的次数
+	GMsize_t cacheMissesAfter = 0; //!< 优化后顶点缓存未命中的次数
+
+	GMfloat getACMRBefore() const
+	{
+		return triangles ? static_cast<GMfloat>(cacheMissesBefore) / triangles : 0;
+	}
+
+	GMfloat getACMRAfter() const
+	{
+		return triangles ? static_cast<GMfloat>(cacheMissesAfter) / triangles : 0;
+	}
+
+	GMMeshOptimizeReport& operator+=(const GMMeshOptimizeReport& rhs)
+	{
+		verticesBefore += rhs.verticesBefore;
+		verticesAfter += rhs.verticesAfter;
+		triangles += rhs.triangles;
+		cacheMissesBefore += rhs.cacheMissesBefore;
+		cacheMissesAfter += rhs.cacheMissesAfter;
+		return *this;
+	}
+};
+
+//! 网格优化器。
+/*!
+  在模型读取之后、传输到显卡之前，对GMPart的顶点和索引进行优化：合并重复顶点、按照变换后顶点缓存重排三角形（Forsyth算法）、
+  按照过度绘制重排三角形簇，最后按照读取顺序重排顶点。优化不会改变网格的形状。
+  \sa GMModelLoadSettings
+*/
+class GM_EXPORT GMMeshOptimizer
+{
+public:
+	//! 优化一个模型的所有Part。
+	/*!
+	  只处理拓扑模式为GMTopologyMode::Triangles，还没有传输到显卡，并且还没有生成LOD的模型。非索引模型只有在合并顶点时才会被处理，
+	  处理后绘制方式变为GMModelDrawMode::Index，与其它索引模型一样，切线空间由着色器在运行时计算。
+	  \param model 需要优化的模型。
+	  \param settings 优化参数。
+	  \param report 优化前后的统计，统计会被累加到此对象上，可以为空。
+	  \return 模型是否被优化。
+	*/
+	static bool optimize(GMModel* model, const GMMeshOptimizeSettings& settings, OUT GMMeshOptimizeReport* report = nullptr);
+
+	//! 优化一个场景中的所有模型。
+	static void optimize(GMScene* scene, const GMMeshOptimizeSettings& settings, OUT GMMeshOptimizeReport* report = nullptr);
+
+	//! 统计绘制一组三角形时，FIFO顶点缓存未命中的次数。
+	static GMsize_t countCacheMisses(const GMIndices& indices, GMsize_t vertexCount, GMuint32 cacheSize);
+
+	//! 合并完全相同的顶点，并重写索引。
+	static void deduplicateVertices(REF GMVertices& vertices, REF GMIndices& indices);
+
+	//! 重排三角形，使得相邻的三角形尽量共用顶点缓存中的顶点。
+	static void optimizeVertexCache(REF GMIndices& indices, GMsize_t vertexCount);
+
+	//! 将三角形划分为簇，在ACMR增长不超过threshold的前提下，按照簇朝外的程度重排簇。
+	/*!
+	  应该在optimizeVertexCache()之后调用。
+	*/
+	static void optimizeOverdraw(REF GMIndices& indices, const GMVertices& vertices, GMuint32 cacheSize, GMfloat threshold);
+
+	//! 按照索引中首次出现的顺序重排顶点，删除没有被引用的顶点。
+	static void optimizeVertexFetch(REF GMVertices& vertices, REF GMIndices& indices);
+
+	//! 为一个模型生成LOD。
+	/*!
+	  每个级别由上一级别简化得到，各级别共用原始网格的顶点，只生成新的索引，保存在GMPart::lods()中，
+	  级别信息保存在GMModel::getLods()中。当某一级无法再明显减少三角形时停止生成。<BR>
+	  模型需要是还没有传输到显卡的索引模型，非索引模型可以先调用optimize()合并顶点。
+	  \param model 需要生成LOD的模型。
+	  \param settings 生成参数。
+	  \return 生成的级别数量。
+	*/
+	static GMuint32 generateLods(GMModel* model, const GMLodSettings& settings);
+
+	//! 为一个场景中的所有模型生成LOD。
+	static void generateLods(GMScene* scene, const GMLodSettings& settings);
+
+	//! 使用二次误差度量（QEM）的边折叠简化网格。
+	/*!
+	  顶点只会折叠到相邻的顶点上，因此结果仍然引用原来的顶点。边界上的顶点，以及纹理坐标、法线等属性不连续的顶点不会被移动。
+	  \param vertices 网格的顶点。
+	  \param indices 网格的三角形索引。
+	  \param targetIndexCount 目标索引数量，达到后停止简化。
+	  \param targetError 允许的最大误差，为模型空间中到原始表面的距离。
+	  \param result 简化后的索引。
+	  \param resultError 简化产生的最大误差，可以为空。
+	*/
+	static void simplify(
+		const GMVertices& vertices,
+		const GMIndices& indices,
+		GMsize_t targetIndexCount,
+		GMfloat targetError,
+		OUT GMIndices& result,
+		OUT GMfloat* resultError = nullptr
+	);
+};
+
+END_NS
+#endif
@@ -8,6 +8,344 @@
 #define TO_VEC3(i) GMVec3((i)[0], (i)[1], (i)[2])
 #define TO_VEC2(i) GMVec2((i)[0], (i)[1])
 
+namespace
+{
+	const GMsize_t VertexDataTypeCount = (GMsize_t)GMVertexDataType::EndOfVertexDataType;
+
+	const GMfloat* getFloatData(const GMVertex& vertex, GMVertexDataType type)
+	{
+		switch (type)
+		{
+		case GMVertexDataType::Position:
+			return vertex.positions.data();
+		case GMVertexDataType::Normal:
+			return vertex.normals.data();
+		case GMVertexDataType::Texcoord:
+			return vertex.texcoords.data();
+		case GMVertexDataType::Tangent:
+			return vertex.tangents.data();
+		case GMVertexDataType::Bitangent:
+			return vertex.bitangents.data();
+		case GMVertexDataType::Lightmap:
+			return vertex.lightmaps.data();
+		case GMVertexDataType::Color:
+			return vertex.color.data();
+		case GMVertexDataType::Weights:
+			return vertex.weights.data();
+		default:
+			GM_ASSERT(false);
+			return nullptr;
+		}
+	}
+
+	// 每个属性的大小对齐到4字节
+	GMuint32 getAttributeSize(GMVertexDataType type, GMVertexAttributeFormat format)
+	{
+		switch (format)
+		{
+		case GMVertexAttributeFormat::None:
+			return 0;
+		case GMVertexAttributeFormat::Default:
+			return GMVertexLayout::getDimension(type) * 4;
+		case GMVertexAttributeFormat::Half:
+			return (GMVertexLayout::getDimension(type) * 2 + 3) & ~3u;
+		case GMVertexAttributeFormat::Octahedral:
+			return 4;
+		case GMVertexAttributeFormat::UNorm8:
+		case GMVertexAttributeFormat::UInt8:
+			return (GMVertexLayout::getDimension(type) + 3) & ~3u;
+		default:
+			GM_ASSERT(false);
+			return 0;
+		}
+	}
+
+	// 转换为半精度浮点数，舍入到最近
+	GMushort toHalf(GMfloat value)
+	{
+		GMuint32 bits;
+		memcpy(&bits, &value, sizeof(bits));
+		GMushort sign = static_cast<GMushort>((bits >> 16) & 0x8000);
+		GMuint32 floatExponent = (bits >> 23) & 0xff;
+		GMuint32 mantissa = bits & 0x7fffff;
+		if (floatExponent == 0xff)
+			return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+
+		GMint32 exponent = static_cast<GMint32>(floatExponent) - 127 + 15;
+		if (exponent >= 0x1f)
+			return sign | 0x7c00;
+
+		if (exponent <= 0)
+		{
+			// 非规格化数
+			if (exponent < -10)
+				return sign;
+
+			mantissa |= 0x800000;
+			GMuint32 shift = static_cast<GMuint32>(14 - exponent);
+			GMuint32 half = mantissa >> shift;
+			if ((mantissa >> (shift - 1)) & 1)
+				++half;
+			return static_cast<GMushort>(sign | half);
+		}
+
+		// 进位可能进到指数上，结果仍然正确
+		GMuint32 half = (exponent << 10) | (mantissa >> 13);
+		if (mantissa & 0x1000)
+			++half;
+		return static_cast<GMushort>(sign | half);
+	}
+
+	GMshort toSNorm16(GMfloat value)
+	{
+		return static_cast<GMshort>(Round(Clamp(value, -1.f, 1.f) * 32767.f));
+	}
+
+	// 八面体映射：将单位向量投影到八面体|x|+|y|+|z|=1上，再将下半部分翻折到上半部分
+	void encodeOctahedral(const GMfloat* v, OUT GMshort* out)
+	{
+		GMfloat length = Fabs(v[0]) + Fabs(v[1]) + Fabs(v[2]);
+		GMfloat x = length > 0 ? v[0] / length : 0;
+		GMfloat y = length > 0 ? v[1] / length : 0;
+		if (length > 0 && v[2] < 0)
+		{
+			GMfloat fx = (1 - Fabs(y)) * (x >= 0 ? 1 : -1);
+			GMfloat fy = (1 - Fabs(x)) * (y >= 0 ? 1 : -1);
+			x = fx;
+			y = fy;
+		}
+		out[0] = toSNorm16(x);
+		out[1] = toSNorm16(y);
+	}
+}
+
+GMVertexLayout::GMVertexLayout()
+{
+	D(d);
+	d->formats.fill(GMVertexAttributeFormat::Default);
+	updateOffsets();
+}
+
+GMVertexLayout GMVertexLayout::createCompactLayout()
+{
+	GMVertexLayout layout;
+	layout.setFormat(GMVertexDataType::Normal, GMVertexAttributeFormat::Octahedral);
+	layout.setFormat(GMVertexDataType::Texcoord, GMVertexAttributeFormat::Half);
+	layout.setFormat(GMVertexDataType::Tangent, GMVertexAttributeFormat::Octahedral);
+	layout.setFormat(GMVertexDataType::Bitangent, GMVertexAttributeFormat::Octahedral);
+	layout.setFormat(GMVertexDataType::Lightmap, GMVertexAttributeFormat::Half);
+	layout.setFormat(GMVertexDataType::Color, GMVertexAttributeFormat::UNorm8);
+	layout.setFormat(GMVertexDataType::BoneIds, GMVertexAttributeFormat::UInt8);
+	layout.setFormat(GMVertexDataType::Weights, GMVertexAttributeFormat::UNorm8);
+	return layout;
+}
+
+GMuint32 GMVertexLayout::getDimension(GMVertexDataType type)
+{
+	switch (type)
+	{
+	case GMVertexDataType::Position:
+		return GMVertex::PositionDimension;
+	case GMVertexDataType::Normal:
+		return GMVertex::NormalDimension;
+	case GMVertexDataType::Texcoord:
+		return GMVertex::TexcoordDimension;
+	case GMVertexDataType::Tangent:
+		return GMVertex::TangentDimension;
+	case GMVertexDataType::Bitangent:
+		return GMVertex::BitangentDimension;
+	case GMVertexDataType::Lightmap:
+		return GMVertex::LightmapDimension;
+	case GMVertexDataType::Color:
+		return GMVertex::ColorDimension;
+	case GMVertexDataType::BoneIds:
+		return GMVertex::BoneIDsDimension;
+	case GMVertexDataType::Weights:
+		return GMVertex::WeightsDimension;
+	default:
+		GM_ASSERT(false);
+		return 0;
+	}
+}
+
+bool GMVertexLayout::isFormatSupported(GMVertexDataType type, GMVertexAttributeFormat format)
+{
+	switch (format)
+	{
+	case GMVertexAttributeFormat::Default:
+		return true;
+	case GMVertexAttributeFormat::None:
+		return type != GMVertexDataType::Position;
+	case GMVertexAttributeFormat::Half:
+		return type != GMVertexDataType::BoneIds;
+	case GMVertexAttributeFormat::Octahedral:
+		return type == GMVertexDataType::Normal || type == GMVertexDataType::Tangent || type == GMVertexDataType::Bitangent;
+	case GMVertexAttributeFormat::UNorm8:
+		return type == GMVertexDataType::Color || type == GMVertexDataType::Weights;
+	case GMVertexAttributeFormat::UInt8:
+		return type == GMVertexDataType::BoneIds;
+	default:
+		return false;
+	}
+}
+
+void GMVertexLayout::setFormat(GMVertexDataType type, GMVertexAttributeFormat format)
+{
+	D(d);
+	if (!isFormatSupported(type, format))
+	{
+		GM_ASSERT(false);
+		gm_error(gm_dbg_wrap("Vertex attribute format is not supported."));
+		return;
+	}
+
+	d->formats[(GMsize_t)type] = format;
+	updateOffsets();
+}
+
+GMVertexAttributeFormat GMVertexLayout::getFormat(GMVertexDataType type) const
+{
+	D(d);
+	return d->formats[(GMsize_t)type];
+}
+
+GMuint32 GMVertexLayout::getOffset(GMVertexDataType type) const
+{
+	D(d);
+	return d->offsets[(GMsize_t)type];
+}
+
+GMuint32 GMVertexLayout::getStride() const
+{
+	D(d);
+	return d->stride;
+}
+
+bool GMVertexLayout::isDefault() const
+{
+	D(d);
+	for (auto format : d->formats)
+	{
+		if (format != GMVertexAttributeFormat::Default)
+			return false;
+	}
+	return true;
+}
+
+GMint32 GMVertexLayout::getOctahedralMask() const
+{
+	D(d);
+	GMint32 mask = 0;
+	for (GMsize_t i = 0; i < VertexDataTypeCount; ++i)
+	{
+		if (d->formats[i] == GMVertexAttributeFormat::Octahedral)
+			mask |= 1 << i;
+	}
+	return mask;
+}
+
+bool GMVertexLayout::fitVertices(const GMVertex* vertices, GMsize_t count)
+{
+	D(d);
+	if (d->formats[(GMsize_t)GMVertexDataType::BoneIds] != GMVertexAttributeFormat::UInt8)
+		return false;
+
+	for (GMsize_t i = 0; i < count; ++i)
+	{
+		for (auto boneId : vertices[i].boneIds)
+		{
+			if (boneId < 0 || boneId > 255)
+			{
+				setFormat(GMVertexDataType::BoneIds, GMVertexAttributeFormat::Default);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void GMVertexLayout::pack(const GMVertex* vertices, GMsize_t count, OUT GMbyte* buffer) const
+{
+	D(d);
+	GM_STATIC_ASSERT(sizeof(GMVertex) == sizeof(GMfloat) * 28, "GMVertex must be tightly packed.");
+	if (isDefault())
+	{
+		memcpy(buffer, vertices, sizeof(GMVertex) * count);
+		return;
+	}
+
+	for (GMsize_t i = 0; i < count; ++i)
+	{
+		const GMVertex& vertex = vertices[i];
+		GMbyte* out = buffer + i * d->stride;
+		GM_FOREACH_ENUM_CLASS(type, GMVertexDataType::Position, GMVertexDataType::EndOfVertexDataType)
+		{
+			const GMVertexAttributeFormat format = d->formats[(GMsize_t)type];
+			if (format == GMVertexAttributeFormat::None)
+				continue;
+
+			GMbyte* attribute = out + d->offsets[(GMsize_t)type];
+			const GMuint32 dimension = getDimension(type);
+			if (type == GMVertexDataType::BoneIds)
+			{
+				if (format == GMVertexAttributeFormat::UInt8)
+				{
+					for (GMuint32 c = 0; c < dimension; ++c)
+					{
+						GM_ASSERT(vertex.boneIds[c] >= 0 && vertex.boneIds[c] < 256);
+						attribute[c] = static_cast<GMbyte>(vertex.boneIds[c]);
+					}
+				}
+				else
+				{
+					memcpy(attribute, vertex.boneIds.data(), sizeof(vertex.boneIds));
+				}
+				continue;
+			}
+
+			const GMfloat* data = getFloatData(vertex, type);
+			switch (format)
+			{
+			case GMVertexAttributeFormat::Default:
+				memcpy(attribute, data, dimension * sizeof(GMfloat));
+				break;
+			case GMVertexAttributeFormat::Half:
+			{
+				GMushort* half = reinterpret_cast<GMushort*>(attribute);
+				for (GMuint32 c = 0; c < dimension; ++c)
+				{
+					half[c] = toHalf(data[c]);
+				}
+				break;
+			}
+			case GMVertexAttributeFormat::Octahedral:
+				encodeOctahedral(data, reinterpret_cast<GMshort*>(attribute));
+				break;
+			case GMVertexAttributeFormat::UNorm8:
+				for (GMuint32 c = 0; c < dimension; ++c)
+				{
+					attribute[c] = static_cast<GMbyte>(Round(Clamp(data[c], 0.f, 1.f) * 255.f));
+				}
+				break;
+			default:
+				GM_ASSERT(false);
+			}
+		}
+	}
+}
+
+void GMVertexLayout::updateOffsets()
+{
+	D(d);
+	GMuint32 offset = 0;
+	for (GMsize_t i = 0; i < VertexDataTypeCount; ++i)
+	{
+		d->offsets[i] = offset;
+		offset += getAttributeSize((GMVertexDataType)i, d->formats[i]);
+	}
+	d->stride = offset;
+}
+
 GMSceneAsset GMScene::createSceneFromSingleModel(GMModelAsset modelAsset)
 {
 	GMScene* scene = new GMScene();
@@ -57,21 +395,155 @@ void GMModelDataProxy::prepareTangentSpace()
 	}
 }
 
+GMsize_t GMModelDataProxy::getPackedVerticesCount()
+{
+	GMsize_t count = 0;
+	for (auto& part : getModel()->getParts())
+	{
+		count += part->vertices().size();
+	}
+	return count;
+}
+
+GMsize_t GMModelDataProxy::getPackedIndicesCount()
+{
+	GMsize_t count = 0;
+	for (auto& part : getModel()->getParts())
+	{
+		count += part->indices().size();
+	}
+	return count;
+}
+
+GMsize_t GMModelDataProxy::getPackedLodIndicesCount()
+{
+	GMsize_t count = 0;
+	const GMsize_t levelCount = getModel()->getLods().levels.size();
+	for (auto& part : getModel()->getParts())
+	{
+		const Vector<GMIndices>& lods = part->lods();
+		for (GMsize_t level = 0; level < levelCount && level < lods.size(); ++level)
+		{
+			count += lods[level].size();
+		}
+	}
+	return count;
+}
+
 void GMModelDataProxy::packVertices(Vector<GMVertex>& vertices)
 {
 	GMModel* model = getModel();
 	GMParts& meshes = model->getParts();
-	GMuint32 offset = 0;
+	vertices.reserve(vertices.size() + getPackedVerticesCount());
+	for (auto& part : meshes)
+	{
+		const GMVertices& partVertices = part->vertices();
+		vertices.insert(vertices.end(), partVertices.begin(), partVertices.end());
+	}
+}
+
+void GMModelDataProxy::packVertices(const GMVertexLayout& layout, OUT GMbyte* target)
+{
+	GMModel* model = getModel();
+	GMParts& meshes = model->getParts();
 	for (auto& part : meshes)
 	{
-		for (auto& vertex : part->vertices())
+		const GMVertices& partVertices = part->vertices();
+		layout.pack(partVertices.data(), partVertices.size(), target);
+		target += partVertices.size() * layout.getStride();
+	}
+}
+
+GMVertexLayout GMModelDataProxy::prepareVertexLayout()
+{
+	GMModel* model = getModel();
+	GMVertexLayout layout = model->getVertexLayout();
+	if (layout.isDefault())
+		return layout;
+
+	// 省略着色程序不读取的属性。自定义着色程序读取哪些属性是未知的，因此不省略任何属性
+	auto remove = [&layout](GMVertexDataType type) {
+		layout.setFormat(type, GMVertexAttributeFormat::None);
+	};
+
+	const bool customShader = model->getType() == GMModelType::Custom || model->getTechniqueId() != 0;
+	switch (customShader ? GMModelType::Custom : model->getType())
+	{
+	case GMModelType::Particle:
+		// 粒子的顶点着色器从光照贴图坐标中读取粒子的大小和角度
+		remove(GMVertexDataType::Normal);
+		remove(GMVertexDataType::Tangent);
+		remove(GMVertexDataType::Bitangent);
+		remove(GMVertexDataType::BoneIds);
+		remove(GMVertexDataType::Weights);
+		break;
+	case GMModelType::Model2D:
+	case GMModelType::Text:
+		remove(GMVertexDataType::Normal);
+		remove(GMVertexDataType::Tangent);
+		remove(GMVertexDataType::Bitangent);
+		remove(GMVertexDataType::Lightmap);
+		remove(GMVertexDataType::BoneIds);
+		remove(GMVertexDataType::Weights);
+		break;
+	case GMModelType::CubeMap:
+		GM_FOREACH_ENUM_CLASS(type, GMVertexDataType::Normal, GMVertexDataType::EndOfVertexDataType)
+		{
+			remove(type);
+		}
+		break;
+	case GMModelType::Model3D:
+		if (!model->getSkeleton())
+		{
+			remove(GMVertexDataType::BoneIds);
+			remove(GMVertexDataType::Weights);
+		}
+		break;
+	default:
+		break;
+	}
+
+	for (auto& part : model->getParts())
+	{
+		const GMVertices& partVertices = part->vertices();
+		layout.fitVertices(partVertices.data(), partVertices.size());
+	}
+
+	// 八面体映射不能表示零向量，而零向量的切线表示需要着色器在运行时计算切线空间
+	for (auto type : { GMVertexDataType::Tangent, GMVertexDataType::Bitangent })
+	{
+		if (layout.getFormat(type) != GMVertexAttributeFormat::Octahedral)
+			continue;
+
+		GMsize_t zeroCount = 0, vertexCount = 0;
+		for (auto& part : model->getParts())
 		{
-			vertices.push_back(vertex);
+			for (const auto& vertex : part->vertices())
+			{
+				const auto& v = type == GMVertexDataType::Tangent ? vertex.tangents : vertex.bitangents;
+				if (v[0] == 0 && v[1] == 0 && v[2] == 0)
+					++zeroCount;
+			}
+			vertexCount += part->vertices().size();
 		}
+
+		if (zeroCount == vertexCount && !customShader)
+			remove(type);
+		else if (zeroCount > 0)
+			layout.setFormat(type, GMVertexAttributeFormat::Half);
 	}
+
+	return layout;
 }
 
 void GMModelDataProxy::packIndices(Vector<GMuint32>& indices)
+{
+	GMsize_t first = indices.size();
+	indices.resize(first + getPackedIndicesCount() + getPackedLodIndicesCount());
+	packIndices(indices.data() + first);
+}
+
+void GMModelDataProxy::packIndices(OUT GMuint32* target)
 {
 	GMModel* model = getModel();
 	GMParts& meshes = model->getParts();
@@ -80,12 +552,46 @@ void GMModelDataProxy::packIndices(Vector<GMuint32>& indices)
 	{
 		for (GMuint32 index : part->indices())
 		{
-			indices.push_back(index + offset);
+			*target++ = index + offset;
 		}
 
 		// 每个part按照自己的坐标排序，因此每个part都应该在总缓存里面加上偏移
 		offset += gm_sizet_to_uint(part->vertices().size());
 	}
+
+	// 每个LOD级别的索引连续存放，绘制时只需要改变索引范围
+	GMsize_t position = getPackedIndicesCount();
+	auto& levels = model->getLods().levels;
+	for (GMsize_t level = 0; level < levels.size(); ++level)
+	{
+		levels[level].indexOffset = position;
+		offset = 0;
+		for (auto& part : meshes)
+		{
+			if (level < part->lods().size())
+			{
+				for (GMuint32 index : part->lods()[level])
+				{
+					*target++ = index + offset;
+				}
+				position += part->lods()[level].size();
+			}
+			offset += gm_sizet_to_uint(part->vertices().size());
+		}
+		levels[level].indexCount = position - levels[level].indexOffset;
+	}
+}
+
+void GMModelDataProxy::releasePartsData()
+{
+	GMModel* model = getModel();
+	if (model->getCPUDataPolicy() == GMModelCPUDataPolicy::Keep)
+		return;
+
+	for (auto& part : model->getParts())
+	{
+		part->clear();
+	}
 }
 
 void GMModelDataProxy::prepareParentModel()
@@ -175,8 +681,10 @@ GMModelBuffer::GMModelBuffer()
 	D(d);
 	d->ref = 1;
 	// 创建一个空的proxy，用于dispose
-	// 它本身不会包含任何数据
-	GM.getFactory()->createModelDataProxy(nullptr, nullptr, &d->modelDataProxy);
+	// 它本身不会包含任何数据。没有图形环境时（例如单元测试）不会有需要释放的缓存，因此不创建
+	IFactory* factory = GM.getFactory();
+	if (factory)
+		factory->createModelDataProxy(nullptr, nullptr, &d->modelDataProxy);
 }
 
 GMModelBuffer::~GMModelBuffer()
@@ -188,7 +696,8 @@ GMModelBuffer::~GMModelBuffer()
 void GMModelBuffer::dispose()
 {
 	D(d);
-	d->modelDataProxy->dispose(this);
+	if (d->modelDataProxy)
+		d->modelDataProxy->dispose(this);
 }
 
 GMPart::GMPart(GMModel* parent)
@@ -201,6 +710,7 @@ void GMPart::clear()
 	D(d);
 	GMClearSTLContainer(d->vertices);
 	GMClearSTLContainer(d->indices);
+	GMClearSTLContainer(d->lods);
 }
 
 void GMPart::vertex(const GMVertex& v)
@@ -238,6 +748,13 @@ void GMPart::swap(GMIndices& indices)
 	d->indices.swap(indices);
 }
 
+void GMPart::addLod(GMIndices& indices)
+{
+	D(d);
+	d->lods.emplace_back();
+	d->lods.back().swap(indices);
+}
+
 void GMPart::calculateTangentSpace(GMTopologyMode topologyMode)
 {
 	D(d);
@@ -42,6 +42,109 @@ struct GMVertex
 	Array<GMfloat, WeightsDimension> weights;
 };
 
+// 所有的顶点属性类型
+enum class GMVertexDataType
+{
+	Position = 0,
+	Normal,
+	Texcoord,
+	Tangent,
+	Bitangent,
+	Lightmap,
+	Color,
+	BoneIds,
+	Weights,
+
+	// ---
+	EndOfVertexDataType
+};
+
+#define gmVertexIndex(i) ((GMuint32)i)
+
+//! 顶点属性在显存中的存储格式。
+enum class GMVertexAttributeFormat
+{
+	None, //!< 不存储此属性，着色器读到的是一个常量
+	Default, //!< 与GMVertex相同，即32位浮点数，骨骼索引为32位整数
+	Half, //!< 16位浮点数
+	Octahedral, //!< 单位向量经过八面体映射后存为2个16位有符号归一化整数，只用于法线、切线和副切线，不能表示零向量
+	UNorm8, //!< 8位无符号归一化整数，只用于颜色和骨骼权重，取值范围为[0, 1]
+	UInt8, //!< 8位无符号整数，只用于骨骼索引
+};
+
+GM_PRIVATE_OBJECT_UNALIGNED(GMVertexLayout)
+{
+	Array<GMVertexAttributeFormat, (GMsize_t)GMVertexDataType::EndOfVertexDataType> formats;
+	Array<GMuint32, (GMsize_t)GMVertexDataType::EndOfVertexDataType> offsets;
+	GMuint32 stride = 0;
+};
+
+//! 描述一个模型的顶点在显存中的格式。
+/*!
+  默认的格式与GMVertex完全相同。紧凑的格式可以省略着色器不读取的属性，或者使用半精度浮点数、八面体映射的法线和8位整数
+  来存放属性，以减少显存占用和传输带宽。每个属性的偏移对齐到4字节。<BR>
+  使用非默认格式的模型，通过GMModelDataProxy::getBuffer()得到的缓存也是此格式的。
+  \sa GMModel::setVertexLayout()
+*/
+class GM_EXPORT GMVertexLayout
+{
+	GM_DECLARE_PRIVATE_NGO(GMVertexLayout)
+
+public:
+	GMVertexLayout();
+
+public:
+	//! 创建一个紧凑的格式。
+	/*!
+	  位置使用32位浮点数，法线、切线和副切线使用八面体映射，纹理坐标使用半精度浮点数，颜色和骨骼权重使用8位归一化整数，
+	  骨骼索引使用8位整数。每个顶点占用44字节，GMVertex为112字节。<BR>
+	  模型的骨骼索引超过255时，传输顶点数据时骨骼索引会改用默认格式，见fitVertices()。
+	*/
+	static GMVertexLayout createCompactLayout();
+
+	//! 获取一个属性的分量数。
+	static GMuint32 getDimension(GMVertexDataType type);
+
+	//! 判断一个属性是否可以使用某种格式。
+	static bool isFormatSupported(GMVertexDataType type, GMVertexAttributeFormat format);
+
+public:
+	void setFormat(GMVertexDataType type, GMVertexAttributeFormat format);
+	GMVertexAttributeFormat getFormat(GMVertexDataType type) const;
+
+	//! 获取属性在一个顶点中的字节偏移。
+	GMuint32 getOffset(GMVertexDataType type) const;
+
+	//! 获取一个顶点占用的字节数。
+	GMuint32 getStride() const;
+
+	//! 是否为与GMVertex相同的默认格式。
+	bool isDefault() const;
+
+	//! 获取使用八面体映射的属性的掩码，第i位对应gmVertexIndex(i)。
+	GMint32 getOctahedralMask() const;
+
+	//! 将无法存放给定顶点的属性改为默认格式。
+	/*!
+	  目前只检查骨骼索引：8位整数只能存放0到255的索引，骨骼超过256个的模型需要使用默认格式。
+	  \param vertices 将要转换的顶点。
+	  \param count 顶点的数量。
+	  \return 格式是否被修改。
+	*/
+	bool fitVertices(const GMVertex* vertices, GMsize_t count);
+
+	//! 将顶点转换为此格式。
+	/*!
+	  \param vertices 需要转换的顶点。
+	  \param count 顶点的数量。
+	  \param buffer 转换的结果，长度需要至少为count * getStride()。
+	*/
+	void pack(const GMVertex* vertices, GMsize_t count, OUT GMbyte* buffer) const;
+
+private:
+	void updateOffsets();
+};
+
 typedef Vector<GMPart*> GMParts;
 
 enum class GMModelBufferType
@@ -90,9 +193,30 @@ protected:
 
 protected:
 	void prepareTangentSpace();
+	GMsize_t getPackedVerticesCount();
+	GMsize_t getPackedIndicesCount();
+	GMsize_t getPackedLodIndicesCount();
 	void packVertices(Vector<GMVertex>& vertices);
+
+	//! 将所有Part的顶点按照格式直接写入目标缓存。
+	/*!
+	  \param layout 顶点格式。
+	  \param target 目标缓存，通常是映射后的显存，大小至少为getPackedVerticesCount() * layout.getStride()字节。
+	*/
+	void packVertices(const GMVertexLayout& layout, OUT GMbyte* target);
+	GMVertexLayout prepareVertexLayout();
 	void packIndices(Vector<GMuint32>& indices);
+
+	//! 将所有Part的索引加上Part的偏移后直接写入目标缓存。
+	/*!
+	  原始网格的索引在前，之后依次是各个LOD级别的索引，并在模型的GMModelLods中记录每个级别的范围。
+	  \param target 目标缓存，至少能容纳getPackedIndicesCount() + getPackedLodIndicesCount()个索引。
+	*/
+	void packIndices(OUT GMuint32* target);
 	void prepareParentModel();
+
+	//! 顶点数据传输完成后，根据模型的GMModelCPUDataPolicy决定是否释放Part中的顶点和索引。
+	void releasePartsData();
 };
 
 enum class GMUsageHint
@@ -101,6 +225,13 @@ enum class GMUsageHint
 	DynamicDraw,
 };
 
+//! 顶点数据传输到显卡之后，内存中顶点数据的处理方式。
+enum class GMModelCPUDataPolicy
+{
+	Release, //!< 释放Part中的顶点和索引，这是默认的方式。
+	Keep, //!< 保留Part中的顶点和索引，用于拾取、碰撞或者重新生成数据等需要访问顶点的场合。
+};
+
 class GMPart;
 struct GMModelBufferData
 {
@@ -124,6 +255,7 @@ struct GMModelBufferData
 GM_PRIVATE_OBJECT(GMModelBuffer)
 {
 	GMModelBufferData buffer = { 0 };
+	GMVertexLayout vertexLayout;
 	GMAtomic<GMint32> ref;
 	GMModelDataProxy* modelDataProxy = nullptr;
 };
@@ -149,6 +281,20 @@ class GMModelBuffer : public GMObject
 		return d->buffer;
 	}
 
+	//! 设置缓存中实际的顶点格式。
+	void setVertexLayout(const GMVertexLayout& vertexLayout)
+	{
+		D(d);
+		d->vertexLayout = vertexLayout;
+	}
+
+	//! 获取缓存中实际的顶点格式，它可能比模型设置的格式省略了更多的属性。
+	const GMVertexLayout& getVertexLayout()
+	{
+		D(d);
+		return d->vertexLayout;
+	}
+
 	void addRef()
 	{
 		D(d);
@@ -187,6 +333,27 @@ enum class GMModelDrawMode
 	Index,
 };
 
+//! 模型的一个LOD级别。
+struct GMModelLodLevel
+{
+	GMfloat screenSize = 0; //!< 模型包围球在屏幕上的高度占比小于此值时使用此级别
+	GMfloat error = 0; //!< 简化产生的误差，相对于包围球半径
+	GMsize_t indexOffset = 0; //!< 此级别的索引在索引缓存中的起始位置，传输时计算
+	GMsize_t indexCount = 0; //!< 此级别的索引数量，传输时计算
+};
+
+//! 模型的LOD信息。
+/*!
+  各个LOD级别共用同一份顶点数据，只是索引不同。级别0为原始网格，不在levels中。
+  \sa GMMeshOptimizer::generateLods()
+*/
+struct GMModelLods
+{
+	Vector<GMModelLodLevel> levels; //!< 级别1到级别N，越往后越简单
+	Array<GMfloat, 3> center = { 0 }; //!< 模型空间的包围球中心
+	GMfloat radius = 0; //!< 模型空间的包围球半径
+};
+
 class GMModel;
 GM_PRIVATE_OBJECT(GMModel)
 {
@@ -204,27 +371,12 @@ GM_PRIVATE_OBJECT(GMModel)
 	GMModelAsset parentAsset;
 	GMOwnedPtr<GMSkeleton> skeleton;
 	AlignedVector<GMMat4> boneTransformations;
+	GMVertexLayout vertexLayout;
+	GMModelCPUDataPolicy cpuDataPolicy = GMModelCPUDataPolicy::Release;
+	GMModelLods lods;
+	GMuint32 activeLod = 0;
 };
 
-// 所有的顶点属性类型
-enum class GMVertexDataType
-{
-	Position = 0,
-	Normal,
-	Texcoord,
-	Tangent,
-	Bitangent,
-	Lightmap,
-	Color,
-	BoneIds,
-	Weights,
-
-	// ---
-	EndOfVertexDataType
-};
-
-#define gmVertexIndex(i) ((GMuint32)i)
-
 GM_ALIGNED_16(class) GM_EXPORT GMModel : public IDestroyObject
 {
 	GM_DECLARE_PRIVATE_NGO(GMModel)
@@ -246,6 +398,57 @@ public:
 	GM_DECLARE_PROPERTY(TechniqueId, techniqueId);
 	GM_DECLARE_PROPERTY(BoneTransformations, boneTransformations)
 
+	//! 模型在显存中的顶点格式，需要在顶点数据传输到显卡之前设置。
+	/*!
+	  格式不是默认格式时，传输时还会省略模型的着色程序不读取的属性：例如2D模型的法线，没有骨骼的模型的骨骼索引和权重，
+	  以及没有切线空间的模型的切线。类型为GMModelType::Custom或者设置了TechniqueId的模型使用自定义着色程序，不会省略任何属性。<BR>
+	  目前只有OpenGL支持非默认的格式，DirectX 11总是使用默认格式。
+	  \sa GMVertexLayout
+	*/
+	GM_DECLARE_PROPERTY(VertexLayout, vertexLayout)
+
+	//! 顶点数据传输到显卡之后，是否保留内存中的顶点数据。
+	/*!
+	  默认情况下，传输完成后Part中的顶点和索引会被释放，此时GMPart::vertices()为空。
+	  \sa GMModelCPUDataPolicy
+	*/
+	GM_DECLARE_PROPERTY(CPUDataPolicy, cpuDataPolicy)
+
+	//! 模型的LOD信息，LOD级别的索引保存在每个GMPart中。
+	/*!
+	  \sa GMMeshOptimizer::generateLods(), GMPart::lods()
+	*/
+	GM_DECLARE_PROPERTY(Lods, lods)
+
+	//! 当前绘制的LOD级别，0表示原始网格。
+	/*!
+	  模型可能被多个GMGameObject共用，GMGameObject会在绘制模型前设置级别，绘制后恢复为0。
+	*/
+	GM_DECLARE_PROPERTY(ActiveLod, activeLod)
+
+public:
+	//! 获取当前需要绘制的顶点或者索引的范围。
+	/*!
+	  没有使用LOD时，范围是从0开始的getVerticesCount()个顶点或者索引。
+	  \param offset 第一个顶点或者索引的位置。
+	  \param count 顶点或者索引的数量。
+	*/
+	inline void getDrawRange(OUT GMsize_t& offset, OUT GMsize_t& count) GM_NOEXCEPT
+	{
+		D(d);
+		if (d->activeLod > 0 && d->activeLod <= d->lods.levels.size())
+		{
+			const GMModelLodLevel& level = d->lods.levels[d->activeLod - 1];
+			offset = level.indexOffset;
+			count = level.indexCount;
+		}
+		else
+		{
+			offset = 0;
+			count = d->verticesCount;
+		}
+	}
+
 public:
 	inline void setModelDataProxy(AUTORELEASE GMModelDataProxy* modelDataProxy)
 	{
@@ -402,6 +605,7 @@ GM_PRIVATE_OBJECT(GMPart)
 {
 	GMVertices vertices;
 	GMIndices indices;
+	Vector<GMIndices> lods;
 };
 
 //! 表示模型中的一部分数据。
@@ -433,6 +637,12 @@ public:
 	void swap(GMVertices& vertex);
 	void swap(GMIndices& indices);
 
+	//! 添加一个LOD级别的索引，索引引用的是此Part的顶点。
+	/*!
+	  \param indices 需要添加的索引，调用后其内容被交换到Part中。
+	*/
+	void addLod(GMIndices& indices);
+
 public:
 	const GMVertices& vertices()
 	{
@@ -446,6 +656,12 @@ public:
 		return d->indices;
 	}
 
+	const Vector<GMIndices>& lods()
+	{
+		D(d);
+		return d->lods;
+	}
+
 private:
 	enum
 	{
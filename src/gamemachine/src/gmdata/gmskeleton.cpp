@@ -1,2 +1,819 @@
 ﻿#include "stdafx.h"
-#include <gmskeleton.h>
\ No newline at end of file
+#include <gmskeleton.h>
+#include <cmath>
+#include <algorithm>
+#if GM_SIMD_SSE2
+#	include <emmintrin.h>
+#endif
+
+namespace
+{
+	inline GMsize_t alignedNodeCount(GMsize_t count)
+	{
+		return (count + 3) & ~static_cast<GMsize_t>(3);
+	}
+
+	// 将旋转矩阵转换为四元数，m的每一行为旋转后的基向量
+	void matrixToQuat(const GMfloat (&m)[3][3], OUT GMfloat& x, OUT GMfloat& y, OUT GMfloat& z, OUT GMfloat& w)
+	{
+		GMfloat trace = m[0][0] + m[1][1] + m[2][2];
+		if (trace > 0)
+		{
+			GMfloat s = std::sqrt(trace + 1) * 2;
+			w = s / 4;
+			x = (m[1][2] - m[2][1]) / s;
+			y = (m[2][0] - m[0][2]) / s;
+			z = (m[0][1] - m[1][0]) / s;
+		}
+		else if (m[0][0] > m[1][1] && m[0][0] > m[2][2])
+		{
+			GMfloat s = std::sqrt(1 + m[0][0] - m[1][1] - m[2][2]) * 2;
+			x = s / 4;
+			w = (m[1][2] - m[2][1]) / s;
+			y = (m[0][1] + m[1][0]) / s;
+			z = (m[2][0] + m[0][2]) / s;
+		}
+		else if (m[1][1] > m[2][2])
+		{
+			GMfloat s = std::sqrt(1 + m[1][1] - m[0][0] - m[2][2]) * 2;
+			y = s / 4;
+			w = (m[2][0] - m[0][2]) / s;
+			x = (m[0][1] + m[1][0]) / s;
+			z = (m[1][2] + m[2][1]) / s;
+		}
+		else
+		{
+			GMfloat s = std::sqrt(1 + m[2][2] - m[0][0] - m[1][1]) * 2;
+			z = s / 4;
+			w = (m[0][1] - m[1][0]) / s;
+			x = (m[2][0] + m[0][2]) / s;
+			y = (m[1][2] + m[2][1]) / s;
+		}
+	}
+
+	inline void normalizeQuat(REF GMfloat& x, REF GMfloat& y, REF GMfloat& z, REF GMfloat& w)
+	{
+		GMfloat lengthSq = x * x + y * y + z * z + w * w;
+		GMfloat inv = lengthSq > 0 ? 1.f / std::sqrt(lengthSq) : 0;
+		x *= inv;
+		y *= inv;
+		z *= inv;
+		w *= inv;
+	}
+
+	enum
+	{
+		// 16位的采样序号能够表示的最大采样数量
+		MaxSampleCount = 65536,
+
+		// 删除关键帧时，两个关键帧之间最多的采样数量，用于限制压缩的时间
+		MaxSegmentSamples = 256,
+
+		// 从游标开始向后顺序查找的最大步数，超过之后使用二分查找
+		MaxCursorSteps = 4,
+	};
+
+	typedef Array<GMfloat, 3> VectorValue;
+	typedef Array<GMfloat, 4> QuatValue;
+	typedef Array<GMushort, 3> PackedValue;
+
+	const GMfloat Sqrt2 = 1.41421356237309505f;
+	const GMfloat RotationQuantization = 32767.f;
+	const GMfloat VectorQuantization = 65535.f;
+
+	// 找到原始关键帧中time所在的区间[i, i + 1]
+	template <typename T>
+	GMsize_t findSourceKeyframe(const AlignedVector<GMSkeletonAnimationKeyframe<T>>& frames, GMDuration time, OUT GMfloat& factor)
+	{
+		GM_ASSERT(frames.size() > 1);
+		auto iter = std::upper_bound(frames.begin() + 1, frames.end() - 1, time, [](GMDuration t, const GMSkeletonAnimationKeyframe<T>& frame) {
+			return t < frame.time;
+		});
+		GMsize_t i = (iter - frames.begin()) - 1;
+		GMDuration length = frames[i + 1].time - frames[i].time;
+		factor = length > 0 ? Clamp((time - frames[i].time) / length, 0.f, 1.f) : 0;
+		return i;
+	}
+
+	VectorValue lerpVector(const VectorValue& a, const VectorValue& b, GMfloat t)
+	{
+		return VectorValue { a[0] + (b[0] - a[0]) * t, a[1] + (b[1] - a[1]) * t, a[2] + (b[2] - a[2]) * t };
+	}
+
+	// 沿着最短路径进行球面插值
+	QuatValue slerpQuat(const QuatValue& a, const QuatValue& b, GMfloat t)
+	{
+		double cosTheta = static_cast<double>(a[0]) * b[0] + static_cast<double>(a[1]) * b[1] + static_cast<double>(a[2]) * b[2] + static_cast<double>(a[3]) * b[3];
+		double sign = cosTheta < 0 ? -1 : 1;
+		cosTheta *= sign;
+
+		double s0 = 1 - t, s1 = t;
+		if (cosTheta < .9999)
+		{
+			double theta = std::acos(cosTheta);
+			double sinTheta = std::sin(theta);
+			s0 = std::sin((1 - t) * theta) / sinTheta;
+			s1 = std::sin(t * theta) / sinTheta;
+		}
+		s1 *= sign;
+
+		QuatValue q;
+		for (GMint32 i = 0; i < 4; ++i)
+		{
+			q[i] = static_cast<GMfloat>(a[i] * s0 + b[i] * s1);
+		}
+		normalizeQuat(q[0], q[1], q[2], q[3]);
+		return q;
+	}
+
+	// 两个旋转之间的夹角
+	GMfloat rotationError(const QuatValue& a, const QuatValue& b)
+	{
+		double dot = static_cast<double>(a[0]) * b[0] + static_cast<double>(a[1]) * b[1] + static_cast<double>(a[2]) * b[2] + static_cast<double>(a[3]) * b[3];
+		double sign = dot < 0 ? -1 : 1;
+		double distanceSq = 0;
+		for (GMint32 i = 0; i < 4; ++i)
+		{
+			double diff = a[i] - b[i] * sign;
+			distanceSq += diff * diff;
+		}
+
+		// 单位四元数之间的距离为2sin(θ/4)，θ为旋转的夹角。比直接对点积求反余弦精确
+		return static_cast<GMfloat>(4 * std::asin(std::min(std::sqrt(distanceSq) / 2, 1.0)));
+	}
+
+	GMfloat vectorError(const VectorValue& a, const VectorValue& b)
+	{
+		return Max(Fabs(a[0] - b[0]), Max(Fabs(a[1] - b[1]), Fabs(a[2] - b[2])));
+	}
+
+	// 使用smallest-three的方式将四元数量化为3个16位整数
+	PackedValue packRotation(QuatValue q)
+	{
+		normalizeQuat(q[0], q[1], q[2], q[3]);
+		GMint32 largest = 0;
+		for (GMint32 i = 1; i < 4; ++i)
+		{
+			if (Fabs(q[i]) > Fabs(q[largest]))
+				largest = i;
+		}
+
+		// q与-q表示同一个旋转，使绝对值最大的分量为正，解码时由其它分量求出。其它分量的范围为[-1/√2, 1/√2]
+		GMfloat sign = q[largest] < 0 ? -1.f : 1.f;
+		PackedValue packed;
+		GMint32 k = 0;
+		for (GMint32 i = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+
+			GMfloat v = Clamp(q[i] * sign * Sqrt2 * .5f + .5f, 0.f, 1.f);
+			packed[k++] = static_cast<GMushort>(v * RotationQuantization + .5f);
+		}
+
+		// 最大分量的索引保存在前两个分量的最高位
+		packed[0] |= (largest & 1) << 15;
+		packed[1] |= (largest >> 1) << 15;
+		return packed;
+	}
+
+	QuatValue unpackRotation(const GMushort* packed)
+	{
+		GMint32 largest = (packed[0] >> 15) | ((packed[1] >> 15) << 1);
+		QuatValue q;
+		GMfloat lengthSq = 0;
+		GMint32 k = 0;
+		for (GMint32 i = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+
+			GMfloat v = ((packed[k++] & 0x7fff) / RotationQuantization * 2 - 1) / Sqrt2;
+			q[i] = v;
+			lengthSq += v * v;
+		}
+		q[largest] = std::sqrt(Max(1 - lengthSq, 0.f));
+		return q;
+	}
+
+	// 在通道的取值范围内将平移或者缩放量化为3个16位整数
+	PackedValue packVector(const VectorValue& v, const GMSkeletalCompressedTrack& track)
+	{
+		PackedValue packed;
+		for (GMint32 i = 0; i < 3; ++i)
+		{
+			GMfloat t = track.extent[i] > 0 ? Clamp((v[i] - track.minimum[i]) / track.extent[i], 0.f, 1.f) : 0;
+			packed[i] = static_cast<GMushort>(t * VectorQuantization + .5f);
+		}
+		return packed;
+	}
+
+	VectorValue unpackVector(const GMushort* packed, const GMSkeletalCompressedTrack& track)
+	{
+		VectorValue v;
+		for (GMint32 i = 0; i < 3; ++i)
+		{
+			v[i] = track.minimum[i] + packed[i] / VectorQuantization * track.extent[i];
+		}
+		return v;
+	}
+
+	// 从采样中选出需要保留的关键帧，第一个和最后一个采样总是被保留，所有采样都在误差范围内时只保留第一个。
+	// samples为采样的结果，decoded为量化之后再解码的结果
+	template <typename T, typename Interpolate, typename Error>
+	void selectKeys(const Vector<T>& samples, const Vector<T>& decoded, GMfloat tolerance, Interpolate&& interpolate, Error&& error, OUT Vector<GMsize_t>& keys)
+	{
+		keys.clear();
+		keys.push_back(0);
+
+		auto fits = [&](GMsize_t start, GMsize_t end) {
+			for (GMsize_t i = start + 1; i < end; ++i)
+			{
+				GMfloat t = static_cast<GMfloat>(i - start) / (end - start);
+				if (error(interpolate(decoded[start], decoded[end], t), samples[i]) > tolerance)
+					return false;
+			}
+			return true;
+		};
+
+		bool constant = true;
+		for (const T& sample : samples)
+		{
+			if (error(decoded[0], sample) > tolerance)
+			{
+				constant = false;
+				break;
+			}
+		}
+
+		if (constant)
+			return;
+
+		// 贪心地延长每一段，直到插值的误差超出范围
+		const GMsize_t count = samples.size();
+		GMsize_t start = 0;
+		while (start + 1 < count)
+		{
+			GMsize_t end = start + 1;
+			while (end + 1 < count && end + 1 - start <= MaxSegmentSamples && fits(start, end + 1))
+			{
+				++end;
+			}
+			keys.push_back(end);
+			start = end;
+		}
+	}
+
+	// 保存选出的关键帧，关键帧数量少于采样数量时还需要保存它们的采样序号
+	void storeKeys(const Vector<GMsize_t>& keys, const Vector<PackedValue>& packed, OUT GMSkeletalCompressedTrack& track, REF Vector<GMushort>& data, REF Vector<GMushort>& frames)
+	{
+		track.keyOffset = gm_sizet_to_uint(data.size() / 3);
+		track.keyCount = gm_sizet_to_uint(keys.size());
+		for (auto key : keys)
+		{
+			data.insert(data.end(), packed[key].begin(), packed[key].end());
+		}
+
+		if (keys.size() > 1 && keys.size() < packed.size())
+		{
+			track.frameOffset = gm_sizet_to_uint(frames.size());
+			for (auto key : keys)
+			{
+				frames.push_back(static_cast<GMushort>(key));
+			}
+		}
+	}
+
+	void compressVectors(const AlignedVector<GMSkeletonAnimationKeyframe<GMVec3>>& frames, GMsize_t sampleCount, GMDuration sampleInterval, GMfloat tolerance, OUT GMSkeletalCompressedTrack& track, REF Vector<GMushort>& data, REF Vector<GMushort>& sampleFrames)
+	{
+		if (frames.empty())
+			return;
+
+		Vector<VectorValue> samples(sampleCount);
+		for (GMsize_t i = 0; i < sampleCount; ++i)
+		{
+			GMVec3 value = frames[0].value;
+			if (frames.size() > 1)
+			{
+				GMfloat factor;
+				GMsize_t k = findSourceKeyframe(frames, i * sampleInterval, factor);
+				value = Lerp(frames[k].value, frames[k + 1].value, factor);
+			}
+			samples[i] = VectorValue { value.getX(), value.getY(), value.getZ() };
+		}
+
+		for (GMint32 c = 0; c < 3; ++c)
+		{
+			GMfloat minimum = samples[0][c], maximum = samples[0][c];
+			for (const auto& sample : samples)
+			{
+				minimum = Min(minimum, sample[c]);
+				maximum = Max(maximum, sample[c]);
+			}
+			track.minimum[c] = minimum;
+			track.extent[c] = maximum - minimum;
+		}
+
+		Vector<PackedValue> packed(sampleCount);
+		Vector<VectorValue> decoded(sampleCount);
+		for (GMsize_t i = 0; i < sampleCount; ++i)
+		{
+			packed[i] = packVector(samples[i], track);
+			decoded[i] = unpackVector(packed[i].data(), track);
+		}
+
+		Vector<GMsize_t> keys;
+		selectKeys(samples, decoded, tolerance, lerpVector, vectorError, keys);
+		storeKeys(keys, packed, track, data, sampleFrames);
+	}
+
+	void compressRotations(const AlignedVector<GMSkeletonAnimationKeyframe<GMQuat>>& frames, GMsize_t sampleCount, GMDuration sampleInterval, GMfloat tolerance, OUT GMSkeletalCompressedTrack& track, REF Vector<GMushort>& data, REF Vector<GMushort>& sampleFrames)
+	{
+		if (frames.empty())
+			return;
+
+		auto toValue = [](const GMQuat& q) {
+			return QuatValue { q.getX(), q.getY(), q.getZ(), q.getW() };
+		};
+
+		Vector<QuatValue> samples(sampleCount);
+		for (GMsize_t i = 0; i < sampleCount; ++i)
+		{
+			if (frames.size() > 1)
+			{
+				GMfloat factor;
+				GMsize_t k = findSourceKeyframe(frames, i * sampleInterval, factor);
+				samples[i] = slerpQuat(toValue(frames[k].value), toValue(frames[k + 1].value), factor);
+			}
+			else
+			{
+				samples[i] = toValue(frames[0].value);
+			}
+		}
+
+		Vector<PackedValue> packed(sampleCount);
+		Vector<QuatValue> decoded(sampleCount);
+		for (GMsize_t i = 0; i < sampleCount; ++i)
+		{
+			packed[i] = packRotation(samples[i]);
+			decoded[i] = unpackRotation(packed[i].data());
+		}
+
+		Vector<GMsize_t> keys;
+		selectKeys(samples, decoded, tolerance, slerpQuat, rotationError, keys);
+		storeKeys(keys, packed, track, data, sampleFrames);
+	}
+}
+
+void GMSkeletalPose::resize(GMsize_t nodeCount)
+{
+	D(d);
+	d->nodeCount = nodeCount;
+	d->stride = alignedNodeCount(nodeCount);
+	d->streams.assign(d->stride * StreamCount, 0);
+	std::fill_n(getStream(RotationW), d->stride, 1.f);
+	std::fill_n(getStream(ScalingX), d->stride * 3, 1.f);
+}
+
+void GMSkeletalPose::setTransform(GMsize_t node, const GMMat4& transform)
+{
+	D(d);
+	GM_ASSERT(node < d->nodeCount);
+	// 矩阵的前3行是缩放后的基向量，第4行是平移
+	const GMfloat* m = ValuePointer(transform);
+	GMfloat rotation[3][3];
+	GMfloat scaling[3];
+	for (GMint32 i = 0; i < 3; ++i)
+	{
+		scaling[i] = std::sqrt(m[i * 4] * m[i * 4] + m[i * 4 + 1] * m[i * 4 + 1] + m[i * 4 + 2] * m[i * 4 + 2]);
+		GMfloat inv = scaling[i] > 0 ? 1.f / scaling[i] : 0;
+		for (GMint32 j = 0; j < 3; ++j)
+		{
+			rotation[i][j] = m[i * 4 + j] * inv;
+		}
+	}
+
+	GMfloat x, y, z, w;
+	matrixToQuat(rotation, x, y, z, w);
+	normalizeQuat(x, y, z, w);
+	getStream(RotationX)[node] = x;
+	getStream(RotationY)[node] = y;
+	getStream(RotationZ)[node] = z;
+	getStream(RotationW)[node] = w;
+	getStream(PositionX)[node] = m[12];
+	getStream(PositionY)[node] = m[13];
+	getStream(PositionZ)[node] = m[14];
+	getStream(ScalingX)[node] = scaling[0];
+	getStream(ScalingY)[node] = scaling[1];
+	getStream(ScalingZ)[node] = scaling[2];
+}
+
+void GMSkeletalPose::getTransforms(AlignedVector<GMMat4>& transforms) const
+{
+	D(d);
+	GM_ASSERT(transforms.size() >= d->nodeCount);
+	const GMsize_t count = d->nodeCount;
+	const GMfloat* rx = getStream(RotationX);
+	const GMfloat* ry = getStream(RotationY);
+	const GMfloat* rz = getStream(RotationZ);
+	const GMfloat* rw = getStream(RotationW);
+	const GMfloat* px = getStream(PositionX);
+	const GMfloat* py = getStream(PositionY);
+	const GMfloat* pz = getStream(PositionZ);
+	const GMfloat* sx = getStream(ScalingX);
+	const GMfloat* sy = getStream(ScalingY);
+	const GMfloat* sz = getStream(ScalingZ);
+
+#if GM_SIMD_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 two = _mm_set1_ps(2.f);
+	for (GMsize_t c = 0; c < count; c += 4)
+	{
+		// 旋转矩阵，与QuatToMatrix的结果一致
+		__m128 x = _mm_loadu_ps(rx + c), y = _mm_loadu_ps(ry + c), z = _mm_loadu_ps(rz + c), w = _mm_loadu_ps(rw + c);
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+		// 先缩放，然后旋转，最后平移。每组4个寄存器分别是4个节点矩阵的同一行，转置后每个寄存器是一个节点矩阵的一行
+		__m128 scaleX = _mm_loadu_ps(sx + c);
+		__m128 scaleY = _mm_loadu_ps(sy + c);
+		__m128 scaleZ = _mm_loadu_ps(sz + c);
+		__m128 row0[4] = {
+			_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scaleX),
+			_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scaleX),
+			_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scaleX),
+			zero
+		};
+		__m128 row1[4] = {
+			_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scaleY),
+			_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scaleY),
+			_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scaleY),
+			zero
+		};
+		__m128 row2[4] = {
+			_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scaleZ),
+			_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scaleZ),
+			_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scaleZ),
+			zero
+		};
+		__m128 row3[4] = {
+			_mm_loadu_ps(px + c),
+			_mm_loadu_ps(py + c),
+			_mm_loadu_ps(pz + c),
+			one
+		};
+		_MM_TRANSPOSE4_PS(row0[0], row0[1], row0[2], row0[3]);
+		_MM_TRANSPOSE4_PS(row1[0], row1[1], row1[2], row1[3]);
+		_MM_TRANSPOSE4_PS(row2[0], row2[1], row2[2], row2[3]);
+		_MM_TRANSPOSE4_PS(row3[0], row3[1], row3[2], row3[3]);
+
+		for (GMsize_t lane = 0; lane < 4 && c + lane < count; ++lane)
+		{
+			GMfloat* m = ValuePointer(transforms[c + lane]);
+			_mm_storeu_ps(m, row0[lane]);
+			_mm_storeu_ps(m + 4, row1[lane]);
+			_mm_storeu_ps(m + 8, row2[lane]);
+			_mm_storeu_ps(m + 12, row3[lane]);
+		}
+	}
+#else
+	for (GMsize_t i = 0; i < count; ++i)
+	{
+		GMQuat rotation(rx[i], ry[i], rz[i], rw[i]);
+		transforms[i] = Scale(GMVec3(sx[i], sy[i], sz[i])) * QuatToMatrix(rotation) * Translate(GMVec3(px[i], py[i], pz[i]));
+	}
+#endif
+}
+
+void GMSkeletalPose::blend(const GMSkeletalPose& other, GMfloat weight, const GMfloat* nodeWeights)
+{
+	D(d);
+	GM_ASSERT(other.getNodeCount() == d->nodeCount);
+	const GMsize_t count = d->nodeCount;
+	GMfloat* rx = getStream(RotationX);
+	GMfloat* ry = getStream(RotationY);
+	GMfloat* rz = getStream(RotationZ);
+	GMfloat* rw = getStream(RotationW);
+	const GMfloat* orx = other.getStream(RotationX);
+	const GMfloat* ory = other.getStream(RotationY);
+	const GMfloat* orz = other.getStream(RotationZ);
+	const GMfloat* orw = other.getStream(RotationW);
+	for (GMsize_t i = 0; i < count; ++i)
+	{
+		GMfloat t = nodeWeights ? weight * nodeWeights[i] : weight;
+		GMfloat dot = rx[i] * orx[i] + ry[i] * ory[i] + rz[i] * orz[i] + rw[i] * orw[i];
+		GMfloat s = dot < 0 ? -t : t;
+		GMfloat x = rx[i] * (1 - t) + orx[i] * s;
+		GMfloat y = ry[i] * (1 - t) + ory[i] * s;
+		GMfloat z = rz[i] * (1 - t) + orz[i] * s;
+		GMfloat w = rw[i] * (1 - t) + orw[i] * s;
+		normalizeQuat(x, y, z, w);
+		rx[i] = x;
+		ry[i] = y;
+		rz[i] = z;
+		rw[i] = w;
+	}
+
+	for (GMint32 stream = PositionX; stream < StreamCount; ++stream)
+	{
+		GMfloat* value = getStream(static_cast<Stream>(stream));
+		const GMfloat* target = other.getStream(static_cast<Stream>(stream));
+		for (GMsize_t i = 0; i < count; ++i)
+		{
+			GMfloat t = nodeWeights ? weight * nodeWeights[i] : weight;
+			value[i] += (target[i] - value[i]) * t;
+		}
+	}
+}
+
+void GMSkeletalPose::blendAdditive(const GMSkeletalPose& other, const GMSkeletalPose& reference, GMfloat weight, const GMfloat* nodeWeights)
+{
+	D(d);
+	GM_ASSERT(other.getNodeCount() == d->nodeCount && reference.getNodeCount() == d->nodeCount);
+	const GMsize_t count = d->nodeCount;
+	GMfloat* rx = getStream(RotationX);
+	GMfloat* ry = getStream(RotationY);
+	GMfloat* rz = getStream(RotationZ);
+	GMfloat* rw = getStream(RotationW);
+	const GMfloat* orx = other.getStream(RotationX);
+	const GMfloat* ory = other.getStream(RotationY);
+	const GMfloat* orz = other.getStream(RotationZ);
+	const GMfloat* orw = other.getStream(RotationW);
+	const GMfloat* rrx = reference.getStream(RotationX);
+	const GMfloat* rry = reference.getStream(RotationY);
+	const GMfloat* rrz = reference.getStream(RotationZ);
+	const GMfloat* rrw = reference.getStream(RotationW);
+	for (GMsize_t i = 0; i < count; ++i)
+	{
+		GMfloat t = nodeWeights ? weight * nodeWeights[i] : weight;
+
+		// 变化量 delta = conjugate(reference) * other
+		GMfloat dw = rrw[i] * orw[i] + rrx[i] * orx[i] + rry[i] * ory[i] + rrz[i] * orz[i];
+		GMfloat dx = rrw[i] * orx[i] - rrx[i] * orw[i] - rry[i] * orz[i] + rrz[i] * ory[i];
+		GMfloat dy = rrw[i] * ory[i] + rrx[i] * orz[i] - rry[i] * orw[i] - rrz[i] * orx[i];
+		GMfloat dz = rrw[i] * orz[i] - rrx[i] * ory[i] + rry[i] * orx[i] - rrz[i] * orw[i];
+
+		// 按照权重从单位四元数插值到变化量
+		GMfloat s = dw < 0 ? -t : t;
+		dx *= s;
+		dy *= s;
+		dz *= s;
+		dw = (1 - t) + dw * s;
+		normalizeQuat(dx, dy, dz, dw);
+
+		// 结果 = this * delta
+		GMfloat x = rw[i] * dx + rx[i] * dw + ry[i] * dz - rz[i] * dy;
+		GMfloat y = rw[i] * dy - rx[i] * dz + ry[i] * dw + rz[i] * dx;
+		GMfloat z = rw[i] * dz + rx[i] * dy - ry[i] * dx + rz[i] * dw;
+		GMfloat w = rw[i] * dw - rx[i] * dx - ry[i] * dy - rz[i] * dz;
+		rx[i] = x;
+		ry[i] = y;
+		rz[i] = z;
+		rw[i] = w;
+	}
+
+	for (GMint32 stream = PositionX; stream <= PositionZ; ++stream)
+	{
+		GMfloat* value = getStream(static_cast<Stream>(stream));
+		const GMfloat* target = other.getStream(static_cast<Stream>(stream));
+		const GMfloat* base = reference.getStream(static_cast<Stream>(stream));
+		for (GMsize_t i = 0; i < count; ++i)
+		{
+			GMfloat t = nodeWeights ? weight * nodeWeights[i] : weight;
+			value[i] += (target[i] - base[i]) * t;
+		}
+	}
+
+	for (GMint32 stream = ScalingX; stream <= ScalingZ; ++stream)
+	{
+		GMfloat* value = getStream(static_cast<Stream>(stream));
+		const GMfloat* target = other.getStream(static_cast<Stream>(stream));
+		const GMfloat* base = reference.getStream(static_cast<Stream>(stream));
+		for (GMsize_t i = 0; i < count; ++i)
+		{
+			GMfloat t = nodeWeights ? weight * nodeWeights[i] : weight;
+			value[i] *= 1 + (target[i] / base[i] - 1) * t;
+		}
+	}
+}
+
+namespace
+{
+	GMAtomic<GMint64> s_skeletalDataGeneration(0);
+}
+
+GMint64 GMSkeletalDataGeneration::current() GM_NOEXCEPT
+{
+	return s_skeletalDataGeneration.load(std::memory_order_acquire);
+}
+
+void GMSkeletalDataGeneration::advance() GM_NOEXCEPT
+{
+	s_skeletalDataGeneration.fetch_add(1, std::memory_order_acq_rel);
+}
+
+GMSkeleton::~GMSkeleton()
+{
+	GMSkeletalDataGeneration::advance();
+}
+
+GMSkeletalHierarchy::GMSkeletalHierarchy(const GMSkeletalNode* root)
+{
+	D(d);
+	if (!root)
+		return;
+
+	// 使用栈进行先序遍历，子节点逆序压栈以保持原来的顺序
+	Stack<std::pair<const GMSkeletalNode*, GMint32>> pending;
+	pending.push(std::make_pair(root, -1));
+	while (!pending.empty())
+	{
+		const GMSkeletalNode* node = pending.top().first;
+		GMint32 parent = pending.top().second;
+		pending.pop();
+
+		GMint32 index = gm_sizet_to_int(d->nodes.size());
+		d->nodes.push_back(node);
+		d->parents.push_back(parent);
+		d->transformsToParent.push_back(node->getTransformToParent());
+
+		const auto& children = node->getChildren();
+		for (auto iter = children.rbegin(); iter != children.rend(); ++iter)
+		{
+			pending.push(std::make_pair(*iter, index));
+		}
+	}
+
+	d->bindPose.resize(d->nodes.size());
+	for (GMsize_t i = 0; i < d->nodes.size(); ++i)
+	{
+		d->bindPose.setTransform(i, d->transformsToParent[i]);
+	}
+}
+
+GMSkeletalCompressedAnimation::GMSkeletalCompressedAnimation(const GMSkeletalAnimation& animation, const GMSkeletalCompressionSettings& settings)
+{
+	D(d);
+	// 采样覆盖[0, duration]，两端都有采样
+	if (animation.duration > 0)
+	{
+		GMfloat seconds = animation.frameRate > 0 ? animation.duration / animation.frameRate : animation.duration;
+		GMsize_t intervals = static_cast<GMsize_t>(std::ceil(Max(seconds * settings.sampleRate, 1.f)));
+		intervals = std::min<GMsize_t>(intervals, MaxSampleCount - 1);
+		d->sampleCount = intervals + 1;
+		d->sampleInterval = animation.duration / intervals;
+	}
+	else
+	{
+		d->sampleCount = 1;
+	}
+
+	d->channels.resize(animation.nodes.size());
+	for (GMsize_t i = 0; i < animation.nodes.size(); ++i)
+	{
+		const GMSkeletalAnimationNode& node = animation.nodes[i];
+		GMSkeletalCompressedChannel& channel = d->channels[i];
+		compressVectors(node.positions, d->sampleCount, d->sampleInterval, settings.positionTolerance, channel.positions, d->vectors, d->frames);
+		compressRotations(node.rotations, d->sampleCount, d->sampleInterval, settings.rotationTolerance, channel.rotations, d->rotations, d->frames);
+		compressVectors(node.scalings, d->sampleCount, d->sampleInterval, settings.scalingTolerance, channel.scalings, d->vectors, d->frames);
+	}
+}
+
+void GMSkeletalCompressedAnimation::findKeys(const GMSkeletalCompressedTrack& track, GMDuration animationTime, REF GMsize_t& cursor, OUT GMsize_t& key0, OUT GMsize_t& key1, OUT GMfloat& factor) const
+{
+	D(d);
+	GM_ASSERT(track.keyCount > 0);
+	if (track.keyCount == 1)
+	{
+		key0 = key1 = 0;
+		factor = 0;
+		return;
+	}
+
+	const GMsize_t lastSample = d->sampleCount - 1;
+	GMfloat position = Clamp(animationTime / d->sampleInterval, 0.f, static_cast<GMfloat>(lastSample));
+	if (track.keyCount == d->sampleCount)
+	{
+		// 每个采样都是关键帧，直接由时间求出索引
+		key0 = std::min(static_cast<GMsize_t>(position), lastSample - 1);
+		key1 = key0 + 1;
+		factor = position - key0;
+		return;
+	}
+
+	const GMushort* frames = d->frames.data() + track.frameOffset;
+	const GMsize_t last = track.keyCount - 2;
+	GMsize_t i = cursor < last ? cursor : last;
+	bool found = false;
+
+	// 时间通常只会比上一帧前进一点，先从游标处往后找
+	if (position >= frames[i])
+	{
+		for (GMint32 step = 0; step < MaxCursorSteps; ++step)
+		{
+			if (i == last || position < frames[i + 1])
+			{
+				found = true;
+				break;
+			}
+			++i;
+		}
+	}
+
+	if (!found)
+	{
+		const GMushort* iter = std::upper_bound(frames + 1, frames + track.keyCount - 1, position, [](GMfloat p, GMushort frame) {
+			return p < frame;
+		});
+		i = (iter - frames) - 1;
+	}
+
+	cursor = i;
+	key0 = i;
+	key1 = i + 1;
+	factor = Clamp((position - frames[i]) / (frames[i + 1] - frames[i]), 0.f, 1.f);
+}
+
+void GMSkeletalCompressedAnimation::decodeRotation(const GMSkeletalCompressedTrack& track, GMsize_t key, OUT GMfloat* x, OUT GMfloat* y, OUT GMfloat* z, OUT GMfloat* w) const
+{
+	D(d);
+	QuatValue q = unpackRotation(d->rotations.data() + (track.keyOffset + key) * 3);
+	*x = q[0];
+	*y = q[1];
+	*z = q[2];
+	*w = q[3];
+}
+
+void GMSkeletalCompressedAnimation::decodeVector(const GMSkeletalCompressedTrack& track, GMsize_t key, OUT GMfloat (&value)[3]) const
+{
+	D(d);
+	VectorValue v = unpackVector(d->vectors.data() + (track.keyOffset + key) * 3, track);
+	value[0] = v[0];
+	value[1] = v[1];
+	value[2] = v[2];
+}
+
+void GMSkeletalCompressedAnimation::sampleVector(const GMSkeletalCompressedTrack& track, GMDuration animationTime, REF GMsize_t& cursor, OUT GMfloat* x, OUT GMfloat* y, OUT GMfloat* z) const
+{
+	if (!track.keyCount)
+		return;
+
+	GMsize_t key0, key1;
+	GMfloat factor;
+	findKeys(track, animationTime, cursor, key0, key1, factor);
+
+	GMfloat v0[3], v1[3];
+	decodeVector(track, key0, v0);
+	decodeVector(track, key1, v1);
+	*x = v0[0] + (v1[0] - v0[0]) * factor;
+	*y = v0[1] + (v1[1] - v0[1]) * factor;
+	*z = v0[2] + (v1[2] - v0[2]) * factor;
+}
+
+GMsize_t GMSkeletalCompressedAnimation::getMemoryUsage() const
+{
+	D(d);
+	return d->channels.size() * sizeof(GMSkeletalCompressedChannel)
+		+ (d->rotations.size() + d->vectors.size() + d->frames.size()) * sizeof(GMushort);
+}
+
+GMsize_t GMSkeletalCompressedAnimation::getMemoryUsage(const GMSkeletalAnimation& animation)
+{
+	GMsize_t size = 0;
+	for (const auto& node : animation.nodes)
+	{
+		size += node.positions.size() * sizeof(GMSkeletonAnimationKeyframe<GMVec3>);
+		size += node.rotations.size() * sizeof(GMSkeletonAnimationKeyframe<GMQuat>);
+		size += node.scalings.size() * sizeof(GMSkeletonAnimationKeyframe<GMVec3>);
+	}
+	return size;
+}
+
+GMSkeletalAnimations::~GMSkeletalAnimations()
+{
+	GMSkeletalDataGeneration::advance();
+}
+
+void GMSkeletalAnimations::compress(const GMSkeletalCompressionSettings& settings, bool releaseKeyframes)
+{
+	D(d);
+	for (auto& animation : d->animations)
+	{
+		if (animation.compressed)
+			continue;
+
+		animation.compressed.reset(new GMSkeletalCompressedAnimation(animation, settings));
+		if (releaseKeyframes)
+		{
+			// 保留通道的名称用于绑定
+			for (auto& node : animation.nodes)
+			{
+				AlignedVector<GMSkeletonAnimationKeyframe<GMVec3>>().swap(node.positions);
+				AlignedVector<GMSkeletonAnimationKeyframe<GMQuat>>().swap(node.rotations);
+				AlignedVector<GMSkeletonAnimationKeyframe<GMVec3>>().swap(node.scalings);
+			}
+		}
+	}
+}
@@ -19,7 +19,17 @@ GM_ALIGNED_STRUCT(GMSkeletalBone)
 	GMMat4 offsetMatrix; //!< 从模型空间到绑定姿势的变换
 	GMModel* targetModel = nullptr;
 	Vector<GMSkeletonWeight> weights;
-	GMMat4 finalTransformation; //!< 所有的计算结果将会放到这里来
+};
+
+//! 骨骼数据的代数。
+/*!
+  GMSkeleton、GMSkeletalNode和GMSkeletalAnimations被析构时，代数会增加。以它们的地址作为键的缓存（例如GMSkeletalPoseCache）
+  在代数变化时丢弃所有的结果，避免新分配的对象复用旧的地址时取到错误的结果。此类是线程安全的。
+*/
+struct GM_EXPORT GMSkeletalDataGeneration
+{
+	static GMint64 current() GM_NOEXCEPT;
+	static void advance() GM_NOEXCEPT;
 };
 
 GM_PRIVATE_OBJECT(GMSkeletalNode)
@@ -42,6 +52,7 @@ GM_ALIGNED_16(class) GMSkeletalNode
 public:
 	~GMSkeletalNode()
 	{
+		GMSkeletalDataGeneration::advance();
 		for (auto& child : getChildren())
 		{
 			GM_delete(child);
@@ -49,6 +60,136 @@ public:
 	}
 };
 
+GM_PRIVATE_OBJECT_UNALIGNED(GMSkeletalPose)
+{
+	GMsize_t nodeCount = 0;
+	GMsize_t stride = 0;
+	AlignedVector<GMfloat> streams;
+};
+
+//! 骨架所有节点的局部姿势。
+/*!
+  每个节点的姿势由平移、旋转（四元数）和缩放组成，按照分量以SoA的方式存放在一块连续的内存中，
+  每个分量的长度为节点数量对齐到4，节点的顺序与GMSkeletalHierarchy相同。<BR>
+  姿势之间的混合直接在这块内存上进行，除了resize()以外不会分配内存。
+*/
+class GMSkeletalPose
+{
+	GM_DECLARE_PRIVATE_NGO(GMSkeletalPose)
+	GM_DECLARE_ALIGNED_ALLOCATOR()
+
+public:
+	enum Stream
+	{
+		RotationX,
+		RotationY,
+		RotationZ,
+		RotationW,
+		PositionX,
+		PositionY,
+		PositionZ,
+		ScalingX,
+		ScalingY,
+		ScalingZ,
+		StreamCount
+	};
+
+public:
+	//! 设置节点数量，所有节点被重置为单位变换。
+	void resize(GMsize_t nodeCount);
+
+	//! 将一个节点的局部变换分解为平移、旋转和缩放，保存到姿势中。
+	/*!
+	  变换中不能包含切变和负的缩放。
+	*/
+	void setTransform(GMsize_t node, const GMMat4& transform);
+
+	//! 将所有节点的姿势合成为局部变换矩阵。
+	/*!
+	  \param transforms 每个节点相对于父节点的变换，长度需要至少为节点数量。
+	*/
+	void getTransforms(AlignedVector<GMMat4>& transforms) const;
+
+	//! 将此姿势向另外一个姿势混合。
+	/*!
+	  平移和缩放使用线性插值，旋转使用归一化的线性插值，并且沿着最短路径进行。
+	  \param other 混合的目标姿势，节点数量需要与此姿势相同。
+	  \param weight 混合的权重，为0时保持此姿势不变，为1时等于目标姿势。
+	  \param nodeWeights 每个节点的权重，与weight相乘，可以为空。长度需要至少为getStride()。
+	*/
+	void blend(const GMSkeletalPose& other, GMfloat weight, const GMfloat* nodeWeights);
+
+	//! 在此姿势上叠加另外一个姿势相对于参考姿势的变化量。
+	/*!
+	  \param other 叠加的姿势。
+	  \param reference 参考姿势，一般为骨架的绑定姿势。
+	  \param weight 叠加的权重。
+	  \param nodeWeights 每个节点的权重，与weight相乘，可以为空。长度需要至少为getStride()。
+	*/
+	void blendAdditive(const GMSkeletalPose& other, const GMSkeletalPose& reference, GMfloat weight, const GMfloat* nodeWeights);
+
+public:
+	inline GMsize_t getNodeCount() const GM_NOEXCEPT
+	{
+		D(d);
+		return d->nodeCount;
+	}
+
+	//! 获取每个分量的长度，即节点数量对齐到4。
+	inline GMsize_t getStride() const GM_NOEXCEPT
+	{
+		D(d);
+		return d->stride;
+	}
+
+	inline GMfloat* getStream(Stream stream) GM_NOEXCEPT
+	{
+		D(d);
+		return d->streams.data() + stream * d->stride;
+	}
+
+	inline const GMfloat* getStream(Stream stream) const GM_NOEXCEPT
+	{
+		D(d);
+		return d->streams.data() + stream * d->stride;
+	}
+};
+
+GM_PRIVATE_OBJECT_UNALIGNED(GMSkeletalHierarchy)
+{
+	Vector<const GMSkeletalNode*> nodes;
+	Vector<GMint32> parents;
+	AlignedVector<GMMat4> transformsToParent;
+	GMSkeletalPose bindPose;
+};
+
+//! 展开后的骨架层级。
+/*!
+  GMSkeletalNode树按照先序遍历展开为数组，父节点总是排在子节点之前，根节点的父节点索引为-1。
+  因此，所有节点在模型空间中的变换可以按照数组顺序在一次线性的遍历中求得，不再需要递归。<BR>
+  节点相对于父节点的变换同时被分解为绑定姿势，作为动画混合时没有动画通道的节点的姿势，以及叠加动画的参考姿势。
+*/
+class GMSkeletalHierarchy
+{
+	GM_DECLARE_PRIVATE_NGO(GMSkeletalHierarchy)
+	GM_DECLARE_ALIGNED_ALLOCATOR()
+	GM_DECLARE_GETTER(Nodes, nodes)
+	GM_DECLARE_GETTER(Parents, parents)
+	GM_DECLARE_GETTER(TransformsToParent, transformsToParent)
+	GM_DECLARE_GETTER(BindPose, bindPose)
+
+public:
+	GMSkeletalHierarchy() = default;
+	GMSkeletalHierarchy(const GMSkeletalNode* root);
+
+public:
+	inline GMsize_t getNodeCount() const GM_NOEXCEPT
+	{
+		D(d);
+		return d->nodes.size();
+	}
+};
+
 GM_PRIVATE_OBJECT(GMSkeletalBones)
 {
 	AlignedVector<GMSkeletalBone> bones;
@@ -79,6 +220,10 @@ public:
 	{
 		BonesPerVertex = 4
 	};
+
+public:
+	GMSkeleton() = default;
+	~GMSkeleton();
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -103,11 +248,100 @@ GM_ALIGNED_STRUCT(GMSkeletalAnimationNode)
 	AlignedVector<GMSkeletonAnimationKeyframe<GMQuat>> rotations;
 };
 
+//! 骨骼动画压缩的参数。
+struct GMSkeletalCompressionSettings
+{
+	GMfloat sampleRate = 30; //!< 每秒的采样数量
+	GMfloat rotationTolerance = .001f; //!< 删除关键帧时旋转允许的最大误差，单位为弧度
+	GMfloat positionTolerance = .001f; //!< 删除关键帧时平移允许的最大误差
+	GMfloat scalingTolerance = .0001f; //!< 删除关键帧时缩放允许的最大误差
+};
+
+//! 压缩后的一种关键帧（平移、旋转或者缩放）。
+struct GMSkeletalCompressedTrack
+{
+	GMuint32 keyOffset = 0; //!< 第一个关键帧在数据中的索引
+	GMuint32 frameOffset = 0; //!< 第一个关键帧的采样序号在getFrames()中的索引
+	GMuint32 keyCount = 0; //!< 关键帧数量，为0时没有此种关键帧，等于采样数量时采样序号是隐含的
+	GMfloat minimum[3] = { 0 }; //!< 平移和缩放量化的下界
+	GMfloat extent[3] = { 0 }; //!< 平移和缩放量化的范围
+};
+
+//! 压缩后的一个动画通道，与GMSkeletalAnimationNode一一对应。
+struct GMSkeletalCompressedChannel
+{
+	GMSkeletalCompressedTrack positions;
+	GMSkeletalCompressedTrack rotations;
+	GMSkeletalCompressedTrack scalings;
+};
+
+GM_PRIVATE_OBJECT_UNALIGNED(GMSkeletalCompressedAnimation)
+{
+	GMsize_t sampleCount = 0;
+	GMDuration sampleInterval = 0;
+	Vector<GMSkeletalCompressedChannel> channels;
+	Vector<GMushort> rotations;
+	Vector<GMushort> vectors;
+	Vector<GMushort> frames;
+};
+
+//! 压缩后的骨骼动画。
+/*!
+  压缩分为三步：<BR>
+  1. 每个通道按照固定的频率重新采样，关键帧的时间由采样序号隐含，不再保存。<BR>
+  2. 如果删除一个关键帧之后，由前后两个关键帧插值得到的结果与采样的误差在允许范围以内，这个关键帧会被删除。
+  此时保留下来的关键帧需要保存16位的采样序号。只有一个关键帧的通道即为常量。<BR>
+  3. 旋转使用smallest-three的方式量化为48位，只保存绝对值最大的分量以外的三个分量；平移和缩放在通道的取值范围内量化为每个分量16位。<BR>
+  误差判断使用量化之后的关键帧，所以删除关键帧带来的误差已经包含了量化误差，但是保留下来的关键帧本身的量化误差不包含在内。
+  量化误差对于旋转约为1e-4弧度，对于平移和缩放约为取值范围的1/131070。
+*/
+class GMSkeletalCompressedAnimation
+{
+	GM_DECLARE_PRIVATE_NGO(GMSkeletalCompressedAnimation)
+	GM_DISABLE_COPY(GMSkeletalCompressedAnimation)
+	GM_DISABLE_ASSIGN(GMSkeletalCompressedAnimation)
+	GM_DECLARE_GETTER(SampleCount, sampleCount)
+	GM_DECLARE_GETTER(SampleInterval, sampleInterval)
+	GM_DECLARE_GETTER(Channels, channels)
+	GM_DECLARE_GETTER(Frames, frames)
+
+public:
+	GMSkeletalCompressedAnimation(const GMSkeletalAnimation& animation, const GMSkeletalCompressionSettings& settings);
+
+public:
+	//! 找到需要插值的两个关键帧。
+	/*!
+	  \param track 关键帧数量需要大于0。
+	  \param animationTime 动画时间，单位为tick。
+	  \param cursor 上一次查找的结果，用于加快顺序播放时的查找。
+	  \param key0 第一个关键帧在track中的索引。
+	  \param key1 第二个关键帧在track中的索引。
+	  \param factor 插值系数。
+	*/
+	void findKeys(const GMSkeletalCompressedTrack& track, GMDuration animationTime, REF GMsize_t& cursor, OUT GMsize_t& key0, OUT GMsize_t& key1, OUT GMfloat& factor) const;
+
+	//! 解码一个旋转关键帧。
+	void decodeRotation(const GMSkeletalCompressedTrack& track, GMsize_t key, OUT GMfloat* x, OUT GMfloat* y, OUT GMfloat* z, OUT GMfloat* w) const;
+
+	//! 对平移或者缩放进行插值，track没有关键帧时不写入任何值。
+	void sampleVector(const GMSkeletalCompressedTrack& track, GMDuration animationTime, REF GMsize_t& cursor, OUT GMfloat* x, OUT GMfloat* y, OUT GMfloat* z) const;
+
+	//! 获取压缩后的数据占用的内存。
+	GMsize_t getMemoryUsage() const;
+
+	//! 获取一个动画中未压缩的关键帧占用的内存。
+	static GMsize_t getMemoryUsage(const GMSkeletalAnimation& animation);
+
+private:
+	void decodeVector(const GMSkeletalCompressedTrack& track, GMsize_t key, OUT GMfloat (&value)[3]) const;
+};
+
 GM_ALIGNED_STRUCT(GMSkeletalAnimation)
 {
 	GMfloat frameRate = 25;
 	GMDuration duration;
 	AlignedVector<GMSkeletalAnimationNode> nodes;
+	GMSharedPtr<const GMSkeletalCompressedAnimation> compressed; //!< 压缩后的关键帧，不为空时求值器使用它代替nodes中的关键帧
 };
 
 GM_PRIVATE_OBJECT(GMSkeletalAnimations)
@@ -115,12 +349,16 @@ GM_PRIVATE_OBJECT(GMSkeletalAnimations)
 	AlignedVector<GMSkeletalAnimation> animations;
 };
 
-GM_ALIGNED_16(class) GMSkeletalAnimations
+GM_ALIGNED_16(class) GM_EXPORT GMSkeletalAnimations
 {
 	GM_DECLARE_PRIVATE_NGO(GMSkeletalAnimations)
 	GM_DECLARE_ALIGNED_ALLOCATOR()
 	GM_DECLARE_PROPERTY(Animations, animations)
 
+public:
+	GMSkeletalAnimations() = default;
+	~GMSkeletalAnimations();
+
 public:
 	inline GMSkeletalAnimation* getAnimation(GMsize_t index) GM_NOEXCEPT
 	{
@@ -133,6 +371,15 @@ public:
 		D(d);
 		return d->animations.size();
 	}
+
+	//! 压缩所有的动画。
+	/*!
+	  已经压缩过的动画会被跳过。
+	  \param settings 压缩的参数。
+	  \param releaseKeyframes 是否释放未压缩的关键帧。释放之后动画只保留通道的名称，只能以压缩的方式求值。
+	  \sa GMSkeletalCompressedAnimation
+	*/
+	void compress(const GMSkeletalCompressionSettings& settings, bool releaseKeyframes = true);
 };
 
 END_NS
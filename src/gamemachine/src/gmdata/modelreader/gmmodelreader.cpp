@@ -70,5 +70,33 @@ bool GMModelReader::load(const GMModelLoadSettings& settings, EngineType type, R
 	if (type == ModelType_End)
 		return false;
 
-	return getReader(type)->load(settingsCache, buffer, asset);
+	if (!getReader(type)->load(settingsCache, buffer, asset))
+		return false;
+
+	if (settingsCache.optimizeMeshes && asset.isScene())
+	{
+		GMMeshOptimizeReport report;
+		GMMeshOptimizer::optimize(asset.getScene(), settingsCache.meshOptimizeSettings, &report);
+		gm_info(gm_dbg_wrap("Mesh optimized: {0}, vertices {1} -> {2}, ACMR {3} -> {4}"),
+			settingsCache.filename,
+			GMString(static_cast<GMlong>(report.verticesBefore)),
+			GMString(static_cast<GMlong>(report.verticesAfter)),
+			GMString(report.getACMRBefore()),
+			GMString(report.getACMRAfter())
+		);
+	}
+
+	if (settingsCache.generateLods && asset.isScene())
+		GMMeshOptimizer::generateLods(asset.getScene(), settingsCache.lodSettings);
+
+	// 顶点数据在对象加入GMGameWorld时才会传输到显卡，因此在这里设置格式即可
+	if (settingsCache.compactVertices && asset.isScene())
+	{
+		GMVertexLayout layout = GMVertexLayout::createCompactLayout();
+		for (auto& modelAsset : asset.getScene()->getModels())
+		{
+			modelAsset.getModel()->setVertexLayout(layout);
+		}
+	}
+	return true;
 }
@@ -4,6 +4,7 @@
 #include <linearmath.h>
 #include <gmgameobject.h>
 #include <gmassets.h>
+#include <gmmeshoptimizer.h>
 BEGIN_NS
 
 class GMModel;
@@ -55,6 +56,11 @@ struct GMModelLoadSettings
 	GMString directory; //!< 模型所在目录
 	const IRenderContext* context;
 	GMModelPathType type; //!< 目录路径参考类型
+	bool optimizeMeshes = false; //!< 读取完成后是否使用GMMeshOptimizer优化网格，优化前后的ACMR会输出到日志
+	GMMeshOptimizeSettings meshOptimizeSettings; //!< 优化网格的参数
+	bool generateLods = false; //!< 读取完成后是否为模型生成LOD，在优化网格之后进行
+	GMLodSettings lodSettings; //!< 生成LOD的参数
+	bool compactVertices = false; //!< 是否将读取的模型的顶点格式设置为GMVertexLayout::createCompactLayout()，减少显存占用和顶点读取的带宽。目前只对OpenGL有效
 };
 
 class GM_EXPORT GMModelReader
@@ -114,7 +114,8 @@ void GMDx11ModelDataProxy::transfer()
 		GMComPtr<ID3D11Device> device = d->engine->getDevice();
 		GM_DX_HR(device->CreateBuffer(&bufDesc, &bufData, &d->indexBuffer));
 
-		verticesCount = packedIndices.size();
+		// 缓存中还包含LOD级别的索引，原始网格只绘制前面的部分
+		verticesCount = getPackedIndicesCount();
 	}
 	else
 	{
@@ -130,10 +131,7 @@ void GMDx11ModelDataProxy::transfer()
 	mb->releaseRef();
 	model->setVerticesCount(verticesCount);
 
-	for (auto& part : model->getParts())
-	{
-		part->clear();
-	}
+	releasePartsData();
 
 	d->inited = true;
 	model->doNotTransferAnymore();
@@ -1151,10 +1151,12 @@ void GMDx11Technique::passAllAndDraw(GMModel* model)
 	{
 		ID3DX11EffectPass* pass = tech->GetPassByIndex(p);
 		pass->Apply(0, d->deviceContext);
+		GMsize_t offset, count;
+		model->getDrawRange(offset, count);
 		if (model->getDrawMode() == GMModelDrawMode::Vertex)
-			d->deviceContext->Draw(gm_sizet_to<UINT>(model->getVerticesCount()), 0);
+			d->deviceContext->Draw(gm_sizet_to<UINT>(count), gm_sizet_to<UINT>(offset));
 		else
-			d->deviceContext->DrawIndexed(gm_sizet_to<UINT>(model->getVerticesCount()), 0, 0);
+			d->deviceContext->DrawIndexed(gm_sizet_to<UINT>(count), gm_sizet_to<UINT>(offset), 0);
 	}
 }
 
@@ -1251,10 +1253,12 @@ void GMDx11Technique_Filter::passAllAndDraw(GMModel* model)
 		}
 		pass->Apply(0, d->deviceContext);
 
+		GMsize_t offset, count;
+		model->getDrawRange(offset, count);
 		if (model->getDrawMode() == GMModelDrawMode::Vertex)
-			d->deviceContext->Draw(gm_sizet_to<UINT>(model->getVerticesCount()), 0);
+			d->deviceContext->Draw(gm_sizet_to<UINT>(count), gm_sizet_to<UINT>(offset));
 		else
-			d->deviceContext->DrawIndexed(gm_sizet_to<UINT>(model->getVerticesCount()), 0, 0);
+			d->deviceContext->DrawIndexed(gm_sizet_to<UINT>(count), gm_sizet_to<UINT>(offset), 0);
 	}
 }
 
@@ -1326,10 +1330,12 @@ void GMDx11Technique_Deferred_3D::passAllAndDraw(GMModel* model)
 
 		GM_ASSERT(framebuffers);
 		framebuffers->bind();
+		GMsize_t offset, count;
+		model->getDrawRange(offset, count);
 		if (model->getDrawMode() == GMModelDrawMode::Vertex)
-			d->deviceContext->Draw(gm_sizet_to<UINT>(model->getVerticesCount()), 0);
+			d->deviceContext->Draw(gm_sizet_to<UINT>(count), gm_sizet_to<UINT>(offset));
 		else
-			d->deviceContext->DrawIndexed(gm_sizet_to<UINT>(model->getVerticesCount()), 0, 0);
+			d->deviceContext->DrawIndexed(gm_sizet_to<UINT>(count), gm_sizet_to<UINT>(offset), 0);
 		framebuffers->unbind();
 	}
 }
@@ -1343,10 +1349,12 @@ void GMDx11Technique_Deferred_3D_LightPass::passAllAndDraw(GMModel* model)
 	{
 		ID3DX11EffectPass* pass = getTechnique()->GetPassByIndex(p);
 		pass->Apply(0, d->deviceContext);
+		GMsize_t offset, count;
+		model->getDrawRange(offset, count);
 		if (model->getDrawMode() == GMModelDrawMode::Vertex)
-			d->deviceContext->Draw(gm_sizet_to<UINT>(model->getVerticesCount()), 0);
+			d->deviceContext->Draw(gm_sizet_to<UINT>(count), gm_sizet_to<UINT>(offset));
 		else
-			d->deviceContext->DrawIndexed(gm_sizet_to<UINT>(model->getVerticesCount()), 0, 0);
+			d->deviceContext->DrawIndexed(gm_sizet_to<UINT>(count), gm_sizet_to<UINT>(offset), 0);
 	}
 }
 
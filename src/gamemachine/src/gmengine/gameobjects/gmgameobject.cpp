@@ -1,6 +1,7 @@
 ﻿#include "stdafx.h"
 #include "gmgameobject.h"
 #include "gmengine/gmgameworld.h"
+#include "gmengine/gmgraphicengine.h"
 #include "gmdata/glyph/gmglyphmanager.h"
 #include "foundation/gamemachine.h"
 #include "gmassets.h"
@@ -145,13 +146,85 @@ void GMGameObject::onAppendingObjectToWorld()
 
 void GMGameObject::draw()
 {
-	cull();
-	foreachModel([this](GMModel* m) {
-		drawModel(getContext(), m);
-	});
+	D(d);
+	// 如果本帧已经在绘制之前裁剪过，则不需要再次裁剪。之前帧的结果已经过期，需要重新裁剪
+	if (d->culledAheadFrame != 0 && d->culledAheadFrame == GM.getRunningStates().frameNumber)
+		d->culledAheadFrame = 0;
+	else
+		cull();
+
+	GMScene* scene = getScene();
+	if (scene)
+	{
+		Vector<GMAsset>& models = scene->getModels();
+		if (d->lod.levels.size() != models.size())
+			d->lod.levels.resize(models.size(), 0);
+
+		for (GMsize_t i = 0; i < models.size(); ++i)
+		{
+			// 模型可能被其它对象共用，绘制完成后恢复为原始网格
+			GMModel* model = models[i].getModel();
+			model->setActiveLod(selectLod(i, model));
+			drawModel(getContext(), model);
+			model->setActiveLod(0u);
+		}
+	}
 	endDraw();
 }
 
+GMuint32 GMGameObject::selectLod(GMsize_t modelIndex, GMModel* model)
+{
+	D(d);
+	const GMModelLods& lods = model->getLods();
+	if (!d->lod.enabled || lods.levels.empty() || lods.radius <= 0 || !d->context)
+		return 0;
+
+	// 包围球变换到世界空间，半径按照最大的缩放计算
+	const GMMat4& transform = d->transforms.transformMatrix;
+	GMVec4 center = GMVec4(lods.center[0], lods.center[1], lods.center[2], 1) * transform;
+	GMfloat scale = 0;
+	for (GMint32 i = 0; i < 3; ++i)
+	{
+		GMVec4 axis = transform[i];
+		scale = Max(scale, Length(GMVec3(axis.getX(), axis.getY(), axis.getZ())));
+	}
+	const GMfloat radius = lods.radius * scale;
+
+	// 包围球的直径占屏幕高度的比例，透视投影需要除以距离
+	GMCamera& camera = d->context->getEngine()->getCamera();
+	const GMMat4& projection = camera.getProjectionMatrix();
+	GMfloat screenSize = radius * projection[1].getY();
+	if (projection[3].getW() == 0)
+	{
+		GMfloat distance = Length(GMVec3(center.getX(), center.getY(), center.getZ()) - camera.getLookAt().position);
+		if (distance <= radius)
+			screenSize = FLT_MAX;
+		else
+			screenSize /= distance;
+	}
+
+	GMuint32& level = d->lod.levels[modelIndex];
+	level = selectLodLevel(lods, screenSize, d->lod.hysteresis, level);
+	return level;
+}
+
+GMuint32 GMGameObject::selectLodLevel(const GMModelLods& lods, GMfloat screenSize, GMfloat hysteresis, GMuint32 level)
+{
+	const GMuint32 levelCount = gm_sizet_to_uint(lods.levels.size());
+	if (level > levelCount)
+		level = levelCount;
+
+	while (level < levelCount && screenSize < lods.levels[level].screenSize * (1 - hysteresis))
+	{
+		++level;
+	}
+	while (level > 0 && screenSize > lods.levels[level - 1].screenSize * (1 + hysteresis))
+	{
+		--level;
+	}
+	return level;
+}
+
 bool GMGameObject::canDeferredRendering()
 {
 	D(d);
@@ -283,6 +356,15 @@ void GMGameObject::drawModel(const IRenderContext* context, GMModel* model)
 		return;
 	IGraphicEngine* engine = context->getEngine();
 	ITechnique* technique = engine->getTechnique(model->getType());
+
+	// 渲染队列录制时只记录模型，所有对象提交之后统一排序绘制
+	GMRenderQueue* renderQueue = gm_cast<GMGraphicEngine*>(engine)->getRenderQueue();
+	if (renderQueue->isRecording())
+	{
+		renderQueue->push(this, model, technique, getScene());
+		return;
+	}
+
 	if (technique != d->drawContext.currentTechnique)
 	{
 		if (d->drawContext.currentTechnique)
@@ -357,6 +439,24 @@ IComputeShaderProgram* GMGameObject::getCullShaderProgram()
 	return defaultProgram;
 }
 
+bool GMGameObject::canCullAhead()
+{
+	D(d);
+	if (d->cullOption != GMGameObjectCullOption::AABB)
+		return false;
+
+	// 使用计算着色器裁剪时需要访问渲染上下文，只能在绘制时进行
+	IComputeShaderProgram* cullShaderProgram = getCullShaderProgram();
+	return !(cullShaderProgram && d->cullGPUAccelerationValid);
+}
+
+void GMGameObject::cullAhead()
+{
+	D(d);
+	cullByCPU();
+	d->culledAheadFrame = GM.getRunningStates().frameNumber;
+}
+
 void GMGameObject::cull()
 {
 	D(d);
@@ -421,39 +521,45 @@ void GMGameObject::cull()
 		}
 		else
 		{
-			Vector<GMAsset>& models = getScene()->getModels();
-			// 计算每个Model的AABB是否与相机Frustum有交集，如果没有，则不进行绘制
-			GM_ASSERT(d->cullAABB.size() == models.size());
-
-			GMAsync::blockedAsync(
-				GMAsync::Async,
-				GM.getRunningStates().systemInfo.numberOfProcessors,
-				d->cullAABB.begin(),
-				d->cullAABB.end(),
-				[d, &models, this](auto begin, auto end) {
-				// 计算一下数据偏移
-				for (auto iter = begin; iter != end; ++iter)
-				{
-					GMVec3 vertices[8];
-					GMsize_t offset = iter - d->cullAABB.begin();
-					auto& shader = models[offset].getModel()->getShader();
-
-					for (auto i = 0; i < 8; ++i)
-					{
-						vertices[i] = d->cullAABB[offset].points[i] * d->transforms.transformMatrix;
-					}
-
-					if (isInsideCameraFrustum(d->cullCamera ? d->cullCamera : &getContext()->getEngine()->getCamera(), vertices))
-						shader.setCulled(false);
-					else
-						shader.setCulled(true);
-				}
-			}
-			);
+			cullByCPU();
 		}
 	}
 }
 
+void GMGameObject::cullByCPU()
+{
+	D(d);
+	Vector<GMAsset>& models = getScene()->getModels();
+	// 计算每个Model的AABB是否与相机Frustum有交集，如果没有，则不进行绘制
+	GM_ASSERT(d->cullAABB.size() == models.size());
+
+	GMAsync::blockedAsync(
+		GMAsync::Async,
+		GM.getRunningStates().systemInfo.numberOfProcessors,
+		d->cullAABB.begin(),
+		d->cullAABB.end(),
+		[d, &models, this](auto begin, auto end) {
+		// 计算一下数据偏移
+		for (auto iter = begin; iter != end; ++iter)
+		{
+			GMVec3 vertices[8];
+			GMsize_t offset = iter - d->cullAABB.begin();
+			auto& shader = models[offset].getModel()->getShader();
+
+			for (auto i = 0; i < 8; ++i)
+			{
+				vertices[i] = d->cullAABB[offset].points[i] * d->transforms.transformMatrix;
+			}
+
+			if (isInsideCameraFrustum(d->cullCamera ? d->cullCamera : &getContext()->getEngine()->getCamera(), vertices))
+				shader.setCulled(false);
+			else
+				shader.setCulled(true);
+		}
+	}
+	);
+}
+
 GMCubeMapGameObject::GMCubeMapGameObject(GMTextureAsset texture)
 {
 	createCubeMap(texture);
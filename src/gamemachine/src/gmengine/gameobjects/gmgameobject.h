@@ -39,6 +39,7 @@ GM_PRIVATE_OBJECT(GMGameObject)
 	GMComputeUAVHandle cullResultUAV = 0;
 	GMsize_t cullSize = 0;
 	bool cullGPUAccelerationValid = true;
+	GMuint64 culledAheadFrame = 0; //!< 提前裁剪时所在的帧，只在同一帧内有效
 
 	GM_ALIGNED_16(struct)
 	{
@@ -52,11 +53,19 @@ GM_PRIVATE_OBJECT(GMGameObject)
 	{
 		ITechnique* currentTechnique = nullptr;
 	} drawContext;
+
+	struct
+	{
+		bool enabled = true;
+		GMfloat hysteresis = .1f;
+		Vector<GMuint32> levels; //!< 每个模型当前使用的LOD级别
+	} lod;
 };
 
 class GM_EXPORT GMGameObject : public GMObject
 {
 	GM_DECLARE_PRIVATE(GMGameObject)
+	GM_FRIEND_CLASS(GMGameWorld)
 
 public:
 	GMGameObject() = default;
@@ -133,6 +142,44 @@ public:
 		d->context = context;
 	}
 
+	//! 设置是否根据模型在屏幕上的大小选择LOD级别，默认开启。
+	/*!
+	  只对生成了LOD的模型有效。
+	  \sa GMMeshOptimizer::generateLods()
+	*/
+	inline void setLodEnabled(bool enabled) GM_NOEXCEPT
+	{
+		D(d);
+		d->lod.enabled = enabled;
+	}
+
+	//! 设置切换LOD级别时的滞后比例。
+	/*!
+	  模型的屏幕占比需要越过级别阈值的(1 - hysteresis)或(1 + hysteresis)倍才会切换级别，避免在阈值附近每帧来回切换。
+	*/
+	inline void setLodHysteresis(GMfloat hysteresis) GM_NOEXCEPT
+	{
+		D(d);
+		d->lod.hysteresis = hysteresis;
+	}
+
+	//! 从上一次使用的级别出发，根据屏幕占比选择LOD级别。
+	/*!
+	  \param lods 模型的LOD信息。
+	  \param screenSize 模型包围球在屏幕上的高度占比。
+	  \param hysteresis 滞后比例，见setLodHysteresis()。
+	  \param level 上一次使用的级别。
+	  \return 新的级别，0表示原始网格。
+	*/
+	static GMuint32 selectLodLevel(const GMModelLods& lods, GMfloat screenSize, GMfloat hysteresis, GMuint32 level);
+
+	//! 获取一个模型在上一次绘制时使用的LOD级别，0表示原始网格。
+	inline GMuint32 getLodLevel(GMsize_t modelIndex) const GM_NOEXCEPT
+	{
+		D(d);
+		return modelIndex < d->lod.levels.size() ? d->lod.levels[modelIndex] : 0;
+	}
+
 private:
 	inline void setAutoUpdateTransformMatrix(bool autoUpdateTransformMatrix) GM_NOEXCEPT
 	{
@@ -141,6 +188,12 @@ private:
 	}
 
 	void releaseAllBufferHandle();
+	GMuint32 selectLod(GMsize_t modelIndex, GMModel* model);
+
+	// 并行帧中，在绘制之前于工作线程中提前裁剪
+	bool canCullAhead();
+	void cullAhead();
+	void cullByCPU();
 
 public:
 	//! 设置默认的裁剪程序。如果没有设置，那么GMGameObject将会采用CPU裁剪。
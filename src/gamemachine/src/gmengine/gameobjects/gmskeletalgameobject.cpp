@@ -3,22 +3,229 @@
 #include "foundation/gmasync.h"
 #include "foundation/gamemachine.h"
 #include "gmengine/gmgameworld.h"
+#include <algorithm>
+#if GM_SIMD_SSE2
+#	include <emmintrin.h>
+#endif
 
 namespace
 {
+	enum
+	{
+		// 从游标开始向后顺序查找的最大步数，超过之后使用二分查找
+		MaxCursorSteps = 4,
+
+		// 每个任务更新的求值器数量
+		EvaluatorsPerJob = 4,
+	};
+
+	// 每一帧从关键帧中取出的旋转，每个分量占用一段长度为通道数（对齐到4）的空间
+	enum SampleStream
+	{
+		Rotation0X,
+		Rotation0Y,
+		Rotation0Z,
+		Rotation0W,
+		Rotation1X,
+		Rotation1Y,
+		Rotation1Z,
+		Rotation1W,
+		RotationFactor,
+		SampleStreamCount
+	};
+
+	// 球面插值的多项式系数，见David Eberly, A Fast and Accurate Algorithm for Computing SLERP
+	const GMfloat SlerpOnePlusMu = 1.90110745351730037f;
+	const GMfloat SlerpU[] = {
+		1.f / (1 * 3), 1.f / (2 * 5), 1.f / (3 * 7), 1.f / (4 * 9),
+		1.f / (5 * 11), 1.f / (6 * 13), 1.f / (7 * 15), SlerpOnePlusMu / (8 * 17)
+	};
+	const GMfloat SlerpV[] = {
+		1.f / 3, 2.f / 5, 3.f / 7, 4.f / 9,
+		5.f / 11, 6.f / 13, 7.f / 15, SlerpOnePlusMu * 8 / 17
+	};
+
+	typedef HashMap<GMString, GMint32, GMStringHashFunctor> ChannelIndexMap;
+
+	inline GMsize_t alignedChannelCount(GMsize_t count)
+	{
+		return (count + 3) & ~static_cast<GMsize_t>(3);
+	}
+
+	// 数量足够多时，将[0, count)分组交给GMJobSystem并行执行
+	template <typename Function>
+	void parallelInvoke(GMsize_t count, GMsize_t grainSize, Function&& function)
+	{
+		if (count > grainSize)
+			GMJobSystem::instance().parallelFor(0, count, grainSize, std::forward<Function>(function));
+		else
+			function(0, count);
+	}
+
+	// 找到animationTime所在的关键帧区间[i, i + 1]，cursor为上一次查找的结果
 	template <typename T>
-	GMsize_t findIndex(GMDuration animationTime, const AlignedVector<GMSkeletonAnimationKeyframe<T>>& frames)
+	GMsize_t findIndex(GMDuration animationTime, const AlignedVector<GMSkeletonAnimationKeyframe<T>>& frames, REF GMsize_t& cursor)
 	{
-		GM_ASSERT(frames.size() > 0);
-		for (GMsize_t i = 0; i < frames.size() - 1; ++i)
+		GM_ASSERT(frames.size() > 1);
+		const GMsize_t last = frames.size() - 2;
+		GMsize_t i = cursor < last ? cursor : last;
+
+		// 时间通常只会比上一帧前进一点，先从游标处往后找
+		if (animationTime >= frames[i].time)
 		{
-			const GMSkeletonAnimationKeyframe<T>& frame = frames[i + 1];
-			if (animationTime < frame.time)
-				return i;
+			for (GMint32 step = 0; step < MaxCursorSteps; ++step)
+			{
+				if (i == last || animationTime < frames[i + 1].time)
+				{
+					cursor = i;
+					return i;
+				}
+				++i;
+			}
 		}
 
-		GM_ASSERT(false);
-		return 0;
+		// 动画循环或者跳转时，使用二分查找
+		auto iter = std::upper_bound(frames.begin() + 1, frames.end() - 1, animationTime, [](GMDuration t, const GMSkeletonAnimationKeyframe<T>& frame) {
+			return t < frame.time;
+		});
+		cursor = (iter - frames.begin()) - 1;
+		return cursor;
+	}
+
+	// 找到需要插值的两个关键帧，返回第一个关键帧的索引，第二个关键帧的索引由next返回
+	template <typename T>
+	GMsize_t findKeyframes(GMDuration animationTime, const AlignedVector<GMSkeletonAnimationKeyframe<T>>& frames, REF GMsize_t& cursor, OUT GMsize_t& next, OUT GMfloat& factor)
+	{
+		if (frames.size() == 1)
+		{
+			next = 0;
+			factor = 0;
+			return 0;
+		}
+
+		GMsize_t frameIdx = findIndex(animationTime, frames, cursor);
+		const auto& frame = frames[frameIdx];
+		const auto& nextFrame = frames[frameIdx + 1];
+		next = frameIdx + 1;
+		factor = Clamp((animationTime - frame.time) / (nextFrame.time - frame.time), 0.f, 1.f);
+		return frameIdx;
+	}
+
+	void sampleVec3(GMDuration animationTime, const AlignedVector<GMSkeletonAnimationKeyframe<GMVec3>>& frames, REF GMsize_t& cursor, GMfloat* x, GMfloat* y, GMfloat* z)
+	{
+		if (frames.empty())
+			return;
+
+		GMsize_t next;
+		GMfloat factor;
+		GMsize_t frameIdx = findKeyframes(animationTime, frames, cursor, next, factor);
+		GMVec3 value = Lerp(frames[frameIdx].value, frames[next].value, factor);
+		*x = value.getX();
+		*y = value.getY();
+		*z = value.getZ();
+	}
+
+	void writeQuat(const GMQuat& q, GMfloat* x, GMfloat* y, GMfloat* z, GMfloat* w)
+	{
+		*x = q.getX();
+		*y = q.getY();
+		*z = q.getZ();
+		*w = q.getW();
+	}
+
+#if GM_SIMD_SSE2
+	// 同时对4组四元数进行球面插值，插值沿着最短路径进行。
+	// 使用多项式代替反三角函数，两个四元数的夹角在45度（旋转90度）以内时误差小于1e-7，最坏情况下误差约为3e-5
+	inline void slerp4(const __m128 (&q0)[4], __m128 (&q1)[4], __m128 t, OUT __m128 (&q)[4])
+	{
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+
+		__m128 cosTheta = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(q0[0], q1[0]), _mm_mul_ps(q0[1], q1[1])),
+			_mm_add_ps(_mm_mul_ps(q0[2], q1[2]), _mm_mul_ps(q0[3], q1[3]))
+		);
+
+		// 点积为负时，使用-q1
+		__m128 sign = _mm_and_ps(cosTheta, signMask);
+		cosTheta = _mm_xor_ps(cosTheta, sign);
+		for (GMint32 i = 0; i < 4; ++i)
+		{
+			q1[i] = _mm_xor_ps(q1[i], sign);
+		}
+
+		__m128 xm1 = _mm_sub_ps(cosTheta, one);
+		__m128 d = _mm_sub_ps(one, t);
+		__m128 sqrT = _mm_mul_ps(t, t);
+		__m128 sqrD = _mm_mul_ps(d, d);
+		__m128 coeffT = one;
+		__m128 coeffD = one;
+		for (GMint32 i = 7; i >= 0; --i)
+		{
+			__m128 u = _mm_set1_ps(SlerpU[i]);
+			__m128 v = _mm_set1_ps(SlerpV[i]);
+			coeffT = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(u, sqrT), v), xm1), coeffT));
+			coeffD = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(u, sqrD), v), xm1), coeffD));
+		}
+		coeffT = _mm_mul_ps(t, coeffT);
+		coeffD = _mm_mul_ps(d, coeffD);
+
+		for (GMint32 i = 0; i < 4; ++i)
+		{
+			q[i] = _mm_add_ps(_mm_mul_ps(q0[i], coeffD), _mm_mul_ps(q1[i], coeffT));
+		}
+	}
+#else
+	GMQuat slerp(const GMQuat& q0, GMQuat q1, GMfloat t)
+	{
+		GMfloat cosTheta = q0.getX() * q1.getX() + q0.getY() * q1.getY() + q0.getZ() * q1.getZ() + q0.getW() * q1.getW();
+		if (cosTheta < 0)
+		{
+			cosTheta = -cosTheta;
+			q1 = GMQuat(-q1.getX(), -q1.getY(), -q1.getZ(), -q1.getW());
+		}
+
+		GMfloat xm1 = cosTheta - 1;
+		GMfloat d = 1 - t;
+		GMfloat coeffT = 1, coeffD = 1;
+		for (GMint32 i = 7; i >= 0; --i)
+		{
+			coeffT = 1 + (SlerpU[i] * t * t - SlerpV[i]) * xm1 * coeffT;
+			coeffD = 1 + (SlerpU[i] * d * d - SlerpV[i]) * xm1 * coeffD;
+		}
+		coeffT *= t;
+		coeffD *= d;
+		return GMQuat(
+			q0.getX() * coeffD + q1.getX() * coeffT,
+			q0.getY() * coeffD + q1.getY() * coeffT,
+			q0.getZ() * coeffD + q1.getZ() * coeffT,
+			q0.getW() * coeffD + q1.getW() * coeffT
+		);
+	}
+#endif
+
+	// out = a * b，即先进行a的变换，再进行b的变换，out不能是a或者b
+	inline void multiplyTransform(const GMMat4& a, const GMMat4& b, OUT GMMat4& out)
+	{
+#if GM_SIMD_SSE2
+		const GMfloat* pa = ValuePointer(a);
+		const GMfloat* pb = ValuePointer(b);
+		GMfloat* po = ValuePointer(out);
+		__m128 b0 = _mm_loadu_ps(pb);
+		__m128 b1 = _mm_loadu_ps(pb + 4);
+		__m128 b2 = _mm_loadu_ps(pb + 8);
+		__m128 b3 = _mm_loadu_ps(pb + 12);
+		for (GMint32 i = 0; i < 16; i += 4)
+		{
+			__m128 r = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(pa[i]), b0), _mm_mul_ps(_mm_set1_ps(pa[i + 1]), b1)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(pa[i + 2]), b2), _mm_mul_ps(_mm_set1_ps(pa[i + 3]), b3))
+			);
+			_mm_storeu_ps(po + i, r);
+		}
+#else
+		out = a * b;
+#endif
 	}
 }
 
@@ -31,144 +238,478 @@ GMSkeletalAnimationEvaluator::GMSkeletalAnimationEvaluator(GMSkeletalNode* root,
 }
 
 void GMSkeletalAnimationEvaluator::update(GMDuration dt)
+{
+	evaluatePose(dt);
+	applyPose();
+}
+
+void GMSkeletalAnimationEvaluator::reset()
+{
+	D(d);
+	d->duration = 0;
+}
+
+void GMSkeletalAnimationEvaluator::advance(GMDuration dt)
 {
 	D(d);
 	d->duration += dt;
+}
 
+GMDuration GMSkeletalAnimationEvaluator::getAnimationTime() const
+{
+	D(d);
 	GMfloat ticks = d->duration * d->animation->frameRate;
 	GMDuration animationTime = Fmod(ticks, d->animation->duration);
+	if (d->timeQuantum > 0)
+	{
+		GMfloat quantum = d->timeQuantum * d->animation->frameRate;
+		animationTime = Floor(animationTime / quantum) * quantum;
+	}
+	return animationTime;
+}
 
-	updateNode(animationTime, d->rootNode, Identity<GMMat4>());
-	AlignedVector<GMMat4>& transforms = d->transforms;
+void GMSkeletalAnimationEvaluator::evaluatePose(GMDuration dt)
+{
+	advance(dt);
+	if (!isBound())
+		bind();
+
+	sampleChannels(getAnimationTime());
+	composePose();
+}
 
-	GMsize_t boneCount = d->skeleton->getBones().getBones().size();
-	transforms.resize(boneCount);
+void GMSkeletalAnimationEvaluator::applyPose()
+{
+	D(d);
+	d->pose.getTransforms(d->localTransforms);
+	updateGlobalTransforms();
+}
 
-	for (GMsize_t i = 0; i < boneCount; ++i)
+const GMSkeletalHierarchy& GMSkeletalAnimationEvaluator::getHierarchy() const
+{
+	D(d);
+	GM_ASSERT(d->binding);
+	return d->binding->hierarchy;
+}
+
+void GMSkeletalAnimationEvaluator::updateBatch(GMSkeletalAnimationEvaluator* const* evaluators, GMsize_t count, GMDuration dt)
+{
+	bindBatch(evaluators, count);
+	parallelInvoke(count, EvaluatorsPerJob, [evaluators, dt](GMsize_t begin, GMsize_t end) {
+		for (GMsize_t i = begin; i < end; ++i)
+		{
+			evaluators[i]->update(dt);
+		}
+	});
+}
+
+void GMSkeletalAnimationEvaluator::evaluatePoseBatch(GMSkeletalAnimationEvaluator* const* evaluators, GMsize_t count, GMDuration dt)
+{
+	bindBatch(evaluators, count);
+	parallelInvoke(count, EvaluatorsPerJob, [evaluators, dt](GMsize_t begin, GMsize_t end) {
+		for (GMsize_t i = begin; i < end; ++i)
+		{
+			evaluators[i]->evaluatePose(dt);
+		}
+	});
+}
+
+void GMSkeletalAnimationEvaluator::bindBatch(GMSkeletalAnimationEvaluator* const* evaluators, GMsize_t count)
+{
+	// 通常每一帧所有的求值器都已经绑定，此时不需要做任何事情
+	GMsize_t firstUnbound = 0;
+	while (firstUnbound < count && evaluators[firstUnbound]->isBound())
 	{
-		transforms[i] = d->skeleton->getBones().getBones()[i].finalTransformation;
+		++firstUnbound;
 	}
+	if (firstUnbound == count)
+		return;
+
+	// 绑定在调用线程中完成，相同的骨架、根节点和动画只绑定一次。临时数组在线程中复用，避免每次分配
+	static thread_local Vector<GMSharedPtr<const GMSkeletalAnimationBinding>> s_bindings;
+	Vector<GMSharedPtr<const GMSkeletalAnimationBinding>>& bindings = s_bindings;
+	auto addBinding = [&bindings](const GMSharedPtr<const GMSkeletalAnimationBinding>& binding) {
+		if (std::find(bindings.begin(), bindings.end(), binding) == bindings.end())
+			bindings.push_back(binding);
+	};
+
+	for (GMsize_t i = 0; i < count; ++i)
+	{
+		GMSkeletalAnimationEvaluator* evaluator = evaluators[i];
+		D_OF(d, evaluator);
+		if (evaluator->isBound())
+		{
+			addBinding(d->binding);
+			continue;
+		}
+
+		auto iter = std::find_if(bindings.begin(), bindings.end(), [d](const GMSharedPtr<const GMSkeletalAnimationBinding>& binding) {
+			return binding->animation == d->animation && binding->skeleton == d->skeleton && binding->rootNode == d->rootNode;
+		});
+
+		if (iter != bindings.end())
+		{
+			evaluator->setBinding(*iter);
+		}
+		else
+		{
+			evaluator->bind();
+			bindings.push_back(d->binding);
+		}
+	}
+
+	// 只保留容量，不持有绑定
+	bindings.clear();
 }
 
-void GMSkeletalAnimationEvaluator::reset()
+void GMSkeletalAnimationEvaluator::bind()
 {
 	D(d);
-	d->duration = 0;
+	GMSkeletalAnimationBinding* binding = new GMSkeletalAnimationBinding();
+	GMSharedPtr<const GMSkeletalAnimationBinding> bindingPtr(binding);
+	binding->animation = d->animation;
+	binding->skeleton = d->skeleton;
+	binding->rootNode = d->rootNode;
+	binding->hierarchy = GMSkeletalHierarchy(d->rootNode);
+
+	// 与之前按名称查找一致，同名的通道以第一个为准
+	ChannelIndexMap channels;
+	for (GMsize_t i = 0; i < d->animation->nodes.size(); ++i)
+	{
+		channels.insert(std::make_pair(d->animation->nodes[i].name, gm_sizet_to_int(i)));
+	}
+
+	const auto& bones = d->skeleton->getBones().getBones();
+	const auto& boneMapping = d->skeleton->getBones().getBoneNameIndexMap();
+	binding->boneNodes.assign(bones.size(), -1);
+	// 没有对应节点的骨骼保持绑定姿势：它在绑定姿势下的全局变换是偏移矩阵的逆，
+	// 与偏移矩阵相乘后为单位矩阵，即顶点保持在绑定时的位置
+	binding->restTransforms.assign(bones.size(), Identity<GMMat4>());
+
+	const auto& nodes = binding->hierarchy.getNodes();
+	for (GMsize_t i = 0; i < nodes.size(); ++i)
+	{
+		const GMString& nodeName = nodes[i]->getName();
+		auto channelIter = channels.find(nodeName);
+		if (channelIter != channels.end())
+		{
+			binding->channels.push_back(channelIter->second);
+			binding->channelNodes.push_back(gm_sizet_to_int(i));
+		}
+
+		// 多个节点对应同一个骨骼时，以最后一个节点为准
+		auto boneIter = boneMapping.find(nodeName);
+		if (boneIter != boneMapping.end())
+			binding->boneNodes[boneIter->second] = gm_sizet_to_int(i);
+	}
+
+	setBinding(bindingPtr);
+}
+
+bool GMSkeletalAnimationEvaluator::isBound() const
+{
+	D(d);
+	return d->binding
+		&& d->binding->animation == d->animation
+		&& d->binding->skeleton == d->skeleton
+		&& d->binding->rootNode == d->rootNode;
 }
 
-void GMSkeletalAnimationEvaluator::updateNode(GMDuration animationTime, GMSkeletalNode* node, const GMMat4& parentTransformation)
+void GMSkeletalAnimationEvaluator::setBinding(const GMSharedPtr<const GMSkeletalAnimationBinding>& binding)
 {
 	D(d);
-	const GMString& nodeName = node->getName();
-	const GMMat4& transformation = node->getTransformToParent();
-	const GMSkeletalAnimationNode* animationNode = findAnimationNode(nodeName);
-	GMMat4 nodeTransformation = node->getTransformToParent();
-	GMfloat factor = 0;
+	d->binding = binding;
+	d->cursors.assign(binding->channels.size(), GMSkeletalKeyframeCursor());
+	d->localTransforms.resize(binding->hierarchy.getNodeCount());
+	d->globalTransforms.resize(binding->hierarchy.getNodeCount());
 
-	if (animationNode)
+	// 有动画通道的节点，在通道没有平移或者缩放关键帧时使用零平移和单位缩放
+	d->pose = binding->hierarchy.getBindPose();
+	for (auto node : binding->channelNodes)
 	{
-		// Position
-		GMVec3 currentPosition;
-		if (!animationNode->positions.empty())
+		d->pose.getStream(GMSkeletalPose::PositionX)[node] = 0;
+		d->pose.getStream(GMSkeletalPose::PositionY)[node] = 0;
+		d->pose.getStream(GMSkeletalPose::PositionZ)[node] = 0;
+		d->pose.getStream(GMSkeletalPose::ScalingX)[node] = 1;
+		d->pose.getStream(GMSkeletalPose::ScalingY)[node] = 1;
+		d->pose.getStream(GMSkeletalPose::ScalingZ)[node] = 1;
+	}
+
+	// 填充的通道保持单位四元数，不会被写入
+	const GMsize_t stride = alignedChannelCount(binding->channels.size());
+	d->samples.assign(stride * SampleStreamCount, 0);
+	GMfloat* samples = d->samples.data();
+	std::fill_n(samples + Rotation0W * stride, stride, 1.f);
+	std::fill_n(samples + Rotation1W * stride, stride, 1.f);
+}
+
+void GMSkeletalAnimationEvaluator::sampleChannels(GMDuration animationTime)
+{
+	D(d);
+	if (d->animation->compressed)
+	{
+		sampleCompressedChannels(animationTime);
+		return;
+	}
+
+	const GMSkeletalAnimationBinding& binding = *d->binding;
+	const GMsize_t count = binding.channels.size();
+	const GMsize_t stride = alignedChannelCount(count);
+	GMfloat* samples = d->samples.data();
+	GMSkeletalPose& pose = d->pose;
+
+	for (GMsize_t c = 0; c < count; ++c)
+	{
+		const GMSkeletalAnimationNode& animationNode = d->animation->nodes[binding.channels[c]];
+		GMSkeletalKeyframeCursor& cursor = d->cursors[c];
+		const GMint32 node = binding.channelNodes[c];
+
+		if (!animationNode.rotations.empty())
 		{
-			const auto& v = animationNode->positions;
-			if (v.size() > 1)
-			{
-				GMfloat frameIdx = findIndex(animationTime, v);
-				GMfloat nextFrameIdx = frameIdx + 1;
-				const auto& frame = v[frameIdx];
-				const auto& nextFrame = v[nextFrameIdx];
-				factor = (animationTime - frame.time) / (nextFrame.time - frame.time);
-				currentPosition = Lerp(frame.value, nextFrame.value, factor);
-			}
-			else
-			{
-				currentPosition = v[0].value;
-			}
+			GMsize_t next;
+			GMsize_t frameIdx = findKeyframes(animationTime, animationNode.rotations, cursor.rotation, next, samples[RotationFactor * stride + c]);
+			writeQuat(animationNode.rotations[frameIdx].value, samples + Rotation0X * stride + c, samples + Rotation0Y * stride + c, samples + Rotation0Z * stride + c, samples + Rotation0W * stride + c);
+			writeQuat(animationNode.rotations[next].value, samples + Rotation1X * stride + c, samples + Rotation1Y * stride + c, samples + Rotation1Z * stride + c, samples + Rotation1W * stride + c);
 		}
 
-		// Rotation
-		GMQuat currentRotation;
-		if (!animationNode->rotations.empty())
+		// 平移和缩放直接写入节点的姿势
+		sampleVec3(animationTime, animationNode.positions, cursor.position, pose.getStream(GMSkeletalPose::PositionX) + node, pose.getStream(GMSkeletalPose::PositionY) + node, pose.getStream(GMSkeletalPose::PositionZ) + node);
+		sampleVec3(animationTime, animationNode.scalings, cursor.scaling, pose.getStream(GMSkeletalPose::ScalingX) + node, pose.getStream(GMSkeletalPose::ScalingY) + node, pose.getStream(GMSkeletalPose::ScalingZ) + node);
+	}
+}
+
+void GMSkeletalAnimationEvaluator::sampleCompressedChannels(GMDuration animationTime)
+{
+	D(d);
+	const GMSkeletalAnimationBinding& binding = *d->binding;
+	const GMSkeletalCompressedAnimation& compressed = *d->animation->compressed;
+	const GMsize_t count = binding.channels.size();
+	const GMsize_t stride = alignedChannelCount(count);
+	GMfloat* samples = d->samples.data();
+	GMSkeletalPose& pose = d->pose;
+
+	// 与sampleChannels()相同，旋转解码到采样缓冲中由composePose()插值，平移和缩放直接解码到节点的姿势
+	for (GMsize_t c = 0; c < count; ++c)
+	{
+		const GMSkeletalCompressedChannel& channel = compressed.getChannels()[binding.channels[c]];
+		GMSkeletalKeyframeCursor& cursor = d->cursors[c];
+		const GMint32 node = binding.channelNodes[c];
+
+		if (channel.rotations.keyCount > 0)
 		{
-			const auto& v = animationNode->rotations;
-			if (v.size() > 1)
-			{
-				GMfloat frameIdx = findIndex(animationTime, v);
-				GMfloat nextFrameIdx = frameIdx + 1;
-				const auto& frame = v[frameIdx];
-				const auto& nextFrame = v[nextFrameIdx];
-				factor = (animationTime - frame.time) / (nextFrame.time - frame.time);
-				GMDuration diffTime = nextFrame.time - frame.time;
-				currentRotation = Lerp(frame.value, nextFrame.value, factor);
-			}
-			else
-			{
-				currentRotation = v[0].value;
-			}
+			GMsize_t key0, key1;
+			compressed.findKeys(channel.rotations, animationTime, cursor.rotation, key0, key1, samples[RotationFactor * stride + c]);
+			compressed.decodeRotation(channel.rotations, key0, samples + Rotation0X * stride + c, samples + Rotation0Y * stride + c, samples + Rotation0Z * stride + c, samples + Rotation0W * stride + c);
+			compressed.decodeRotation(channel.rotations, key1, samples + Rotation1X * stride + c, samples + Rotation1Y * stride + c, samples + Rotation1Z * stride + c, samples + Rotation1W * stride + c);
 		}
 
-		// Scaling
-		GMVec3 currentScaling;
-		if (!animationNode->scalings.empty())
+		compressed.sampleVector(channel.positions, animationTime, cursor.position, pose.getStream(GMSkeletalPose::PositionX) + node, pose.getStream(GMSkeletalPose::PositionY) + node, pose.getStream(GMSkeletalPose::PositionZ) + node);
+		compressed.sampleVector(channel.scalings, animationTime, cursor.scaling, pose.getStream(GMSkeletalPose::ScalingX) + node, pose.getStream(GMSkeletalPose::ScalingY) + node, pose.getStream(GMSkeletalPose::ScalingZ) + node);
+	}
+}
+
+void GMSkeletalAnimationEvaluator::composePose()
+{
+	D(d);
+	const GMSkeletalAnimationBinding& binding = *d->binding;
+	const GMsize_t count = binding.channels.size();
+	const GMsize_t stride = alignedChannelCount(count);
+	const GMfloat* samples = d->samples.data();
+	GMfloat* rotations[] = {
+		d->pose.getStream(GMSkeletalPose::RotationX),
+		d->pose.getStream(GMSkeletalPose::RotationY),
+		d->pose.getStream(GMSkeletalPose::RotationZ),
+		d->pose.getStream(GMSkeletalPose::RotationW),
+	};
+
+#if GM_SIMD_SSE2
+	for (GMsize_t c = 0; c < count; c += 4)
+	{
+		const __m128 q0[4] = {
+			_mm_loadu_ps(samples + Rotation0X * stride + c),
+			_mm_loadu_ps(samples + Rotation0Y * stride + c),
+			_mm_loadu_ps(samples + Rotation0Z * stride + c),
+			_mm_loadu_ps(samples + Rotation0W * stride + c),
+		};
+		__m128 q1[4] = {
+			_mm_loadu_ps(samples + Rotation1X * stride + c),
+			_mm_loadu_ps(samples + Rotation1Y * stride + c),
+			_mm_loadu_ps(samples + Rotation1Z * stride + c),
+			_mm_loadu_ps(samples + Rotation1W * stride + c),
+		};
+		__m128 q[4];
+		slerp4(q0, q1, _mm_loadu_ps(samples + RotationFactor * stride + c), q);
+
+		// 将结果分散到每个通道对应的节点上
+		GMfloat result[4][4];
+		for (GMint32 i = 0; i < 4; ++i)
 		{
-			const auto& v = animationNode->scalings;
-			if (v.size() > 1)
-			{
-				GMfloat frameIdx = findIndex(animationTime, v);
-				GMfloat nextFrameIdx = frameIdx + 1;
-				const auto& frame = v[frameIdx];
-				const auto& nextFrame = v[nextFrameIdx];
-				factor = (animationTime - frame.time) / (nextFrame.time - frame.time);
-				GMDuration diffTime = nextFrame.time - frame.time;
-				currentScaling = Lerp(frame.value, nextFrame.value, factor);
-			}
-			else
+			_mm_storeu_ps(result[i], q[i]);
+		}
+
+		for (GMsize_t lane = 0; lane < 4 && c + lane < count; ++lane)
+		{
+			const GMint32 node = binding.channelNodes[c + lane];
+			for (GMint32 i = 0; i < 4; ++i)
 			{
-				currentScaling = v[0].value;
+				rotations[i][node] = result[i][lane];
 			}
 		}
+	}
+#else
+	for (GMsize_t c = 0; c < count; ++c)
+	{
+		GMQuat q0(samples[Rotation0X * stride + c], samples[Rotation0Y * stride + c], samples[Rotation0Z * stride + c], samples[Rotation0W * stride + c]);
+		GMQuat q1(samples[Rotation1X * stride + c], samples[Rotation1Y * stride + c], samples[Rotation1Z * stride + c], samples[Rotation1W * stride + c]);
+		GMQuat rotation = slerp(q0, q1, samples[RotationFactor * stride + c]);
+		const GMint32 node = binding.channelNodes[c];
+		rotations[0][node] = rotation.getX();
+		rotations[1][node] = rotation.getY();
+		rotations[2][node] = rotation.getZ();
+		rotations[3][node] = rotation.getW();
+	}
+#endif
+}
 
-		nodeTransformation = Scale(currentScaling) * QuatToMatrix(currentRotation) * Translate(currentPosition);
+void GMSkeletalAnimationEvaluator::updateGlobalTransforms()
+{
+	D(d);
+	const GMSkeletalAnimationBinding& binding = *d->binding;
+	const Vector<GMint32>& parents = binding.hierarchy.getParents();
+	const AlignedVector<GMMat4>& localTransforms = d->localTransforms;
+	AlignedVector<GMMat4>& globalTransforms = d->globalTransforms;
+
+	// 节点按照先序排列，父节点总是在子节点之前计算完成
+	for (GMsize_t i = 0; i < parents.size(); ++i)
+	{
+		if (parents[i] < 0)
+			globalTransforms[i] = localTransforms[i];
+		else
+			multiplyTransform(localTransforms[i], globalTransforms[parents[i]], globalTransforms[i]);
 	}
 
-	GMMat4 globalTransformation = nodeTransformation * parentTransformation;
+	const auto& bones = d->skeleton->getBones().getBones();
+	AlignedVector<GMMat4>& transforms = d->transforms;
+	transforms.resize(bones.size());
+	for (GMsize_t i = 0; i < bones.size(); ++i)
+	{
+		const GMint32 node = binding.boneNodes[i];
+		if (node < 0)
+		{
+			transforms[i] = binding.restTransforms[i];
+		}
+		else
+		{
+			GMMat4 boneTransform;
+			multiplyTransform(bones[i].offsetMatrix, globalTransforms[node], boneTransform);
+			multiplyTransform(boneTransform, d->globalInverseTransform, transforms[i]);
+		}
+	}
+}
 
-	// 把变换结果保存
-	auto& boneMapping = d->skeleton->getBones().getBoneNameIndexMap();
-	auto& boneInfo = d->skeleton->getBones().getBones();
-	if (boneMapping.find(nodeName) != boneMapping.end())
+namespace
+{
+	// 骨骼数据被析构过时，键中的地址可能已经被新的对象复用，移除所有的结果。调用者需要持有独占锁。
+	void dropStaleEntries(GM_PRIVATE_NAME(GMSkeletalPoseCache)& data)
 	{
-		GMsize_t idx = boneMapping[nodeName];
-		auto& bone = boneInfo[idx];
-		bone.finalTransformation = bone.offsetMatrix * globalTransformation * d->globalInverseTransform;
+		GMint64 generation = GMSkeletalDataGeneration::current();
+		if (data.dataGeneration == generation)
+			return;
+
+		for (auto& entry : data.entries)
+		{
+			data.freeTransforms.push_back(std::move(entry.second.transforms));
+		}
+		data.entries.clear();
+		data.dataGeneration = generation;
 	}
+}
 
-	for (auto& child : node->getChildren())
+bool GMSkeletalPoseCache::find(const GMSkeletalPoseKey& key, OUT AlignedVector<GMMat4>& transforms)
+{
+	D(d);
+	GMSharedLockGuard<GMReadWriteLock> lock(d->lock);
+	if (d->dataGeneration != GMSkeletalDataGeneration::current())
+		return false;
+
+	auto iter = d->entries.find(key);
+	if (iter == d->entries.end())
+		return false;
+
+	iter->second.frame.store(d->frame, std::memory_order_relaxed);
+	transforms = iter->second.transforms;
+	return true;
+}
+
+void GMSkeletalPoseCache::insert(const GMSkeletalPoseKey& key, const AlignedVector<GMMat4>& transforms)
+{
+	D(d);
+	GMLockGuard<GMReadWriteLock> lock(d->lock);
+	dropStaleEntries(*d);
+	auto result = d->entries.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple());
+	auto& entry = result.first->second;
+	if (result.second && !d->freeTransforms.empty())
 	{
-		updateNode(animationTime, child, globalTransformation);
+		// 重复使用被移除的结果的内存
+		entry.transforms.swap(d->freeTransforms.back());
+		d->freeTransforms.pop_back();
 	}
+	entry.transforms = transforms;
+	entry.frame.store(d->frame, std::memory_order_relaxed);
 }
 
-const GMSkeletalAnimationNode* GMSkeletalAnimationEvaluator::findAnimationNode(const GMString& name)
+void GMSkeletalPoseCache::nextFrame()
 {
 	D(d);
-	for (auto& node : d->animation->nodes)
+	GMLockGuard<GMReadWriteLock> lock(d->lock);
+	dropStaleEntries(*d);
+	for (auto iter = d->entries.begin(); iter != d->entries.end();)
 	{
-		if (node.name == name)
-			return &node;
+		if (iter->second.frame.load(std::memory_order_relaxed) < d->frame)
+		{
+			d->freeTransforms.push_back(std::move(iter->second.transforms));
+			iter = d->entries.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
 	}
-	return nullptr;
+	++d->frame;
 }
-GMSkeletalGameObject::~GMSkeletalGameObject()
+
+void GMSkeletalPoseCache::clear()
 {
 	D(d);
-	for (auto& kv : d->modelEvaluatorMap)
+	GMLockGuard<GMReadWriteLock> lock(d->lock);
+	d->entries.clear();
+	d->freeTransforms.clear();
+	d->dataGeneration = GMSkeletalDataGeneration::current();
+}
+
+GMsize_t GMSkeletalPoseCache::getEntryCount() const
+{
+	D(d);
+	GMSharedLockGuard<GMReadWriteLock> lock(d->lock);
+	return d->entries.size();
+}
+
+GMSkeletalModelEvaluators::~GMSkeletalModelEvaluators()
+{
+	GM_delete(base);
+	GM_delete(fading);
+	for (auto& layer : layers)
 	{
-		GM_delete(kv.second);
+		GM_delete(layer.evaluator);
 	}
 }
 
+GMSkeletalGameObject::~GMSkeletalGameObject()
+{
+	D(d);
+	d->modelEvaluatorMap.clear();
+}
+
 void GMSkeletalGameObject::update(GMDuration dt)
 {
 	D(d);
@@ -178,29 +719,178 @@ void GMSkeletalGameObject::update(GMDuration dt)
 		if (!scene)
 			return;
 
+		auto animations = scene->getAnimations();
+		if (!animations)
+			return;
+
+		bool fading = d->fadeElapsed < d->fadeDuration;
+		if (fading)
+			d->fadeElapsed += dt;
+
+		// 只有没有混合的结果才能被缓存
+		bool blending = fading;
+		for (const auto& layer : d->layers)
+		{
+			if (layer.weight > 0)
+				blending = true;
+		}
+
+		GMSkeletalPoseCache* cache = nullptr;
+		if (d->poseCacheEnabled && !blending && getWorld())
+			cache = &getWorld()->getSkeletalPoseCache();
+
+		d->updatingModels.clear();
+		d->blendingModels.clear();
+		d->updatingEvaluators.clear();
 		for (auto& model : scene->getModels())
 		{
 			auto skeleton = model.getModel()->getSkeleton();
-			if (skeleton)
+			if (!skeleton)
+				continue;
+
+			GMSkeletalModelEvaluators& evaluators = d->modelEvaluatorMap[model.getModel()];
+			if (!evaluators.base)
+				evaluators.base = new GMSkeletalAnimationEvaluator(scene->getRootNode(), skeleton);
+
+			GMSkeletalModelUpdate update;
+			update.model = model.getModel();
+			update.evaluators = &evaluators;
+
+			evaluators.base->setAnimation(animations->getAnimation(d->animationIndex));
+			evaluators.base->setTimeQuantum(cache ? d->poseCacheQuantum : 0);
+			evaluators.base->advance(dt);
+			if (cache)
 			{
-				auto animations = scene->getAnimations();
-				if (animations)
+				update.cached = true;
+				update.key.skeleton = skeleton;
+				update.key.rootNode = scene->getRootNode();
+				update.key.animation = evaluators.base->getAnimation();
+				update.key.animationTime = evaluators.base->getAnimationTime();
+
+				// 先在这一次更新中查找，然后再查找缓存
+				for (GMsize_t i = 0; i < d->updatingModels.size(); ++i)
+				{
+					const GMSkeletalModelUpdate& other = d->updatingModels[i];
+					if (other.cached && other.source < 0 && other.key == update.key)
+					{
+						update.source = gm_sizet_to_int(i);
+						break;
+					}
+				}
+
+				if (update.source < 0)
+					update.cacheHit = cache->find(update.key, update.model->getBoneTransformations());
+
+				if (update.source >= 0 || update.cacheHit)
 				{
-					GMSkeletalAnimationEvaluator* evaluator = d->modelEvaluatorMap[model.getModel()];
-					if (!evaluator)
-						evaluator = d->modelEvaluatorMap[model.getModel()] = new GMSkeletalAnimationEvaluator(scene->getRootNode(), skeleton);
+					d->updatingModels.push_back(update);
+					continue;
+				}
+			}
 
-					evaluator->setAnimation(animations->getAnimation(d->animationIndex));
-					evaluator->update(dt);
+			d->updatingEvaluators.push_back(evaluators.base);
+			if (fading && evaluators.fading)
+			{
+				evaluators.fading->setAnimation(animations->getAnimation(d->fadingAnimationIndex));
+				evaluators.fading->advance(dt);
+				d->updatingEvaluators.push_back(evaluators.fading);
+			}
 
-					auto& transforms = evaluator->getTransforms();
-					model.getModel()->getBoneTransformations().swap(transforms);
+			evaluators.layers.resize(d->layers.size());
+			for (GMsize_t i = 0; i < d->layers.size(); ++i)
+			{
+				const GMSkeletalAnimationLayer& layer = d->layers[i];
+				GMSkeletalLayerEvaluator& layerEvaluator = evaluators.layers[i];
+				if (!layerEvaluator.evaluator)
+					layerEvaluator.evaluator = new GMSkeletalAnimationEvaluator(scene->getRootNode(), skeleton);
+
+				if (layer.weight > 0)
+				{
+					layerEvaluator.evaluator->setAnimation(animations->getAnimation(layer.animationIndex));
+					layerEvaluator.evaluator->advance(dt);
+					d->updatingEvaluators.push_back(layerEvaluator.evaluator);
 				}
 			}
+
+			d->updatingModels.push_back(update);
+			d->blendingModels.push_back(&evaluators);
+		}
+
+		// 先求出所有动画的姿势，然后按照模型进行混合。时间已经推进过了
+		GMSkeletalAnimationEvaluator::evaluatePoseBatch(d->updatingEvaluators.data(), d->updatingEvaluators.size(), 0);
+
+		GMfloat fadeWeight = fading ? Min(d->fadeElapsed / d->fadeDuration, 1.f) : 1.f;
+		parallelInvoke(d->blendingModels.size(), EvaluatorsPerJob, [this, d, fading, fadeWeight](GMsize_t begin, GMsize_t end) {
+			for (GMsize_t i = begin; i < end; ++i)
+			{
+				blendPose(*d->blendingModels[i], fading, fadeWeight);
+			}
+		});
+
+		for (auto& update : d->updatingModels)
+		{
+			if (update.cacheHit)
+				continue;
+
+			auto& boneTransformations = update.model->getBoneTransformations();
+			if (update.source >= 0)
+			{
+				boneTransformations = d->updatingModels[update.source].model->getBoneTransformations();
+				continue;
+			}
+
+			boneTransformations.swap(update.evaluators->base->getTransforms());
+			if (update.cached)
+				cache->insert(update.key, boneTransformations);
 		}
 	}
 }
 
+void GMSkeletalGameObject::blendPose(GMSkeletalModelEvaluators& evaluators, bool fading, GMfloat fadeWeight)
+{
+	D(d);
+	GMSkeletalAnimationEvaluator* base = evaluators.base;
+	GMSkeletalPose& pose = base->getPose();
+	if (fading && evaluators.fading)
+		pose.blend(evaluators.fading->getPose(), 1 - fadeWeight, nullptr);
+
+	const GMSkeletalHierarchy& hierarchy = base->getHierarchy();
+	for (GMsize_t i = 0; i < d->layers.size(); ++i)
+	{
+		const GMSkeletalAnimationLayer& layer = d->layers[i];
+		if (layer.weight <= 0)
+			continue;
+
+		GMSkeletalLayerEvaluator& layerEvaluator = evaluators.layers[i];
+		if (layerEvaluator.maskVersion != layer.maskVersion)
+			updateLayerMask(layer, layerEvaluator, hierarchy);
+
+		const GMfloat* nodeWeights = layer.mask.empty() ? nullptr : layerEvaluator.nodeWeights.data();
+		if (layer.mode == GMSkeletalBlendMode::Additive)
+			pose.blendAdditive(layerEvaluator.evaluator->getPose(), hierarchy.getBindPose(), layer.weight, nodeWeights);
+		else
+			pose.blend(layerEvaluator.evaluator->getPose(), layer.weight, nodeWeights);
+	}
+
+	base->applyPose();
+}
+
+void GMSkeletalGameObject::updateLayerMask(const GMSkeletalAnimationLayer& layer, GMSkeletalLayerEvaluator& layerEvaluator, const GMSkeletalHierarchy& hierarchy)
+{
+	layerEvaluator.maskVersion = layer.maskVersion;
+	layerEvaluator.nodeWeights.assign(hierarchy.getBindPose().getStride(), 0);
+
+	// 节点按照先序排列，父节点的权重总是先计算完成
+	const auto& nodes = hierarchy.getNodes();
+	const auto& parents = hierarchy.getParents();
+	for (GMsize_t i = 0; i < nodes.size(); ++i)
+	{
+		bool masked = std::find(layer.mask.begin(), layer.mask.end(), nodes[i]->getName()) != layer.mask.end();
+		if (masked || (parents[i] >= 0 && layerEvaluator.nodeWeights[parents[i]] > 0))
+			layerEvaluator.nodeWeights[i] = 1;
+	}
+}
+
 bool GMSkeletalGameObject::isSkeletalObject() const
 {
 	return true;
@@ -229,11 +919,20 @@ void GMSkeletalGameObject::pause()
 void GMSkeletalGameObject::reset(bool update)
 {
 	D(d);
-	for (auto& evaluator : d->modelEvaluatorMap)
+	for (auto& kv : d->modelEvaluatorMap)
 	{
-		if (evaluator.second)
-			evaluator.second->reset();
+		GMSkeletalModelEvaluators& evaluators = kv.second;
+		if (evaluators.base)
+			evaluators.base->reset();
+		if (evaluators.fading)
+			evaluators.fading->reset();
+		for (auto& layer : evaluators.layers)
+		{
+			if (layer.evaluator)
+				layer.evaluator->reset();
+		}
 	}
+	d->fadeDuration = d->fadeElapsed = 0;
 
 	if (update)
 	{
@@ -259,4 +958,98 @@ GMsize_t GMSkeletalGameObject::getAnimationCount()
 		return 0;
 
 	return scene->getAnimations()->getAnimationCount();
-}
\ No newline at end of file
+}
+
+void GMSkeletalGameObject::setAnimation(GMsize_t index)
+{
+	D(d);
+	d->animationIndex = index;
+	d->fadeDuration = d->fadeElapsed = 0;
+	for (auto& kv : d->modelEvaluatorMap)
+	{
+		if (kv.second.base)
+			kv.second.base->reset();
+	}
+}
+
+void GMSkeletalGameObject::crossfade(GMsize_t index, GMDuration duration)
+{
+	D(d);
+	if (duration <= 0)
+	{
+		setAnimation(index);
+		return;
+	}
+
+	// 当前的动画开始淡出，新的动画使用上一次淡出的求值器，从头开始播放
+	for (auto& kv : d->modelEvaluatorMap)
+	{
+		GMSkeletalModelEvaluators& evaluators = kv.second;
+		if (!evaluators.base)
+			continue;
+
+		std::swap(evaluators.base, evaluators.fading);
+		if (!evaluators.base)
+			evaluators.base = new GMSkeletalAnimationEvaluator(evaluators.fading->getRootNode(), evaluators.fading->getSkeleton());
+		evaluators.base->reset();
+	}
+
+	d->fadingAnimationIndex = d->animationIndex;
+	d->animationIndex = index;
+	d->fadeDuration = duration;
+	d->fadeElapsed = 0;
+}
+
+GMsize_t GMSkeletalGameObject::getAnimationIndex()
+{
+	D(d);
+	return d->animationIndex;
+}
+
+GMsize_t GMSkeletalGameObject::addLayer(GMsize_t animationIndex, GMSkeletalBlendMode mode, GMfloat weight)
+{
+	D(d);
+	GMSkeletalAnimationLayer layer;
+	layer.animationIndex = animationIndex;
+	layer.mode = mode;
+	layer.weight = weight;
+	d->layers.push_back(std::move(layer));
+	return d->layers.size() - 1;
+}
+
+void GMSkeletalGameObject::removeLayer(GMsize_t layer)
+{
+	D(d);
+	GM_ASSERT(layer < d->layers.size());
+	d->layers.erase(d->layers.begin() + layer);
+	for (auto& kv : d->modelEvaluatorMap)
+	{
+		auto& layers = kv.second.layers;
+		if (layer < layers.size())
+		{
+			GM_delete(layers[layer].evaluator);
+			layers.erase(layers.begin() + layer);
+		}
+	}
+}
+
+void GMSkeletalGameObject::setLayerWeight(GMsize_t layer, GMfloat weight)
+{
+	D(d);
+	GM_ASSERT(layer < d->layers.size());
+	d->layers[layer].weight = weight;
+}
+
+void GMSkeletalGameObject::setLayerMask(GMsize_t layer, const Vector<GMString>& nodeNames)
+{
+	D(d);
+	GM_ASSERT(layer < d->layers.size());
+	d->layers[layer].mask = nodeNames;
+	++d->layers[layer].maskVersion;
+}
+
+GMsize_t GMSkeletalGameObject::getLayerCount()
+{
+	D(d);
+	return d->layers.size();
+}
@@ -2,8 +2,34 @@
 #define __GMSKELETONGAMEOBJECT_H__
 #include <gmcommon.h>
 #include <gmgameobject.h>
+#include <gmthread.h>
 BEGIN_NS
 
+//! 记录一个动画通道上次查找到的关键帧。
+struct GMSkeletalKeyframeCursor
+{
+	GMsize_t position = 0;
+	GMsize_t rotation = 0;
+	GMsize_t scaling = 0;
+};
+
+//! 一个骨骼动画在一个骨架上的绑定结果。
+/*!
+  绑定时将骨架展开为GMSkeletalHierarchy，并将动画通道和骨骼按照名称对应到展开后的节点索引上。
+  绑定结果是只读的，因此同一个骨架上播放同一个动画的多个求值器可以共享它。
+*/
+GM_ALIGNED_STRUCT(GMSkeletalAnimationBinding)
+{
+	const GMSkeletalAnimation* animation = nullptr;
+	const GMSkeleton* skeleton = nullptr;
+	const GMSkeletalNode* rootNode = nullptr;
+	GMSkeletalHierarchy hierarchy;
+	Vector<GMint32> channels; //!< 有对应节点的动画通道
+	Vector<GMint32> channelNodes; //!< channels中每个通道对应的节点
+	Vector<GMint32> boneNodes; //!< 每个骨骼对应的节点，-1表示没有对应的节点
+	AlignedVector<GMMat4> restTransforms; //!< 没有对应节点的骨骼使用的变换
+};
+
 GM_PRIVATE_OBJECT(GMSkeletalAnimationEvaluator)
 {
 	const GMSkeletalAnimation* animation = nullptr;
@@ -12,8 +38,24 @@ GM_PRIVATE_OBJECT(GMSkeletalAnimationEvaluator)
 	GMSkeleton* skeleton = nullptr;
 	GMSkeletalNode* rootNode = nullptr;
 	GMMat4 globalInverseTransform;
+	GMDuration timeQuantum = 0;
+
+	GMSharedPtr<const GMSkeletalAnimationBinding> binding;
+	Vector<GMSkeletalKeyframeCursor> cursors; //!< 每个动画通道的关键帧游标
+	GMSkeletalPose pose; //!< 每个节点的局部姿势
+	AlignedVector<GMMat4> localTransforms; //!< 每个节点相对于父节点的变换
+	AlignedVector<GMMat4> globalTransforms; //!< 每个节点在模型空间中的变换
+	AlignedVector<GMfloat> samples; //!< 每帧从关键帧中取出的旋转，按照通道以SoA的方式存放
 };
 
+//! 骨骼动画求值器。
+/*!
+  求值器在一个骨架上播放一个骨骼动画，每一帧计算出所有骨骼的变换。<BR>
+  每一帧分为3步：首先从关键帧中取出每个通道的平移、旋转和缩放，以SIMD的方式一次处理4个通道，进行四元数的球面插值，
+  得到每个节点的局部姿势（evaluatePose()）；然后将姿势合成为节点的局部变换；最后按照展开后的层级顺序，
+  在一次线性的遍历中求出每个节点在模型空间中的变换（applyPose()）。<BR>
+  在两个步骤之间，可以修改getPose()中的姿势，以混合其它的动画。
+*/
 class GMSkeletalAnimationEvaluator
 {
 	GM_DECLARE_PRIVATE_NGO(GMSkeletalAnimationEvaluator)
@@ -22,6 +64,8 @@ class GMSkeletalAnimationEvaluator
 	GM_DECLARE_PROPERTY(RootNode, rootNode)
 	GM_DECLARE_PROPERTY(Animation, animation)
 	GM_DECLARE_GETTER(Transforms, transforms)
+	GM_DECLARE_GETTER(Pose, pose)
+	GM_DECLARE_PROPERTY(TimeQuantum, timeQuantum)
 
 public:
 	GMSkeletalAnimationEvaluator(GMSkeletalNode* root, GMSkeleton* skeleton);
@@ -30,9 +74,185 @@ public:
 	void update(GMDuration dt);
 	void reset();
 
+	//! 推进动画的时间，并求出每个节点的局部姿势，结果保存在getPose()中。
+	void evaluatePose(GMDuration dt);
+
+	//! 只推进动画的时间，不进行求值。
+	void advance(GMDuration dt);
+
+	//! 获取当前的动画时间，单位为动画的tick。
+	/*!
+	  如果设置了时间的量化间隔（setTimeQuantum()，单位为秒），动画时间会向下对齐到间隔的整数倍，求值也使用对齐后的时间。
+	*/
+	GMDuration getAnimationTime() const;
+
+	//! 由getPose()中的局部姿势求出所有骨骼的变换，结果保存在getTransforms()中。
+	void applyPose();
+
+	//! 获取展开后的骨架层级，只有在求值之后才能调用。
+	const GMSkeletalHierarchy& getHierarchy() const;
+
+public:
+	//! 同时更新多个求值器。
+	/*!
+	  骨架、根节点和动画都相同的求值器共享同一个绑定结果，所有求值器被分成若干组，交给GMJobSystem并行求值。
+	  适用于大量角色使用同一个骨架的场景。
+	  \param evaluators 需要更新的求值器。
+	  \param count 求值器的数量。
+	  \param dt 距离上一次更新经过的时间。
+	*/
+	static void updateBatch(GMSkeletalAnimationEvaluator* const* evaluators, GMsize_t count, GMDuration dt);
+
+	//! 同时推进多个求值器的时间并求出局部姿势，相当于对每个求值器调用evaluatePose()。
+	/*!
+	  \sa updateBatch()
+	*/
+	static void evaluatePoseBatch(GMSkeletalAnimationEvaluator* const* evaluators, GMsize_t count, GMDuration dt);
+
 private:
-	void updateNode(GMDuration animationTime, GMSkeletalNode* node, const GMMat4& parentTransformation);
-	const GMSkeletalAnimationNode* findAnimationNode(const GMString& name);
+	static void bindBatch(GMSkeletalAnimationEvaluator* const* evaluators, GMsize_t count);
+
+	//! 将节点与动画通道、骨骼绑定。
+	/*!
+	  绑定只在动画、骨架或根节点改变时进行一次，之后每一帧直接通过索引访问，不再按名称查找。
+	*/
+	void bind();
+	bool isBound() const;
+	void setBinding(const GMSharedPtr<const GMSkeletalAnimationBinding>& binding);
+	void sampleChannels(GMDuration animationTime);
+	void sampleCompressedChannels(GMDuration animationTime);
+	void composePose();
+	void updateGlobalTransforms();
+};
+
+//! 骨骼动画求值结果的键。
+struct GMSkeletalPoseKey
+{
+	const GMSkeleton* skeleton = nullptr;
+	const GMSkeletalNode* rootNode = nullptr;
+	const GMSkeletalAnimation* animation = nullptr;
+	GMDuration animationTime = 0; //!< 量化后的动画时间
+};
+
+inline bool operator==(const GMSkeletalPoseKey& a, const GMSkeletalPoseKey& b)
+{
+	return a.skeleton == b.skeleton && a.rootNode == b.rootNode && a.animation == b.animation && a.animationTime == b.animationTime;
+}
+
+struct GMSkeletalPoseKeyHashFunctor
+{
+	GMsize_t operator()(const GMSkeletalPoseKey& key) const
+	{
+		std::hash<const void*> pointerHash;
+		GMsize_t seed = pointerHash(key.skeleton);
+		seed ^= pointerHash(key.rootNode) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		seed ^= pointerHash(key.animation) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		seed ^= std::hash<GMDuration>()(key.animationTime) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+		return seed;
+	}
+};
+
+GM_PRIVATE_OBJECT_UNALIGNED(GMSkeletalPoseCache)
+{
+	struct Entry
+	{
+		AlignedVector<GMMat4> transforms;
+		GMAtomic<GMint64> frame{ 0 }; //!< 最后一次使用的帧，查找时只持有共享锁，所以是原子的
+	};
+
+	GMReadWriteLock lock;
+	HashMap<GMSkeletalPoseKey, Entry, GMSkeletalPoseKeyHashFunctor> entries;
+	Vector<AlignedVector<GMMat4>> freeTransforms;
+	GMint64 frame = 0;
+	GMint64 dataGeneration = 0; //!< 结果对应的GMSkeletalDataGeneration
+};
+
+//! 骨骼动画求值结果的缓存。
+/*!
+  以骨架、根节点、动画和量化后的动画时间为键，保存求值得到的所有骨骼的变换。在同一时刻播放同一个动画的模型和实例
+  （例如同步播放待机动画的人群）只需要求值一次，其它的直接复制结果。<BR>
+  缓存由GMGameWorld持有，每一帧开始时，上一帧没有使用过的结果会被移除，它们的内存会被之后的结果重复使用。<BR>
+  骨架、节点或者动画被析构时（见GMSkeletalDataGeneration），所有的结果都会失效，之后的查找不会命中，结果在下一次插入或者下一帧时被移除。<BR>
+  此类是线程安全的，查找只持有共享锁，多个线程可以同时查找。
+*/
+class GM_EXPORT GMSkeletalPoseCache
+{
+	GM_DECLARE_PRIVATE_NGO(GMSkeletalPoseCache)
+	GM_DISABLE_COPY(GMSkeletalPoseCache)
+	GM_DISABLE_ASSIGN(GMSkeletalPoseCache)
+
+public:
+	GMSkeletalPoseCache() = default;
+
+public:
+	//! 查找缓存的骨骼变换。
+	/*!
+	  \param key 求值结果的键。
+	  \param transforms 找到时，骨骼变换被复制到这里。
+	  \return 是否找到。
+	*/
+	bool find(const GMSkeletalPoseKey& key, OUT AlignedVector<GMMat4>& transforms);
+
+	//! 保存一个求值结果。
+	void insert(const GMSkeletalPoseKey& key, const AlignedVector<GMMat4>& transforms);
+
+	//! 开始新的一帧，移除上一帧没有使用过的结果。
+	void nextFrame();
+
+	//! 立即清除所有的结果，并释放它们的内存。
+	void clear();
+
+	GMsize_t getEntryCount() const;
+};
+
+//! 骨骼动画层的混合方式。
+enum class GMSkeletalBlendMode
+{
+	Override, //!< 按照权重，从下层的姿势过渡到此层的姿势
+	Additive, //!< 按照权重，将此层相对于绑定姿势的变化量叠加到下层的姿势上
+};
+
+//! 一个骨骼动画层。
+struct GMSkeletalAnimationLayer
+{
+	GMsize_t animationIndex = 0;
+	GMSkeletalBlendMode mode = GMSkeletalBlendMode::Override;
+	GMfloat weight = 1;
+	Vector<GMString> mask; //!< 此层只影响这些节点及其子节点，为空时影响所有节点
+	GMint32 maskVersion = 0;
+};
+
+//! 一个模型的动画层的求值器。
+struct GMSkeletalLayerEvaluator
+{
+	GMSkeletalAnimationEvaluator* evaluator = nullptr;
+	AlignedVector<GMfloat> nodeWeights; //!< 由动画层的mask得到的每个节点的权重
+	GMint32 maskVersion = -1;
+};
+
+//! 一个模型在GMSkeletalGameObject中使用的所有求值器。
+struct GMSkeletalModelEvaluators
+{
+	GM_DISABLE_COPY(GMSkeletalModelEvaluators)
+	GM_DISABLE_ASSIGN(GMSkeletalModelEvaluators)
+
+	GMSkeletalModelEvaluators() = default;
+	~GMSkeletalModelEvaluators();
+
+	GMSkeletalAnimationEvaluator* base = nullptr; //!< 当前播放的动画
+	GMSkeletalAnimationEvaluator* fading = nullptr; //!< 交叉淡化时，正在淡出的动画
+	Vector<GMSkeletalLayerEvaluator> layers;
+};
+
+//! 一个模型在一次更新中的状态。
+struct GMSkeletalModelUpdate
+{
+	GMModel* model = nullptr;
+	GMSkeletalModelEvaluators* evaluators = nullptr;
+	GMSkeletalPoseKey key;
+	bool cached = false; //!< 是否可以使用缓存
+	bool cacheHit = false; //!< 骨骼变换是否已经从缓存中得到
+	GMint32 source = -1; //!< 与同一次更新中的另外一个模型结果相同时，为那个模型的索引
 };
 
 GM_PRIVATE_OBJECT(GMSkeletalGameObject)
@@ -41,14 +261,31 @@ GM_PRIVATE_OBJECT(GMSkeletalGameObject)
 
 	bool playing = true;
 	GMVec4 skeletonColor = GMVec4(0, 1, 0, 1);
-	Map<GMModel*, GMSkeletalAnimationEvaluator*> modelEvaluatorMap;
+	Map<GMModel*, GMSkeletalModelEvaluators> modelEvaluatorMap;
+	Vector<GMSkeletalModelUpdate> updatingModels;
+	Vector<GMSkeletalModelEvaluators*> blendingModels;
+	Vector<GMSkeletalAnimationEvaluator*> updatingEvaluators;
+	bool poseCacheEnabled = true;
+	GMDuration poseCacheQuantum = 0;
 	GMsize_t animationIndex = 0;
+	GMsize_t fadingAnimationIndex = 0;
+	GMDuration fadeDuration = 0;
+	GMDuration fadeElapsed = 0;
+	Vector<GMSkeletalAnimationLayer> layers;
 };
 
+//! 播放骨骼动画的游戏对象。
+/*!
+  没有进行交叉淡化，也没有权重大于0的动画层时，模型的骨骼变换会保存在GMGameWorld的GMSkeletalPoseCache中，
+  使用同一个骨架、在同一时刻播放同一个动画的模型和实例直接复用这个结果。<BR>
+  通过setPoseCacheQuantum()设置量化间隔（单位为秒）之后，动画时间会向下对齐到间隔的整数倍，时间相近的实例也可以共享结果。
+*/
 class GM_EXPORT GMSkeletalGameObject : public GMGameObject
 {
 	GM_DECLARE_PRIVATE_AND_BASE(GMSkeletalGameObject, GMGameObject)
 	GM_DECLARE_PROPERTY(SkeletonColor, skeletonColor)
+	GM_DECLARE_PROPERTY(PoseCacheEnabled, poseCacheEnabled)
+	GM_DECLARE_PROPERTY(PoseCacheQuantum, poseCacheQuantum)
 
 public:
 	enum { AutoPlayFrame = -1 };
@@ -66,6 +303,46 @@ public:
 	void reset(bool update);
 	GMsize_t getAnimationCount();
 
+	//! 立即切换到另外一个动画，动画从头开始播放。
+	void setAnimation(GMsize_t index);
+
+	//! 在一段时间内从当前的动画平滑地过渡到另外一个动画。
+	/*!
+	  过渡期间两个动画同时播放，姿势的权重随时间线性变化。如果上一次过渡还没有结束，正在淡出的动画会被直接丢弃。
+	  \param index 需要过渡到的动画的索引。
+	  \param duration 过渡的时间，不大于0时等同于setAnimation()。
+	*/
+	void crossfade(GMsize_t index, GMDuration duration);
+
+	//! 获取当前播放的动画的索引。
+	GMsize_t getAnimationIndex();
+
+	//! 增加一个动画层。
+	/*!
+	  动画层按照增加的顺序，依次混合到当前动画的姿势上。每个动画层有自己的播放时间。
+	  \param animationIndex 动画层播放的动画的索引。
+	  \param mode 动画层的混合方式。
+	  \param weight 动画层的权重，为0时此层不会被求值。
+	  \return 动画层的索引。
+	*/
+	GMsize_t addLayer(GMsize_t animationIndex, GMSkeletalBlendMode mode, GMfloat weight = 1);
+
+	//! 移除一个动画层，之后的动画层的索引减1。
+	void removeLayer(GMsize_t layer);
+
+	//! 设置一个动画层的权重。
+	void setLayerWeight(GMsize_t layer, GMfloat weight);
+
+	//! 设置一个动画层影响的节点。
+	/*!
+	  动画层只影响给定的节点以及它们的子节点，例如只给上半身叠加一个动画。
+	  \param layer 动画层的索引。
+	  \param nodeNames 节点的名称，为空时影响所有节点。
+	*/
+	void setLayerMask(GMsize_t layer, const Vector<GMString>& nodeNames);
+
+	GMsize_t getLayerCount();
+
 public:
 	inline bool isPlaying() GM_NOEXCEPT
 	{
@@ -75,6 +352,8 @@ public:
 
 private:
 	void updateSkeleton();
+	void blendPose(GMSkeletalModelEvaluators& evaluators, bool fading, GMfloat fadeWeight);
+	void updateLayerMask(const GMSkeletalAnimationLayer& layer, GMSkeletalLayerEvaluator& layerEvaluator, const GMSkeletalHierarchy& hierarchy);
 };
 
 END_NS
@@ -129,6 +129,7 @@ const GMAsset& GMAsset::invalidAsset()
 GMAsset GMAssets::addAsset(GMAsset asset)
 {
 	D(d);
+	GMLockGuard<GMReadWriteLock> guard(d->lock);
 	d->unnamedAssets.push_back(asset);
 	return asset;
 }
@@ -136,6 +137,7 @@ GMAsset GMAssets::addAsset(GMAsset asset)
 GMAsset GMAssets::addAsset(const GMString& name, GMAsset asset)
 {
 	D(d);
+	GMLockGuard<GMReadWriteLock> guard(d->lock);
 	auto result = d->childs.insert({ name, asset });
 	if (result.second)
 		return asset;
@@ -145,12 +147,14 @@ GMAsset GMAssets::addAsset(const GMString& name, GMAsset asset)
 GMAsset GMAssets::getAsset(GMsize_t index)
 {
 	D(d);
+	GMSharedLockGuard<GMReadWriteLock> guard(d->lock);
 	return d->unnamedAssets[index];
 }
 
 GMAsset GMAssets::getAsset(const GMString& name)
 {
 	D(d);
+	GMSharedLockGuard<GMReadWriteLock> guard(d->lock);
 	auto iter = d->childs.find(name);
 	if (iter != d->childs.end())
 		return iter->second;
@@ -1,6 +1,7 @@
 ﻿#ifndef __GMASSETS_H__
 #define __GMASSETS_H__
 #include <gmcommon.h>
+#include <gmthread.h>
 BEGIN_NS
 
 struct ITexture;
@@ -120,10 +121,15 @@ inline bool operator !=(const GMAsset& a, const GMAsset& b) GM_NOEXCEPT
 
 GM_PRIVATE_OBJECT_UNALIGNED(GMAssets)
 {
+	GMReadWriteLock lock;
 	Vector<GMAsset> unnamedAssets;
 	HashMap<GMString, GMAsset, GMStringHashFunctor> childs;
 };
 
+//! 资产表。
+/*!
+  资产表可以被多个线程同时读取，添加资产时会独占资产表。
+*/
 class GM_EXPORT GMAssets
 {
 	GM_DECLARE_PRIVATE_NGO(GMAssets)
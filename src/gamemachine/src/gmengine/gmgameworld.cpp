@@ -5,9 +5,16 @@
 #include <algorithm>
 #include <time.h>
 #include "foundation/gamemachine.h"
+#include <extensions/objects/particle/gmparticle.h>
 
 namespace
 {
+	enum
+	{
+		RenderFlag_Deferred = 0x01,
+		RenderFlag_Blend = 0x02,
+	};
+
 	bool needBlend(GMGameObject* object)
 	{
 		GMScene* scene = object->getScene();
@@ -45,7 +52,10 @@ void GMGameWorld::addObjectAndInit(AUTORELEASE GMGameObject* obj)
 void GMGameWorld::renderScene()
 {
 	D(d);
-	static List<GMGameObject*> s_emptyList;
+	static GMGameObjectList s_emptyList;
+	if (getParallelFrame())
+		prepareRenderListParallel();
+
 	IGraphicEngine* engine = d->context->getEngine();
 	if (getRenderPreference() == GMRenderPreference::PreferForwardRendering)
 	{
@@ -80,8 +90,21 @@ const IRenderContext* GMGameWorld::getContext()
 void GMGameWorld::updateGameWorld(GMDuration dt)
 {
 	D(d);
+	d->skeletalPoseCache.nextFrame();
 	auto phyw = getPhysicsWorld();
-	updateGameObjects(dt, phyw, d->gameObjects);
+	if (getParallelFrame())
+	{
+		updateGameObjectsParallel(dt, phyw, d->gameObjects);
+	}
+	else
+	{
+		updateGameObjects(dt, phyw, d->gameObjects);
+		updateParticleSystems(dt);
+		for (auto& frameTask : d->frameTasks)
+		{
+			frameTask.function();
+		}
+	}
 }
 
 void GMGameWorld::clearRenderList()
@@ -89,6 +112,44 @@ void GMGameWorld::clearRenderList()
 	D(d);
 	d->renderList.deferred.clear();
 	d->renderList.forward.clear();
+	d->pendingRenderObjects.clear();
+}
+
+GMFrameTaskHandle GMGameWorld::addFrameTask(GMJobFunction function, GMFrameTaskThread thread)
+{
+	D(d);
+	GMFrameTaskHandle handle = d->nextFrameTaskHandle++;
+	d->frameTasks.push_back({ handle, std::move(function), thread });
+	return handle;
+}
+
+bool GMGameWorld::removeFrameTask(GMFrameTaskHandle handle)
+{
+	D(d);
+	auto iter = std::find_if(d->frameTasks.begin(), d->frameTasks.end(), [handle](const GMWorldFrameTask& task) {
+		return task.handle == handle;
+	});
+	if (iter == d->frameTasks.end())
+		return false;
+	d->frameTasks.erase(iter);
+	return true;
+}
+
+void GMGameWorld::addParticleSystemManager(GMParticleSystemManager* manager)
+{
+	D(d);
+	GM_ASSERT(std::find(d->particleSystemManagers.begin(), d->particleSystemManagers.end(), manager) == d->particleSystemManagers.end());
+	d->particleSystemManagers.push_back(manager);
+}
+
+bool GMGameWorld::removeParticleSystemManager(GMParticleSystemManager* manager)
+{
+	D(d);
+	auto iter = std::find(d->particleSystemManagers.begin(), d->particleSystemManagers.end(), manager);
+	if (iter == d->particleSystemManagers.end())
+		return false;
+	d->particleSystemManagers.erase(iter);
+	return true;
 }
 
 void GMGameWorld::updateGameObjects(GMDuration dt, GMPhysicsWorld* phyw, const Set<GMOwnedPtr<GMGameObject>>& gameObjects)
@@ -101,7 +162,217 @@ void GMGameWorld::updateGameObjects(GMDuration dt, GMPhysicsWorld* phyw, const S
 	}
 }
 
+void GMGameWorld::updateParticleSystems(GMDuration dt)
+{
+	D(d);
+	for (auto manager : d->particleSystemManagers)
+	{
+		manager->update(dt);
+	}
+}
+
+void GMGameWorld::updateGameObjectsParallel(GMDuration dt, GMPhysicsWorld* phyw, const Set<GMOwnedPtr<GMGameObject>>& gameObjects)
+{
+	D(d);
+	// 共享同一个场景的对象（如共享骨骼动画的模型）会修改相同的数据，因此放在同一组中顺序更新，不同组之间并行更新
+	// 分组只在此次更新中使用，因此从帧内存中分配。帧内存由世界自己重置，不依赖GameMachine::renderFrame()，
+	// 这样只调用updateGameWorld()的程序（如没有窗口的服务器）也不会使帧内存无限增长
+	d->frameArena.reset();
+	FrameHashMap<GMScene*, GMsize_t> sceneGroups(0, GMFrameAllocator<std::pair<GMScene* const, GMsize_t>>(&d->frameArena));
+	GMsize_t groupCount = 0;
+	for (decltype(auto) gameObject : gameObjects)
+	{
+		GMScene* scene = gameObject->getScene();
+		GMsize_t groupIndex = groupCount;
+		if (scene)
+		{
+			auto iter = sceneGroups.find(scene);
+			if (iter != sceneGroups.end())
+				groupIndex = iter->second;
+			else
+				sceneGroups[scene] = groupIndex;
+		}
+
+		if (groupIndex == groupCount)
+		{
+			if (d->updateGroups.size() <= groupCount)
+				d->updateGroups.resize(groupCount + 1);
+			d->updateGroups[groupCount].clear();
+			++groupCount;
+		}
+		d->updateGroups[groupIndex].push_back(gameObject.get());
+	}
+
+	// 含有骨骼动画对象的组单独作为骨骼动画求值的节点，其余的组作为普通对象更新的节点，两者互不依赖
+	FrameVector<GMsize_t> objectGroups{ GMFrameAllocator<GMsize_t>(&d->frameArena) };
+	FrameVector<GMsize_t> skeletalGroups{ GMFrameAllocator<GMsize_t>(&d->frameArena) };
+	for (GMsize_t i = 0; i < groupCount; ++i)
+	{
+		const auto& group = d->updateGroups[i];
+		bool skeletal = std::any_of(group.begin(), group.end(), [](GMGameObject* gameObject) {
+			return gameObject->isSkeletalObject();
+		});
+		if (skeletal)
+			skeletalGroups.push_back(i);
+		else
+			objectGroups.push_back(i);
+	}
+
+	auto updateObjectGroups = [d, dt](const FrameVector<GMsize_t>& groups) {
+		GMJobSystem& jobSystem = GMJobSystem::instance();
+		GMsize_t grainSize = groups.size() / (jobSystem.getWorkerCount() * 4 + 1) + 1;
+		jobSystem.parallelFor(0, groups.size(), grainSize, [d, dt, &groups](GMsize_t begin, GMsize_t end) {
+			for (GMsize_t i = begin; i < end; ++i)
+			{
+				for (auto gameObject : d->updateGroups[groups[i]])
+				{
+					gameObject->update(dt);
+				}
+			}
+		});
+	};
+
+	GMFrameGraph& graph = d->frameGraph;
+	graph.clear();
+
+	GMFrameTaskId objectTask = graph.addTask([&updateObjectGroups, &objectGroups]() {
+		updateObjectGroups(objectGroups);
+	});
+	GMFrameTaskId skeletalTask = graph.addTask([&updateObjectGroups, &skeletalGroups]() {
+		updateObjectGroups(skeletalGroups);
+	});
+	Vector<GMFrameTaskId> simulationDependencies = { objectTask, skeletalTask };
+
+	// 物理世界不是线程安全的，在所有对象更新完成后在一个任务中顺序执行
+	if (phyw)
+	{
+		GMFrameTaskId physicsTask = graph.addTask([d, dt, phyw, groupCount]() {
+			for (GMsize_t i = 0; i < groupCount; ++i)
+			{
+				for (auto gameObject : d->updateGroups[i])
+				{
+					phyw->update(dt, gameObject);
+				}
+			}
+		}, simulationDependencies);
+		simulationDependencies = { physicsTask };
+	}
+
+	// 粒子模拟在对象和物理更新之后执行。使用计算着色器的粒子系统需要渲染上下文，因此在调用线程中执行
+	if (!d->particleSystemManagers.empty())
+	{
+		graph.addTask([this, dt]() {
+			updateParticleSystems(dt);
+		}, simulationDependencies, GMFrameTaskThread::MainThread);
+	}
+
+	for (auto& frameTask : d->frameTasks)
+	{
+		graph.addTask(frameTask.function, Vector<GMFrameTaskId>(), frameTask.thread);
+	}
+
+	graph.execute();
+}
+
+void GMGameWorld::prepareRenderListParallel()
+{
+	D(d);
+	GMFrameGraph& graph = d->frameGraph;
+	graph.clear();
+
+	// 计算需要提前裁剪的对象。共享场景的对象会互相覆盖模型的裁剪状态，只能在绘制时裁剪
+	d->frameArena.reset();
+	FrameHashMap<GMScene*, GMint32> sceneRefCount(0, GMFrameAllocator<std::pair<GMScene* const, GMint32>>(&d->frameArena));
+	auto countScene = [&sceneRefCount](GMGameObject* object) {
+		++sceneRefCount[object->getScene()];
+	};
+	for (auto object : d->renderList.deferred)
+		countScene(object);
+	for (auto object : d->renderList.forward)
+		countScene(object);
+	for (auto object : d->pendingRenderObjects)
+		countScene(object);
+
+	d->cullObjects.clear();
+	auto collectCullObject = [d, &sceneRefCount](GMGameObject* object) {
+		if (object->getScene() && sceneRefCount[object->getScene()] == 1 && object->canCullAhead())
+			d->cullObjects.push_back(object);
+	};
+	for (auto object : d->renderList.deferred)
+		collectCullObject(object);
+	for (auto object : d->renderList.forward)
+		collectCullObject(object);
+	for (auto object : d->pendingRenderObjects)
+		collectCullObject(object);
+
+	GMFrameTaskId classifyTask = graph.addTask([d]() {
+		GMsize_t count = d->pendingRenderObjects.size();
+		d->pendingRenderFlags.resize(count);
+		GMJobSystem::instance().parallelFor(0, count, 64, [d](GMsize_t begin, GMsize_t end) {
+			for (GMsize_t i = begin; i < end; ++i)
+			{
+				GMGameObject* object = d->pendingRenderObjects[i];
+				GMbyte flags = 0;
+				if (object->canDeferredRendering())
+					flags |= RenderFlag_Deferred;
+				else if (needBlend(object))
+					flags |= RenderFlag_Blend;
+				d->pendingRenderFlags[i] = flags;
+			}
+		});
+	});
+
+	graph.addTask([d]() {
+		for (GMsize_t i = 0; i < d->pendingRenderObjects.size(); ++i)
+		{
+			GMGameObject* object = d->pendingRenderObjects[i];
+			GMbyte flags = d->pendingRenderFlags[i];
+			if (flags & RenderFlag_Deferred)
+				d->renderList.deferred.push_back(object);
+			else if (flags & RenderFlag_Blend)
+				d->renderList.forward.push_back(object);
+			else
+				d->renderList.forward.push_front(object);
+		}
+		d->pendingRenderObjects.clear();
+	}, { classifyTask });
+
+	graph.addTask([d]() {
+		GMJobSystem::instance().parallelFor(0, d->cullObjects.size(), 1, [d](GMsize_t begin, GMsize_t end) {
+			for (GMsize_t i = begin; i < end; ++i)
+			{
+				d->cullObjects[i]->cullAhead();
+			}
+		});
+	});
+
+	graph.execute();
+}
+
+void GMGameWorld::flushPendingRenderList()
+{
+	D(d);
+	for (auto object : d->pendingRenderObjects)
+	{
+		insertToRenderList(object);
+	}
+	d->pendingRenderObjects.clear();
+}
+
 void GMGameWorld::addToRenderList(GMGameObject* object)
+{
+	D(d);
+	if (getParallelFrame())
+	{
+		// 并行帧模式下，在renderScene时并行计算对象需要放入的渲染列表
+		d->pendingRenderObjects.push_back(object);
+		return;
+	}
+
+	insertToRenderList(object);
+}
+
+void GMGameWorld::insertToRenderList(GMGameObject* object)
 {
 	D(d);
 	if (object->canDeferredRendering())
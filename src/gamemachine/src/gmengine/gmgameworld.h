@@ -5,7 +5,9 @@
 #include "../gmphysics/gmphysicsworld.h"
 #include <gmenums.h>
 #include "gameobjects/gmgameobject.h"
+#include "gameobjects/gmskeletalgameobject.h"
 #include <gmassets.h>
+#include <gmframegraph.h>
 
 BEGIN_NS
 
@@ -13,6 +15,10 @@ class GMControlGameObject;
 class GMCharacter;
 class GMModelDataProxy;
 class GMPhysicsWorld;
+class GMParticleSystemManager;
+
+//! 每帧任务的句柄，用于移除任务。0表示无效的句柄。
+typedef GMuint32 GMFrameTaskHandle;
 
 enum class GMRenderPreference
 {
@@ -22,8 +28,15 @@ enum class GMRenderPreference
 
 struct GMRenderList
 {
-	List<GMGameObject*> forward;
-	List<GMGameObject*> deferred;
+	GMGameObjectList forward;
+	GMGameObjectList deferred;
+};
+
+struct GMWorldFrameTask
+{
+	GMFrameTaskHandle handle;
+	GMJobFunction function;
+	GMFrameTaskThread thread;
 };
 
 GM_PRIVATE_OBJECT(GMGameWorld)
@@ -34,6 +47,17 @@ GM_PRIVATE_OBJECT(GMGameWorld)
 	GMAssets assets;
 	GMRenderPreference renderPreference = GMRenderPreference::PreferForwardRendering;
 	GMRenderList renderList;
+	bool parallelFrame = false; // 是否通过任务图在工作线程中并行更新对象、准备渲染列表
+	GMFrameGraph frameGraph;
+	Vector<GMWorldFrameTask> frameTasks;
+	GMFrameTaskHandle nextFrameTaskHandle = 1;
+	Vector<GMParticleSystemManager*> particleSystemManagers;
+	Vector<Vector<GMGameObject*>> updateGroups;
+	Vector<GMGameObject*> pendingRenderObjects;
+	Vector<GMbyte> pendingRenderFlags;
+	Vector<GMGameObject*> cullObjects;
+	GMSkeletalPoseCache skeletalPoseCache;
+	GMFrameArena frameArena{ 16 * 1024 }; // 并行帧使用的临时数据，每次更新或者准备渲染列表时重置
 };
 
 class GM_EXPORT GMGameWorld : public GMObject
@@ -41,6 +65,7 @@ class GM_EXPORT GMGameWorld : public GMObject
 	GM_DECLARE_PRIVATE(GMGameWorld)
 	GM_FRIEND_CLASS(GMPhysicsWorld)
 	GM_DECLARE_PROPERTY(RenderPreference, renderPreference)
+	GM_DECLARE_PROPERTY(ParallelFrame, parallelFrame)
 
 public:
 	GMGameWorld(const IRenderContext* context);
@@ -61,15 +86,63 @@ public:
 	void addToRenderList(GMGameObject* object);
 	inline GMAssets& getAssets() { D(d); return d->assets; }
 
+	//! 获取此世界中骨骼动画求值结果的缓存。
+	/*!
+	  缓存在每一次updateGameWorld()开始时移除上一帧没有使用过的结果。
+	  \sa GMSkeletalGameObject
+	*/
+	inline GMSkeletalPoseCache& getSkeletalPoseCache() { D(d); return d->skeletalPoseCache; }
+
+	//! 添加一个每帧都会执行的任务。
+	/*!
+	  在并行帧模式下，任务会与对象的更新并行执行。如果任务需要访问渲染上下文，应该将thread设置为GMFrameTaskThread::MainThread。
+	  非并行帧模式下，任务在对象和粒子系统更新之后，按照添加的顺序在调用updateGameWorld()的线程中执行。
+	  \param function 每帧执行的函数。
+	  \param thread 任务执行的线程。
+	  \return 任务的句柄，可以通过removeFrameTask()移除任务。
+	  \sa setParallelFrame(), removeFrameTask()
+	*/
+	GMFrameTaskHandle addFrameTask(GMJobFunction function, GMFrameTaskThread thread = GMFrameTaskThread::Worker);
+
+	//! 移除一个每帧都会执行的任务。
+	/*!
+	  \param handle addFrameTask()返回的句柄。
+	  \return 如果找到并移除了任务，返回true。
+	*/
+	bool removeFrameTask(GMFrameTaskHandle handle);
+
+	//! 添加一个随世界更新的粒子系统管理器。
+	/*!
+	  世界不拥有管理器。如果管理器被销毁之后世界还会继续更新，需要先调用removeParticleSystemManager()。<BR>
+	  在并行帧模式下，粒子模拟是任务图中的一个节点，它在对象更新、骨骼动画求值和物理更新之后，在调用线程中执行，
+	  因为使用计算着色器的粒子系统需要访问渲染上下文。在CPU中更新的粒子系统仍然由管理器交给工作线程并行更新。
+	  \param manager 需要更新的粒子系统管理器。
+	  \sa GMParticleSystemManager::update()
+	*/
+	void addParticleSystemManager(GMParticleSystemManager* manager);
+
+	//! 移除一个随世界更新的粒子系统管理器。
+	/*!
+	  \param manager 需要移除的粒子系统管理器。
+	  \return 如果找到并移除了管理器，返回true。
+	*/
+	bool removeParticleSystemManager(GMParticleSystemManager* manager);
+
 protected:
 	inline GMRenderList& getRenderList()
 	{
 		D(d);
+		flushPendingRenderList();
 		return d->renderList;
 	}
 
 private:
 	void updateGameObjects(GMDuration dt, GMPhysicsWorld* phyw, const Set<GMOwnedPtr<GMGameObject>>& gameObjects);
+	void updateGameObjectsParallel(GMDuration dt, GMPhysicsWorld* phyw, const Set<GMOwnedPtr<GMGameObject>>& gameObjects);
+	void updateParticleSystems(GMDuration dt);
+	void prepareRenderListParallel();
+	void flushPendingRenderList();
+	void insertToRenderList(GMGameObject* object);
 
 	// GMPhysicsWorld
 private:
@@ -93,6 +93,7 @@ static GMShaderVariablesDesc s_defaultShaderVariablesDesc =
 
 	"GM_IlluminationModel",
 	"GM_ColorVertexOp",
+	"GM_OctahedralVertexAttributes",
 
 	{
 		"GM_Debug_Normal",
@@ -134,6 +135,7 @@ GMGraphicEngine::GMGraphicEngine(const IRenderContext* context)
 	d->debugConfig = GM.getConfigs().getConfig(GMConfigs::Debug).asDebugConfig();
 	d->shadow.type = GMShadowSourceDesc::NoShadow;
 	d->renderTechniqueManager.reset(new GMRenderTechniqueManager(context));
+	d->renderQueue.reset(new GMRenderQueue(this));
 
 	if (context->getWindow())
 	{
@@ -173,10 +175,19 @@ IFramebuffers* GMGraphicEngine::getFilterFramebuffers()
 	return d->filterFramebuffers;
 }
 
-void GMGraphicEngine::draw(const List<GMGameObject*>& forwardRenderingObjects, const List<GMGameObject*>& deferredRenderingObjects)
+void GMGraphicEngine::draw(const GMGameObjectList& forwardRenderingObjects, const GMGameObjectList& deferredRenderingObjects)
 {
 	GM_PROFILE("draw");
 	D(d);
+	// 新的一帧开始时，保存上一帧的渲染统计
+	GMDuration now = GM.getRunningStates().elapsedTime;
+	if (now != d->renderStatisticsTime)
+	{
+		d->lastRenderStatistics = d->renderStatistics;
+		d->renderStatistics = GMRenderQueueStatistics();
+		d->renderStatisticsTime = now;
+	}
+
 	// 如果绘制阴影，先生成阴影缓存
 	if (d->shadow.type != GMShadowSourceDesc::NoShadow)
 	{
@@ -226,13 +237,21 @@ void GMGraphicEngine::draw(const List<GMGameObject*>& forwardRenderingObjects, c
 	}
 }
 
-void GMGraphicEngine::draw(const List<GMGameObject*>& objects)
+void GMGraphicEngine::draw(const GMGameObjectList& objects)
 {
 	D(d);
+	// 如果已经在录制（对象在绘制时又绘制了一组对象），直接放入同一个队列
+	bool useRenderQueue = !d->renderQueue->isRecording() && d->renderConfig.get(GMRenderConfigs::RenderQueue_Bool).toBool();
+	if (useRenderQueue)
+		d->renderQueue->begin();
+
 	for (auto object : objects)
 	{
 		object->draw();
 	}
+
+	if (useRenderQueue)
+		d->renderQueue->end(d->renderStatistics);
 }
 
 const GMFilterMode::Mode GMGraphicEngine::getCurrentFilterMode()
@@ -387,7 +406,7 @@ void GMGraphicEngine::createFilterFramebuffer()
 	}
 }
 
-void GMGraphicEngine::generateShadowBuffer(const List<GMGameObject*>& forwardRenderingObjects, const List<GMGameObject*>& deferredRenderingObjects)
+void GMGraphicEngine::generateShadowBuffer(const GMGameObjectList& forwardRenderingObjects, const GMGameObjectList& deferredRenderingObjects)
 {
 	D(d);
 	d->isDrawingShadow = true;
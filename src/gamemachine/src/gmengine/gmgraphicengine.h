@@ -5,6 +5,7 @@
 #include <gmmodel.h>
 #include <gmcamera.h>
 #include <gmrendertechnique.h>
+#include <gmrenderqueue.h>
 BEGIN_NS
 
 template <typename T>
@@ -161,6 +162,7 @@ struct GMShaderVariablesDesc_t
 	// 模型
 	T IlluminationModel;
 	T ColorVertexOp;
+	T OctahedralVertexAttributes;
 
 	// 调试
 	GMShaderVariableDebugDesc<T> Debug;
@@ -236,6 +238,12 @@ GM_PRIVATE_OBJECT(GMGraphicEngine)
 	GMGlobalBlendStateDesc blendState;
 	GMOwnedPtr<GMRenderTechniqueManager> renderTechniqueManager;
 	GMOwnedPtr<GMPrimitiveManager> primitiveManager;
+	GMOwnedPtr<GMRenderQueue> renderQueue;
+
+	// 渲染统计
+	GMRenderQueueStatistics renderStatistics;
+	GMRenderQueueStatistics lastRenderStatistics;
+	GMDuration renderStatisticsTime = -1;
 
 	// Shadow
 	GMShadowSourceDesc shadow;
@@ -257,7 +265,7 @@ public:
 	virtual void init() override;
 	virtual IGBuffer* getGBuffer() override;
 	virtual IFramebuffers* getFilterFramebuffers() override;
-	virtual void draw(const List<GMGameObject*>& forwardRenderingObjects, const List<GMGameObject*>& deferredRenderingObjects) override;
+	virtual void draw(const GMGameObjectList& forwardRenderingObjects, const GMGameObjectList& deferredRenderingObjects) override;
 	virtual GMLightIndex addLight(AUTORELEASE ILight* light) override;
 	virtual ILight* getLight(GMLightIndex index) override;
 	virtual void removeLights() override;
@@ -286,7 +294,7 @@ protected:
 	virtual void createShadowFramebuffers(OUT IFramebuffers** framebuffers);
 	virtual void resetCSM();
 	virtual void createFilterFramebuffer();
-	virtual void generateShadowBuffer(const List<GMGameObject*>& forwardRenderingObjects, const List<GMGameObject*>& deferredRenderingObjects);
+	virtual void generateShadowBuffer(const GMGameObjectList& forwardRenderingObjects, const GMGameObjectList& deferredRenderingObjects);
 	virtual bool needUseFilterFramebuffer();
 	virtual void bindFilterFramebufferAndClear();
 	virtual void unbindFilterFramebufferAndDraw();
@@ -294,7 +302,12 @@ protected:
 public:
 	const GMFilterMode::Mode getCurrentFilterMode();
 
-	void draw(const List<GMGameObject*>& objects);
+	//! 绘制一组对象。
+	/*!
+	  如果GMRenderConfigs::RenderQueue_Bool为true（默认为false），对象中的模型会先放入渲染队列，按照状态排序之后再绘制。
+	  \sa GMRenderQueue
+	*/
+	void draw(const GMGameObjectList& objects);
 	IFramebuffers* getShadowMapFramebuffers();
 
 	bool needGammaCorrection();
@@ -369,6 +382,26 @@ public:
 		D(d);
 		return d->blendState;
 	}
+
+	inline GMRenderQueue* getRenderQueue()
+	{
+		D(d);
+		return d->renderQueue.get();
+	}
+
+	//! 获取上一帧的渲染统计。
+	inline const GMRenderQueueStatistics& getRenderStatistics()
+	{
+		D(d);
+		return d->lastRenderStatistics;
+	}
+
+	//! 获取当前帧正在累加的渲染统计。
+	inline GMRenderQueueStatistics& getCurrentRenderStatistics()
+	{
+		D(d);
+		return d->renderStatistics;
+	}
 };
 
 END_NS
@@ -15,6 +15,7 @@ enum class GameMachineMessageType
 	WindowSizeChanged, //!< 当某个原生窗口大小发生变化时的消息
 	Dx11Ready, //!< 如果使用DirectX11，DirectX11就绪时的消息
 	SystemMessage, //!< 操作系统产生消息时的消息
+	EndOfEnum,
 };
 
 struct GMMessage
@@ -0,0 +1,306 @@
+﻿#include "stdafx.h"
+#include "gmrenderqueue.h"
+#include "gmgraphicengine.h"
+#include "gmengine/gameobjects/gmgameobject.h"
+#include "gmdata/gmmodel.h"
+#include <cstring>
+
+namespace
+{
+	enum
+	{
+		DepthBits = 12,
+		BufferBits = 12,
+		TextureBits = 12,
+		MaterialBits = 8,
+		TechniqueBits = 4,
+		SegmentBits = 16,
+
+		BufferShift = DepthBits,
+		TextureShift = BufferShift + BufferBits,
+		MaterialShift = TextureShift + TextureBits,
+		TechniqueShift = MaterialShift + MaterialBits,
+		SegmentShift = TechniqueShift + TechniqueBits,
+	};
+
+	static_assert(SegmentShift + SegmentBits == 64, "Sort key must use all 64 bits.");
+
+	constexpr GMuint32 maxId(GMuint32 bits)
+	{
+		return (1u << bits) - 1;
+	}
+
+	inline GMuint32 getField(GMRenderSortKey key, GMuint32 shift, GMuint32 bits)
+	{
+		return static_cast<GMuint32>(key >> shift) & maxId(bits);
+	}
+
+	// 为状态分配一个紧凑的ID，ID用完之后新的状态共用最后一个ID，只会影响排序的效果
+	GMuint32 getStateId(HashMap<const void*, GMuint32>& ids, const void* state, GMuint32 bits)
+	{
+		auto iter = ids.find(state);
+		if (iter != ids.end())
+			return iter->second;
+
+		GMuint32 id = Min(gm_sizet_to_uint(ids.size()), maxId(bits));
+		ids[state] = id;
+		return id;
+	}
+
+	// 模型的主纹理，没有纹理时返回空
+	const void* getMainTexture(GMModel* model)
+	{
+		static const GMTextureType s_types[] = {
+			GMTextureType::Albedo,
+			GMTextureType::Diffuse,
+			GMTextureType::Ambient,
+		};
+
+		GMTextureList& textureList = model->getShader().getTextureList();
+		for (auto type : s_types)
+		{
+			GMTextureSampler& sampler = textureList.getTextureSampler(type);
+			if (sampler.getFrameCount() > 0)
+				return sampler.getFrameByIndex(0).getTexture();
+		}
+		return nullptr;
+	}
+
+	// 会导致渲染状态变化的着色器属性
+	GMuint32 getMaterialState(GMShader& shader)
+	{
+		GMuint32 state = static_cast<GMuint32>(shader.getIlluminationModel()) & 0x03;
+		state |= (static_cast<GMuint32>(shader.getCull()) & 0x03) << 2;
+		state |= (static_cast<GMuint32>(shader.getFrontFace()) & 0x01) << 4;
+		state |= (static_cast<GMuint32>(shader.getVertexColorOp()) & 0x07) << 5;
+		return state & maxId(MaterialBits);
+	}
+
+	// 统计从prev到current的状态变化，prev为空时表示第一次绘制
+	GMsize_t countStateChanges(const GMRenderQueueItem* prev, const GMRenderQueueItem& current, GMRenderQueueStatistics* statistics)
+	{
+		GMRenderQueueStatistics changes;
+		if (!prev || prev->technique != current.technique)
+		{
+			changes.techniqueChanges = 1;
+		}
+		else if (prev->scene != current.scene)
+		{
+			changes.sceneChanges = 1;
+		}
+
+		if (prev)
+		{
+			if (getField(prev->key, MaterialShift, MaterialBits) != getField(current.key, MaterialShift, MaterialBits))
+				changes.materialChanges = 1;
+			if (getField(prev->key, TextureShift, TextureBits) != getField(current.key, TextureShift, TextureBits))
+				changes.textureChanges = 1;
+			if (prev->model->getModelBuffer() != current.model->getModelBuffer())
+				changes.bufferChanges = 1;
+		}
+
+		changes.stateChanges = changes.techniqueChanges + changes.sceneChanges + changes.materialChanges + changes.textureChanges + changes.bufferChanges;
+		if (statistics)
+		{
+			statistics->techniqueChanges += changes.techniqueChanges;
+			statistics->sceneChanges += changes.sceneChanges;
+			statistics->materialChanges += changes.materialChanges;
+			statistics->textureChanges += changes.textureChanges;
+			statistics->bufferChanges += changes.bufferChanges;
+			statistics->stateChanges += changes.stateChanges;
+		}
+		return changes.stateChanges;
+	}
+}
+
+GMRenderQueue::GMRenderQueue(GMGraphicEngine* engine)
+{
+	D(d);
+	d->engine = engine;
+}
+
+void GMRenderQueue::begin()
+{
+	D(d);
+	GM_ASSERT(!d->recording);
+	d->recording = true;
+	// 没有图形引擎时以原点作为视点
+	d->viewPosition = d->engine ? d->engine->getCamera().getLookAt().position : Zero<GMVec3>();
+}
+
+void GMRenderQueue::end(REF GMRenderQueueStatistics& statistics)
+{
+	D(d);
+	GM_ASSERT(d->recording);
+	// 先结束录制，使得绘制过程中调用的GMGameObject::drawModel()直接绘制
+	d->recording = false;
+	flush();
+	statistics += d->statistics;
+	d->statistics = GMRenderQueueStatistics();
+}
+
+void GMRenderQueue::push(GMGameObject* object, GMModel* model, ITechnique* technique, GMScene* scene)
+{
+	D(d);
+	GM_ASSERT(d->recording);
+
+	// 不能排序的模型单独占用一个分段，连续的可排序模型共用一个分段
+	bool sortable = isSortable(model);
+	if (!d->items.empty() && !(sortable && d->lastSortable))
+	{
+		if (d->segment == maxId(SegmentBits))
+			flush();
+		else
+			++d->segment;
+	}
+	d->lastSortable = sortable;
+
+	GMRenderQueueItem item;
+	item.key = makeKey(object, model, technique, sortable);
+	item.object = object;
+	item.model = model;
+	item.technique = technique;
+	item.scene = scene;
+	item.lod = model->getActiveLod();
+	d->items.push_back(item);
+}
+
+GMRenderSortKey GMRenderQueue::makeKey(GMGameObject* object, GMModel* model, ITechnique* technique, bool sortable)
+{
+	D(d);
+	GMRenderSortKey key = static_cast<GMRenderSortKey>(d->segment) << SegmentShift;
+	if (!sortable)
+		return key;
+
+	GMShader& shader = model->getShader();
+	GMVec4 position = GMVec4(0, 0, 0, 1) * object->getTransform();
+	GMfloat depth = Length(GMVec3(position.getX(), position.getY(), position.getZ()) - d->viewPosition);
+
+	key |= static_cast<GMRenderSortKey>(getStateId(d->techniqueIds, technique, TechniqueBits)) << TechniqueShift;
+	key |= static_cast<GMRenderSortKey>(getMaterialState(shader)) << MaterialShift;
+	key |= static_cast<GMRenderSortKey>(getStateId(d->textureIds, getMainTexture(model), TextureBits)) << TextureShift;
+	key |= static_cast<GMRenderSortKey>(getStateId(d->bufferIds, model->getModelBuffer(), BufferBits)) << BufferShift;
+	key |= depthToKey(depth);
+	return key;
+}
+
+void GMRenderQueue::flush()
+{
+	D(d);
+	if (d->items.empty())
+		return;
+
+	GMRenderQueueStatistics& statistics = d->statistics;
+	const GMuint32 count = gm_sizet_to_uint(d->items.size());
+	d->entries.resize(count);
+	for (GMuint32 i = 0; i < count; ++i)
+	{
+		d->entries[i].key = d->items[i].key;
+		d->entries[i].index = i;
+	}
+	radixSort(d->entries, d->sortBuffer);
+
+	const GMuint64 outerFlushId = d->flushId;
+	d->flushId = ++d->flushCount;
+
+	const GMRenderQueueItem* prev = nullptr;
+	for (const auto& item : d->items)
+	{
+		statistics.unsortedStateChanges += countStateChanges(prev, item, nullptr);
+		prev = &item;
+	}
+
+	// 只有渲染技术或场景变化时才调用beginScene()和endScene()
+	prev = nullptr;
+	for (const auto& entry : d->entries)
+	{
+		const GMRenderQueueItem& item = d->items[entry.index];
+		if (countStateChanges(prev, item, &statistics) > 0)
+			++statistics.batches;
+
+		if (!prev || prev->technique != item.technique || prev->scene != item.scene)
+		{
+			if (prev)
+				prev->technique->endScene();
+			item.technique->beginScene(item.scene);
+		}
+
+		GMModel* model = item.model;
+		model->setActiveLod(item.lod);
+		item.technique->beginModel(model, item.object);
+		item.technique->draw(model);
+		item.technique->endModel();
+		model->setActiveLod(0u);
+
+		++statistics.drawCalls;
+		prev = &item;
+	}
+
+	if (prev)
+		prev->technique->endScene();
+
+	d->flushId = outerFlushId;
+	d->items.clear();
+	d->techniqueIds.clear();
+	d->textureIds.clear();
+	d->bufferIds.clear();
+	d->segment = 0;
+	d->lastSortable = false;
+}
+
+void GMRenderQueue::radixSort(REF Vector<GMRenderSortEntry>& entries, REF Vector<GMRenderSortEntry>& buffer)
+{
+	const GMsize_t count = entries.size();
+	if (count < 2)
+		return;
+
+	buffer.resize(count);
+	GMRenderSortEntry* src = entries.data();
+	GMRenderSortEntry* dst = buffer.data();
+	for (GMuint32 pass = 0; pass < sizeof(GMRenderSortKey); ++pass)
+	{
+		const GMuint32 shift = pass * 8;
+		GMsize_t offsets[256] = { 0 };
+		for (GMsize_t i = 0; i < count; ++i)
+		{
+			++offsets[(src[i].key >> shift) & 0xFF];
+		}
+
+		// 所有键值在这个字节上都相同，顺序不变
+		if (offsets[(src[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		GMsize_t sum = 0;
+		for (auto& offset : offsets)
+		{
+			GMsize_t c = offset;
+			offset = sum;
+			sum += c;
+		}
+
+		for (GMsize_t i = 0; i < count; ++i)
+		{
+			dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+		}
+		std::swap(src, dst);
+	}
+
+	if (src != entries.data())
+		entries.swap(buffer);
+}
+
+bool GMRenderQueue::isSortable(GMModel* model)
+{
+	GMShader& shader = model->getShader();
+	return model->getType() == GMModelType::Model3D && !shader.getBlend() && !shader.getNoDepthTest();
+}
+
+GMuint32 GMRenderQueue::depthToKey(GMfloat depth)
+{
+	if (!(depth > 0))
+		return 0;
+
+	GMuint32 bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	return Min(bits >> (32 - DepthBits - 1), maxId(DepthBits));
+}
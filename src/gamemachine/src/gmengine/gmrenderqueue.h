@@ -0,0 +1,168 @@
+﻿#ifndef __GMRENDERQUEUE_H__
+#define __GMRENDERQUEUE_H__
+#include <gmcommon.h>
+#include <linearmath.h>
+BEGIN_NS
+
+class GMGameObject;
+class GMGraphicEngine;
+
+//! 渲染队列的排序键。
+/*!
+  从高位到低位依次为：分段（16位）、渲染技术（4位）、材质状态（8位）、纹理（12位）、顶点缓存（12位）、深度（12位）。<BR>
+  半透明、关闭深度测试以及2D、文字等依赖提交顺序的模型会单独占用一个分段，因此它们与前后模型的相对顺序保持不变，
+  只有同一分段中的不透明3D模型会按照状态排序，状态相同时由近到远绘制。
+*/
+typedef GMuint64 GMRenderSortKey;
+
+//! 渲染队列的统计信息。
+/*!
+  统计在一帧之内累加。各项状态的切换次数按照排序之后的绘制顺序计算，unsortedStateChanges为按照提交顺序绘制时的切换次数，
+  两者的差值即为排序减少的状态切换。
+*/
+struct GMRenderQueueStatistics
+{
+	GMsize_t drawCalls = 0; //!< 绘制的模型数量。
+	GMsize_t batches = 0; //!< 排序后状态完全相同的连续绘制视为一个批次，此项为批次的数量。
+	GMsize_t techniqueChanges = 0; //!< 切换渲染技术的次数，即调用ITechnique::beginScene()的次数。
+	GMsize_t sceneChanges = 0; //!< 同一个渲染技术下，切换场景的次数。
+	GMsize_t materialChanges = 0; //!< 材质状态（光照模型、剔除、深度测试等）变化的次数。
+	GMsize_t textureChanges = 0; //!< 主纹理变化的次数。
+	GMsize_t bufferChanges = 0; //!< 顶点缓存变化的次数。
+	GMsize_t stateChanges = 0; //!< 以上各项状态变化的总次数。
+	GMsize_t unsortedStateChanges = 0; //!< 按照提交顺序绘制时，状态变化的总次数。
+	GMsize_t programBinds = 0; //!< 实际绑定着色器程序的次数。
+	GMsize_t programBindsSkipped = 0; //!< 着色器程序已经处于使用状态，因此被跳过的绑定次数。
+
+	GMRenderQueueStatistics& operator+=(const GMRenderQueueStatistics& rhs)
+	{
+		drawCalls += rhs.drawCalls;
+		batches += rhs.batches;
+		techniqueChanges += rhs.techniqueChanges;
+		sceneChanges += rhs.sceneChanges;
+		materialChanges += rhs.materialChanges;
+		textureChanges += rhs.textureChanges;
+		bufferChanges += rhs.bufferChanges;
+		stateChanges += rhs.stateChanges;
+		unsortedStateChanges += rhs.unsortedStateChanges;
+		programBinds += rhs.programBinds;
+		programBindsSkipped += rhs.programBindsSkipped;
+		return *this;
+	}
+};
+
+//! 渲染队列中的一次绘制。
+struct GMRenderQueueItem
+{
+	GMRenderSortKey key = 0;
+	GMGameObject* object = nullptr;
+	GMModel* model = nullptr;
+	ITechnique* technique = nullptr;
+	GMScene* scene = nullptr;
+	GMuint32 lod = 0;
+};
+
+//! 排序时使用的键值对，index为绘制在队列中的位置。
+struct GMRenderSortEntry
+{
+	GMRenderSortKey key;
+	GMuint32 index;
+};
+
+GM_PRIVATE_OBJECT(GMRenderQueue)
+{
+	GMGraphicEngine* engine = nullptr;
+	bool recording = false;
+	GMuint32 segment = 0;
+	bool lastSortable = false;
+	GMuint64 flushCount = 0;
+	GMuint64 flushId = 0;
+	GMRenderQueueStatistics statistics;
+	GMVec3 viewPosition = Zero<GMVec3>();
+	Vector<GMRenderQueueItem> items;
+	Vector<GMRenderSortEntry> entries;
+	Vector<GMRenderSortEntry> sortBuffer;
+	HashMap<const void*, GMuint32> techniqueIds;
+	HashMap<const void*, GMuint32> textureIds;
+	HashMap<const void*, GMuint32> bufferIds;
+};
+
+//! 渲染队列。
+/*!
+  GMGraphicEngine::draw()在调用每个对象的GMGameObject::draw()之前开始录制，对象中的模型不会立即绘制，而是连同渲染技术、
+  场景和LOD级别一起放入队列。所有对象提交完成之后，队列按照排序键进行基数排序，再依次绘制，相邻的绘制使用同一个渲染技术
+  和场景时不再重复调用ITechnique::beginScene()和ITechnique::endScene()。<BR>
+  排序键只决定绘制顺序，不影响绘制的结果，因此ID冲突时只会减少批次的合并，不会绘制错误。
+  \sa GMRenderSortKey, GMRenderQueueStatistics
+*/
+class GM_EXPORT GMRenderQueue : public GMObject
+{
+	GM_DECLARE_PRIVATE(GMRenderQueue)
+
+public:
+	GMRenderQueue(GMGraphicEngine* engine);
+
+public:
+	//! 开始录制，之后的GMGameObject::drawModel()会将模型放入队列。
+	void begin();
+
+	//! 结束录制，排序并绘制队列中的所有模型。
+	/*!
+	  \param statistics 本次绘制的统计，统计会被累加到此对象上。
+	*/
+	void end(REF GMRenderQueueStatistics& statistics);
+
+	//! 将一个模型放入队列。
+	/*!
+	  \param object 模型所在的对象，绘制时作为ITechnique::beginModel()的参数。
+	  \param model 需要绘制的模型。
+	  \param technique 绘制模型的渲染技术。
+	  \param scene 模型所在的场景。
+	*/
+	void push(GMGameObject* object, GMModel* model, ITechnique* technique, GMScene* scene);
+
+	inline bool isRecording() const GM_NOEXCEPT
+	{
+		D(d);
+		return d->recording;
+	}
+
+	//! 获取正在绘制的队列的编号。
+	/*!
+	  每次绘制队列中的模型时编号都不同，不在绘制队列时返回0。图形引擎只在同一次绘制中跳过重复的状态设置，
+	  队列之外的绘制可能直接修改了图形API的状态。
+	*/
+	inline GMuint64 getFlushId() const GM_NOEXCEPT
+	{
+		D(d);
+		return d->flushId;
+	}
+
+public:
+	//! 按照键值从小到大排序，键值相同时保持原来的顺序。
+	/*!
+	  使用每次8位的LSD基数排序，所有键值在某一个字节上都相同时跳过这一趟。
+	  \param entries 需要排序的键值对，排序结果也保存在这里。
+	  \param buffer 排序时使用的临时空间，大小会被调整为与entries相同。
+	*/
+	static void radixSort(REF Vector<GMRenderSortEntry>& entries, REF Vector<GMRenderSortEntry>& buffer);
+
+	//! 是否可以改变一个模型的绘制顺序。
+	/*!
+	  只有不需要混合、开启了深度测试的3D模型可以排序，其它模型的绘制结果依赖于提交顺序。
+	*/
+	static bool isSortable(GMModel* model);
+
+	//! 将深度（到摄像机的距离）转换为12位的排序键。
+	/*!
+	  非负浮点数的二进制表示与数值的大小顺序相同，因此直接取其高位。
+	*/
+	static GMuint32 depthToKey(GMfloat depth);
+
+private:
+	void flush();
+	GMRenderSortKey makeKey(GMGameObject* object, GMModel* model, ITechnique* technique, bool sortable);
+};
+
+END_NS
+#endif
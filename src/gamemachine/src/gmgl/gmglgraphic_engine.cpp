@@ -163,6 +163,31 @@ void GMGLGraphicEngine::shaderProgramChanged(IShaderProgram* program)
 	emitSignal(GM_SIGNAL(GMGLGraphicEngine, shaderProgramChanged));
 }
 
+bool GMGLGraphicEngine::bindShaderProgram(GMuint32 program)
+{
+	D(d);
+	GMRenderQueueStatistics& statistics = getCurrentRenderStatistics();
+	const GMuint64 flushId = getRenderQueue()->getFlushId();
+	if (flushId != 0 && d->currentShaderProgramFlushId == flushId && d->currentShaderProgram == program)
+	{
+		++statistics.programBindsSkipped;
+		return false;
+	}
+
+	glUseProgram(program);
+	d->currentShaderProgram = program;
+	d->currentShaderProgramFlushId = flushId;
+	++statistics.programBinds;
+	return true;
+}
+
+void GMGLGraphicEngine::invalidateShaderProgram()
+{
+	D(d);
+	d->currentShaderProgram = 0;
+	d->currentShaderProgramFlushId = 0;
+}
+
 void GMGLGraphicEngine::update(GMUpdateDataType type)
 {
 	D(d);
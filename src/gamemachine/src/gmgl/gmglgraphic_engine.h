@@ -75,6 +75,9 @@ GM_PRIVATE_OBJECT(GMGLGraphicEngine)
 	GMGLLightContext lightContext;
 
 	Vector<GMint32> lightCountIndices;
+	GMuint32 currentShaderProgram = 0;
+	GMuint64 currentShaderProgramFlushId = 0; //!< 绑定currentShaderProgram时渲染队列的编号
+
 };
 
 class GMGLGraphicEngine : public GMGraphicEngine
@@ -117,6 +120,18 @@ public:
 	void activateLights(ITechnique* technique);
 	void shaderProgramChanged(IShaderProgram* program);
 
+	//! 使用一个着色器程序。
+	/*!
+	  在渲染队列的同一次绘制中（见GMRenderQueue::getFlushId()），如果程序已经处于使用状态，则跳过glUseProgram。
+	  队列之外的绘制总是调用glUseProgram，因为程序可能已被删除，或者其它代码直接修改了当前程序。
+	  \param program OpenGL着色器程序。
+	  \return 是否真正绑定了着色器程序。
+	*/
+	bool bindShaderProgram(GMuint32 program);
+
+	//! 直接调用glUseProgram之后，需要调用此方法使记录的程序失效。
+	void invalidateShaderProgram();
+
 private:
 	void installShaders();
 
@@ -8,7 +8,72 @@
 #include "foundation/gamemachine.h"
 
 GM_STATIC_ASSERT(sizeof(gm::GMfloat) == sizeof(gm::GMint32), "Wrong type size.");
-#define BIT32_OFFSET(i) ((void*)(sizeof(gm::GMfloat) * i))
+
+namespace
+{
+	// 按照顶点格式设置属性指针，省略的属性被禁用，着色器会读到GMGLTechnique设置的常量
+	void bindVertexAttributes(const GMVertexLayout& layout)
+	{
+		const GLsizei stride = layout.getStride();
+		GM_FOREACH_ENUM_CLASS(type, GMVertexDataType::Position, GMVertexDataType::EndOfVertexDataType)
+		{
+			const GLuint index = gmVertexIndex(type);
+			const void* offset = reinterpret_cast<const void*>(static_cast<GMsize_t>(layout.getOffset(type)));
+			switch (layout.getFormat(type))
+			{
+			case GMVertexAttributeFormat::None:
+				glDisableVertexAttribArray(index);
+				continue;
+			case GMVertexAttributeFormat::Default:
+				if (type == GMVertexDataType::BoneIds)
+					glVertexAttribIPointer(index, GMVertexLayout::getDimension(type), GL_INT, stride, offset);
+				else
+					glVertexAttribPointer(index, GMVertexLayout::getDimension(type), GL_FLOAT, GL_FALSE, stride, offset);
+				break;
+			case GMVertexAttributeFormat::Half:
+				glVertexAttribPointer(index, GMVertexLayout::getDimension(type), GL_HALF_FLOAT, GL_FALSE, stride, offset);
+				break;
+			case GMVertexAttributeFormat::Octahedral:
+				// 着色器读到的是(x, y, 0)，由GM_OctahedralVertexAttributes决定是否解码
+				glVertexAttribPointer(index, 2, GL_SHORT, GL_TRUE, stride, offset);
+				break;
+			case GMVertexAttributeFormat::UNorm8:
+				glVertexAttribPointer(index, GMVertexLayout::getDimension(type), GL_UNSIGNED_BYTE, GL_TRUE, stride, offset);
+				break;
+			case GMVertexAttributeFormat::UInt8:
+				glVertexAttribIPointer(index, GMVertexLayout::getDimension(type), GL_UNSIGNED_BYTE, stride, offset);
+				break;
+			default:
+				GM_ASSERT(false);
+				continue;
+			}
+			glEnableVertexAttribArray(index);
+		}
+	}
+
+	// 分配缓存后映射显存，由writer直接写入数据，避免在内存中再拼接一份完整的副本
+	template <typename Writer>
+	void uploadBuffer(GLenum target, GMsize_t size, GLenum usage, Writer writer)
+	{
+		glBufferData(target, size, nullptr, usage);
+		if (size == 0)
+			return;
+
+		void* mapped = glMapBufferRange(target, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (mapped)
+		{
+			writer(static_cast<GMbyte*>(mapped));
+			if (glUnmapBuffer(target) == GL_TRUE)
+				return;
+		}
+
+		// 无法映射，或者映射期间缓存的内容被破坏（例如切换了显示模式），此时才使用临时内存上传
+		gm_warning(gm_dbg_wrap("Mapping buffer failed, falling back to glBufferSubData."));
+		Vector<GMbyte> data(size);
+		writer(data.data());
+		glBufferSubData(target, 0, size, data.data());
+	}
+}
 
 GMGLModelDataProxy::GMGLModelDataProxy(const IRenderContext* context, GMModel* objs)
 	: GMModelDataProxy(context, objs)
@@ -34,10 +99,7 @@ void GMGLModelDataProxy::transfer()
 	prepareTangentSpace();
 
 	GMModelBufferData bufferData;
-	Vector<GMVertex> packedVertices;
-	// 把数据打入顶点数组
-	packVertices(packedVertices);
-
+	const GMsize_t packedVerticesCount = getPackedVerticesCount();
 	GMsize_t verticeCount = 0;
 
 	GLuint vao;
@@ -51,49 +113,38 @@ void GMGLModelDataProxy::transfer()
 
 	GLenum usage = model->getUsageHint() == GMUsageHint::StaticDraw ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW;
 	glBindBuffer(GL_ARRAY_BUFFER, bufferData.vertexBufferId);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GMVertex) * packedVertices.size(), packedVertices.data(), usage);
-
-	glVertexAttribPointer(gmVertexIndex(GMVertexDataType::Position),	GMVertex::PositionDimension,	GL_FLOAT, GL_FALSE, sizeof(GMVertex), 0);
-	glVertexAttribPointer(gmVertexIndex(GMVertexDataType::Normal),		GMVertex::NormalDimension,		GL_FLOAT, GL_FALSE, sizeof(GMVertex), BIT32_OFFSET(3));
-	glVertexAttribPointer(gmVertexIndex(GMVertexDataType::Texcoord),	GMVertex::TexcoordDimension,	GL_FLOAT, GL_FALSE, sizeof(GMVertex), BIT32_OFFSET(6));
-	glVertexAttribPointer(gmVertexIndex(GMVertexDataType::Tangent),		GMVertex::TangentDimension,		GL_FLOAT, GL_FALSE, sizeof(GMVertex), BIT32_OFFSET(8));
-	glVertexAttribPointer(gmVertexIndex(GMVertexDataType::Bitangent),	GMVertex::BitangentDimension,	GL_FLOAT, GL_FALSE, sizeof(GMVertex), BIT32_OFFSET(11));
-	glVertexAttribPointer(gmVertexIndex(GMVertexDataType::Lightmap),	GMVertex::LightmapDimension,	GL_FLOAT, GL_FALSE, sizeof(GMVertex), BIT32_OFFSET(14));
-	glVertexAttribPointer(gmVertexIndex(GMVertexDataType::Color),		GMVertex::ColorDimension,		GL_FLOAT, GL_FALSE, sizeof(GMVertex), BIT32_OFFSET(16));
-	glVertexAttribIPointer(gmVertexIndex(GMVertexDataType::BoneIds),	GMVertex::BoneIDsDimension,		GL_INT,				sizeof(GMVertex), BIT32_OFFSET(20));
-	glVertexAttribPointer(gmVertexIndex(GMVertexDataType::Weights),		GMVertex::WeightsDimension,		GL_FLOAT, GL_FALSE, sizeof(GMVertex), BIT32_OFFSET(24));
-
-	GM_FOREACH_ENUM_CLASS(type, GMVertexDataType::Position, GMVertexDataType::EndOfVertexDataType)
-	{
-		glEnableVertexAttribArray(gmVertexIndex(type));
-	}
-	
+
+	// 把各个Part的顶点直接写入显存
+	GMVertexLayout layout = prepareVertexLayout();
+	uploadBuffer(GL_ARRAY_BUFFER, layout.getStride() * packedVerticesCount, usage, [this, &layout](GMbyte* target) {
+		packVertices(layout, target);
+	});
+	bindVertexAttributes(layout);
+
 	if (model->getDrawMode() == GMModelDrawMode::Index)
 	{
-		Vector<GMuint32> packedIndices;
-		// 把数据打入顶点数组
-		packIndices(packedIndices);
-
+		// LOD级别的索引放在原始网格的索引之后
+		const GMsize_t packedIndicesCount = getPackedIndicesCount();
+		const GMsize_t bufferIndicesCount = packedIndicesCount + getPackedLodIndicesCount();
 		glGenBuffers(1, &bufferData.indexBufferId);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferData.indexBufferId);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GMuint32) * packedIndices.size(), packedIndices.data(), GL_STATIC_DRAW);
+		uploadBuffer(GL_ELEMENT_ARRAY_BUFFER, sizeof(GMuint32) * bufferIndicesCount, GL_STATIC_DRAW, [this](GMbyte* target) {
+			packIndices(reinterpret_cast<GMuint32*>(target));
+		});
 
-		verticeCount = packedIndices.size();
+		verticeCount = packedIndicesCount;
 	}
 	else
 	{
-		verticeCount = packedVertices.size();
+		verticeCount = packedVerticesCount;
 	}
 
 	glBindVertexArray(0);
-
-	for (auto& part : model->getParts())
-	{
-		part->clear();
-	}
+	releasePartsData();
 
 	GMModelBuffer* modelBuffer = new GMModelBuffer();
 	modelBuffer->setData(bufferData);
+	modelBuffer->setVertexLayout(layout);
 
 	model->setVerticesCount(verticeCount);
 	model->setModelBuffer(modelBuffer);
@@ -133,9 +133,10 @@ GMGLShaderProgram::~GMGLShaderProgram()
 void GMGLShaderProgram::useProgram()
 {
 	D(d);
-	glUseProgram(d->shaderProgram);
-	
 	GMGLGraphicEngine* engine = gm_cast<GMGLGraphicEngine*>(d->context->getEngine());
+	engine->bindShaderProgram(d->shaderProgram);
+
+	// 即使跳过了绑定也需要通知，其它技术可能在同一个程序上修改了阴影等参数
 	engine->shaderProgramChanged(this);
 }
 
@@ -422,6 +423,8 @@ void GMGLComputeShaderProgram::dispatch(GMint32 threadGroupCountX, GMint32 threa
 {
 	D(d);
 	glUseProgram(d->shaderProgram);
+	if (d->context && d->context->getEngine())
+		gm_cast<GMGLGraphicEngine*>(d->context->getEngine())->invalidateShaderProgram();
 	glDispatchCompute(threadGroupCountX, threadGroupCountY, threadGroupCountZ);
 	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 	cleanUp();
@@ -242,6 +242,9 @@ void GMGLTechnique::beginModel(GMModel* model, const GMGameObject* parent)
 	// 设置顶点颜色运算方式
 	shaderProgram->setInt(VI(ColorVertexOp), static_cast<GMint32>(model->getShader().getVertexColorOp()));
 
+	// 顶点格式
+	applyVertexLayout(shaderProgram, model);
+
 	// 骨骼动画
 	GM_ASSERT(d->techContext.currentScene);
 	if (d->techContext.currentScene->hasAnimation() && parent && parent->isSkeletalObject())
@@ -260,6 +263,27 @@ void GMGLTechnique::beginModel(GMModel* model, const GMGameObject* parent)
 	}
 }
 
+void GMGLTechnique::applyVertexLayout(IShaderProgram* shaderProgram, GMModel* model)
+{
+	D(d);
+	const GMVertexLayout& layout = model->getModelBuffer()->getVertexLayout();
+	shaderProgram->setInt(VI(OctahedralVertexAttributes), layout.getOctahedralMask());
+
+	// 被省略的属性的值是全局的状态，每次绘制之前都需要设置。颜色默认为白色，其它属性为0
+	GM_FOREACH_ENUM_CLASS(type, GMVertexDataType::Position, GMVertexDataType::EndOfVertexDataType)
+	{
+		if (layout.getFormat(type) != GMVertexAttributeFormat::None)
+			continue;
+
+		if (type == GMVertexDataType::BoneIds)
+			glVertexAttribI4i(gmVertexIndex(type), 0, 0, 0, 0);
+		else if (type == GMVertexDataType::Color)
+			glVertexAttrib4f(gmVertexIndex(type), 1, 1, 1, 1);
+		else
+			glVertexAttrib4f(gmVertexIndex(type), 0, 0, 0, 0);
+	}
+}
+
 void GMGLTechnique::endModel()
 {
 	D(d);
@@ -676,10 +700,12 @@ void GMGLTechnique::startDraw(GMModel* model)
 {
 	D(d);
 	GLenum mode = (d->engine->isWireFrameMode(model)) ? GL_LINE_LOOP : getMode(model->getPrimitiveTopologyMode());
+	GMsize_t offset, count;
+	model->getDrawRange(offset, count);
 	if (model->getDrawMode() == GMModelDrawMode::Vertex)
-		glDrawArrays(mode, 0, gm_sizet_to<GLsizei>(model->getVerticesCount()));
+		glDrawArrays(mode, gm_sizet_to<GLint>(offset), gm_sizet_to<GLsizei>(count));
 	else
-		glDrawElements(mode, gm_sizet_to<GLsizei>(model->getVerticesCount()), GL_UNSIGNED_INT, 0);
+		glDrawElements(mode, gm_sizet_to<GLsizei>(count), GL_UNSIGNED_INT, reinterpret_cast<const void*>(offset * sizeof(GMuint32)));
 }
 
 //////////////////////////////////////////////////////////////////////////
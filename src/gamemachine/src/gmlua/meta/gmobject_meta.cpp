@@ -98,7 +98,7 @@ GM_LUA_PROXY_IMPL(GMObjectProxy, connect)
 	GMArgumentHelper::popArgumentAsObject(L, self, s_invoker); //self
 	if (self)
 	{
-		self->connect(*sender.get(), signal, [L, callback](GMObject* s, GMObject* r) {
+		self->connect(*sender.get(), GMObject::internSignal(signal), [L, callback](GMObject* s, GMObject* r) {
 			GMObjectProxy sender(L), receiver(L);
 			sender.set(s);
 			receiver.set(r);
@@ -120,7 +120,7 @@ GM_LUA_PROXY_IMPL(GMObjectProxy, emitSignal)
 	GMString signal = GMArgumentHelper::popArgumentAsString(L, s_invoker); //signal
 	GMArgumentHelper::popArgumentAsObject(L, self, s_invoker); //self
 	if (self)
-		self->emitSignal(signal);
+		self->emitSignal(GMObject::internSignal(signal));
 	return GMReturnValues();
 }
 //////////////////////////////////////////////////////////////////////////
@@ -43,6 +43,8 @@ void Demo_Assimp::init()
 
 	// 创建对象
 	getDemoWorldReference().reset(new gm::GMDemoGameWorld(db->parentDemonstrationWorld->getContext()));
+	// 骨骼动画求值作为任务图中的节点并行执行
+	getDemoWorldReference()->setParallelFrame(true);
 	gm::GMTextureAsset texture = gm::GMToolUtil::createTexture(getDemoWorldReference()->getContext(), "bnp.png");
 	getDemoWorldReference()->getAssets().addAsset(texture);
 
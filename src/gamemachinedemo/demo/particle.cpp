@@ -12,6 +12,8 @@ void Demo_Particle2D::init()
 
 	// 创建对象
 	d->particleSystemManager.reset(new gm::GMParticleSystemManager(getDemoWorldReference()->getContext(), 128));
+	getDemoWorldReference()->setParallelFrame(true);
+	getDemoWorldReference()->addParticleSystemManager(d->particleSystemManager.get());
 
 	gm::GMControlButton* button = nullptr;
 	gm::GMWidget* widget = createDefaultWidget();
@@ -63,7 +65,7 @@ void Demo_Particle2D::event(gm::GameMachineHandlerEvent evt)
 	switch (evt)
 	{
 	case gm::GameMachineHandlerEvent::Update:
-		d->particleSystemManager->update(GM.getRunningStates().lastFrameElpased);
+		getDemoWorldReference()->updateGameWorld(GM.getRunningStates().lastFrameElpased);
 		break;
 	case gm::GameMachineHandlerEvent::Render:
 		d->particleSystemManager->render();
@@ -90,6 +92,8 @@ void Demo_ParticleBillboard::init()
 
 	// 创建对象
 	d->particleSystemManager.reset(new gm::GMParticleSystemManager(getDemoWorldReference()->getContext(), 128));
+	getDemoWorldReference()->setParallelFrame(true);
+	getDemoWorldReference()->addParticleSystemManager(d->particleSystemManager.get());
 
 	gm::GMControlButton* button = nullptr;
 	gm::GMWidget* widget = createDefaultWidget();
@@ -138,7 +142,7 @@ void Demo_ParticleBillboard::event(gm::GameMachineHandlerEvent evt)
 	switch (evt)
 	{
 	case gm::GameMachineHandlerEvent::Update:
-		d->particleSystemManager->update(GM.getRunningStates().lastFrameElpased);
+		getDemoWorldReference()->updateGameWorld(GM.getRunningStates().lastFrameElpased);
 		break;
 	case gm::GameMachineHandlerEvent::Render:
 		d->particleSystemManager->render();
@@ -4,6 +4,7 @@
 #include <AL/alc.h>
 #include "decoder.h"
 #include <gmthread.h>
+#include <gmthreadpool.h>
 #include "../src/foundation/gamemachine.h"
 
 // 大小保持一致
@@ -171,6 +172,10 @@ public:
 	{
 		D(d);
 		d->source = src;
+
+		// 流播放线程不与主线程争抢第0个逻辑处理器
+		setName(L"GMM Audio Stream");
+		setAffinityMask(gm::GMThreadPool::backgroundAffinityMask());
 	}
 
 	~GMMAudioStreamPlayThread()
@@ -5,6 +5,7 @@
 #include "common/utilities/gmmstream.h"
 #include "gmmaudioreader_stream.h"
 #include <gmthread.h>
+#include <gmthreadpool.h>
 
 #define _MAD_CHECK_FLOW(i) if ((i) == MAD_FLOW_STOP) return MAD_FLOW_STOP;
 
@@ -73,6 +74,8 @@ public:
 	{
 		D(d);
 		d->decodeThread.setData(d, decode);
+		d->decodeThread.setName(L"GMM MP3 Decode");
+		d->decodeThread.setAffinityMask(gm::GMThreadPool::backgroundAffinityMask());
 		d->decodeThread.start();
 	}
 
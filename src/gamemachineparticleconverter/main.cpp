@@ -0,0 +1,44 @@
+﻿#include "stdafx.h"
+#include <gamemachine.h>
+#include <gmparticle.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+using namespace gm;
+
+// 将Cocos2D的粒子plist离线转换为GMParticleSystem::saveParticleDescription()的二进制格式。
+// 转换后的文件可以直接放入粒子资源包代替原文件，加载时不再需要解析XML、Base64和压缩过的纹理。
+// 用法：gamemachineparticleconverter <输入的plist> <输出的文件>
+int main(int argc, char* argv[])
+{
+	if (argc != 3)
+	{
+		std::cout << "Usage: gamemachineparticleconverter <input.plist> <output>" << std::endl;
+		return 1;
+	}
+
+	std::ifstream input(argv[1], std::ios::binary);
+	if (!input)
+	{
+		std::cout << "Cannot open " << argv[1] << std::endl;
+		return 1;
+	}
+
+	Vector<GMbyte> content((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+	GMBuffer plist(content.data(), content.size());
+	GMBuffer binary;
+	if (!GMParticleSystem::convertCocos2DPlist(plist, binary))
+	{
+		std::cout << "Cannot decode the texture of " << argv[1] << std::endl;
+		return 1;
+	}
+
+	std::ofstream output(argv[2], std::ios::binary);
+	output.write(reinterpret_cast<const char*>(binary.getData()), binary.getSize());
+	if (!output)
+	{
+		std::cout << "Cannot write " << argv[2] << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,3 @@
+﻿#if GM_WINDOWS
+#include <windows.h>
+#endif
\ No newline at end of file
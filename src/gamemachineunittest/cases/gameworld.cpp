@@ -0,0 +1,139 @@
+﻿#include "stdafx.h"
+#include "gameworld.h"
+#include <gmgameworld.h>
+#include <gmparticle.h>
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+	// 记录每一帧中各个节点执行的顺序
+	struct FrameRecorder
+	{
+		GMAtomic<gm::GMint32> counter{ 0 };
+		GMAtomic<gm::GMint32> particleStamp{ 0 };
+		GMAtomic<gm::GMint32> taskRuns{ 0 };
+		GMAtomic<gm::GMint32> removedTaskRuns{ 0 };
+	};
+
+	class RecordingObject : public gm::GMGameObject
+	{
+	public:
+		RecordingObject(FrameRecorder* recorder, bool skeletal)
+			: recorder(recorder)
+			, skeletal(skeletal)
+		{
+		}
+
+		virtual void update(gm::GMDuration dt) override
+		{
+			// 骨骼动画求值比较慢，如果粒子模拟没有等待它，就会先于它完成
+			if (skeletal)
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+			stamp = ++recorder->counter;
+		}
+
+		virtual bool isSkeletalObject() const override
+		{
+			return skeletal;
+		}
+
+	public:
+		FrameRecorder* recorder;
+		bool skeletal;
+		gm::GMint32 stamp = 0;
+	};
+
+	class RecordingParticleEffect : public gm::GMParticleEffect
+	{
+	public:
+		RecordingParticleEffect(FrameRecorder* recorder)
+			: recorder(recorder)
+		{
+		}
+
+	protected:
+		virtual void CPUUpdate(gm::GMParticleEmitter*, gm::GMDuration) override
+		{
+			recorder->particleStamp = ++recorder->counter;
+		}
+
+		virtual bool GPUUpdate(gm::GMParticleEmitter*, const gm::IRenderContext*, gm::GMDuration) override
+		{
+			return false;
+		}
+
+	private:
+		FrameRecorder* recorder;
+	};
+
+	bool runFrames(bool parallel)
+	{
+		FrameRecorder recorder;
+		gm::GMGameWorld world(nullptr);
+		world.setParallelFrame(parallel);
+
+		Vector<RecordingObject*> objects;
+		for (gm::GMint32 i = 0; i < 64; ++i)
+		{
+			RecordingObject* object = new RecordingObject(&recorder, i % 4 == 0);
+			world.addObjectAndInit(object);
+			objects.push_back(object);
+		}
+
+		gm::GMParticleSystemManager manager(nullptr);
+		gm::GMParticleSystem* system = new gm::GMParticleSystem();
+		system->getEmitter()->setParticleEffect(new RecordingParticleEffect(&recorder));
+		system->getEmitter()->setDuration(-1);
+		manager.addParticleSystem(system);
+		world.addParticleSystemManager(&manager);
+
+		gm::GMFrameTaskHandle task = world.addFrameTask([&recorder]() {
+			++recorder.taskRuns;
+		});
+		gm::GMFrameTaskHandle removedTask = world.addFrameTask([&recorder]() {
+			++recorder.removedTaskRuns;
+		});
+		if (!task || !removedTask || task == removedTask)
+			return false;
+		if (!world.removeFrameTask(removedTask) || world.removeFrameTask(removedTask))
+			return false;
+
+		// 第一帧尝试使用计算着色器，失败后从第二帧开始在CPU中模拟粒子
+		const gm::GMint32 frameCount = 8;
+		for (gm::GMint32 frame = 0; frame < frameCount; ++frame)
+		{
+			recorder.counter = 0;
+			recorder.particleStamp = 0;
+			world.updateGameWorld(.016f);
+
+			// 每个对象都恰好更新一次，粒子模拟在所有对象（包括骨骼动画）更新完之后执行
+			gm::GMint32 lastObjectStamp = 0;
+			for (auto object : objects)
+			{
+				if (object->stamp <= 0)
+					return false;
+				lastObjectStamp = std::max(lastObjectStamp, object->stamp);
+				object->stamp = 0;
+			}
+
+			if (frame > 0 && recorder.particleStamp <= lastObjectStamp)
+				return false;
+		}
+
+		bool removed = world.removeParticleSystemManager(&manager) && !world.removeParticleSystemManager(&manager);
+		return removed && recorder.taskRuns == frameCount && recorder.removedTaskRuns == 0;
+	}
+}
+
+void cases::GameWorld::addToUnitTest(UnitTest& ut)
+{
+	ut.addTestCase("GMGameWorld parallel frame ordering", []() {
+		return runFrames(true);
+	});
+
+	ut.addTestCase("GMGameWorld serial frame tasks", []() {
+		// 非并行帧模式下，粒子系统和每帧任务同样会被执行
+		return runFrames(false);
+	});
+}
@@ -0,0 +1,143 @@
+﻿#include "stdafx.h"
+#include "memory.h"
+#include <gmthread.h>
+#include <gmjobsystem.h>
+
+namespace
+{
+	struct PooledObject
+	{
+		GM_DECLARE_POOLED_ALLOCATOR(PooledObject)
+
+		gm::GMint32 value[8];
+	};
+
+	struct DerivedPooledObject : PooledObject
+	{
+		gm::GMint32 extra[32];
+	};
+}
+
+void cases::Memory::addToUnitTest(UnitTest& ut)
+{
+	ut.addTestCase("GMFixedSizePool", []() {
+		gm::GMFixedSizePool& pool = gm::GMFixedSizePool::poolOf<PooledObject>();
+		PooledObject* a = new PooledObject();
+		PooledObject* b = new PooledObject();
+		bool aligned = (reinterpret_cast<gm::GMsize_t>(a) & 15) == 0 && (reinterpret_cast<gm::GMsize_t>(b) & 15) == 0;
+		bool counted = pool.getLiveBlocks() == 2;
+
+		// 派生类超出了块大小，将直接从堆上分配
+		DerivedPooledObject* c = new DerivedPooledObject();
+		counted = counted && pool.getLiveBlocks() == 2;
+
+		delete a;
+		PooledObject* d = new PooledObject();
+		bool reused = d == a;
+		delete b;
+		delete c;
+		delete d;
+		return aligned && counted && reused && pool.getLiveBlocks() == 0;
+	});
+
+	ut.addTestCase("GMFrameArena", []() {
+		gm::GMFrameArena arena(256);
+		GMAtomic<gm::GMint32> misaligned(0);
+		gm::GMJobSystem::instance().parallelFor(0, 1000, 10, [&arena, &misaligned](gm::GMsize_t begin, gm::GMsize_t end) {
+			for (gm::GMsize_t i = begin; i < end; ++i)
+			{
+				gm::GMsize_t* p = arena.create<gm::GMsize_t>(i);
+				if ((reinterpret_cast<gm::GMsize_t>(p) & (alignof(gm::GMsize_t) - 1)) != 0 || *p != i)
+					++misaligned;
+			}
+		});
+
+		// 超出容量后申请了新的块，重置之后合并成一块
+		gm::GMsize_t capacity = arena.getCapacity();
+		arena.reset();
+		bool merged = arena.getCapacity() == capacity && arena.getUsedBytes() == 0;
+
+		gm::FrameVector<gm::GMint32> values{ gm::GMFrameAllocator<gm::GMint32>(&arena) };
+		gm::FrameHashMap<gm::GMint32, gm::GMint32> squares(16, gm::GMFrameAllocator<std::pair<const gm::GMint32, gm::GMint32>>(&arena));
+		for (gm::GMint32 i = 0; i < 100; ++i)
+		{
+			values.push_back(i);
+			squares[i] = i * i;
+		}
+		return misaligned == 0 && capacity > 256 && merged && values[99] == 99 && squares.size() == 100 && squares[99] == 99 * 99;
+	});
+
+	ut.addTestCase("GMPoolAllocator", []() {
+		// 任务对象和引用计数一起从内存池中分配，释放之后立即被复用
+		gm::GMJob* first = nullptr;
+		{
+			gm::GMJobHandle job = gm::GMJobSystem::createJob();
+			first = job.get();
+		}
+		gm::GMJobHandle job = gm::GMJobSystem::createJob();
+
+		gm::GMPoolAllocator<PooledObject> allocator;
+		PooledObject* object = allocator.allocate(1);
+		bool counted = gm::GMFixedSizePool::poolOf<PooledObject>().getLiveBlocks() == 1;
+		allocator.deallocate(object, 1);
+
+		// 一次分配多个元素时超出了块大小，直接从堆上分配
+		Vector<gm::GMint32, gm::GMPoolAllocator<gm::GMint32>> values(100, 1);
+
+		// 渲染列表清空后再次填充，复用之前的节点
+		gm::GMGameObjectList objects(3, nullptr);
+		Set<gm::GMGameObject**> nodes;
+		for (auto& object : objects)
+		{
+			nodes.insert(&object);
+		}
+		objects.clear();
+		objects.resize(3, nullptr);
+		bool nodesReused = true;
+		for (auto& object : objects)
+		{
+			nodesReused = nodesReused && nodes.count(&object) == 1;
+		}
+
+		return job.get() == first && (reinterpret_cast<gm::GMsize_t>(first) & 15) == 0 && counted
+			&& gm::GMFixedSizePool::poolOf<PooledObject>().getLiveBlocks() == 0 && values[99] == 1 && nodesReused;
+	});
+
+	ut.addTestCase("GMBuffer slice", []() {
+		gm::GMbyte bytes[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+		gm::GMBuffer slice;
+		{
+			gm::GMBuffer buffer(bytes, sizeof(bytes));
+			slice = gm::GMBuffer::createBufferView(buffer, 2, 3);
+		}
+
+		// 原缓冲区释放后，切片依然持有数据
+		gm::GMBuffer tail = gm::GMBuffer::createBufferView(slice, 1, 100);
+		return slice.getSize() == 3 && slice.getData()[0] == 2 && slice.getData()[2] == 4
+			&& tail.getSize() == 2 && tail.getData()[1] == 4
+			&& (reinterpret_cast<gm::GMsize_t>(slice.getData() - 2) & 15) == 0;
+	});
+
+	ut.addTestCase("GMBufferPool", []() {
+		gm::GMBufferPool& pool = gm::GMBufferPool::instance();
+		gm::GMbyte* first = nullptr;
+		{
+			gm::GMBuffer buffer(nullptr, 1000);
+			first = buffer.getData();
+		}
+		gm::GMint64 reused = pool.getReuseCount();
+		gm::GMBuffer buffer(nullptr, 900);
+		gm::GMBuffer large(nullptr, gm::GMBufferPool::MaxBlockSize + 1);
+		return buffer.getData() == first && pool.getReuseCount() == reused + 1 && large.getSize() == gm::GMBufferPool::MaxBlockSize + 1;
+	});
+
+	ut.addTestCase("gmAlignedAlloc statistics", []() {
+		gm::GMAlignedMemoryStatistics before = gm::AlignedMemoryAlloc::getStatistics();
+		void* p = gmAlignedAlloc(100, 16);
+		gmAlignedFree(p);
+		gm::GMAlignedMemoryStatistics after = gm::AlignedMemoryAlloc::getStatistics();
+		return after.numAllocs - before.numAllocs >= 1
+			&& after.numFrees - before.numFrees >= 1
+			&& after.totalBytesAllocated - before.totalBytesAllocated >= 100;
+	});
+}
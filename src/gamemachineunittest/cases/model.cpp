@@ -0,0 +1,236 @@
+﻿#include "stdafx.h"
+#include "model.h"
+#include <gmmodel.h>
+#include <gmmeshoptimizer.h>
+#include <algorithm>
+
+namespace
+{
+	// 每个三角形的三个顶点位置，旋转到最小的顶点在前面后排序，用来比较两个网格是否相同
+	Vector<Array<gm::GMfloat, 9>> sortedTriangles(const gm::GMVertices& vertices, const gm::GMIndices& indices)
+	{
+		Vector<Array<gm::GMfloat, 9>> triangles;
+		for (gm::GMsize_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			Array<Array<gm::GMfloat, 3>, 3> p;
+			for (gm::GMsize_t k = 0; k < 3; ++k)
+			{
+				p[k] = vertices[indices[i + k]].positions;
+			}
+			std::rotate(p.begin(), std::min_element(p.begin(), p.end()), p.end());
+
+			Array<gm::GMfloat, 9> triangle;
+			for (gm::GMsize_t k = 0; k < 9; ++k)
+			{
+				triangle[k] = p[k / 3][k % 3];
+			}
+			triangles.push_back(triangle);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+}
+
+void cases::Model::addToUnitTest(UnitTest& ut)
+{
+	ut.addTestCase("GMVertexLayout default", []() {
+		gm::GMVertexLayout layout;
+		gm::GMVertex vertex = { 0 };
+		vertex.positions = { 1, 2, 3 };
+		vertex.boneIds = { 4, 5, 6, 7 };
+		gm::GMbyte buffer[sizeof(gm::GMVertex)];
+		layout.pack(&vertex, 1, buffer);
+		return layout.isDefault()
+			&& layout.getStride() == sizeof(gm::GMVertex)
+			&& memcmp(buffer, &vertex, sizeof(vertex)) == 0;
+	});
+
+	ut.addTestCase("GMVertexLayout compact", []() {
+		gm::GMVertexLayout layout = gm::GMVertexLayout::createCompactLayout();
+		if (layout.isDefault() || layout.getStride() != 44)
+			return false;
+
+		gm::GMVertex vertex = { 0 };
+		vertex.positions = { 1, 2, 3 };
+		vertex.normals = { 0, 0, -1 };
+		vertex.texcoords = { .5f, 2 };
+		vertex.color = { 1, 0, .5f, 1 };
+		vertex.boneIds = { 1, 2, 127, 0 };
+
+		Vector<gm::GMbyte> buffer(layout.getStride());
+		layout.pack(&vertex, 1, buffer.data());
+
+		gm::GMfloat position[3];
+		memcpy(position, buffer.data() + layout.getOffset(gm::GMVertexDataType::Position), sizeof(position));
+
+		// (0, 0, -1)翻折到八面体的角上
+		gm::GMshort normal[2];
+		memcpy(normal, buffer.data() + layout.getOffset(gm::GMVertexDataType::Normal), sizeof(normal));
+
+		// 0.5和2.0的半精度浮点数
+		gm::GMushort texcoord[2];
+		memcpy(texcoord, buffer.data() + layout.getOffset(gm::GMVertexDataType::Texcoord), sizeof(texcoord));
+
+		const gm::GMbyte* color = buffer.data() + layout.getOffset(gm::GMVertexDataType::Color);
+		const gm::GMbyte* boneIds = buffer.data() + layout.getOffset(gm::GMVertexDataType::BoneIds);
+		return position[0] == 1 && position[1] == 2 && position[2] == 3
+			&& normal[0] == 32767 && normal[1] == 32767
+			&& texcoord[0] == 0x3800 && texcoord[1] == 0x4000
+			&& color[0] == 255 && color[1] == 0 && color[2] == 128 && color[3] == 255
+			&& boneIds[0] == 1 && boneIds[1] == 2 && boneIds[2] == 127 && boneIds[3] == 0;
+	});
+
+	ut.addTestCase("GMVertexLayout more than 255 bones", []() {
+		// 300个骨骼，每个顶点引用不同的骨骼
+		gm::GMVertices vertices(300, gm::GMVertex{ 0 });
+		for (gm::GMint32 i = 0; i < 300; ++i)
+		{
+			vertices[i].boneIds = { i, 0, 0, 0 };
+		}
+
+		// 前256个顶点的骨骼索引可以使用8位整数
+		gm::GMVertexLayout layout = gm::GMVertexLayout::createCompactLayout();
+		if (layout.fitVertices(vertices.data(), 256) || layout.getFormat(gm::GMVertexDataType::BoneIds) != gm::GMVertexAttributeFormat::UInt8)
+			return false;
+
+		if (!layout.fitVertices(vertices.data(), vertices.size())
+			|| layout.getFormat(gm::GMVertexDataType::BoneIds) != gm::GMVertexAttributeFormat::Default
+			|| layout.getFormat(gm::GMVertexDataType::Normal) != gm::GMVertexAttributeFormat::Octahedral
+			|| layout.getStride() != 44 - 4 + sizeof(vertices[0].boneIds))
+			return false;
+
+		Vector<gm::GMbyte> buffer(layout.getStride() * vertices.size());
+		layout.pack(vertices.data(), vertices.size(), buffer.data());
+		for (gm::GMsize_t i = 0; i < vertices.size(); ++i)
+		{
+			gm::GMint32 boneIds[4];
+			memcpy(boneIds, buffer.data() + i * layout.getStride() + layout.getOffset(gm::GMVertexDataType::BoneIds), sizeof(boneIds));
+			if (boneIds[0] != static_cast<gm::GMint32>(i))
+				return false;
+		}
+		return true;
+	});
+
+	ut.addTestCase("GMVertexLayout formats", []() {
+		gm::GMVertexLayout layout;
+		layout.setFormat(gm::GMVertexDataType::Normal, gm::GMVertexAttributeFormat::None);
+		layout.setFormat(gm::GMVertexDataType::Texcoord, gm::GMVertexAttributeFormat::Half);
+		return layout.getStride() == sizeof(gm::GMVertex) - 3 * sizeof(gm::GMfloat) - sizeof(gm::GMfloat)
+			&& layout.getOffset(gm::GMVertexDataType::Texcoord) == 3 * sizeof(gm::GMfloat)
+			&& !gm::GMVertexLayout::isFormatSupported(gm::GMVertexDataType::Position, gm::GMVertexAttributeFormat::None)
+			&& !gm::GMVertexLayout::isFormatSupported(gm::GMVertexDataType::Texcoord, gm::GMVertexAttributeFormat::Octahedral);
+	});
+
+	ut.addTestCase("GMMeshOptimizer deduplicate", []() {
+		// 两个三角形组成的四边形，非索引时有6个顶点
+		gm::GMVertices vertices(6, gm::GMVertex{ 0 });
+		const gm::GMfloat positions[6][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 } };
+		for (gm::GMsize_t i = 0; i < vertices.size(); ++i)
+		{
+			vertices[i].positions = { positions[i][0], positions[i][1], positions[i][2] };
+		}
+		gm::GMIndices indices = { 0, 1, 2, 3, 4, 5 };
+		auto before = sortedTriangles(vertices, indices);
+
+		gm::GMMeshOptimizer::deduplicateVertices(vertices, indices);
+		return vertices.size() == 4
+			&& indices.size() == 6
+			&& sortedTriangles(vertices, indices) == before;
+	});
+
+	ut.addTestCase("GMMeshOptimizer ACMR", []() {
+		// 打乱三角形顺序的网格
+		const gm::GMuint32 size = 64;
+		gm::GMVertices vertices;
+		for (gm::GMuint32 y = 0; y <= size; ++y)
+		{
+			for (gm::GMuint32 x = 0; x <= size; ++x)
+			{
+				gm::GMVertex vertex = { 0 };
+				vertex.positions = { static_cast<gm::GMfloat>(x), static_cast<gm::GMfloat>(y), 0 };
+				vertices.push_back(vertex);
+			}
+		}
+
+		Vector<Array<gm::GMuint32, 3>> triangles;
+		for (gm::GMuint32 y = 0; y < size; ++y)
+		{
+			for (gm::GMuint32 x = 0; x < size; ++x)
+			{
+				gm::GMuint32 i = y * (size + 1) + x;
+				triangles.push_back({ i, i + 1, i + size + 2 });
+				triangles.push_back({ i, i + size + 2, i + size + 1 });
+			}
+		}
+
+		gm::GMuint32 seed = 1;
+		for (gm::GMsize_t i = triangles.size() - 1; i > 0; --i)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			std::swap(triangles[i], triangles[seed % (i + 1)]);
+		}
+
+		gm::GMIndices indices;
+		for (const auto& triangle : triangles)
+		{
+			indices.insert(indices.end(), triangle.begin(), triangle.end());
+		}
+		auto before = sortedTriangles(vertices, indices);
+
+		const gm::GMuint32 cacheSize = 16;
+		gm::GMsize_t missesBefore = gm::GMMeshOptimizer::countCacheMisses(indices, vertices.size(), cacheSize);
+		gm::GMMeshOptimizer::optimizeVertexCache(indices, vertices.size());
+		gm::GMMeshOptimizer::optimizeOverdraw(indices, vertices, cacheSize, 1.05f);
+		gm::GMMeshOptimizer::optimizeVertexFetch(vertices, indices);
+		gm::GMsize_t missesAfter = gm::GMMeshOptimizer::countCacheMisses(indices, vertices.size(), cacheSize);
+
+		gm::GMfloat acmr = static_cast<gm::GMfloat>(missesAfter) / triangles.size();
+		return missesAfter < missesBefore
+			&& acmr < .8f
+			&& indices[0] == 0
+			&& sortedTriangles(vertices, indices) == before;
+	});
+
+	ut.addTestCase("GMMeshOptimizer simplify", []() {
+		// 平面网格可以在误差为0的情况下简化，边界上的顶点保持不动
+		const gm::GMuint32 size = 32;
+		gm::GMVertices vertices;
+		for (gm::GMuint32 y = 0; y <= size; ++y)
+		{
+			for (gm::GMuint32 x = 0; x <= size; ++x)
+			{
+				gm::GMVertex vertex = { 0 };
+				vertex.positions = { static_cast<gm::GMfloat>(x), static_cast<gm::GMfloat>(y), 0 };
+				vertices.push_back(vertex);
+			}
+		}
+
+		gm::GMIndices indices;
+		for (gm::GMuint32 y = 0; y < size; ++y)
+		{
+			for (gm::GMuint32 x = 0; x < size; ++x)
+			{
+				gm::GMuint32 i = y * (size + 1) + x;
+				indices.insert(indices.end(), { i, i + 1, i + size + 2, i, i + size + 2, i + size + 1 });
+			}
+		}
+
+		gm::GMIndices result;
+		gm::GMfloat error = 1;
+		const gm::GMsize_t target = indices.size() / 4 / 3 * 3;
+		gm::GMMeshOptimizer::simplify(vertices, indices, target, .01f, result, &error);
+		if (result.empty() || result.size() > target || error > 1e-4f)
+			return false;
+
+		for (gm::GMsize_t i = 0; i < result.size(); i += 3)
+		{
+			const auto& p0 = vertices[result[i]].positions;
+			const auto& p1 = vertices[result[i + 1]].positions;
+			const auto& p2 = vertices[result[i + 2]].positions;
+			gm::GMfloat z = (p1[0] - p0[0]) * (p2[1] - p0[1]) - (p1[1] - p0[1]) * (p2[0] - p0[0]);
+			if (z <= 0)
+				return false;
+		}
+		return true;
+	});
+}
@@ -0,0 +1,16 @@
+﻿#ifndef __CASES_MODEL_H__
+#define __CASES_MODEL_H__
+#include "unittest_def.h"
+#include <gamemachine.h>
+#include "unittestcase.h"
+
+namespace cases
+{
+	struct Model : public UnitTestCase
+	{
+	public:
+		virtual void addToUnitTest(UnitTest& ut) override;
+	};
+}
+
+#endif
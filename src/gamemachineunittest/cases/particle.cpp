@@ -0,0 +1,558 @@
+﻿#include "stdafx.h"
+#include "particle.h"
+#include <gmparticle.h>
+#include <algorithm>
+#include <random>
+
+namespace
+{
+	// 只在CPU中更新的粒子效果，不需要渲染上下文
+	class CPUParticleEffect : public gm::GMParticleEffect
+	{
+	protected:
+		virtual void CPUUpdate(gm::GMParticleEmitter* emitter, gm::GMDuration dt) override
+		{
+			gm::GMParticlePool& particles = emitter->getParticles();
+			gm::GMfloat* remainingLife = particles.stream(gm::GMParticlePool::RemainingLife);
+			for (gm::GMsize_t i = 0; i < particles.size(); ++i)
+			{
+				remainingLife[i] -= dt;
+			}
+			particles.removeDead();
+		}
+
+		virtual bool GPUUpdate(gm::GMParticleEmitter*, const gm::IRenderContext*, gm::GMDuration) override
+		{
+			return false;
+		}
+	};
+
+	// 填充count个随机的粒子
+	void fillParticles(gm::GMParticlePool& pool, gm::GMsize_t count)
+	{
+		std::mt19937 engine(0x1234);
+		std::uniform_real_distribution<gm::GMfloat> position(-10.f, 10.f);
+		std::uniform_real_distribution<gm::GMfloat> unit(0, 1.f);
+		std::uniform_real_distribution<gm::GMfloat> rotation(-7.f, 7.f);
+		pool.setCapacity(count);
+		for (gm::GMsize_t i = 0; i < count; ++i)
+		{
+			pool.add(gm::GMParticle());
+		}
+
+		gm::GMParticlePool::Stream positionStreams[] = { gm::GMParticlePool::PositionX, gm::GMParticlePool::PositionY, gm::GMParticlePool::PositionZ };
+		gm::GMParticlePool::Stream colorStreams[] = { gm::GMParticlePool::ColorR, gm::GMParticlePool::ColorG, gm::GMParticlePool::ColorB, gm::GMParticlePool::ColorA };
+		for (gm::GMsize_t i = 0; i < count; ++i)
+		{
+			for (auto s : positionStreams)
+				pool.stream(s)[i] = position(engine);
+			for (auto s : colorStreams)
+				pool.stream(s)[i] = unit(engine);
+			pool.stream(gm::GMParticlePool::Size)[i] = unit(engine) * 4.f;
+			pool.stream(gm::GMParticlePool::Rotation)[i] = rotation(engine);
+		}
+	}
+
+	// 原来逐个粒子展开四边形的算法：先绕z轴旋转，再平移到原点进行billboard旋转，最后平移回粒子中心
+	void expandBillboardReference(const gm::GMParticlePool& pool, gm::GMsize_t index, const GMQuat& billboardRotation, bool useParticleZ, GMVec3 (&corners)[4])
+	{
+		const GMVec3 center(
+			pool.stream(gm::GMParticlePool::PositionX)[index],
+			pool.stream(gm::GMParticlePool::PositionY)[index],
+			pool.stream(gm::GMParticlePool::PositionZ)[index]
+		);
+		const gm::GMfloat h = pool.stream(gm::GMParticlePool::Size)[index] / 2.f;
+		const gm::GMfloat z = useParticleZ ? center.getZ() : 0;
+		const GMQuat quat = Rotate(pool.stream(gm::GMParticlePool::Rotation)[index], GMVec3(0, 0, 1));
+		const GMVec4 raw[4] = {
+			GMVec4(center.getX() - h, center.getY() - h, z, 1),
+			GMVec4(center.getX() - h, center.getY() + h, z, 1),
+			GMVec4(center.getX() + h, center.getY() - h, z, 1),
+			GMVec4(center.getX() + h, center.getY() + h, z, 1),
+		};
+
+		const GMMat4 transToOrigin = Translate(-center);
+		const GMMat4 transToCenterPt = Translate(center);
+		for (gm::GMint32 i = 0; i < 4; ++i)
+		{
+			GMVec4 transformed = raw[i] * quat * transToOrigin * billboardRotation * transToCenterPt;
+			corners[i] = GMVec3(transformed.getX(), transformed.getY(), transformed.getZ());
+		}
+	}
+
+	// 用Size流标记每个粒子，按照pattern决定粒子是否存活，移除死亡粒子后检查剩下的恰好是存活的粒子
+	bool removeDeadKeepsAlive(gm::GMParticleRemoveMode mode, gm::GMsize_t count)
+	{
+		gm::GMParticlePool pool;
+		pool.setRemoveMode(mode);
+		pool.setCapacity(count);
+		Vector<gm::GMfloat> alive;
+		for (gm::GMsize_t i = 0; i < count; ++i)
+		{
+			// 第一个和最后一个粒子死亡，中间有连续死亡的粒子
+			bool dead = i == 0 || i == count - 1 || i % 7 == 3 || i % 7 == 4 || i % 5 == 0;
+			gm::GMParticle particle;
+			particle.setSize(static_cast<gm::GMfloat>(i));
+			particle.setRemainingLife(dead ? -.5f : 1.f);
+			pool.add(particle);
+			if (!dead)
+				alive.push_back(static_cast<gm::GMfloat>(i));
+		}
+
+		pool.removeDead();
+		if (pool.size() != alive.size())
+			return false;
+
+		const gm::GMfloat* life = pool.stream(gm::GMParticlePool::RemainingLife);
+		if (std::any_of(life, life + pool.size(), [](gm::GMfloat value) { return value <= 0; }))
+			return false;
+
+		// 稳定模式保持原来的顺序，另一种模式只要求是同一组粒子
+		Vector<gm::GMfloat> remaining(pool.stream(gm::GMParticlePool::Size), pool.stream(gm::GMParticlePool::Size) + pool.size());
+		if (mode == gm::GMParticleRemoveMode::SwapWithLast)
+			std::sort(remaining.begin(), remaining.end());
+		return remaining == alive;
+	}
+
+	// 粒子池满了之后，粒子不断死亡和发射，粒子池不应该再分配内存
+	bool steadyEmissionDoesNotAllocate(gm::GMParticleRemoveMode mode)
+	{
+		gm::GMParticleSystem system;
+		gm::GMParticleEmitter* emitter = system.getEmitter();
+		CPUParticleEffect* effect = new CPUParticleEffect();
+		effect->setLife(.3f);
+		effect->setLifeV(.2f);
+		emitter->setParticleEffect(effect);
+		emitter->setParticleCount(64);
+		emitter->setEmitRate(400);
+		emitter->setDuration(-1);
+		gm::GMParticlePool& pool = emitter->getParticles();
+		pool.setRemoveMode(mode);
+
+		// 第一次更新时设置粒子池的容量
+		emitter->update(nullptr, .016f);
+		Vector<const gm::GMfloat*> streams;
+		for (gm::GMint32 s = 0; s < gm::GMParticlePool::StreamCount; ++s)
+		{
+			streams.push_back(pool.stream(static_cast<gm::GMParticlePool::Stream>(s)));
+		}
+
+		bool full = false;
+		for (gm::GMint32 frame = 0; frame < 300; ++frame)
+		{
+			emitter->update(nullptr, .016f);
+			full = full || pool.full();
+			if (pool.capacity() != 64)
+				return false;
+			for (gm::GMint32 s = 0; s < gm::GMParticlePool::StreamCount; ++s)
+			{
+				if (pool.stream(static_cast<gm::GMParticlePool::Stream>(s)) != streams[s])
+					return false;
+			}
+		}
+		return full && !pool.empty();
+	}
+
+	// 公开CPUUpdate，以便直接调用SIMD的核函数
+	class GravityEffect : public gm::GMGravityParticleEffect
+	{
+	public:
+		using gm::GMGravityParticleEffect::CPUUpdate;
+	};
+
+	class RadialEffect : public gm::GMRadialParticleEffect
+	{
+	public:
+		using gm::GMRadialParticleEffect::CPUUpdate;
+	};
+
+	// 4096个粒子为一个任务，4103个粒子使第二个任务的最后3个粒子由标量部分处理。每4个粒子中有一个还没有离开出生点
+	Vector<gm::GMParticle> makeSimulationParticles(gm::GMParticlePool& pool)
+	{
+		const gm::GMsize_t count = 4103;
+		std::mt19937 engine(0x5678);
+		std::uniform_real_distribution<gm::GMfloat> value(-5.f, 5.f);
+		auto vec3 = [&]() { return GMVec3(value(engine), value(engine), value(engine)); };
+		auto vec4 = [&]() { return GMVec4(value(engine), value(engine), value(engine), value(engine)); };
+
+		Vector<gm::GMParticle> particles(count);
+		pool.setCapacity(count);
+		for (gm::GMsize_t i = 0; i < count; ++i)
+		{
+			gm::GMParticle& particle = particles[i];
+			particle.setPosition(vec3());
+			particle.setStartPosition(vec3());
+			particle.setChangePosition(i % 4 == 1 ? Zero<GMVec3>() : vec3());
+			particle.setColor(vec4());
+			particle.setDeltaColor(vec4());
+			particle.setSize(Fabs(value(engine)));
+			particle.setDeltaSize(value(engine));
+			particle.setRotation(value(engine));
+			particle.setDeltaRotation(value(engine));
+			particle.setRemainingLife(10.f + value(engine));
+			particle.getGravityModeData().initialVelocity = vec3();
+			particle.getGravityModeData().radialAcceleration = value(engine);
+			particle.getGravityModeData().tangentialAcceleration = value(engine);
+			particle.getRadiusModeData().angle = value(engine);
+			particle.getRadiusModeData().degressPerSecond = value(engine);
+			particle.getRadiusModeData().radius = value(engine);
+			particle.getRadiusModeData().deltaRadius = value(engine);
+			pool.add(particle);
+		}
+		return particles;
+	}
+
+	bool fuzzyEquals(const GMVec3& a, const GMVec3& b)
+	{
+		return Length(a - b) <= 1e-3f * Max(1.f, Length(b));
+	}
+
+	bool fuzzyEquals(const GMVec4& a, const GMVec4& b)
+	{
+		return fuzzyEquals(GMVec3(a.getX(), a.getY(), a.getZ()), GMVec3(b.getX(), b.getY(), b.getZ())) && Fabs(a.getW() - b.getW()) <= 1e-3f;
+	}
+
+	// 比较两种模式共有的属性
+	bool commonEquals(const gm::GMParticle& actual, const gm::GMParticle& expected)
+	{
+		return fuzzyEquals(actual.getPosition(), expected.getPosition()) &&
+			fuzzyEquals(actual.getChangePosition(), expected.getChangePosition()) &&
+			fuzzyEquals(actual.getColor(), expected.getColor()) &&
+			Fabs(actual.getSize() - expected.getSize()) <= 1e-4f &&
+			Fabs(actual.getRotation() - expected.getRotation()) <= 1e-4f &&
+			Fabs(actual.getRemainingLife() - expected.getRemainingLife()) <= 1e-4f;
+	}
+
+	// 原来逐个粒子更新的重力模式
+	void gravityReference(gm::GMParticle& particle, gm::GMParticleEmitter* emitter, const GMVec3& gravity, bool relative, gm::GMDuration dt)
+	{
+		particle.setRemainingLife(particle.getRemainingLife() - dt);
+		GMVec3 radial = Zero<GMVec3>();
+		if (particle.getChangePosition().getX() != 0 || particle.getChangePosition().getY() != 0 || particle.getChangePosition().getZ() != 0)
+			radial = Normalize(particle.getGravityModeData().initialVelocity);
+		GMVec3 tangential = radial;
+		radial *= particle.getGravityModeData().radialAcceleration;
+
+		gm::GMfloat y = tangential.getX();
+		tangential.setX(-tangential.getY());
+		tangential.setY(y);
+		tangential *= particle.getGravityModeData().tangentialAcceleration;
+
+		particle.getGravityModeData().initialVelocity += (radial + tangential + gravity) * dt;
+		particle.setChangePosition(particle.getChangePosition() + particle.getGravityModeData().initialVelocity * dt);
+		particle.setColor(particle.getColor() + particle.getDeltaColor() * dt);
+		particle.setSize(Max(0, particle.getSize() + particle.getDeltaSize() * dt));
+		particle.setRotation(particle.getRotation() + particle.getDeltaRotation() * dt);
+		if (relative)
+			particle.setPosition(particle.getChangePosition() + emitter->getEmitPosition() - particle.getStartPosition());
+		else
+			particle.setPosition(particle.getChangePosition());
+	}
+
+	// 原来逐个粒子更新的半径模式，旋转轴由Rotate()自己单位化
+	void radialReference(gm::GMParticle& particle, gm::GMParticleEmitter* emitter, bool relative, gm::GMDuration dt)
+	{
+		particle.setRemainingLife(particle.getRemainingLife() - dt);
+		particle.getRadiusModeData().angle += particle.getRadiusModeData().degressPerSecond * dt;
+		particle.getRadiusModeData().radius += particle.getRadiusModeData().deltaRadius * dt;
+		GMQuat rotationQuat = Rotate(particle.getRadiusModeData().angle, emitter->getRotationAxis());
+		particle.setChangePosition(GMVec4(0, 1, 0, 1) * rotationQuat * particle.getRadiusModeData().radius);
+		if (relative)
+			particle.setPosition(particle.getChangePosition() + particle.getStartPosition());
+		else
+			particle.setPosition(particle.getChangePosition() + emitter->getEmitPosition());
+		particle.setColor(particle.getColor() + particle.getDeltaColor() * dt);
+		particle.setSize(Max(0, particle.getSize() + particle.getDeltaSize() * dt));
+		particle.setRotation(particle.getRotation() + particle.getDeltaRotation() * dt);
+	}
+
+	bool gravityMatchesReference(gm::GMParticleMotionMode mode)
+	{
+		const gm::GMDuration dt = .016f;
+		const GMVec3 gravity(.5f, -9.8f, 1.f);
+		gm::GMParticleSystem system;
+		gm::GMParticleEmitter* emitter = system.getEmitter();
+		emitter->setEmitPosition(GMVec3(1, 2, 3));
+		gm::GMParticlePool& pool = emitter->getParticles();
+		Vector<gm::GMParticle> expected = makeSimulationParticles(pool);
+
+		GravityEffect effect;
+		effect.setMotionMode(mode);
+		effect.getGravityMode().setGravity(gravity);
+		effect.CPUUpdate(emitter, dt);
+
+		if (pool.size() != expected.size())
+			return false;
+		for (gm::GMsize_t i = 0; i < expected.size(); ++i)
+		{
+			gravityReference(expected[i], emitter, gravity, mode == gm::GMParticleMotionMode::Relative, dt);
+			gm::GMParticle actual;
+			pool.get(i, actual);
+			if (!commonEquals(actual, expected[i]) || !fuzzyEquals(actual.getGravityModeData().initialVelocity, expected[i].getGravityModeData().initialVelocity))
+				return false;
+		}
+		return true;
+	}
+
+	bool radialMatchesReference(gm::GMParticleMotionMode mode)
+	{
+		const gm::GMDuration dt = .016f;
+		gm::GMParticleSystem system;
+		gm::GMParticleEmitter* emitter = system.getEmitter();
+		emitter->setEmitPosition(GMVec3(1, 2, 3));
+		// 非单位长度的旋转轴
+		emitter->setRotationAxis(GMVec3(1.f, 2.f, -2.f));
+		gm::GMParticlePool& pool = emitter->getParticles();
+		Vector<gm::GMParticle> expected = makeSimulationParticles(pool);
+
+		RadialEffect effect;
+		effect.setMotionMode(mode);
+		effect.CPUUpdate(emitter, dt);
+
+		if (pool.size() != expected.size())
+			return false;
+		for (gm::GMsize_t i = 0; i < expected.size(); ++i)
+		{
+			radialReference(expected[i], emitter, mode == gm::GMParticleMotionMode::Relative, dt);
+			gm::GMParticle actual;
+			pool.get(i, actual);
+			if (!commonEquals(actual, expected[i]) ||
+				Fabs(actual.getRadiusModeData().angle - expected[i].getRadiusModeData().angle) > 1e-4f ||
+				Fabs(actual.getRadiusModeData().radius - expected[i].getRadiusModeData().radius) > 1e-4f)
+				return false;
+		}
+		return true;
+	}
+
+	bool expandBillboardsMatchesReference(bool useParticleZ)
+	{
+		// 13个粒子，SIMD的部分处理前12个，最后一个由标量部分处理
+		const gm::GMsize_t count = 13;
+		gm::GMParticlePool pool;
+		fillParticles(pool, count);
+
+		const GMQuat billboardRotation = RotationTo(GMVec3(0, 0, -1.f), Normalize(GMVec3(.3f, -.4f, 1.f)), Zero<GMVec3>());
+		Vector<gm::GMVertex> vertices(count * 6);
+		gm::GMParticleModel::expandBillboards(pool, 0, count, billboardRotation, useParticleZ, vertices.data());
+
+		// 两个三角形的顶点依次为四边形的第0、1、2、2、1、3个角
+		const gm::GMint32 cornerOfVertex[6] = { 0, 1, 2, 2, 1, 3 };
+		const gm::GMParticlePool::Stream colorStreams[] = { gm::GMParticlePool::ColorR, gm::GMParticlePool::ColorG, gm::GMParticlePool::ColorB, gm::GMParticlePool::ColorA };
+		for (gm::GMsize_t i = 0; i < count; ++i)
+		{
+			GMVec3 corners[4];
+			expandBillboardReference(pool, i, billboardRotation, useParticleZ, corners);
+			for (gm::GMint32 j = 0; j < 6; ++j)
+			{
+				const gm::GMVertex& vertex = vertices[i * 6 + j];
+				const GMVec3& expected = corners[cornerOfVertex[j]];
+				const gm::GMfloat actual[3] = { vertex.positions[0], vertex.positions[1], vertex.positions[2] };
+				const gm::GMfloat reference[3] = { expected.getX(), expected.getY(), expected.getZ() };
+				for (gm::GMint32 k = 0; k < 3; ++k)
+				{
+					if (Fabs(actual[k] - reference[k]) > 1e-3f)
+						return false;
+				}
+				for (gm::GMint32 k = 0; k < 4; ++k)
+				{
+					if (vertex.color[k] != pool.stream(colorStreams[k])[i])
+						return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+void cases::Particle::addToUnitTest(UnitTest& ut)
+{
+	ut.addTestCase("GMParticleDescription binary", []() {
+		gm::GMParticleDescription desc;
+		desc.setParticleCount(300);
+		desc.setEmitRate(12.5f);
+		desc.setEmitterType(gm::GMParticleEmitterType::Radius);
+		desc.setEmitterPosition(GMVec3(1, 2, 3));
+		desc.setBeginColor(GMVec4(.1f, .2f, .3f, .4f));
+		desc.setEndSizeV(7);
+		desc.getGravityMode().setGravity(GMVec3(0, -9.8f, 0));
+		desc.getRadiusMode().setSpinPerSecond(45);
+		desc.setParticleModelType(gm::GMParticleModelType::Particle3D);
+
+		// 一张2x2的RGBA纹理
+		gm::GMSharedPtr<gm::GMParticleTexture> texture = gm_makeSharedPtr<gm::GMParticleTexture>();
+		texture->image.reset(new gm::GMImage());
+		gm::GMImage::Data& data = texture->image->getData();
+		data.target = gm::GMImageTarget::Texture2D;
+		data.mipLevels = 1;
+		data.internalFormat = gm::GMImageInternalFormat::RGBA8;
+		data.format = gm::GMImageFormat::RGBA;
+		data.type = gm::GMImageDataType::UnsignedByte;
+		data.mip[0].width = data.mip[0].height = 2;
+		data.mip[0].data = new gm::GMbyte[16];
+		for (gm::GMbyte i = 0; i < 16; ++i)
+		{
+			data.mip[0].data[i] = i;
+		}
+		desc.setSharedTexture(texture);
+
+		gm::GMBuffer buffer;
+		if (!gm::GMParticleSystem::saveParticleDescription(desc, buffer) || !gm::GMParticleSystem::isParticleDescriptionBinary(buffer))
+			return false;
+
+		gm::GMParticleDescription loaded;
+		if (!gm::GMParticleSystem::loadParticleDescription(buffer, loaded))
+			return false;
+
+		bool equals = loaded.getParticleCount() == 300 &&
+			loaded.getEmitRate() == 12.5f &&
+			loaded.getEmitterType() == gm::GMParticleEmitterType::Radius &&
+			loaded.getEmitterPosition() == GMVec3(1, 2, 3) &&
+			loaded.getBeginColor() == GMVec4(.1f, .2f, .3f, .4f) &&
+			loaded.getEndSizeV() == 7 &&
+			loaded.getGravityMode().getGravity() == GMVec3(0, -9.8f, 0) &&
+			loaded.getRadiusMode().getSpinPerSecond() == 45 &&
+			loaded.getParticleModelType() == gm::GMParticleModelType::Particle3D;
+
+		const auto& loadedTexture = loaded.getSharedTexture();
+		bool textureEquals = loadedTexture && loadedTexture->image &&
+			loadedTexture->image->getWidth() == 2 &&
+			loadedTexture->image->getHeight() == 2 &&
+			memcmp(loadedTexture->image->getData().mip[0].data, data.mip[0].data, 16) == 0;
+
+		// 不是二进制格式的数据不会被加载
+		gm::GMbyte plist[] = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><plist></plist>";
+		gm::GMBuffer plistBuffer(plist, sizeof(plist));
+		bool rejected = !gm::GMParticleSystem::loadParticleDescription(plistBuffer, loaded);
+		return equals && textureEquals && rejected;
+	});
+
+	ut.addTestCase("GMParticleDescription float texture", []() {
+		// 一张2x1的RGBA浮点纹理，每个通道4个字节
+		gm::GMParticleDescription desc;
+		gm::GMSharedPtr<gm::GMParticleTexture> texture = gm_makeSharedPtr<gm::GMParticleTexture>();
+		texture->image.reset(new gm::GMImage());
+		gm::GMImage::Data& data = texture->image->getData();
+		data.target = gm::GMImageTarget::Texture2D;
+		data.mipLevels = 1;
+		data.internalFormat = gm::GMImageInternalFormat::RGBA8;
+		data.format = gm::GMImageFormat::RGBA;
+		data.type = gm::GMImageDataType::Float;
+		data.mip[0].width = 2;
+		data.mip[0].height = 1;
+		const gm::GMfloat pixels[8] = { .1f, .2f, .3f, .4f, .5f, .6f, .7f, .8f };
+		data.mip[0].data = new gm::GMbyte[sizeof(pixels)];
+		memcpy(data.mip[0].data, pixels, sizeof(pixels));
+		desc.setSharedTexture(texture);
+
+		gm::GMBuffer buffer;
+		gm::GMParticleDescription loaded;
+		if (!gm::GMParticleSystem::saveParticleDescription(desc, buffer) || !gm::GMParticleSystem::loadParticleDescription(buffer, loaded))
+			return false;
+
+		const auto& loadedTexture = loaded.getSharedTexture();
+		bool textureEquals = loadedTexture && loadedTexture->image &&
+			loadedTexture->image->getData().type == gm::GMImageDataType::Float &&
+			memcmp(loadedTexture->image->getData().mip[0].data, pixels, sizeof(pixels)) == 0;
+
+		// 截断的数据不会被加载
+		gm::GMBuffer truncated(buffer.getData(), buffer.getSize() - sizeof(gm::GMfloat));
+		bool rejected = !gm::GMParticleSystem::loadParticleDescription(truncated, loaded);
+		return textureEquals && rejected;
+	});
+
+	ut.addTestCase("GMParticleSystemManager frame arena", []() {
+		// 只调用update()、不经过GameMachine::renderFrame()的程序，帧内存的占用也不会一直增长
+		gm::GMParticleSystemManager manager(nullptr);
+		for (gm::GMint32 i = 0; i < 200; ++i)
+		{
+			gm::GMParticleSystem* system = new gm::GMParticleSystem();
+			system->getEmitter()->setParticleEffect(new CPUParticleEffect());
+			system->getEmitter()->setDuration(-1);
+			manager.addParticleSystem(system);
+		}
+
+		// 第一次更新时尝试使用计算着色器，之后所有的粒子系统都并行更新，并行更新列表超出了帧内存的初始容量
+		Vector<gm::GMsize_t> capacities;
+		for (gm::GMint32 i = 0; i < 10; ++i)
+		{
+			manager.update(.016f);
+			capacities.push_back(manager.getFrameArena().getCapacity());
+		}
+		return capacities[1] > 1024 && std::all_of(capacities.begin() + 1, capacities.end(), [&capacities](gm::GMsize_t capacity) {
+			return capacity == capacities[1];
+		});
+	});
+
+	ut.addTestCase("GMParticleModel::expandBillboards 2D", []() {
+		return expandBillboardsMatchesReference(false);
+	});
+
+	ut.addTestCase("GMParticleModel::expandBillboards 3D", []() {
+		return expandBillboardsMatchesReference(true);
+	});
+
+	ut.addTestCase("GMParticleModel::writeParticles", []() {
+		const gm::GMsize_t count = 5;
+		gm::GMParticlePool pool;
+		fillParticles(pool, count);
+		Vector<gm::GMParticleVertex> vertices(count * 6);
+		gm::GMParticleModel::writeParticles(pool, 0, count, vertices.data());
+		for (gm::GMsize_t i = 0; i < count * 6; ++i)
+		{
+			const gm::GMParticleVertex& vertex = vertices[i];
+			const gm::GMsize_t index = i / 6;
+			gm::GMbyte alpha = static_cast<gm::GMbyte>(Round(pool.stream(gm::GMParticlePool::ColorA)[index] * 255.f));
+			if (vertex.position[0] != pool.stream(gm::GMParticlePool::PositionX)[index] ||
+				vertex.position[1] != pool.stream(gm::GMParticlePool::PositionY)[index] ||
+				vertex.position[2] != pool.stream(gm::GMParticlePool::PositionZ)[index] ||
+				vertex.size != pool.stream(gm::GMParticlePool::Size)[index] ||
+				vertex.rotation != pool.stream(gm::GMParticlePool::Rotation)[index] ||
+				vertex.color[3] != alpha)
+				return false;
+		}
+		return true;
+	});
+
+	ut.addTestCase("GMParticlePool removeDead", []() {
+		// 20000个粒子时，稳定模式会并行地压缩各个流
+		return removeDeadKeepsAlive(gm::GMParticleRemoveMode::Stable, 40) &&
+			removeDeadKeepsAlive(gm::GMParticleRemoveMode::Stable, 20000) &&
+			removeDeadKeepsAlive(gm::GMParticleRemoveMode::SwapWithLast, 40) &&
+			removeDeadKeepsAlive(gm::GMParticleRemoveMode::SwapWithLast, 20000);
+	});
+
+	ut.addTestCase("GMParticleEmitter steady state", []() {
+		return steadyEmissionDoesNotAllocate(gm::GMParticleRemoveMode::Stable) &&
+			steadyEmissionDoesNotAllocate(gm::GMParticleRemoveMode::SwapWithLast);
+	});
+
+	ut.addTestCase("GMGravityParticleEffect SIMD kernel", []() {
+		return gravityMatchesReference(gm::GMParticleMotionMode::Free) && gravityMatchesReference(gm::GMParticleMotionMode::Relative);
+	});
+
+	ut.addTestCase("GMRadialParticleEffect SIMD kernel", []() {
+		return radialMatchesReference(gm::GMParticleMotionMode::Free) && radialMatchesReference(gm::GMParticleMotionMode::Relative);
+	});
+
+	ut.addTestCase("GMParticleSystem pooled data", []() {
+		// 粒子系统、发射器和粒子效果的数据段从各自的内存池中分配
+		gm::GMFixedSizePool& systemPool = gm::GMFixedSizePool::poolOf<gm::GMParticleSystemPrivate>();
+		gm::GMFixedSizePool& emitterPool = gm::GMFixedSizePool::poolOf<gm::GMParticleEmitterPrivate>();
+		gm::GMFixedSizePool& effectPool = gm::GMFixedSizePool::poolOf<gm::GMParticleEffectPrivate>();
+		gm::GMsize_t systems = systemPool.getLiveBlocks();
+		gm::GMsize_t emitters = emitterPool.getLiveBlocks();
+		gm::GMsize_t effects = effectPool.getLiveBlocks();
+
+		gm::GMParticleSystem* system = new gm::GMParticleSystem();
+		system->getEmitter()->setParticleEffect(new CPUParticleEffect());
+		bool counted = systemPool.getLiveBlocks() == systems + 1
+			&& emitterPool.getLiveBlocks() == emitters + 1
+			&& effectPool.getLiveBlocks() == effects + 1;
+
+		delete system;
+		return counted
+			&& systemPool.getLiveBlocks() == systems
+			&& emitterPool.getLiveBlocks() == emitters
+			&& effectPool.getLiveBlocks() == effects;
+	});
+}
@@ -0,0 +1,160 @@
+﻿#include "stdafx.h"
+#include "renderqueue.h"
+#include <gmrenderqueue.h>
+#include <gmgameobject.h>
+#include <gmmodel.h>
+#include <algorithm>
+
+namespace
+{
+	// 记录每次绘制时模型的LOD级别
+	class LodRecordingTechnique : public gm::ITechnique
+	{
+	public:
+		virtual void beginScene(gm::GMScene*) override {}
+		virtual void endScene() override {}
+		virtual void beginModel(gm::GMModel*, const gm::GMGameObject*) override {}
+		virtual void endModel() override {}
+		virtual void draw(gm::GMModel* model) override
+		{
+			lods.push_back(model->getActiveLod());
+		}
+
+		Vector<gm::GMuint32> lods;
+	};
+
+	gm::GMModelLods makeLods()
+	{
+		// 屏幕占比小于0.5时使用级别1，小于0.25时使用级别2
+		gm::GMModelLods lods;
+		lods.levels.resize(2);
+		lods.levels[0].screenSize = .5f;
+		lods.levels[1].screenSize = .25f;
+		lods.radius = 1;
+		return lods;
+	}
+}
+
+void cases::RenderQueue::addToUnitTest(UnitTest& ut)
+{
+	ut.addTestCase("GMRenderQueue radix sort", []() {
+		// 高位只有少量不同的值，用来检查稳定性和跳过相同字节的情况
+		Vector<gm::GMRenderSortEntry> entries;
+		gm::GMuint64 seed = 1;
+		for (gm::GMuint32 i = 0; i < 5000; ++i)
+		{
+			seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+			gm::GMRenderSortKey key = ((seed >> 60) << 48) | ((seed >> 20) & 0xFFF);
+			entries.push_back({ key, i });
+		}
+
+		Vector<gm::GMRenderSortEntry> expected = entries;
+		std::stable_sort(expected.begin(), expected.end(), [](const gm::GMRenderSortEntry& a, const gm::GMRenderSortEntry& b) {
+			return a.key < b.key;
+		});
+
+		Vector<gm::GMRenderSortEntry> buffer;
+		gm::GMRenderQueue::radixSort(entries, buffer);
+		for (gm::GMsize_t i = 0; i < entries.size(); ++i)
+		{
+			if (entries[i].key != expected[i].key || entries[i].index != expected[i].index)
+				return false;
+		}
+		return true;
+	});
+
+	ut.addTestCase("GMRenderQueue depth key", []() {
+		gm::GMuint32 last = gm::GMRenderQueue::depthToKey(0);
+		for (gm::GMfloat depth = .01f; depth < 10000.f; depth *= 1.5f)
+		{
+			gm::GMuint32 key = gm::GMRenderQueue::depthToKey(depth);
+			if (key < last || key > 0xFFF)
+				return false;
+			last = key;
+		}
+		return gm::GMRenderQueue::depthToKey(1.f) < gm::GMRenderQueue::depthToKey(4.f);
+	});
+
+	ut.addTestCase("GMGameObject LOD threshold crossing", []() {
+		const gm::GMModelLods lods = makeLods();
+		const gm::GMfloat hysteresis = .1f;
+
+		// 变小时需要低于阈值的0.9倍才切换到更简单的级别
+		if (gm::GMGameObject::selectLodLevel(lods, .46f, hysteresis, 0) != 0
+			|| gm::GMGameObject::selectLodLevel(lods, .44f, hysteresis, 0) != 1
+			|| gm::GMGameObject::selectLodLevel(lods, .2f, hysteresis, 1) != 2)
+			return false;
+
+		// 变大时需要高于阈值的1.1倍才切换回更精细的级别
+		if (gm::GMGameObject::selectLodLevel(lods, .27f, hysteresis, 2) != 2
+			|| gm::GMGameObject::selectLodLevel(lods, .28f, hysteresis, 2) != 1
+			|| gm::GMGameObject::selectLodLevel(lods, .54f, hysteresis, 1) != 1
+			|| gm::GMGameObject::selectLodLevel(lods, .56f, hysteresis, 1) != 0)
+			return false;
+
+		// 一次可以跨越多个级别，超出范围的级别被限制到最后一个级别
+		return gm::GMGameObject::selectLodLevel(lods, .1f, hysteresis, 0) == 2
+			&& gm::GMGameObject::selectLodLevel(lods, 1.f, hysteresis, 2) == 0
+			&& gm::GMGameObject::selectLodLevel(lods, .4f, hysteresis, 5) == 1
+			&& gm::GMGameObject::selectLodLevel(lods, .49f, 0, 0) == 1;
+	});
+
+	ut.addTestCase("GMGameObject LOD no flicker", []() {
+		const gm::GMModelLods lods = makeLods();
+		const gm::GMfloat hysteresis = .1f;
+
+		// 屏幕占比在阈值附近来回变化时，级别保持不变
+		gm::GMuint32 level = 0;
+		for (gm::GMint32 frame = 0; frame < 100; ++frame)
+		{
+			level = gm::GMGameObject::selectLodLevel(lods, frame % 2 ? .47f : .53f, hysteresis, level);
+			if (level != 0)
+				return false;
+		}
+
+		level = gm::GMGameObject::selectLodLevel(lods, .4f, hysteresis, level);
+		if (level != 1)
+			return false;
+
+		for (gm::GMint32 frame = 0; frame < 100; ++frame)
+		{
+			level = gm::GMGameObject::selectLodLevel(lods, frame % 2 ? .47f : .53f, hysteresis, level);
+			if (level != 1)
+				return false;
+		}
+
+		// 没有滞后时，同样的变化每帧都会切换级别
+		gm::GMuint32 switches = 0;
+		level = 0;
+		for (gm::GMint32 frame = 0; frame < 100; ++frame)
+		{
+			gm::GMuint32 next = gm::GMGameObject::selectLodLevel(lods, frame % 2 ? .47f : .53f, 0, level);
+			if (next != level)
+				++switches;
+			level = next;
+		}
+		return switches == 99;
+	});
+
+	ut.addTestCase("GMRenderQueue LOD", []() {
+		// 与GMGameObject::draw()相同：放入队列前设置级别，放入之后恢复为0
+		gm::GMGameObject object;
+		gm::GMModel model;
+		model.setLods(makeLods());
+		LodRecordingTechnique technique;
+		gm::GMRenderQueue queue(nullptr);
+		queue.begin();
+		for (gm::GMuint32 lod : { 2u, 1u, 0u })
+		{
+			model.setActiveLod(lod);
+			queue.push(&object, &model, &technique, nullptr);
+			model.setActiveLod(0u);
+		}
+
+		gm::GMRenderQueueStatistics statistics;
+		queue.end(statistics);
+		return technique.lods == Vector<gm::GMuint32>({ 2, 1, 0 })
+			&& statistics.drawCalls == 3
+			&& model.getActiveLod() == 0;
+	});
+}
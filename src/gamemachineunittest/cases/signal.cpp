@@ -0,0 +1,43 @@
+﻿#include "stdafx.h"
+#include "signal.h"
+
+namespace
+{
+	class SignalSender : public gm::GMObject
+	{
+		GM_DECLARE_SIGNAL(fired)
+		GM_DECLARE_SIGNAL(other)
+	};
+}
+
+void cases::Signal::addToUnitTest(UnitTest& ut)
+{
+	ut.addTestCase("信号ID驻留", []() {
+		return GM_SIGNAL(SignalSender, fired) == gm::GMObject::internSignal(L"fired") &&
+			GM_SIGNAL(SignalSender, fired) != GM_SIGNAL(SignalSender, other) &&
+			gm::GMObject::getSignalName(GM_SIGNAL(SignalSender, other)) == L"other";
+	});
+
+	ut.addTestCase("触发与解绑信号", []() {
+		SignalSender sender;
+		gm::GMint32 fired = 0, other = 0;
+		bool result = true;
+		{
+			gm::GMObject receiver;
+			receiver.connect(sender, GM_SIGNAL(SignalSender, fired), [&](gm::GMObject*, gm::GMObject*) { ++fired; });
+			receiver.connect(sender, GM_SIGNAL(SignalSender, other), [&](gm::GMObject*, gm::GMObject*) { ++other; });
+			sender.emitSignal(GM_SIGNAL(SignalSender, fired));
+			sender.emitSignal(GM_SIGNAL(SignalSender, fired));
+			sender.emitSignal(GM_SIGNAL(SignalSender, other));
+			result = fired == 2 && other == 1;
+
+			receiver.disconnect(sender, GM_SIGNAL(SignalSender, fired));
+			sender.emitSignal(GM_SIGNAL(SignalSender, fired));
+			result = result && fired == 2;
+		}
+
+		// 接收者析构后，信号不再通知它
+		sender.emitSignal(GM_SIGNAL(SignalSender, other));
+		return result && other == 1;
+	});
+}
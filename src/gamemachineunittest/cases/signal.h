@@ -0,0 +1,16 @@
+﻿#ifndef __CASES_SIGNAL_H__
+#define __CASES_SIGNAL_H__
+#include "unittest_def.h"
+#include <gamemachine.h>
+#include "unittestcase.h"
+
+namespace cases
+{
+	struct Signal : public UnitTestCase
+	{
+	public:
+		virtual void addToUnitTest(UnitTest& ut) override;
+	};
+}
+
+#endif
@@ -0,0 +1,493 @@
+﻿#include "stdafx.h"
+#include "skeleton.h"
+#include <gmskeleton.h>
+#include <gmskeletalgameobject.h>
+#include <cmath>
+#include <functional>
+
+namespace
+{
+	gm::GMSkeletalNode* createNode(const gm::GMString& name, const GMMat4& transform, gm::GMSkeletalNode* parent)
+	{
+		gm::GMSkeletalNode* node = new gm::GMSkeletalNode();
+		node->setName(name);
+		node->setParent(parent);
+		node->setTransformToParent(transform);
+		if (parent)
+			parent->getChildren().push_back(node);
+		return node;
+	}
+
+	GMMat4 makeTransform(gm::GMfloat scaling, gm::GMfloat angle, const GMVec3& axis, const GMVec3& translation)
+	{
+		return Scale(GMVec3(scaling)) * QuatToMatrix(Rotate(angle, Normalize(axis))) * Translate(translation);
+	}
+
+	bool matrixEquals(const GMMat4& a, const GMMat4& b, gm::GMfloat tolerance)
+	{
+		const gm::GMfloat* pa = ValuePointer(a);
+		const gm::GMfloat* pb = ValuePointer(b);
+		for (gm::GMint32 i = 0; i < 16; ++i)
+		{
+			if (Fabs(pa[i] - pb[i]) > tolerance)
+				return false;
+		}
+		return true;
+	}
+
+	// q与-q表示同一个旋转
+	bool quatEquals(const gm::GMfloat (&a)[4], const gm::GMfloat (&b)[4], gm::GMfloat tolerance)
+	{
+		gm::GMfloat same = 0, opposite = 0;
+		for (gm::GMint32 i = 0; i < 4; ++i)
+		{
+			same = Max(same, Fabs(a[i] - b[i]));
+			opposite = Max(opposite, Fabs(a[i] + b[i]));
+		}
+		return Min(same, opposite) <= tolerance;
+	}
+
+	void getRotation(const gm::GMSkeletalPose& pose, gm::GMsize_t node, OUT gm::GMfloat (&q)[4])
+	{
+		q[0] = pose.getStream(gm::GMSkeletalPose::RotationX)[node];
+		q[1] = pose.getStream(gm::GMSkeletalPose::RotationY)[node];
+		q[2] = pose.getStream(gm::GMSkeletalPose::RotationZ)[node];
+		q[3] = pose.getStream(gm::GMSkeletalPose::RotationW)[node];
+	}
+
+	void toArray(const GMQuat& quat, OUT gm::GMfloat (&q)[4])
+	{
+		q[0] = quat.getX();
+		q[1] = quat.getY();
+		q[2] = quat.getZ();
+		q[3] = quat.getW();
+	}
+
+	// 以双精度计算的球面插值，沿着最短路径进行
+	void referenceSlerp(const GMQuat& q0, const GMQuat& q1, gm::GMfloat t, OUT gm::GMfloat (&q)[4])
+	{
+		gm::GMfloat a[4], b[4];
+		toArray(q0, a);
+		toArray(q1, b);
+		double cosTheta = 0;
+		for (gm::GMint32 i = 0; i < 4; ++i)
+		{
+			cosTheta += static_cast<double>(a[i]) * b[i];
+		}
+		double sign = cosTheta < 0 ? -1 : 1;
+		double theta = std::acos(std::min(cosTheta * sign, 1.0));
+		double s0 = 1 - t, s1 = t;
+		if (theta > 1e-6)
+		{
+			s0 = std::sin((1 - t) * theta) / std::sin(theta);
+			s1 = std::sin(t * theta) / std::sin(theta);
+		}
+		for (gm::GMint32 i = 0; i < 4; ++i)
+		{
+			q[i] = static_cast<gm::GMfloat>(a[i] * s0 + b[i] * s1 * sign);
+		}
+	}
+
+	// 一个根节点下面挂若干个子节点的骨架，每个子节点都有对应的动画通道
+	struct SkeletonFixture
+	{
+		SkeletonFixture(gm::GMsize_t channelCount)
+		{
+			root = createNode("root", Identity<GMMat4>(), nullptr);
+			animation.frameRate = 1;
+			animation.duration = 10;
+			for (gm::GMsize_t i = 0; i < channelCount; ++i)
+			{
+				gm::GMString name = gm::GMString(L"node") + gm::GMString(gm::gm_sizet_to_int(i));
+				createNode(name, makeTransform(1, .1f * i, GMVec3(0, 1, 0), GMVec3(0, 1, 0)), root);
+
+				gm::GMSkeletalAnimationNode channel;
+				channel.name = name;
+				animation.nodes.push_back(channel);
+			}
+		}
+
+		~SkeletonFixture()
+		{
+			GM_delete(root);
+		}
+
+		gm::GMSkeletalNode* root = nullptr;
+		gm::GMSkeleton skeleton;
+		gm::GMSkeletalAnimation animation;
+	};
+}
+
+void cases::Skeleton::addToUnitTest(UnitTest& ut)
+{
+	ut.addTestCase("GMSkeletalAnimationEvaluator cursor", []() {
+		// 关键帧间隔不均匀，顺序播放并且循环几次，结果与每次重新查找的求值器相同
+		SkeletonFixture fixture(2);
+		gm::GMfloat time = 0;
+		for (gm::GMint32 k = 0; k < 40; ++k)
+		{
+			gm::GMfloat value = static_cast<gm::GMfloat>(k);
+			fixture.animation.nodes[0].positions.emplace_back(time, GMVec3(value, -value, value * value));
+			fixture.animation.nodes[1].scalings.emplace_back(time, GMVec3(1 + value, 1, 2));
+			time += (k % 3 + 1) * .1f;
+		}
+		fixture.animation.duration = time;
+
+		gm::GMSkeletalAnimationEvaluator playing(fixture.root, &fixture.skeleton);
+		playing.setAnimation(&fixture.animation);
+		for (gm::GMint32 frame = 1; frame < 200; ++frame)
+		{
+			// 偶尔跳过一大段时间
+			gm::GMfloat dt = frame % 50 == 0 ? 2.3f : .07f;
+			playing.evaluatePose(dt);
+
+			gm::GMSkeletalAnimationEvaluator seeking(fixture.root, &fixture.skeleton);
+			seeking.setAnimation(&fixture.animation);
+			seeking.evaluatePose(playing.getAnimationTime());
+			for (gm::GMint32 stream = gm::GMSkeletalPose::PositionX; stream < gm::GMSkeletalPose::StreamCount; ++stream)
+			{
+				auto s = static_cast<gm::GMSkeletalPose::Stream>(stream);
+				for (gm::GMsize_t n = 0; n < 3; ++n)
+				{
+					if (Fabs(playing.getPose().getStream(s)[n] - seeking.getPose().getStream(s)[n]) > 1e-4f)
+						return false;
+				}
+			}
+		}
+
+		// 没有平移关键帧的通道使用零平移，没有缩放关键帧的通道使用单位缩放
+		const gm::GMSkeletalPose& pose = playing.getPose();
+		return pose.getStream(gm::GMSkeletalPose::ScalingX)[1] == 1
+			&& pose.getStream(gm::GMSkeletalPose::PositionY)[2] == 0;
+	});
+
+	ut.addTestCase("GMSkeletalHierarchy flatten", []() {
+		// root -> a -> c，root -> b
+		gm::GMSkeletalNode* root = createNode("root", makeTransform(2, .3f, GMVec3(0, 0, 1), GMVec3(1, 2, 3)), nullptr);
+		gm::GMSkeletalNode* a = createNode("a", makeTransform(1, .5f, GMVec3(1, 0, 0), GMVec3(0, 1, 0)), root);
+		gm::GMSkeletalNode* b = createNode("b", makeTransform(1.5f, -.7f, GMVec3(0, 1, 1), GMVec3(-1, 0, 2)), root);
+		gm::GMSkeletalNode* c = createNode("c", makeTransform(.5f, 1.2f, GMVec3(1, 1, 0), GMVec3(0, 0, -3)), a);
+
+		gm::GMSkeletalHierarchy hierarchy(root);
+		const auto& nodes = hierarchy.getNodes();
+		const auto& parents = hierarchy.getParents();
+		bool flattened = nodes.size() == 4
+			&& nodes[0] == root && nodes[1] == a && nodes[2] == c && nodes[3] == b
+			&& parents[0] == -1 && parents[1] == 0 && parents[2] == 1 && parents[3] == 0;
+
+		// 骨骼c有偏移矩阵，骨骼missing没有对应的节点，保持绑定姿势
+		gm::GMSkeleton skeleton;
+		auto& bones = skeleton.getBones().getBones();
+		auto& boneMapping = skeleton.getBones().getBoneNameIndexMap();
+		const char* boneNames[] = { "b", "c", "a", "missing" };
+		for (gm::GMsize_t i = 0; i < 4; ++i)
+		{
+			gm::GMSkeletalBone bone;
+			bone.name = boneNames[i];
+			bone.offsetMatrix = Identity<GMMat4>();
+			bones.push_back(bone);
+			boneMapping[bone.name] = i;
+		}
+		bones[1].offsetMatrix = makeTransform(1, .2f, GMVec3(0, 1, 0), GMVec3(4, 0, 0));
+		bones[3].offsetMatrix = Translate(GMVec3(7, 8, 9));
+
+		// 没有动画通道时，所有节点保持绑定姿势
+		gm::GMSkeletalAnimation animation;
+		animation.duration = 1;
+		gm::GMSkeletalAnimationEvaluator evaluator(root, &skeleton);
+		evaluator.setAnimation(&animation);
+		evaluator.update(0);
+
+		// 与递归计算的结果比较
+		std::function<GMMat4(const gm::GMSkeletalNode*)> globalTransform = [&](const gm::GMSkeletalNode* node) {
+			if (!node->getParent())
+				return node->getTransformToParent();
+			return node->getTransformToParent() * globalTransform(node->getParent());
+		};
+		GMMat4 globalInverse = Inverse(root->getTransformToParent());
+		const auto& transforms = evaluator.getTransforms();
+		bool matches = transforms.size() == 4
+			&& matrixEquals(transforms[0], globalTransform(b) * globalInverse, 1e-4f)
+			&& matrixEquals(transforms[1], bones[1].offsetMatrix * globalTransform(c) * globalInverse, 1e-4f)
+			&& matrixEquals(transforms[2], globalTransform(a) * globalInverse, 1e-4f)
+			&& matrixEquals(transforms[3], Identity<GMMat4>(), 0);
+
+		GM_delete(root);
+		return flattened && matches;
+	});
+
+	ut.addTestCase("GMSkeletalAnimationEvaluator slerp", []() {
+		// 6个通道，覆盖SIMD的一组4个通道以及不足4个的剩余部分
+		const gm::GMsize_t channelCount = 6;
+		SkeletonFixture fixture(channelCount);
+		Vector<GMQuat> from, to;
+		for (gm::GMsize_t i = 0; i < channelCount; ++i)
+		{
+			GMQuat q0 = Rotate(.3f * i, Normalize(GMVec3(1, i, 2)));
+			GMQuat q1 = Rotate(.3f * i + .2f + .3f * i, Normalize(GMVec3(i, 1, -1.f)));
+
+			// 第2个通道的终点取反，需要沿着最短路径插值
+			if (i == 2)
+				q1 = GMQuat(-q1.getX(), -q1.getY(), -q1.getZ(), -q1.getW());
+
+			from.push_back(q0);
+			to.push_back(q1);
+			fixture.animation.nodes[i].rotations.emplace_back(0.f, GMQuat(q0));
+			fixture.animation.nodes[i].rotations.emplace_back(10.f, GMQuat(q1));
+		}
+
+		gm::GMSkeletalAnimationEvaluator evaluator(fixture.root, &fixture.skeleton);
+		evaluator.setAnimation(&fixture.animation);
+		evaluator.evaluatePose(3.7f);
+
+		const auto& nodes = evaluator.getHierarchy().getNodes();
+		const gm::GMSkeletalPose& pose = evaluator.getPose();
+		for (gm::GMsize_t n = 1; n < nodes.size(); ++n)
+		{
+			gm::GMsize_t i = n - 1;
+			if (nodes[n]->getName() != fixture.animation.nodes[i].name)
+				return false;
+
+			gm::GMfloat expected[4], actual[4];
+			referenceSlerp(from[i], to[i], .37f, expected);
+			getRotation(pose, n, actual);
+			if (!quatEquals(expected, actual, 1e-4f))
+				return false;
+		}
+		return true;
+	});
+
+	ut.addTestCase("GMSkeletalPose blend", []() {
+		const gm::GMsize_t nodeCount = 5;
+		gm::GMSkeletalPose a, b;
+		a.resize(nodeCount);
+		b.resize(nodeCount);
+		for (gm::GMsize_t i = 0; i < nodeCount; ++i)
+		{
+			a.setTransform(i, makeTransform(1, .2f * i, GMVec3(0, 1, 0), GMVec3(i, 0, 0)));
+			b.setTransform(i, makeTransform(2, -.4f * i, GMVec3(1, 0, 1), GMVec3(0, i, 1)));
+		}
+
+		// 交叉淡入淡出：平移和缩放线性插值，旋转归一化线性插值
+		gm::GMSkeletalPose crossfade = a;
+		crossfade.blend(b, .25f, nullptr);
+		for (gm::GMsize_t i = 0; i < nodeCount; ++i)
+		{
+			gm::GMfloat qa[4], qb[4], expected[4], actual[4];
+			getRotation(a, i, qa);
+			getRotation(b, i, qb);
+			gm::GMfloat length = 0;
+			for (gm::GMint32 k = 0; k < 4; ++k)
+			{
+				expected[k] = qa[k] * .75f + qb[k] * .25f;
+				length += expected[k] * expected[k];
+			}
+			for (auto& v : expected)
+			{
+				v /= std::sqrt(length);
+			}
+			getRotation(crossfade, i, actual);
+
+			gm::GMfloat position = crossfade.getStream(gm::GMSkeletalPose::PositionY)[i];
+			gm::GMfloat scaling = crossfade.getStream(gm::GMSkeletalPose::ScalingZ)[i];
+			if (!quatEquals(expected, actual, 1e-5f) || Fabs(position - i * .25f) > 1e-5f || Fabs(scaling - 1.25f) > 1e-5f)
+				return false;
+		}
+
+		// 节点权重为0的节点保持不变，权重为1的节点等于目标姿势
+		Vector<gm::GMfloat> nodeWeights(a.getStride(), 1.f);
+		nodeWeights[0] = 0;
+		gm::GMSkeletalPose masked = a;
+		masked.blend(b, 1, nodeWeights.data());
+		for (gm::GMsize_t i = 0; i < nodeCount; ++i)
+		{
+			const gm::GMSkeletalPose& expected = i == 0 ? a : b;
+			for (gm::GMint32 stream = 0; stream < gm::GMSkeletalPose::StreamCount; ++stream)
+			{
+				auto s = static_cast<gm::GMSkeletalPose::Stream>(stream);
+				if (Fabs(masked.getStream(s)[i] - expected.getStream(s)[i]) > 1e-5f)
+					return false;
+			}
+		}
+
+		// 叠加与参考姿势相同的姿势，结果不变
+		gm::GMSkeletalPose additive = a;
+		additive.blendAdditive(b, b, 1, nullptr);
+		for (gm::GMsize_t i = 0; i < nodeCount; ++i)
+		{
+			gm::GMfloat expected[4], actual[4];
+			getRotation(a, i, expected);
+			getRotation(additive, i, actual);
+			if (!quatEquals(expected, actual, 1e-5f)
+				|| Fabs(additive.getStream(gm::GMSkeletalPose::PositionX)[i] - a.getStream(gm::GMSkeletalPose::PositionX)[i]) > 1e-5f
+				|| Fabs(additive.getStream(gm::GMSkeletalPose::ScalingX)[i] - a.getStream(gm::GMSkeletalPose::ScalingX)[i]) > 1e-5f)
+				return false;
+		}
+
+		// 在单位姿势上叠加相对于单位姿势的变化量，结果等于叠加的姿势
+		gm::GMSkeletalPose identity, result;
+		identity.resize(nodeCount);
+		result.resize(nodeCount);
+		result.blendAdditive(b, identity, 1, nullptr);
+		for (gm::GMsize_t i = 0; i < nodeCount; ++i)
+		{
+			gm::GMfloat expected[4], actual[4];
+			getRotation(b, i, expected);
+			getRotation(result, i, actual);
+			if (!quatEquals(expected, actual, 1e-5f)
+				|| Fabs(result.getStream(gm::GMSkeletalPose::PositionY)[i] - b.getStream(gm::GMSkeletalPose::PositionY)[i]) > 1e-5f
+				|| Fabs(result.getStream(gm::GMSkeletalPose::ScalingY)[i] - b.getStream(gm::GMSkeletalPose::ScalingY)[i]) > 1e-5f)
+				return false;
+		}
+		return true;
+	});
+
+	ut.addTestCase("GMSkeletalPoseCache", []() {
+		gm::GMSkeletalPoseCache cache;
+		gm::GMSkeletalPoseKey key;
+		key.animationTime = 3;
+		gm::AlignedVector<GMMat4> transforms(2, Translate(GMVec3(1, 2, 3)));
+		cache.insert(key, transforms);
+
+		// 动画时间不同的结果不能共享
+		gm::GMSkeletalPoseKey other = key;
+		other.animationTime = 4;
+		gm::AlignedVector<GMMat4> found;
+		if (cache.find(other, found) || !cache.find(key, found) || found.size() != 2 || !matrixEquals(found[1], transforms[1], 0))
+			return false;
+
+		// 一帧没有使用的结果在下一帧开始时被移除
+		cache.nextFrame();
+		bool kept = cache.find(key, found);
+		cache.nextFrame();
+		kept = kept && cache.getEntryCount() == 1;
+		cache.nextFrame();
+		return kept && cache.getEntryCount() == 0 && !cache.find(key, found);
+	});
+
+	ut.addTestCase("GMSkeletalPoseCache skeletal data release", []() {
+		gm::GMSkeletalPoseCache cache;
+		gm::GMSkeletalPoseKey key;
+		key.skeleton = new gm::GMSkeleton();
+		gm::AlignedVector<GMMat4> transforms(1, Translate(GMVec3(1, 2, 3)));
+		cache.insert(key, transforms);
+
+		// 骨架被析构后，同一个地址可能属于新的骨架，之前的结果不能再被取到
+		gm::AlignedVector<GMMat4> found;
+		bool hit = cache.find(key, found);
+		delete key.skeleton;
+		if (!hit || cache.find(key, found))
+			return false;
+
+		cache.nextFrame();
+		if (cache.getEntryCount() != 0)
+			return false;
+
+		gm::GMSkeletalAnimations* animations = new gm::GMSkeletalAnimations();
+		cache.insert(key, transforms);
+		hit = cache.find(key, found);
+		delete animations;
+		if (!hit || cache.find(key, found))
+			return false;
+
+		// 新插入的结果会先移除失效的结果
+		cache.insert(key, transforms);
+		return cache.getEntryCount() == 1 && cache.find(key, found);
+	});
+
+	ut.addTestCase("GMSkeletalAnimationEvaluator time quantum", []() {
+		// 每秒30个tick，量化间隔0.1秒即3个tick
+		SkeletonFixture fixture(1);
+		fixture.animation.frameRate = 30;
+		fixture.animation.duration = 60;
+		gm::GMSkeletalAnimationEvaluator evaluator(fixture.root, &fixture.skeleton);
+		evaluator.setAnimation(&fixture.animation);
+		evaluator.advance(.25f);
+		if (Fabs(evaluator.getAnimationTime() - 7.5f) > 1e-4f)
+			return false;
+
+		evaluator.setTimeQuantum(.1f);
+		return Fabs(evaluator.getAnimationTime() - 6) < 1e-4f;
+	});
+
+	ut.addTestCase("GMSkeletalCompressedAnimation round trip", []() {
+		// 每个tick一个关键帧，共1秒
+		const gm::GMsize_t channelCount = 3;
+		SkeletonFixture fixture(channelCount);
+		fixture.animation.frameRate = 30;
+		fixture.animation.duration = 30;
+		for (gm::GMsize_t i = 0; i < channelCount; ++i)
+		{
+			auto& channel = fixture.animation.nodes[i];
+			for (gm::GMint32 t = 0; t <= 30; ++t)
+			{
+				gm::GMfloat time = static_cast<gm::GMfloat>(t);
+				channel.rotations.emplace_back(time, Rotate(.1f * t + i, Normalize(GMVec3(1, 2, i + 1.f))));
+				channel.positions.emplace_back(time, GMVec3(std::sin(.2f * t), i, .5f * t));
+			}
+			channel.scalings.emplace_back(0.f, GMVec3(1, 2, 3));
+		}
+
+		// 采样率与关键帧相同并且不允许误差时，所有关键帧都被保留，只剩下量化误差
+		gm::GMSkeletalCompressionSettings settings;
+		settings.rotationTolerance = settings.positionTolerance = settings.scalingTolerance = 0;
+		gm::GMSkeletalCompressedAnimation compressed(fixture.animation, settings);
+		if (compressed.getSampleCount() != 31 || compressed.getMemoryUsage() >= gm::GMSkeletalCompressedAnimation::getMemoryUsage(fixture.animation))
+			return false;
+
+		for (gm::GMsize_t i = 0; i < channelCount; ++i)
+		{
+			const auto& channel = compressed.getChannels()[i];
+			if (channel.rotations.keyCount != 31 || channel.positions.keyCount != 31 || channel.scalings.keyCount != 1)
+				return false;
+
+			for (gm::GMsize_t key = 0; key < 31; ++key)
+			{
+				gm::GMfloat expected[4], actual[4];
+				toArray(fixture.animation.nodes[i].rotations[key].value, expected);
+				compressed.decodeRotation(channel.rotations, key, actual + 0, actual + 1, actual + 2, actual + 3);
+				if (!quatEquals(expected, actual, 1e-4f))
+					return false;
+			}
+		}
+
+		// 压缩前后求值的结果相同
+		gm::GMSkeletalAnimation compressedAnimation = fixture.animation;
+		compressedAnimation.compressed.reset(new gm::GMSkeletalCompressedAnimation(fixture.animation, settings));
+		gm::GMSkeletalAnimationEvaluator raw(fixture.root, &fixture.skeleton);
+		gm::GMSkeletalAnimationEvaluator decoded(fixture.root, &fixture.skeleton);
+		raw.setAnimation(&fixture.animation);
+		decoded.setAnimation(&compressedAnimation);
+		for (gm::GMint32 frame = 0; frame < 3; ++frame)
+		{
+			raw.evaluatePose(.27f);
+			decoded.evaluatePose(.27f);
+			for (gm::GMsize_t n = 1; n <= channelCount; ++n)
+			{
+				gm::GMfloat expected[4], actual[4];
+				getRotation(raw.getPose(), n, expected);
+				getRotation(decoded.getPose(), n, actual);
+				if (!quatEquals(expected, actual, 1e-4f))
+					return false;
+
+				for (gm::GMint32 stream = gm::GMSkeletalPose::PositionX; stream < gm::GMSkeletalPose::StreamCount; ++stream)
+				{
+					auto s = static_cast<gm::GMSkeletalPose::Stream>(stream);
+					if (Fabs(raw.getPose().getStream(s)[n] - decoded.getPose().getStream(s)[n]) > 1e-3f)
+						return false;
+				}
+			}
+		}
+
+		// 释放关键帧之后只保留通道的名称
+		gm::GMSkeletalAnimations animations;
+		animations.getAnimations().push_back(fixture.animation);
+		animations.compress(gm::GMSkeletalCompressionSettings());
+		const gm::GMSkeletalAnimation* released = animations.getAnimation(0);
+		return released->compressed
+			&& released->nodes.size() == channelCount
+			&& released->nodes[0].name == fixture.animation.nodes[0].name
+			&& released->nodes[0].rotations.empty()
+			&& released->nodes[0].positions.empty();
+	});
+}
@@ -2,6 +2,12 @@
 #include "thread.h"
 #include <gmthread.h>
 #include <gmasync.h>
+#include <gmjobsystem.h>
+#include <gmframegraph.h>
+#include <gmmessagequeue.h>
+#include <gmprofile.h>
+#include <gmthreadpool.h>
+#include <thread>
 
 #define LOOP_NUM 3
 volatile static gm::GMint32 g_testCode = 0;
@@ -159,6 +165,381 @@ void cases::Thread::addToUnitTest(UnitTest& ut)
 		return gm::__i == LOOP_NUM && finished;
 	});
 
+	ut.addTestCase("GMAsync nested wait", []() {
+		// 异步函数等待另一个异步函数的结果，异步函数的数量远多于工作线程时也不会死锁
+		Vector<gm::GMFuture<gm::GMint32>> results;
+		for (gm::GMint32 i = 0; i < 64; ++i)
+		{
+			results.push_back(gm::GMAsync::async(gm::GMAsync::Async, [i]() {
+				gm::GMFuture<gm::GMint32> inner = gm::GMAsync::async(gm::GMAsync::Async, [i]() {
+					gm::GMThread::sleep(1);
+					return i * 2;
+				});
+				return inner.get() + 1;
+			}));
+		}
+
+		for (gm::GMint32 i = 0; i < 64; ++i)
+		{
+			if (results[i].get() != i * 2 + 1)
+				return false;
+		}
+		return true;
+	});
+
+	ut.addTestCase("GMJobSystem parallelFor", []() {
+		std::vector<int> values(10000, 0);
+		gm::GMJobSystem::instance().parallelFor(0, values.size(), 64, [&values](gm::GMsize_t begin, gm::GMsize_t end) {
+			for (gm::GMsize_t i = begin; i < end; ++i)
+			{
+				values[i] = static_cast<int>(i);
+			}
+		});
+
+		for (gm::GMsize_t i = 0; i < values.size(); ++i)
+		{
+			if (values[i] != static_cast<int>(i))
+				return false;
+		}
+		return true;
+	});
+
+	ut.addTestCase("GMJobSystem dependencies", []() {
+		std::vector<int> order;
+		std::mutex m;
+		auto record = [&order, &m](int i) {
+			std::lock_guard<std::mutex> lock(m);
+			order.push_back(i);
+		};
+
+		gm::GMJobSystem& js = gm::GMJobSystem::instance();
+		gm::GMJobHandle first = js.schedule([&record]() { gm::GMThread::sleep(50); record(1); });
+		gm::GMJobHandle second = js.schedule([&record]() { record(2); }, first);
+		gm::GMJobHandle third = js.schedule([&record]() { record(3); }, { first, second });
+		js.wait(third);
+		return order.size() == 3 && order[0] == 1 && order[1] == 2 && order[2] == 3;
+	});
+
+	ut.addTestCase("GMJobSystem statistics", []() {
+		// 等待中的任务会嵌套执行其它任务，嵌套任务的时间不能重复统计，利用率不会超过100%
+		gm::GMJobSystem& js = gm::GMJobSystem::instance();
+		js.resetStatistics();
+		Vector<gm::GMJobHandle> jobs;
+		for (gm::GMint32 i = 0; i < 64; ++i)
+		{
+			jobs.push_back(js.schedule([&js]() {
+				Vector<gm::GMJobHandle> inner;
+				for (gm::GMint32 j = 0; j < 4; ++j)
+				{
+					inner.push_back(js.schedule([]() {
+						gm::GMThread::sleep(2);
+					}));
+				}
+				js.waitAll(inner);
+			}));
+		}
+		js.waitAll(jobs);
+
+		gm::GMWorkerStatistics statistics = js.getStatistics();
+		return statistics.tasksExecuted == 64 * 5 && statistics.utilization > 0 && statistics.utilization <= 1.f;
+	});
+
+	ut.addTestCase("GMFrameGraph", []() {
+		GMAtomic<int> updated(0);
+		bool mainThreadOrderCorrect = false;
+		bool workerOrderCorrect = false;
+		gm::GMThreadId mainThreadId = gm::GMThread::getCurrentThreadId();
+		bool ranOnMainThread = false;
+
+		gm::GMFrameGraph graph;
+		gm::GMFrameTaskId update = graph.addTask([&updated]() {
+			gm::GMJobSystem::instance().parallelFor(0, 100, 10, [&updated](gm::GMsize_t begin, gm::GMsize_t end) {
+				updated += static_cast<int>(end - begin);
+			});
+		});
+		gm::GMFrameTaskId submit = graph.addTask([&]() {
+			ranOnMainThread = gm::GMThread::getCurrentThreadId() == mainThreadId;
+			mainThreadOrderCorrect = updated == 100;
+		}, { update }, gm::GMFrameTaskThread::MainThread);
+		graph.addTask([&]() {
+			workerOrderCorrect = mainThreadOrderCorrect;
+		}, { submit });
+		graph.execute();
+		return ranOnMainThread && mainThreadOrderCorrect && workerOrderCorrect;
+	});
+
+	ut.addTestCase("GMMessageQueue", []() {
+		enum { ProducerCount = 4, MessageCount = 10000 };
+
+		// 容量很小，以便覆盖溢出队列
+		gm::GMMessageQueue queue(16);
+		gm::GMJobSystem& js = gm::GMJobSystem::instance();
+		Vector<gm::GMJobHandle> producers;
+		for (gm::GMint32 p = 0; p < ProducerCount; ++p)
+		{
+			producers.push_back(js.schedule([&queue, p]() {
+				for (gm::GMint32 i = 0; i < MessageCount; ++i)
+				{
+					queue.push({ gm::GameMachineMessageType::FrameUpdate, i, reinterpret_cast<void*>(static_cast<intptr_t>(p)) });
+				}
+			}));
+		}
+
+		gm::GMint32 expected[ProducerCount] = { 0 };
+		gm::GMint32 received = 0;
+		gm::GMMessage batch[32];
+		while (received < ProducerCount * MessageCount)
+		{
+			gm::GMsize_t count = queue.popBatch(batch, 32);
+			for (gm::GMsize_t i = 0; i < count; ++i)
+			{
+				intptr_t p = reinterpret_cast<intptr_t>(batch[i].object);
+				if (batch[i].param != expected[p]++)
+					return false;
+				queue.markHandled(batch[i]);
+			}
+			received += static_cast<gm::GMint32>(count);
+		}
+		js.waitAll(producers);
+
+		gm::GMMessage msg;
+		return !queue.pop(msg)
+			&& queue.getPostedCount(gm::GameMachineMessageType::FrameUpdate) == ProducerCount * MessageCount
+			&& queue.getHandledCount(gm::GameMachineMessageType::FrameUpdate) == ProducerCount * MessageCount
+			&& queue.getPostedCount(gm::GameMachineMessageType::QuitGameMachine) == 0;
+	});
+
+	ut.addTestCase("GMProfiler", []() {
+		gm::GMProfiler& profiler = gm::GMProfiler::instance();
+		profiler.setEnabled(true);
+		profiler.resetTimeline();
+		gm::GMJobSystem::instance().parallelFor(0, 16, 1, [](gm::GMsize_t, gm::GMsize_t) {
+			GM_PROFILE("unittest outer");
+			{
+				GM_PROFILE("unittest inner");
+			}
+		});
+		profiler.endFrame();
+		profiler.endFrame();
+		profiler.setEnabled(false);
+		profiler.flush();
+
+		bool counted = false;
+		for (const auto& item : profiler.getFrameSummary())
+		{
+			if (item.name == L"unittest outer")
+				counted = item.count == 16;
+		}
+		std::string trace = profiler.exportChromeTrace();
+		return counted && trace.find("\"name\":\"unittest inner\"") != std::string::npos;
+	});
+
+	ut.addTestCase("GMProfiler handler order", []() {
+		// 只记录本测试的作用域，其它线程可能同时在统计
+		struct Handler : public gm::IProfileHandler
+		{
+			virtual void beginProfile(const gm::GMString& name, gm::GMfloat, gm::GMThreadId, gm::GMint32 level) override
+			{
+				if (isOrderScope(name))
+					calls.push_back(L"+" + name + gm::GMString(level));
+			}
+
+			virtual void endProfile(const gm::GMString& name, gm::GMfloat, gm::GMThreadId, gm::GMint32 level) override
+			{
+				if (isOrderScope(name))
+					calls.push_back(L"-" + name + gm::GMString(level));
+			}
+
+			static bool isOrderScope(const gm::GMString& name)
+			{
+				return name == L"a" || name == L"b" || name == L"c" || name == L"d";
+			}
+
+			Vector<gm::GMString> calls;
+		};
+
+		gm::GMProfiler& profiler = gm::GMProfiler::instance();
+		Handler handler;
+		profiler.setEnabled(true);
+		profiler.setHandler(&handler);
+
+		// 事件按照结束顺序写入，内层先于外层，回调时需要还原为外层在前
+		std::thread thread([]() {
+			GM_PROFILE("a");
+			{
+				GM_PROFILE("b");
+				{
+					GM_PROFILE("c");
+				}
+			}
+			{
+				GM_PROFILE("d");
+			}
+		});
+		thread.join();
+		profiler.flush();
+
+		// setHandler()返回之后，旧的处理器不会再被调用
+		profiler.setHandler(nullptr);
+		profiler.setEnabled(false);
+
+		static const gm::GMwchar* s_expected[] = { L"+a0", L"+b1", L"+c2", L"-c2", L"-b1", L"+d1", L"-d1", L"-a0" };
+		if (handler.calls.size() != GM_array_size(s_expected))
+			return false;
+		for (gm::GMsize_t i = 0; i < handler.calls.size(); ++i)
+		{
+			if (handler.calls[i] != s_expected[i])
+				return false;
+		}
+		return true;
+	});
+
+	ut.addTestCase("GMThreadPool", []() {
+		gm::GMThreadPoolDesc desc;
+		desc.name = L"unittest pool";
+		desc.threadCount = 3;
+		desc.affinityMask = gm::GMThreadPool::backgroundAffinityMask();
+		gm::GMThreadPool pool(desc);
+
+		GMAtomic<gm::GMint32> sum(0);
+		Vector<gm::GMJobHandle> jobs;
+		for (gm::GMint32 i = 1; i <= 100; ++i)
+		{
+			jobs.push_back(pool.submit([&sum, i]() {
+				sum += i;
+			}));
+		}
+		for (const auto& job : jobs)
+		{
+			pool.wait(job);
+		}
+
+		bool result = sum == 5050 && pool.getStatistics().tasksExecuted == 100;
+		pool.stop();
+
+		// 停止后再次提交任务会重新启动线程池
+		gm::GMJobHandle job = pool.submit([&sum]() {
+			sum = 0;
+		});
+		pool.wait(job);
+		return result && sum == 0;
+	});
+
+	ut.addTestCase("GMThreadPool submit while stopping", []() {
+		gm::GMThreadPoolDesc desc;
+		desc.name = L"unittest stopping pool";
+		desc.threadCount = 2;
+		gm::GMThreadPool pool(desc);
+
+		// 一个线程不断提交任务，同时另一个线程停止线程池，所有任务都必须被执行
+		GMAtomic<gm::GMint32> executed(0);
+		Vector<gm::GMJobHandle> jobs;
+		std::thread producer([&]() {
+			for (gm::GMint32 i = 0; i < 2000; ++i)
+			{
+				jobs.push_back(pool.submit([&executed]() {
+					++executed;
+				}));
+			}
+		});
+		for (gm::GMint32 i = 0; i < 20; ++i)
+		{
+			pool.stop();
+		}
+		producer.join();
+
+		for (const auto& job : jobs)
+		{
+			pool.wait(job);
+		}
+		pool.stop();
+		return executed == 2000;
+	});
+
+	ut.addTestCase("GMReadWriteLock", []() {
+		gm::GMReadWriteLock lock;
+		gm::GMint32 value = 0;
+		bool consistent = true;
+		gm::GMJobSystem::instance().parallelFor(0, 64, 1, [&](gm::GMsize_t begin, gm::GMsize_t) {
+			for (gm::GMint32 i = 0; i < 1000; ++i)
+			{
+				if (begin % 4 == 0)
+				{
+					gm::GMLockGuard<gm::GMReadWriteLock> guard(lock);
+					++value;
+				}
+				else
+				{
+					gm::GMSharedLockGuard<gm::GMReadWriteLock> guard(lock);
+					if (value < 0)
+						consistent = false;
+				}
+			}
+		});
+
+		bool exclusive = false;
+		{
+			gm::GMSharedLockGuard<gm::GMReadWriteLock> guard(lock);
+			exclusive = !lock.tryLock() && lock.tryLockShared();
+			lock.unlockShared();
+		}
+		return consistent && exclusive && value == 16 * 1000;
+	});
+
+	ut.addTestCase("GMSpinLock", []() {
+		gm::GMSpinLock lock;
+		lock.setProfileName(L"unittest spinlock");
+		gm::GMint32 value = 0;
+		gm::GMJobSystem::instance().parallelFor(0, 16, 1, [&](gm::GMsize_t, gm::GMsize_t) {
+			for (gm::GMint32 i = 0; i < 10000; ++i)
+			{
+				gm::GMLockGuard<gm::GMSpinLock> guard(lock);
+				++value;
+			}
+		});
+
+		bool locked = lock.tryLock() && !lock.tryLock();
+		lock.unlock();
+		return locked && value == 16 * 10000;
+	});
+
+	ut.addTestCase("GMRandom", []() {
+		// 相同的种子产生相同的序列
+		gm::GMRandomXoshiro128::seed(42);
+		gm::GMfloat a[37];
+		gm::GMRandomXoshiro128::fill_real(a, GM_array_size(a), -1.f, 1.f);
+		gm::GMint32 i0 = gm::GMRandomXoshiro128::random_int(0, 1000);
+
+		gm::GMRandomXoshiro128::seed(42);
+		gm::GMfloat b[37];
+		gm::GMRandomXoshiro128::fill_real(b, GM_array_size(b), -1.f, 1.f);
+		gm::GMint32 i1 = gm::GMRandomXoshiro128::random_int(0, 1000);
+
+		bool result = i0 == i1;
+		for (gm::GMsize_t i = 0; i < GM_array_size(a); ++i)
+		{
+			result = result && a[i] == b[i] && a[i] >= -1.f && a[i] < 1.f;
+		}
+
+		// 每个线程拥有自己的引擎，设置相同的种子后得到相同的结果
+		Vector<gm::GMfloat> sums(8);
+		gm::GMJobSystem::instance().parallelFor(0, sums.size(), 1, [&sums](gm::GMsize_t begin, gm::GMsize_t) {
+			gm::GMRandomXoshiro128::seed(7);
+			gm::GMfloat values[256];
+			gm::GMRandomXoshiro128::fill_real(values, GM_array_size(values), 0.f, 1.f);
+			for (auto value : values)
+			{
+				sums[begin] += value;
+			}
+		});
+
+		for (auto sum : sums)
+		{
+			result = result && sum == sums[0];
+		}
+		return result && sums[0] > 100.f && sums[0] < 156.f;
+	});
+
 	ut.addTestCase("GMEvent", []() {
 		TestThread_Event thread;
 		thread.start();
@@ -8,6 +8,13 @@
 #include "cases/variant.h"
 #include "cases/lua.h"
 #include "cases/base64.h"
+#include "cases/memory.h"
+#include "cases/signal.h"
+#include "cases/particle.h"
+#include "cases/model.h"
+#include "cases/renderqueue.h"
+#include "cases/skeleton.h"
+#include "cases/gameworld.h"
 
 int main(int argc, char* argv[])
 {
@@ -22,7 +29,14 @@ int main(int argc, char* argv[])
 		new cases::Thread(),
 		new cases::Variant(),
 		new cases::Lua(),
-		new cases::Base64()
+		new cases::Base64(),
+		new cases::Memory(),
+		new cases::Signal(),
+		new cases::Particle(),
+		new cases::Model(),
+		new cases::RenderQueue(),
+		new cases::Skeleton(),
+		new cases::GameWorld()
 	};
 
 	for (auto& c : caseArray)